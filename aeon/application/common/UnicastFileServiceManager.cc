@@ -38,6 +38,8 @@
 
 using namespace std;
 
+static const uint64_t READAHEAD_BLOCKS = 8;
+
 UnicastFileServiceManager::UnicastFileServiceManager(BlockManager& bm,
 						     BufferedTransportServiceClass& router,
 						     bool rts) :
@@ -220,6 +222,10 @@ void UnicastFileServiceManager::loadData() {
   unicast_file_header h;
   h.sequence = currentBlock;
   data.append((char*)&h, sizeof(unicast_file_header));
+  // keep the next blocks in flight while this one is sent
+  for (uint64_t i = currentBlock + 1; i <= currentBlock + READAHEAD_BLOCKS; i++) {
+    blockManager.prefetchBlock(i);
+  }
   string block = blockManager.getBlock(currentBlock);
   data.append(block);
   diskc += (TimeUtil::timeu() - now);
@@ -40,6 +40,7 @@
 #include "lib/params.h"
 #include "lib/Log.h"
 #include "application/common/UnicastFileServiceManager.h"
+#include "AsyncFileBlockManager.h"
 #include "BufferedTransportServiceClass.h"
 #include "services/Transport/TcpTransport-init.h"
 #include "Accumulator.h"
@@ -81,7 +82,7 @@ int main(int argc, char* argv[]) {
 //   Accumulator::startLogging(100*1000);
   Accumulator::startLogging();
 
-  FileBlockManager bm;
+  AsyncFileBlockManager bm;
 //   NullBlockManager bm(NULL_SIZE);
 
   BufferedTransportServiceClass& router =
@@ -60,6 +60,13 @@ class SimTimeUtil : public TimeUtil, public mace::PrintPrintable {
     time_t timeImpl() {
       return nodeTimes[Sim::getCurrentNode()]/(1*1000*1000); //convert from microseconds to seconds
     }
+    // simulated time never jumps, so the monotonic clocks are the node's time too
+    uint64_t monotimeuImpl() {
+      return timeuImpl();
+    }
+    uint64_t coarsetimeuImpl() {
+      return timeuImpl();
+    }
     uint64_t realTimeuImpl() {
       return TimeUtil::timeuImpl();
     }
@@ -35,6 +35,7 @@
 #include "ThreadCreate.h"
 #include "mace-macros.h"
 #include "DummyServiceMapper.h"
+#include "Metrics.h"
 
 using std::cerr;
 using std::endl;
@@ -155,6 +156,7 @@ void Accumulator::dumpAll() {
     maceLog("accumulator %s amount %" PRIu64,
 	      i->first.c_str(), i->second->getAmount());
   }
+  mace::Metrics::dumpAll();
 }
 
 void Accumulator::logAll() {
@@ -177,6 +179,8 @@ void Accumulator::startLogging(uint64_t interval) {
     pthread_attr_setdetachstate(&threadAttr, PTHREAD_CREATE_JOINABLE);
 
     runNewThread(&athread, Accumulator::startLoggingThread, &sint, &threadAttr);
+    // the transport and event metrics used to be accumulators
+    mace::Metrics::startLogging(interval);
   }
   else {
     Log::err() << "cannot start Accumulator logging more than once" << Log::endl;
@@ -185,6 +189,7 @@ void Accumulator::startLogging(uint64_t interval) {
 
 void Accumulator::stopLogging() {
   isLogging = false;
+  mace::Metrics::stopLogging();
 }
 
 mace::BinaryLogObject* accumulatorLogFactory() {
@@ -0,0 +1,658 @@
+/* 
+ * AsyncFileBlockManager.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "maceConfig.h"
+#include "Log.h"
+#include "ScopedLock.h"
+#include "AsyncFileBlockManager.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define USE_IO_URING
+#endif
+#endif
+
+using namespace std;
+
+struct AsyncFileBlockManager::Request {
+  bool write;
+  uint64_t index;
+  char* buffer;
+  size_t size;
+  Callback* cb;
+  ssize_t result;
+  struct iovec iov;
+};
+
+namespace {
+  /// blocks the caller until its one request completes
+  class SyncCallback : public AsyncFileBlockManager::Callback {
+  public:
+    SyncCallback() : done(false), result(0) {
+      pthread_mutex_init(&lock, NULL);
+      pthread_cond_init(&cond, NULL);
+    }
+    ~SyncCallback() {
+      pthread_cond_destroy(&cond);
+      pthread_mutex_destroy(&lock);
+    }
+    void blockRead(uint64_t index, char* buffer, ssize_t r) {
+      signal(r);
+    }
+    void blockWritten(uint64_t index, const char* buffer, ssize_t r) {
+      signal(r);
+    }
+    ssize_t wait() {
+      ScopedLock sl(lock);
+      while (!done) {
+        pthread_cond_wait(&cond, &lock);
+      }
+      return result;
+    }
+  private:
+    void signal(ssize_t r) {
+      ScopedLock sl(lock);
+      result = r;
+      done = true;
+      pthread_cond_signal(&cond);
+    }
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool done;
+    ssize_t result;
+  };
+
+#ifdef USE_IO_URING
+  int io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+  }
+
+  int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+  }
+#endif
+}
+
+class AsyncFileBlockManager::PrefetchCallback : public AsyncFileBlockManager::Callback {
+public:
+  PrefetchCallback(AsyncFileBlockManager& m) : manager(m) { }
+  void blockRead(uint64_t index, char* buffer, ssize_t result) {
+    ScopedLock sl(manager.lock);
+    PrefetchMap::iterator i = manager.prefetched.find(index);
+    ASSERT(i != manager.prefetched.end());
+    i->second.done = true;
+    i->second.result = result;
+    pthread_cond_broadcast(&manager.cond);
+  }
+  void blockWritten(uint64_t index, const char* buffer, ssize_t result) { }
+private:
+  AsyncFileBlockManager& manager;
+};
+
+AsyncFileBlockManager::AsyncFileBlockManager(unsigned queueDepth, unsigned threads,
+                                             unsigned readahead, bool useUring) :
+  queueDepth(queueDepth), threadCount(threads), readahead(readahead), useUring(useUring),
+  isOpenFlag(false), stopping(false), path("(null)"), fd(-1), flags(0), released(0),
+  inflight(0), running(0), submitCount(0), prefetchCallback(new PrefetchCallback(*this)),
+  uringFd(-1), sqRing(NULL), sqRingSize(0), cqRing(NULL), cqRingSize(0), sqes(NULL), sqesSize(0),
+  sqHead(NULL), sqTail(NULL), sqMask(NULL), sqArray(NULL),
+  cqHead(NULL), cqTail(NULL), cqMask(NULL), cqes(NULL) {
+  ASSERT(queueDepth > 0);
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&cond, NULL);
+  pthread_cond_init(&workReady, NULL);
+
+  if (useUring && setupUring()) {
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, startCompletionThread, this) == 0);
+    this->threads.push_back(t);
+  }
+  else {
+    ASSERT(threadCount > 0);
+    for (unsigned i = 0; i < threadCount; i++) {
+      pthread_t t;
+      ASSERT(pthread_create(&t, NULL, startWorkerThread, this) == 0);
+      this->threads.push_back(t);
+    }
+  }
+} // AsyncFileBlockManager
+
+AsyncFileBlockManager::~AsyncFileBlockManager() {
+  close();
+  shutdown();
+  delete prefetchCallback;
+  pthread_cond_destroy(&workReady);
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&lock);
+} // ~AsyncFileBlockManager
+
+const string& AsyncFileBlockManager::getPath() const {
+  return path;
+}
+
+string AsyncFileBlockManager::getFileName() const {
+  if (path.find("/") != string::npos) {
+    return path.substr(path.rfind("/")+1);
+  }
+  else {
+    return path;
+  }
+}
+
+bool AsyncFileBlockManager::setupUring() {
+#ifdef USE_IO_URING
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int rfd = io_uring_setup(queueDepth, &p);
+  if (rfd < 0) {
+    Log::logf("AsyncFileBlockManager::setupUring",
+              "io_uring unavailable (%s), using %u threads", strerror(errno), threadCount);
+    return false;
+  }
+
+  sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  bool singleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    singleMmap = true;
+    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+  }
+#endif
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED) {
+    ::close(rfd);
+    sqRing = NULL;
+    return false;
+  }
+  if (singleMmap) {
+    cqRing = sqRing;
+  }
+  else {
+    cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) {
+      munmap(sqRing, sqRingSize);
+      ::close(rfd);
+      sqRing = cqRing = NULL;
+      return false;
+    }
+  }
+  sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (cqRing != sqRing) {
+      munmap(cqRing, cqRingSize);
+    }
+    munmap(sqRing, sqRingSize);
+    ::close(rfd);
+    sqRing = cqRing = sqes = NULL;
+    return false;
+  }
+
+  char* sq = (char*)sqRing;
+  sqHead = (unsigned*)(sq + p.sq_off.head);
+  sqTail = (unsigned*)(sq + p.sq_off.tail);
+  sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+  sqArray = (unsigned*)(sq + p.sq_off.array);
+  char* cq = (char*)cqRing;
+  cqHead = (unsigned*)(cq + p.cq_off.head);
+  cqTail = (unsigned*)(cq + p.cq_off.tail);
+  cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+  cqes = cq + p.cq_off.cqes;
+  uringFd = rfd;
+  Log::logf("AsyncFileBlockManager::setupUring", "using io_uring with %u entries", p.sq_entries);
+  return true;
+#else
+  return false;
+#endif
+} // setupUring
+
+void AsyncFileBlockManager::shutdown() {
+  {
+    ScopedLock sl(lock);
+    stopping = true;
+#ifdef USE_IO_URING
+    if (uringFd >= 0) {
+      // a nop with no request wakes the completion thread to exit
+      unsigned tail = *sqTail;
+      unsigned idx = tail & *sqMask;
+      struct io_uring_sqe* sqe = (struct io_uring_sqe*)sqes + idx;
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = 0;
+      sqArray[idx] = idx;
+      __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+      while (io_uring_enter(uringFd, 1, 0, 0) < 0 && errno == EINTR);
+    }
+#endif
+    pthread_cond_broadcast(&workReady);
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    pthread_join(threads[i], NULL);
+  }
+  threads.clear();
+#ifdef USE_IO_URING
+  if (uringFd >= 0) {
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing) {
+      munmap(cqRing, cqRingSize);
+    }
+    munmap(sqRing, sqRingSize);
+    ::close(uringFd);
+    uringFd = -1;
+  }
+#endif
+} // shutdown
+
+int AsyncFileBlockManager::open(const std::string& p, const char* mode) {
+  if (isOpen()) {
+    return 0;
+  }
+  Log::logf("AsyncFileBlockManager::open", "path=%s mode=%s", p.c_str(), mode);
+
+  // translate the fopen mode
+  bool plus = strchr(mode, '+') != NULL;
+  switch (mode[0]) {
+  case 'r': flags = plus ? O_RDWR : O_RDONLY; break;
+  case 'w': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+  case 'a': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT; break;
+  default:
+    fprintf(stderr, "AsyncFileBlockManager::open: bad mode %s\n", mode);
+    exit(-1);
+  }
+
+  fd = ::open(p.c_str(), flags, 0666);
+  if (fd < 0) {
+    perror("AsyncFileBlockManager: open");
+    exit(-1);
+  }
+
+  isOpenFlag = true;
+  path = p;
+
+  struct stat sbuf;
+  if (fstat(fd, &sbuf) != 0) {
+    perror("AsyncFileBlockManager::open: fstat");
+    exit(-1);
+  }
+
+  size = sbuf.st_size;
+  blockCount = size / blockSize;
+  if ((size % blockSize) != 0) {
+    blockCount++;
+  }
+
+  Log::logf("AsyncFileBlockManager::open",
+	    "opened file %d size=%" PRIu64 " blockSize=%zu blockCount=%"
+	    PRIu64 , fd, size, blockSize, blockCount);
+
+  return 0;
+} // open
+
+bool AsyncFileBlockManager::isOpen() const {
+  return isOpenFlag;
+} // isOpen
+
+int AsyncFileBlockManager::close() {
+  if (!isOpen()) {
+    return 0;
+  }
+  drain();
+  ScopedLock sl(lock);
+  for (PrefetchMap::iterator i = prefetched.begin(); i != prefetched.end(); i++) {
+    delete [] i->second.buffer;
+  }
+  prefetched.clear();
+  isOpenFlag = false;
+  Log::logf("AsyncFileBlockManager::close", "closing file %d", fd);
+  int r = ::close(fd);
+  fd = -1;
+  return r;
+} // close
+
+int AsyncFileBlockManager::flush() {
+  if (!isOpen()) {
+    return 0;
+  }
+  drain();
+  if ((flags & O_ACCMODE) == O_RDONLY) {
+    return 0;
+  }
+  return fdatasync(fd);
+} // flush
+
+void AsyncFileBlockManager::readBlock(uint64_t index, char* buffer, Callback* cb) {
+  ASSERT(isOpen());
+  Request* r = new Request();
+  r->write = false;
+  r->index = index;
+  r->buffer = buffer;
+  r->size = blockSize;
+  r->cb = cb;
+  r->result = 0;
+  enqueue(r);
+} // readBlock
+
+void AsyncFileBlockManager::writeBlock(uint64_t index, const char* buffer, size_t sz, Callback* cb) {
+  ASSERT(isOpen());
+  ASSERT(sz <= blockSize);
+  Request* r = new Request();
+  r->write = true;
+  r->index = index;
+  r->buffer = const_cast<char*>(buffer);
+  r->size = sz;
+  r->cb = cb;
+  r->result = 0;
+  enqueue(r);
+} // writeBlock
+
+ssize_t AsyncFileBlockManager::readBlock(uint64_t index, char* buffer) {
+  SyncCallback cb;
+  readBlock(index, buffer, &cb);
+  submit();
+  return cb.wait();
+} // readBlock
+
+string AsyncFileBlockManager::getBlock(uint64_t index) {
+  ASSERT(isOpen());
+  ssize_t r;
+  {
+    ScopedLock sl(lock);
+    PrefetchMap::iterator i = prefetched.find(index);
+    if (i != prefetched.end()) {
+      while (!i->second.done) {
+        pthread_cond_wait(&cond, &lock);
+      }
+      r = i->second.result;
+      char* buf = i->second.buffer;
+      prefetched.erase(i);
+      if (r < 0) {
+        delete [] buf;
+        fprintf(stderr, "AsyncFileBlockManager::getBlock: read: %s\n", strerror(-r));
+        exit(-1);
+      }
+      string s(buf, r);
+      delete [] buf;
+      return s;
+    }
+  }
+
+  string s(blockSize, '\0');
+  r = readBlock(index, &s[0]);
+  if (r < 0) {
+    fprintf(stderr, "AsyncFileBlockManager::getBlock: read: %s\n", strerror(-r));
+    exit(-1);
+  }
+  s.resize(r);
+  return s;
+} // getBlock
+
+size_t AsyncFileBlockManager::setBlock(uint64_t index, const string& buf) {
+  ASSERT(isOpen());
+  {
+    // a pending readahead of this block would now be stale
+    ScopedLock sl(lock);
+    PrefetchMap::iterator i = prefetched.find(index);
+    while (i != prefetched.end() && !i->second.done) {
+      pthread_cond_wait(&cond, &lock);
+      i = prefetched.find(index);
+    }
+    if (i != prefetched.end()) {
+      delete [] i->second.buffer;
+      prefetched.erase(i);
+    }
+  }
+  SyncCallback cb;
+  writeBlock(index, buf.data(), buf.size(), &cb);
+  submit();
+  ssize_t r = cb.wait();
+  if (r < 0) {
+    fprintf(stderr, "AsyncFileBlockManager::setBlock: write: %s\n", strerror(-r));
+    exit(-1);
+  }
+  return r;
+} // setBlock
+
+void AsyncFileBlockManager::prefetchBlock(uint64_t index) {
+  if (!isOpen() || index >= blockCount) {
+    return;
+  }
+  char* buf;
+  {
+    ScopedLock sl(lock);
+    if (prefetched.size() >= readahead || prefetched.find(index) != prefetched.end()) {
+      return;
+    }
+    buf = new char[blockSize];
+    Prefetch& p = prefetched[index];
+    p.buffer = buf;
+    p.done = false;
+    p.result = 0;
+  }
+  readBlock(index, buf, prefetchCallback);
+  submit();
+} // prefetchBlock
+
+void AsyncFileBlockManager::enqueue(Request* r) {
+  r->iov.iov_base = r->buffer;
+  r->iov.iov_len = r->size;
+  ScopedLock sl(lock);
+  queued.push_back(r);
+  if (queued.size() - released >= queueDepth) {
+    released = queued.size();
+    dispatch();
+  }
+} // enqueue
+
+void AsyncFileBlockManager::submit() {
+  ScopedLock sl(lock);
+  released = queued.size();
+  dispatch();
+} // submit
+
+void AsyncFileBlockManager::drain() {
+  ScopedLock sl(lock);
+  released = queued.size();
+  dispatch();
+  while (inflight > 0 || running > 0 || !queued.empty()) {
+    pthread_cond_wait(&cond, &lock);
+  }
+} // drain
+
+void AsyncFileBlockManager::dispatch() {
+  // called with lock held; sends released requests while there is room in flight
+  size_t n = std::min(released, (size_t)(queueDepth - inflight));
+  if (n == 0) {
+    return;
+  }
+  std::vector<Request*> batch(queued.begin(), queued.begin() + n);
+  queued.erase(queued.begin(), queued.begin() + n);
+  released -= n;
+  inflight += n;
+  submitCount++;
+  if (uringFd >= 0) {
+    submitUring(batch);
+  }
+  else {
+    work.insert(work.end(), batch.begin(), batch.end());
+    pthread_cond_broadcast(&workReady);
+  }
+} // dispatch
+
+void AsyncFileBlockManager::submitUring(const std::vector<Request*>& batch) {
+#ifdef USE_IO_URING
+  unsigned tail = *sqTail;
+  for (size_t i = 0; i < batch.size(); i++) {
+    Request* r = batch[i];
+    unsigned idx = tail & *sqMask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = r->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = r->index * blockSize;
+    sqe->addr = (uintptr_t)&r->iov;
+    sqe->len = 1;
+    sqe->user_data = (uintptr_t)r;
+    sqArray[idx] = idx;
+    tail++;
+  }
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+  unsigned submitted = 0;
+  while (submitted < batch.size()) {
+    int n = io_uring_enter(uringFd, batch.size() - submitted, 0, 0);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      perror("AsyncFileBlockManager::submit: io_uring_enter");
+      exit(-1);
+    }
+    submitted += n;
+  }
+#endif
+} // submitUring
+
+void AsyncFileBlockManager::complete(Request* r) {
+  {
+    ScopedLock sl(lock);
+    inflight--;
+    running++;
+    dispatch();
+  }
+  if (r->cb != NULL) {
+    if (r->write) {
+      r->cb->blockWritten(r->index, r->buffer, r->result);
+    }
+    else {
+      r->cb->blockRead(r->index, r->buffer, r->result);
+    }
+  }
+  delete r;
+  ScopedLock sl(lock);
+  running--;
+  pthread_cond_broadcast(&cond);
+} // complete
+
+void AsyncFileBlockManager::runCompletions() {
+#ifdef USE_IO_URING
+  while (true) {
+    if (io_uring_enter(uringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      perror("AsyncFileBlockManager::runCompletions: io_uring_enter");
+      exit(-1);
+    }
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    bool exit = false;
+    while (head != tail) {
+      struct io_uring_cqe* cqe = (struct io_uring_cqe*)cqes + (head & *cqMask);
+      Request* r = (Request*)(uintptr_t)cqe->user_data;
+      if (r == NULL) {
+        exit = true;
+      }
+      else {
+        r->result = cqe->res;
+        complete(r);
+      }
+      head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    if (exit) {
+      return;
+    }
+  }
+#endif
+} // runCompletions
+
+void AsyncFileBlockManager::runWorker() {
+  while (true) {
+    Request* r;
+    {
+      ScopedLock sl(lock);
+      while (work.empty() && !stopping) {
+        pthread_cond_wait(&workReady, &lock);
+      }
+      if (work.empty()) {
+        return;
+      }
+      r = work.front();
+      work.pop_front();
+    }
+
+    off_t offset = r->index * blockSize;
+    size_t done = 0;
+    while (done < r->size) {
+      ssize_t n = r->write ?
+        pwrite(fd, r->buffer + done, r->size - done, offset + done) :
+        pread(fd, r->buffer + done, r->size - done, offset + done);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        done = 0;
+        r->result = -errno;
+        break;
+      }
+      if (n == 0) {
+        break;
+      }
+      done += n;
+    }
+    if (r->result == 0) {
+      r->result = done;
+    }
+    complete(r);
+  }
+} // runWorker
+
+void* AsyncFileBlockManager::startCompletionThread(void* arg) {
+  ((AsyncFileBlockManager*)arg)->runCompletions();
+  return NULL;
+} // startCompletionThread
+
+void* AsyncFileBlockManager::startWorkerThread(void* arg) {
+  ((AsyncFileBlockManager*)arg)->runWorker();
+  return NULL;
+} // startWorkerThread
@@ -0,0 +1,189 @@
+/* 
+ * AsyncFileBlockManager.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <pthread.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BlockManager.h"
+
+#ifndef ASYNC_FILE_BLOCK_MANAGER_H
+#define ASYNC_FILE_BLOCK_MANAGER_H
+
+/**
+ * \file AsyncFileBlockManager.h
+ * \brief declares the AsyncFileBlockManager class
+ */
+
+/**
+ * \addtogroup BlockManagers
+ * @{
+ */
+
+/**
+ * \brief BlockManager for files with asynchronous, batched block I/O.
+ *
+ * Reads and writes are queued with readBlock() and writeBlock() into caller
+ * provided buffers, handed to the kernel together by submit(), and reported
+ * to a Callback from a completion thread.  On Linux the requests go through
+ * io_uring; where io_uring is unavailable they are served by a pool of
+ * threads doing pread and pwrite.
+ *
+ * The synchronous BlockManager interface is layered on top: prefetchBlock()
+ * starts a read into an internal readahead buffer, and a later getBlock()
+ * for that block waits for it instead of reading again.
+ *
+ * Buffers passed to readBlock() and writeBlock() must stay valid until the
+ * callback for the request has run.
+ */
+class AsyncFileBlockManager : public BlockManager {
+public:
+  /// receives the completion of an asynchronous request
+  class Callback {
+  public:
+    /// \c result is the number of bytes read, or -errno
+    virtual void blockRead(uint64_t index, char* buffer, ssize_t result) = 0;
+    /// \c result is the number of bytes written, or -errno
+    virtual void blockWritten(uint64_t index, const char* buffer, ssize_t result) = 0;
+    virtual ~Callback() {}
+  };
+
+  static const unsigned DEFAULT_QUEUE_DEPTH = 64;
+  static const unsigned DEFAULT_THREADS = 4;
+  static const unsigned DEFAULT_READAHEAD = 16;
+
+  /**
+   * \param queueDepth maximum number of requests in flight
+   * \param threads number of pread/pwrite threads when io_uring is unavailable
+   * \param readahead maximum number of prefetched blocks held
+   * \param useUring set false to always use the thread pool
+   */
+  AsyncFileBlockManager(unsigned queueDepth = DEFAULT_QUEUE_DEPTH, unsigned threads = DEFAULT_THREADS,
+                        unsigned readahead = DEFAULT_READAHEAD, bool useUring = true);
+  virtual ~AsyncFileBlockManager();
+
+  virtual const std::string& getPath() const;
+  virtual std::string getFileName() const;
+  virtual std::string getBlock(uint64_t index);
+  virtual size_t setBlock(uint64_t index, const std::string& buffer);
+  virtual void prefetchBlock(uint64_t index);
+  virtual int open(const std::string& path, const char* mode);
+  virtual bool isOpen() const;
+  virtual int close();
+  virtual int flush();
+
+  /// queues a read of block \c index into \c buffer, which holds at least getBlockSize() bytes
+  void readBlock(uint64_t index, char* buffer, Callback* cb);
+  /// queues a write of \c size bytes from \c buffer to block \c index
+  void writeBlock(uint64_t index, const char* buffer, size_t size, Callback* cb);
+  /// hands every queued request to the kernel or the thread pool at once
+  void submit();
+  /// reads block \c index into \c buffer, returning the bytes read or -errno
+  ssize_t readBlock(uint64_t index, char* buffer);
+  /// submits queued requests and waits for every request in flight to complete
+  void drain();
+
+  /// true if requests go through io_uring rather than the thread pool
+  bool isUsingUring() const { return uringFd >= 0; }
+  /// number of submit batches issued
+  uint64_t getSubmitCount() const { return submitCount; }
+
+  struct Request;
+
+private:
+  struct Prefetch {
+    char* buffer;
+    bool done;
+    ssize_t result;
+  };
+  typedef std::map<uint64_t, Prefetch> PrefetchMap;
+  class PrefetchCallback;
+  friend class PrefetchCallback;
+
+  void enqueue(Request* r);
+  void complete(Request* r);
+  bool setupUring();
+  void dispatch();
+  void submitUring(const std::vector<Request*>& batch);
+  void runCompletions();
+  void runWorker();
+  void shutdown();
+  static void* startCompletionThread(void* arg);
+  static void* startWorkerThread(void* arg);
+
+  const unsigned queueDepth;
+  const unsigned threadCount;
+  const unsigned readahead;
+  const bool useUring;
+  bool isOpenFlag;
+  bool stopping;
+  std::string path;
+  int fd;
+  int flags;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_cond_t workReady;
+  std::vector<Request*> queued;
+  /// number of requests at the front of queued that submit() has released
+  size_t released;
+  std::deque<Request*> work;
+  unsigned inflight;
+  /// completed requests whose callbacks are still running
+  unsigned running;
+  uint64_t submitCount;
+  PrefetchMap prefetched;
+  PrefetchCallback* prefetchCallback;
+  std::vector<pthread_t> threads;
+
+  // io_uring rings
+  int uringFd;
+  void* sqRing;
+  size_t sqRingSize;
+  void* cqRing;
+  size_t cqRingSize;
+  void* sqes;
+  size_t sqesSize;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void* cqes;
+}; // AsyncFileBlockManager
+
+/** @} */
+
+#endif // ASYNC_FILE_BLOCK_MANAGER_H
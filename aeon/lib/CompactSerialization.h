@@ -0,0 +1,318 @@
+/* 
+ * CompactSerialization.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _MACE_COMPACT_SERIALIZATION_H
+#define _MACE_COMPACT_SERIALIZATION_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <limits>
+#include "Serializable.h"
+#include "m_map.h"
+#include "mpair.h"
+#include "mset.h"
+#include "mvector.h"
+
+/**
+ * \file CompactSerialization.h
+ * \brief declares serializeCompact() and deserializeCompact(), the opt-in compact wire format
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/*
+ * The compact format is selected per type: macec emits serializeCompact()
+ * and deserializeCompact() for the fields of messages and auto types
+ * declared with __attribute((serialize(compact))), and hand-written
+ * serializers may call them directly.  Both ends must agree on the format
+ * for a type, which they do when built from the same declaration.
+ *
+ * - unsigned integers are LEB128 varints: 7 bits per byte, low bits first,
+ *   high bit set on every byte but the last.
+ * - signed integers are zigzag mapped (0, -1, 1, -2, ... to 0, 1, 2, 3, ...)
+ *   and then written as varints.
+ * - string, vector, set and map sizes are varints.
+ * - integer keys of sets and maps are written as the difference from the
+ *   previous key, so sorted keys cost roughly log128 of the gap between them.
+ * - anything else falls back to mace::serialize().
+ */
+
+/// append \c v as a LEB128 varint
+inline void serializeVarint(std::string& str, uint64_t v) {
+  char buf[10];
+  size_t n = 0;
+  while (v >= 0x80) {
+    buf[n++] = static_cast<char>(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = static_cast<char>(v);
+  str.append(buf, n);
+}
+
+/// read a LEB128 varint into \c v, returning the number of bytes read
+inline int deserializeVarint(std::istream& in, uint64_t& v) throw(SerializationException) {
+  v = 0;
+  for (int n = 0; n < 10; n++) {
+    int c = in.get();
+    if (c == EOF) {
+      throw SerializationException("could not read varint");
+    }
+    v |= static_cast<uint64_t>(c & 0x7f) << (7 * n);
+    if (!(c & 0x80)) {
+      return n + 1;
+    }
+  }
+  throw SerializationException("varint longer than 10 bytes");
+}
+
+inline uint64_t zigzagEncode(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+/// read a varint that must fit in \c T
+template<typename T>
+inline int deserializeVarintAs(std::istream& in, T* pitem) throw(SerializationException) {
+  uint64_t v;
+  int n = deserializeVarint(in, v);
+  if (v > static_cast<uint64_t>(std::numeric_limits<T>::max())) {
+    throw SerializationException("varint out of range for " + std::string(typeid(T).name()));
+  }
+  *pitem = static_cast<T>(v);
+  return n;
+}
+
+/// read a zigzag varint that must fit in \c T
+template<typename T>
+inline int deserializeZigzagAs(std::istream& in, T* pitem) throw(SerializationException) {
+  uint64_t v;
+  int n = deserializeVarint(in, v);
+  int64_t s = zigzagDecode(v);
+  if (s > static_cast<int64_t>(std::numeric_limits<T>::max()) ||
+      s < static_cast<int64_t>(std::numeric_limits<T>::min())) {
+    throw SerializationException("varint out of range for " + std::string(typeid(T).name()));
+  }
+  *pitem = static_cast<T>(s);
+  return n;
+}
+
+/**
+ * \brief read a string or container size, rejecting one that cannot fit in
+ * what is left of \c in.
+ *
+ * Every byte and every element takes at least one byte on the wire, so a
+ * corrupt length is caught before it is used to size a buffer.  A stream
+ * that cannot tell how much input remains (in_avail() of 0) is not checked.
+ */
+inline int deserializeCompactSize(std::istream& in, uint32_t& sz) throw(SerializationException) {
+  int n = deserializeVarintAs(in, &sz);
+  std::streamsize avail = in.rdbuf() ? in.rdbuf()->in_avail() : 0;
+  if (avail != 0 && static_cast<std::streamsize>(sz) > std::max(avail, static_cast<std::streamsize>(0))) {
+    throw SerializationException("size " + boost::lexical_cast<std::string>(sz) + " exceeds the remaining input");
+  }
+  return n;
+}
+
+/// types without a compact form use the default encoding
+template<typename T>
+inline void serializeCompact(std::string& str, const T* pitem) {
+  mace::serialize(str, pitem);
+}
+
+template<typename T>
+inline int deserializeCompact(std::istream& in, T* pitem) throw(SerializationException) {
+  return mace::deserialize(in, pitem);
+}
+
+inline void serializeCompact(std::string& str, const uint16_t* pitem) { serializeVarint(str, *pitem); }
+inline void serializeCompact(std::string& str, const uint32_t* pitem) { serializeVarint(str, *pitem); }
+inline void serializeCompact(std::string& str, const uint64_t* pitem) { serializeVarint(str, *pitem); }
+inline void serializeCompact(std::string& str, const int16_t* pitem) { serializeVarint(str, zigzagEncode(*pitem)); }
+inline void serializeCompact(std::string& str, const int32_t* pitem) { serializeVarint(str, zigzagEncode(*pitem)); }
+inline void serializeCompact(std::string& str, const int64_t* pitem) { serializeVarint(str, zigzagEncode(*pitem)); }
+
+inline int deserializeCompact(std::istream& in, uint16_t* pitem) throw(SerializationException) { return deserializeVarintAs(in, pitem); }
+inline int deserializeCompact(std::istream& in, uint32_t* pitem) throw(SerializationException) { return deserializeVarintAs(in, pitem); }
+inline int deserializeCompact(std::istream& in, uint64_t* pitem) throw(SerializationException) { return deserializeVarintAs(in, pitem); }
+inline int deserializeCompact(std::istream& in, int16_t* pitem) throw(SerializationException) { return deserializeZigzagAs(in, pitem); }
+inline int deserializeCompact(std::istream& in, int32_t* pitem) throw(SerializationException) { return deserializeZigzagAs(in, pitem); }
+inline int deserializeCompact(std::istream& in, int64_t* pitem) throw(SerializationException) { return deserializeZigzagAs(in, pitem); }
+
+/// strings are a varint length followed by the bytes
+inline void serializeCompact(std::string& str, const std::string* pitem) {
+  serializeVarint(str, pitem->size());
+  str.append(*pitem);
+}
+
+inline int deserializeCompact(std::istream& in, std::string* pitem) throw(SerializationException) {
+  uint32_t sz;
+  int n = deserializeCompactSize(in, sz);
+  pitem->resize(sz);
+  if (sz > 0) {
+    in.read(&(*pitem)[0], sz);
+    if (!in) {
+      throw SerializationException("could not read " + boost::lexical_cast<std::string>(sz) + " bytes");
+    }
+  }
+  return n + sz;
+}
+
+/**
+ * \brief how a set or map writes its keys: delta from the previous key for
+ * integers, the key's own compact form otherwise.
+ *
+ * Deltas are taken modulo 2^64, so any key order round trips; ascending
+ * keys (the default std::less ordering) give small deltas.
+ */
+template<typename K>
+struct CompactKeyCoder {
+  K prev;
+  CompactKeyCoder() : prev() {}
+  void put(std::string& str, const K& k) { serializeCompact(str, &k); }
+  int get(std::istream& in, K& k) { return deserializeCompact(in, &k); }
+};
+
+template<typename K>
+struct CompactIntegerKeyCoder {
+  K prev;
+  CompactIntegerKeyCoder() : prev(0) {}
+  void put(std::string& str, const K& k) {
+    serializeVarint(str, static_cast<uint64_t>(k) - static_cast<uint64_t>(prev));
+    prev = k;
+  }
+  int get(std::istream& in, K& k) throw(SerializationException) {
+    uint64_t delta;
+    int n = deserializeVarint(in, delta);
+    k = static_cast<K>(static_cast<uint64_t>(prev) + delta);
+    prev = k;
+    return n;
+  }
+};
+
+template<> struct CompactKeyCoder<uint16_t> : public CompactIntegerKeyCoder<uint16_t> {};
+template<> struct CompactKeyCoder<uint32_t> : public CompactIntegerKeyCoder<uint32_t> {};
+template<> struct CompactKeyCoder<uint64_t> : public CompactIntegerKeyCoder<uint64_t> {};
+template<> struct CompactKeyCoder<int16_t> : public CompactIntegerKeyCoder<int16_t> {};
+template<> struct CompactKeyCoder<int32_t> : public CompactIntegerKeyCoder<int32_t> {};
+template<> struct CompactKeyCoder<int64_t> : public CompactIntegerKeyCoder<int64_t> {};
+
+template<typename A, typename B>
+inline void serializeCompact(std::string& str, const mace::pair<A, B>* pitem) {
+  serializeCompact(str, &pitem->first);
+  serializeCompact(str, &pitem->second);
+}
+
+template<typename A, typename B>
+inline int deserializeCompact(std::istream& in, mace::pair<A, B>* pitem) throw(SerializationException) {
+  int n = deserializeCompact(in, &pitem->first);
+  return n + deserializeCompact(in, &pitem->second);
+}
+
+template<typename T, typename S, typename A>
+inline void serializeCompact(std::string& str, const mace::vector<T, S, A>* pitem) {
+  serializeVarint(str, pitem->size());
+  for (typename mace::vector<T, S, A>::const_iterator i = pitem->begin(); i != pitem->end(); i++) {
+    serializeCompact(str, &*i);
+  }
+}
+
+template<typename T, typename S, typename A>
+inline int deserializeCompact(std::istream& in, mace::vector<T, S, A>* pitem) throw(SerializationException) {
+  uint32_t sz;
+  int n = deserializeCompactSize(in, sz);
+  pitem->clear();
+  pitem->resize(sz);
+  for (typename mace::vector<T, S, A>::iterator i = pitem->begin(); i != pitem->end(); i++) {
+    n += deserializeCompact(in, &*i);
+  }
+  return n;
+}
+
+template<typename K, typename S, typename C, typename A>
+inline void serializeCompact(std::string& str, const mace::set<K, S, C, A>* pitem) {
+  serializeVarint(str, pitem->size());
+  CompactKeyCoder<K> keys;
+  for (typename mace::set<K, S, C, A>::const_iterator i = pitem->begin(); i != pitem->end(); i++) {
+    keys.put(str, *i);
+  }
+}
+
+template<typename K, typename S, typename C, typename A>
+inline int deserializeCompact(std::istream& in, mace::set<K, S, C, A>* pitem) throw(SerializationException) {
+  uint32_t sz;
+  int n = deserializeVarintAs(in, &sz);
+  pitem->clear();
+  CompactKeyCoder<K> keys;
+  for (uint32_t i = 0; i < sz; i++) {
+    K k;
+    n += keys.get(in, k);
+    pitem->insert(pitem->end(), k);
+  }
+  return n;
+}
+
+template<typename K, typename D, typename S, typename C, typename A>
+inline void serializeCompact(std::string& str, const mace::map<K, D, S, C, A>* pitem) {
+  serializeVarint(str, pitem->size());
+  CompactKeyCoder<K> keys;
+  for (typename mace::map<K, D, S, C, A>::const_iterator i = pitem->begin(); i != pitem->end(); i++) {
+    keys.put(str, i->first);
+    serializeCompact(str, &i->second);
+  }
+}
+
+template<typename K, typename D, typename S, typename C, typename A>
+inline int deserializeCompact(std::istream& in, mace::map<K, D, S, C, A>* pitem) throw(SerializationException) {
+  uint32_t sz;
+  int n = deserializeVarintAs(in, &sz);
+  pitem->clear();
+  CompactKeyCoder<K> keys;
+  for (uint32_t i = 0; i < sz; i++) {
+    K k;
+    n += keys.get(in, k);
+    typename mace::map<K, D, S, C, A>::iterator j = pitem->insert(pitem->end(), std::make_pair(k, D()));
+    n += deserializeCompact(in, &j->second);
+  }
+  return n;
+}
+
+/** @} */
+
+}
+
+#endif // _MACE_COMPACT_SERIALIZATION_H
@@ -0,0 +1,162 @@
+/* 
+ * ContextAffinity.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include "ContextAffinity.h"
+
+/**
+ * \file ContextAffinity.cc
+ * \brief Defines the assignment of contexts to pinned worker threads
+ */
+
+namespace mace {
+
+namespace {
+  // finalizer of MurmurHash3, spreads consecutive ids over the ring
+  uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+  }
+}
+
+ContextAffinityMap::ContextAffinityMap(uint32_t workers, uint32_t replicas) : workers(workers) {
+  for (uint32_t w = 0; w < workers; w++) {
+    for (uint32_t r = 0; r < replicas; r++) {
+      uint32_t point = mix(mix(w) + r * 0x9e3779b9);
+      // on a collision the lower worker keeps the point
+      if (ring.find(point) == ring.end()) {
+        ring[point] = w;
+      }
+    }
+  }
+}
+
+uint32_t ContextAffinityMap::getRingWorker(uint32_t contextId) const {
+  if (ring.empty()) {
+    return 0;
+  }
+  RingType::const_iterator i = ring.lower_bound(mix(contextId));
+  if (i == ring.end()) {
+    i = ring.begin();
+  }
+  return i->second;
+}
+
+uint32_t ContextAffinityMap::getWorker(uint32_t contextId) const {
+  RingType::const_iterator i = moved.find(contextId);
+  if (i != moved.end()) {
+    return i->second;
+  }
+  return getRingWorker(contextId);
+}
+
+void ContextAffinityMap::record(uint32_t contextId, uint64_t load) {
+  contextLoad[contextId] += load;
+}
+
+uint32_t ContextAffinityMap::rebalance(double imbalance) {
+  uint32_t count = 0;
+  if (workers < 2 || contextLoad.empty()) {
+    contextLoad.clear();
+    return count;
+  }
+
+  std::vector<uint64_t> load(workers, 0);
+  uint64_t total = 0;
+  for (LoadMap::const_iterator i = contextLoad.begin(); i != contextLoad.end(); i++) {
+    load[getWorker(i->first)] += i->second;
+    total += i->second;
+  }
+  const double average = (double)total / workers;
+
+  // every context moves at most once per period
+  for (uint32_t n = 0; n < contextLoad.size(); n++) {
+    uint32_t busiest = 0;
+    uint32_t idlest = 0;
+    for (uint32_t w = 1; w < workers; w++) {
+      if (load[w] > load[busiest]) {
+        busiest = w;
+      }
+      if (load[w] < load[idlest]) {
+        idlest = w;
+      }
+    }
+    if (load[busiest] <= imbalance * average) {
+      break;
+    }
+
+    // the context closest to half the difference evens the two workers best
+    const uint64_t gap = load[busiest] - load[idlest];
+    LoadMap::iterator best = contextLoad.end();
+    uint64_t bestDistance = 0;
+    for (LoadMap::iterator i = contextLoad.begin(); i != contextLoad.end(); i++) {
+      if (i->second == 0 || i->second >= gap || getWorker(i->first) != busiest) {
+        continue;
+      }
+      uint64_t distance = (2 * i->second > gap) ? 2 * i->second - gap : gap - 2 * i->second;
+      if (best == contextLoad.end() || distance < bestDistance) {
+        best = i;
+        bestDistance = distance;
+      }
+    }
+    if (best == contextLoad.end()) {
+      break;
+    }
+
+    if (getRingWorker(best->first) == idlest) {
+      moved.erase(best->first);
+    }
+    else {
+      moved[best->first] = idlest;
+    }
+    load[busiest] -= best->second;
+    load[idlest] += best->second;
+    best->second = 0;
+    count++;
+  }
+
+  contextLoad.clear();
+  return count;
+}
+
+uint64_t ContextAffinityMap::getLoad(uint32_t worker) const {
+  uint64_t load = 0;
+  for (LoadMap::const_iterator i = contextLoad.begin(); i != contextLoad.end(); i++) {
+    if (getWorker(i->first) == worker) {
+      load += i->second;
+    }
+  }
+  return load;
+}
+
+}
@@ -0,0 +1,99 @@
+/* 
+ * ContextAffinity.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <map>
+#include <vector>
+
+/**
+ * \file ContextAffinity.h
+ * \brief Declares the assignment of contexts to pinned worker threads
+ */
+
+#ifndef _MACE_CONTEXT_AFFINITY_H
+#define _MACE_CONTEXT_AFFINITY_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief assigns contexts to a fixed set of workers by consistent hashing, and moves contexts off overloaded workers.
+ *
+ * Each worker owns \c replicas points on a hash ring, and a context belongs
+ * to the worker owning the first point at or after the hash of its id, so
+ * most contexts keep their worker when the number of workers changes.
+ * The load of each context is recorded as it runs, and rebalance() moves
+ * the contexts that make a worker busier than the others to the least
+ * loaded worker.  Moved contexts stay with their new worker until moved
+ * again.
+ *
+ * Not thread safe; ContextEventTP locks around it.
+ */
+class ContextAffinityMap {
+private:
+  typedef std::map<uint32_t, uint32_t> RingType;
+  typedef std::map<uint32_t, uint64_t> LoadMap;
+
+  uint32_t workers;
+  RingType ring; ///< hash point to worker
+  RingType moved; ///< context id to worker, for contexts not on their ring worker
+  LoadMap contextLoad; ///< load of each context since the last rebalance
+
+  uint32_t getRingWorker(uint32_t contextId) const;
+
+public:
+  ContextAffinityMap(uint32_t workers, uint32_t replicas = 64);
+
+  /// return the worker running the context
+  uint32_t getWorker(uint32_t contextId) const;
+  /// adds \c load, in any unit, to the context
+  void record(uint32_t contextId, uint64_t load);
+  /**
+   * moves contexts from the busiest worker to the least busy one, while the
+   * busiest worker has more than \c imbalance times the average load and a
+   * move lowers it.  Starts a new load period.
+   *
+   * @return the number of contexts moved
+   */
+  uint32_t rebalance(double imbalance = 1.25);
+
+  /// return the load of the worker since the last rebalance
+  uint64_t getLoad(uint32_t worker) const;
+  uint32_t size() const { return workers; }
+};
+
+/** @} */
+
+}
+#endif // _MACE_CONTEXT_AFFINITY_H
@@ -2,6 +2,7 @@
 #include "ContextDispatch.h"
 #include "ScopedLock.h"
 #include "ContextLock.h"
+#include "EventTrace.h"
 #include "ContextService.h"
 #include <map>
 using namespace mace;
@@ -256,6 +257,7 @@ ContextBaseClass::ContextBaseClass(const mace::string& contextName, const uint64
     handlingCreateEventNumber( 0 ),
     isWaitingForHandlingCreateEvents( false ),
     now_max_execute_ticket(0),
+    admittedReaders(),
     eventExecutionInfos( ),
     migrationEventWaiting( false ),
     skipCreateTickets( ),
@@ -272,8 +274,8 @@ ContextBaseClass::ContextBaseClass(const mace::string& contextName, const uint64
 #endif
     numReaders(0),
     numWriters(0),
-    conditionVariables( ),
-    commitConditionVariables( ),
+    executeWaiters( ),
+    commitWaiters( ),
     uncommittedEvents(0,-1)    
 {
     contextTypeName = contextName;
@@ -618,6 +620,7 @@ OrderID mace::ContextBaseClass::newCreateTicket() {
   OrderID eventId(this->contextId, this->createTicketNumber);
   macedbg(1) << "Context "<< this->contextId <<" sold create ticket "<< this->createTicketNumber << Log::endl;
   this->createTicketNumber ++;
+  EventTrace::sampleNewEvent(eventId, this->contextId);
   return eventId;
 }
 
@@ -804,6 +807,7 @@ void ContextBaseClass::createEvent(BaseMaceService* sv, mace::OrderID& myEventId
   ADD_SELECTORS("ContextBaseClass::createEvent");
   //macedbg(1) << "Context("<< contextName <<") creates event which target context " << targetContextName << Log::endl;
   //OrderID myEventId = newCreateTicket();
+  EventTrace::Span span(EventTrace::HEAD_CREATE, myEventId, contextId);
 
   ScopedLock sl(createEventMutex);
   macedbg(1) << "now_serving_create_ticket=" << now_serving_create_ticket << " create_ticket=" << myEventId.ticket << Log::endl;
@@ -877,9 +881,16 @@ void ContextBaseClass::commitEvent(const mace::OrderID& eventId) {
   contextEventOrder.removeEventExecuteTicket(eventId);
   // committedEventIds.push_back(eventId);
   sl.unlock();
+
+  if( EventTrace::isSampled(eventId) ){
+    uint64_t now = TimeUtil::timeu();
+    EventTrace::record(EventTrace::COMMIT, eventId, contextId, now, now);
+  }
   
   this->deleteEventExecutionInfo(eventId);
   (this->runtimeInfo).commitEvent(eventId);
+  // whatever this thread allocated for the event is released with the chunk once it is all freed
+  mace::EventArena::retire();
 }
 
 void ContextBaseClass::putBackEventObject(mace::Event* event) {
@@ -1876,7 +1887,26 @@ void ContextBaseClass::enqueueReadyCreateEventQueueWithLock() {
 
 // executeEventQueue should be locked before and during this method
 bool ContextBaseClass::enqueueReadyExecuteEventQueue() {
-  ADD_SELECTORS("ContextBaseClass::enqueueReadyExecuteEventQueue");
+  // Consecutive read-only events are admitted together.  They take
+  // consecutive tickets and pass the read lock to each other in ContextLock,
+  // so they run in parallel on the context thread pool instead of waiting
+  // here for each other to start.
+  bool admitted = false;
+  bool readBatch = false;
+  while( admitReadyExecuteEvent(readBatch) ) {
+    admitted = true;
+    if( !readBatch ) {
+      break;
+    }
+  }
+  return admitted;
+}
+
+// admits the event at the front of executeEventQueue if it may run now. readBatch is set if it joined a run of readers
+bool ContextBaseClass::admitReadyExecuteEvent( bool& readBatch ) {
+  ADD_SELECTORS("ContextBaseClass::admitReadyExecuteEvent");
+  static const uint64_t maxReadBatch = params::get<uint64_t>("MAX_READ_BATCH", 64);
+  readBatch = false;
   if( executeEventQueue.empty() ){
     return false;
   }
@@ -1909,10 +1939,20 @@ bool ContextBaseClass::enqueueReadyExecuteEventQueue() {
     macedbg(1) << "context("<< this->contextName<<") executeTicket=" << execute_ticket << " nextExecuteTicketNumber=" << 
       contextEventOrder.getExecuteTicketNumber() << " now_serving_execute_ticket="<< this->now_serving_execute_ticket << Log::endl;
     
-    ASSERT( contextEventOrder.getExecuteTicketNumber() >= this->now_serving_execute_ticket );
+    const uint64_t nextExecuteTicket = contextEventOrder.getExecuteTicketNumber();
+    ASSERT( nextExecuteTicket >= this->now_serving_execute_ticket );
+
+    bool readOnly = false;
+    if( e.type == ContextEvent::TYPE_ASYNC_EVENT || e.type == ContextEvent::TYPE_BROADCAST_EVENT ) {
+      readOnly = static_cast<AsyncEvent_Message*>(e.param)->getEvent().eventOpType == mace::Event::EVENT_OP_READ;
+    } else if( e.type == ContextEvent::TYPE_ROUTINE_EVENT ) {
+      readOnly = static_cast<Routine_Message*>(e.param)->getEvent().eventOpType == mace::Event::EVENT_OP_READ;
+    }
+    // a reader may also start while all the admitted events ahead of it are readers
+    const bool joinReaders = this->admittedReaders.canJoin(readOnly, nextExecuteTicket, this->now_serving_execute_ticket, maxReadBatch);
 
     ContextStructure& contextStructure = _service->contextStructure;
-    if( execute_ticket == 0 && contextEventOrder.getExecuteTicketNumber() == this->now_serving_execute_ticket ){ // context allow next event to execute
+    if( execute_ticket == 0 && (nextExecuteTicket == this->now_serving_execute_ticket || joinReaders) ){ // context allow next event to execute
       mace::EventExecutionInfo eventInfo;
       
       if( e.type == ContextEvent::TYPE_ASYNC_EVENT ){
@@ -1951,10 +1991,12 @@ bool ContextBaseClass::enqueueReadyExecuteEventQueue() {
       }
 
       const uint64_t executeTicket = contextEventOrder.getExecuteEventTicket(e.eventId);
-      if( executeTicket == 0 || executeTicket != this->now_serving_execute_ticket ) {
+      if( executeTicket == 0 || executeTicket != nextExecuteTicket ) {
         maceerr << "context("<< this->contextName <<") executeTicket=" << executeTicket << ", now_serving_execute_ticket=" << this->now_serving_execute_ticket << Log::endl;
         ASSERTMSG(false, "Wrong event ticket assignment!");
       }
+      this->admittedReaders.admitted(executeTicket, readOnly);
+      readBatch = readOnly;
 
       ScopedLock execute_sl( eventExecutingSyncMutex );
       mace::map<mace::OrderID, EventExecutionInfo>::iterator einfo_iter = getEventExecutionInfo(e.eventId);
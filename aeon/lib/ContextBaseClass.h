@@ -20,6 +20,8 @@
 #include "SockUtil.h"
 #include "ElasticPolicy.h"
 #include "eMonitor.h"
+#include "TicketWaitRing.h"
+#include "ReadBatch.h"
 
 #define  MARK_RESERVED NULL
 /**
@@ -142,6 +144,9 @@ public:
   ContextBaseClass* contextObject;
   bool isAsyncEvent;
 
+  static void* operator new(size_t size) { return mace::EventArena::allocate(size); }
+  static void operator delete(void* p) { mace::EventArena::release(p); }
+
   ContextCommitEvent(): sv(NULL), eventId(), contextObject(NULL), isAsyncEvent(false) {}
   ContextCommitEvent(BaseMaceService* sv, OrderID const& eventId, mace::ContextBaseClass* contextObject, const bool isAsyncEvent): sv(sv), eventId(eventId), 
     contextObject(contextObject), isAsyncEvent(isAsyncEvent) { }
@@ -574,7 +579,6 @@ friend class ContextThreadSpecific;
 friend class ContextLock;
 friend class ContextEventTP;
 public:
-    typedef std::pair<uint64_t, pthread_cond_t*> QueueItemType;
     static const uint8_t HEAD = 0;
     static const uint8_t CONTEXT = 1;
 
@@ -654,6 +658,7 @@ public:
     bool isWaitingForHandlingCreateEvents;
 
     uint64_t now_max_execute_ticket;
+    ReadBatch admittedReaders; ///< the readers admitted ahead of now_serving, which more readers may join
 
     mace::map< mace::OrderID, EventExecutionInfo > eventExecutionInfos;
 
@@ -747,7 +752,7 @@ public:
 
     void insertEventCreateStartTime( const mace::OrderID& eventId) {
       ScopedLock sl(timeMutex);
-      eventCreateStartTime[eventId] = TimeUtil::timeu();
+      eventCreateStartTime[eventId] = TimeUtil::monotimeu();
     }
 
     void insertEventCreateEndTime( const mace::OrderID& eventId ) {
@@ -756,7 +761,7 @@ public:
       mace::map< mace::OrderID, uint64_t>::const_iterator cIter = eventCreateStartTime.find(eventId);
       if( cIter != eventCreateStartTime.end() ) {
         committedEventCount ++;
-        uint64_t end_time = TimeUtil::timeu();
+        uint64_t end_time = TimeUtil::monotimeu();
         totalEventTime += end_time - cIter->second;
         
         if( committedEventCount % 1000 == 0 ) {
@@ -771,7 +776,7 @@ public:
 
     void insertEventExecuteStartTime( const mace::OrderID& eventId) {
       ScopedLock sl(executeTimeMutex);
-      eventExecuteStartTime[eventId] = TimeUtil::timeu();
+      eventExecuteStartTime[eventId] = TimeUtil::monotimeu();
     }
 
     void insertEventExecuteEndTime( const mace::OrderID& eventId ) {
@@ -780,7 +785,7 @@ public:
       mace::map< mace::OrderID, uint64_t>::const_iterator cIter = eventExecuteStartTime.find(eventId);
       if( cIter != eventExecuteStartTime.end() ) {
         finishedEventCount ++;
-        uint64_t end_time = TimeUtil::timeu();
+        uint64_t end_time = TimeUtil::monotimeu();
         totalEventExecuteTime += end_time - cIter->second;
         if( finishedEventCount % 1000 == 0 ) {
           uint64_t avg = (uint64_t)( totalEventExecuteTime / 1000 );
@@ -1056,6 +1061,7 @@ public:
     mace::map<mace::OrderID, EventExecutionInfo>::iterator getEventExecutionInfo( const mace::OrderID& eventId);
 
     bool enqueueReadyExecuteEventQueue();
+    bool admitReadyExecuteEvent( bool& readBatch );
     bool enqueueReadyCreateEventQueue();
     bool enqueueReadyCommitEventQueue();
 
@@ -1121,11 +1127,6 @@ public:
 
 private:
     
-    struct CondQueueComp{
-      bool operator()( const std::pair<uint64_t, pthread_cond_t*>& p1, const std::pair<uint64_t, pthread_cond_t*>& p2 ){
-        return p1.first > p2.first;
-      }
-    };
     struct BypassSorter{
       // The bypass range shouldn't intersect
       bool operator()(const std::pair<uint64_t,uint64_t>& p1, const std::pair<uint64_t,uint64_t>& p2){
@@ -1133,7 +1134,6 @@ private:
       }
     };
 
-    typedef std::priority_queue< std::pair<uint64_t, pthread_cond_t*>, std::vector<std::pair<uint64_t, pthread_cond_t*> >, CondQueueComp > CondQueue;
     typedef std::set< std::pair< uint64_t, uint64_t >, BypassSorter > BypassQueueType ;
 
     pthread_key_t pkey;
@@ -1142,8 +1142,8 @@ public:
     int numReaders;
     int numWriters;
 private:
-    CondQueue conditionVariables;
-    CondQueue commitConditionVariables;
+    TicketWaitRing executeWaiters; ///< events waiting in ContextLock for their execute ticket
+    TicketWaitRing commitWaiters; ///< events waiting in ContextLock for their commit turn
     pthread_mutex_t _context_ticketbooth; 
     BypassQueueType bypassQueue;
     BypassQueueType commitBypassQueue;
@@ -1,6 +1,10 @@
 #include "ContextDispatch.h"
 #include "ContextService.h"
 #include "InternalMessage.h"
+#include "ScopedContextRPC.h"
+#include <sched.h>
+
+__thread mace::ContextEventTP::AffinityWorker* mace::ContextEventTP::runningWorker = NULL;
 
 bool mace::ContextEventTP::runDeliverExecuteCondition(ExecuteThreadPoolType* tp, uint threadId) {
 	ADD_SELECTORS("ContextEventTP::runDeliverExecuteCondition");
@@ -54,6 +58,15 @@ mace::ContextEventTP::~ContextEventTP() {
   	etpptr = NULL;
   	delete ctp;
   	delete etp;  
+
+  	for( uint32_t i = 0; i < affinityWorkers.size(); i++ ) {
+  		pthread_mutex_destroy(&affinityWorkers[i]->mutex);
+  		pthread_cond_destroy(&affinityWorkers[i]->cond);
+  		delete affinityWorkers[i];
+  	}
+  	affinityWorkers.clear();
+  	delete affinity;
+  	pthread_mutex_destroy(&affinityMutex);
   	
   	pthread_mutex_destroy(&commitExitMutex);
 }
@@ -68,6 +81,8 @@ void mace::ContextEventTP::signalCreateThread() {
 
 void mace::ContextEventTP::haltAndWaitExecute() {
   ASSERTMSG(etpptr != NULL, "Please submit a bug report describing how this happened.  If you can submit a stack trace that would be preferable.");
+  // first, so the events still queued on the pinned workers join the shared queue
+  haltAndWaitAffinity();
   etpptr->halt();
   etpptr->waitForEmptySignal();
 }
@@ -150,17 +165,200 @@ void mace::ContextEventTP::haltAndWaitCommit() {
 
 
 // New implementation for shared threadpool
-mace::ContextEventTP::ContextEventTP( uint32_t minThreadSize, uint32_t maxThreadSize ) :
+mace::ContextEventTP::ContextEventTP( uint32_t minThreadSize, uint32_t maxThreadSize, uint32_t affinityThreads, size_t coroutineStackSize ) :
 		etpptr (new ExecuteThreadPoolType(*this, &mace::ContextEventTP::runExecuteCondition, &mace::ContextEventTP::runExecuteProcessUnlocked,
   			NULL, NULL, ThreadStructure::ASYNC_THREAD_TYPE, minThreadSize, maxThreadSize) ),
   		ctpptr (new CreateThreadPoolType(*this, &mace::ContextEventTP::runCreateCondition, &mace::ContextEventTP::runCreateProcessUnlocked,
   			NULL, NULL, ThreadStructure::ASYNC_THREAD_TYPE, minThreadSize, maxThreadSize) ),
   		mtpptr (new CommitThreadPoolType(*this, &mace::ContextEventTP::runCommitCondition, &mace::ContextEventTP::runCommitProcessUnlocked,
-  			NULL, &mace::ContextEventTP::runCommitProcessFinish, ThreadStructure::ASYNC_THREAD_TYPE, minThreadSize, maxThreadSize) )	 {
+  			NULL, &mace::ContextEventTP::runCommitProcessFinish, ThreadStructure::ASYNC_THREAD_TYPE, minThreadSize, maxThreadSize) ),
+  		affinity( NULL ), lastRebalance( 0 ),
+  		coroutineStackSize( coroutineStackSize ), resumingCoroutines( maxThreadSize, NULL ) {
 
 	pthread_mutex_init(&readyExecuteEventQueueMutex, NULL);
 	pthread_mutex_init(&readyCreateEventQueueMutex, NULL);
 	pthread_mutex_init(&readyCommitEventQueueMutex, NULL);
+	pthread_mutex_init(&affinityMutex, NULL);
+
+	if( affinityThreads > 0 ) {
+		affinity = new ContextAffinityMap( affinityThreads );
+		lastRebalance = TimeUtil::timeu();
+		for( uint32_t i = 0; i < affinityThreads; i++ ) {
+			AffinityWorker* w = new AffinityWorker();
+			pthread_mutex_init(&w->mutex, NULL);
+			pthread_cond_init(&w->cond, NULL);
+			w->tp = this;
+			w->sleeping = false;
+			w->halting = false;
+			w->blocked = false;
+			affinityWorkers.push_back(w);
+		}
+		ScopedContextRPC::setBlockingHook( &ContextEventTP::blockAffinityWorker );
+		for( uint32_t i = 0; i < affinityThreads; i++ ) {
+			ContextThreadArg* arg = new ContextThreadArg;
+			arg->p = this;
+			arg->i = i;
+			runNewThread(&affinityWorkers[i]->thread, ContextEventTP::startAffinityWorker, arg, 0);
+		}
+	}
+}
+
+void* mace::ContextEventTP::startAffinityWorker(void* arg) {
+	ContextThreadArg* a = (ContextThreadArg*)(arg);
+	a->p->runAffinityWorker(a->i);
+	delete a;
+	return 0;
+}
+
+// Runs the ready events of the contexts assigned to this worker, one after
+// the other, without handing them through the shared pool.  Memory the
+// events allocate is local to the NUMA node of the pinned CPU, since Linux
+// places pages on the node of the thread that first touches them.
+void mace::ContextEventTP::runAffinityWorker(uint32_t index) {
+	ADD_SELECTORS("ContextEventTP::runAffinityWorker");
+	static const uint32_t firstCpu = params::get<uint32_t>("CONTEXT_AFFINITY_FIRST_CPU", 0);
+	ThreadStructure::setThreadType( ThreadStructure::ASYNC_THREAD_TYPE );
+
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if( cpus > 0 ) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET((firstCpu + index) % cpus, &cpuset);
+		if( pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0 ) {
+			macewarn << "Failed to pin worker " << index << " to cpu " << (firstCpu + index) % cpus << Log::endl;
+		}
+	}
+
+	AffinityWorker& w = *affinityWorkers[index];
+	runningWorker = &w;
+	ScopedLock sl(w.mutex);
+	while( !w.halting ) {
+		// a resumed event already holds its contexts, so it goes before new ones
+		if( !w.resumeQueue.empty() ) {
+			Coroutine* co = w.resumeQueue.front();
+			w.resumeQueue.pop_front();
+			sl.unlock();
+
+			const uint32_t contextId = static_cast<CoroutineEvent*>(co->getArg())->event.contextObject->contextId;
+			const uint64_t start = TimeUtil::timeu();
+			runCoroutine(co);
+			const uint64_t elapsed = TimeUtil::timeu() - start;
+
+			ScopedLock al(affinityMutex);
+			affinity->record(contextId, elapsed + 1);
+			al.unlock();
+			sl.lock();
+			continue;
+		}
+		if( w.readyQueue.empty() ) {
+			w.sleeping = true;
+			pthread_cond_wait(&w.cond, &w.mutex);
+			w.sleeping = false;
+			continue;
+		}
+		mace::ContextEvent ce = w.readyQueue.front();
+		w.readyQueue.front().param = NULL;
+		w.readyQueue.pop_front();
+		sl.unlock();
+
+		const uint32_t contextId = ce.contextObject->contextId;
+		const uint64_t start = TimeUtil::timeu();
+		executeEvent(ce);
+		const uint64_t elapsed = TimeUtil::timeu() - start;
+
+		ScopedLock al(affinityMutex);
+		affinity->record(contextId, elapsed + 1);
+		al.unlock();
+		sl.lock();
+	}
+	sl.unlock();
+	runningWorker = NULL;
+	releaseMemory();
+}
+
+// Only async events are pinned; the routine events they call into stay on
+// the shared pool.  That alone does not keep a worker from waiting on its
+// own queue: an event blocked in a routine call may be waiting for an event
+// queued behind it, which holds a ticket of the context it calls into.  So
+// a worker that blocks hands its queue to the shared pool, and takes no
+// new events until the call returns.  Events in coroutines yield instead of
+// blocking, and the worker goes on with its queue.
+bool mace::ContextEventTP::enqueueAffinityEvent( const mace::ContextEvent& event ) {
+	ADD_SELECTORS("ContextEventTP::enqueueAffinityEvent");
+	static const uint64_t rebalancePeriod = params::get<uint64_t>("CONTEXT_AFFINITY_REBALANCE_PERIOD", 1000000);
+	static const double rebalanceImbalance = params::get<double>("CONTEXT_AFFINITY_IMBALANCE", 1.25);
+	if( affinity == NULL || event.type != ContextEvent::TYPE_ASYNC_EVENT || event.contextObject == NULL ) {
+		return false;
+	}
+
+	ScopedLock al(affinityMutex);
+	const uint64_t now = TimeUtil::timeu();
+	if( now - lastRebalance >= rebalancePeriod ) {
+		uint32_t moved = affinity->rebalance(rebalanceImbalance);
+		lastRebalance = now;
+		if( moved > 0 ) {
+			macedbg(1) << "Moved " << moved << " contexts between pinned workers" << Log::endl;
+		}
+	}
+	const uint32_t index = affinity->getWorker( event.contextObject->contextId );
+	al.unlock();
+
+	AffinityWorker& w = *affinityWorkers[index];
+	ScopedLock sl(w.mutex);
+	if( w.blocked || w.halting ) {
+		return false;
+	}
+	w.readyQueue.push_back(event);
+	if( w.sleeping ) {
+		pthread_cond_signal(&w.cond);
+	}
+	return true;
+}
+
+void mace::ContextEventTP::requeueAffinityEvents( AffinityWorker& w ) {
+	if( w.readyQueue.empty() && w.resumeQueue.empty() ) {
+		return;
+	}
+	ScopedLock sl(readyExecuteEventQueueMutex);
+	while( !w.resumeQueue.empty() ) {
+		readyResumeQueue.push_back( w.resumeQueue.front() );
+		w.resumeQueue.pop_front();
+	}
+	while( !w.readyQueue.empty() ) {
+		readyExecuteEventQueue.push_back( w.readyQueue.front() );
+		w.readyQueue.front().param = NULL;
+		w.readyQueue.pop_front();
+	}
+	sl.unlock();
+	signalSharedExecuteThread();
+}
+
+void mace::ContextEventTP::blockAffinityWorker( bool blocking ) {
+	AffinityWorker* w = runningWorker;
+	if( w == NULL ) {
+		return;
+	}
+	ScopedLock sl(w->mutex);
+	w->blocked = blocking;
+	if( blocking ) {
+		w->tp->requeueAffinityEvents(*w);
+	}
+}
+
+void mace::ContextEventTP::haltAndWaitAffinity() {
+	if( affinityWorkers.empty() ) {
+		return;
+	}
+	for( uint32_t i = 0; i < affinityWorkers.size(); i++ ) {
+		ScopedLock sl(affinityWorkers[i]->mutex);
+		affinityWorkers[i]->halting = true;
+		pthread_cond_signal(&affinityWorkers[i]->cond);
+	}
+	for( uint32_t i = 0; i < affinityWorkers.size(); i++ ) {
+		pthread_join(affinityWorkers[i]->thread, NULL);
+		ScopedLock sl(affinityWorkers[i]->mutex);
+		requeueAffinityEvents(*affinityWorkers[i]);
+	}
 }
 
 bool mace::ContextEventTP::runCreateCondition(CreateThreadPoolType* tp, uint threadId) {
@@ -236,6 +434,12 @@ void mace::ContextEventTP::runCreateProcessUnlocked(CreateThreadPoolType* tp, ui
 bool mace::ContextEventTP::runExecuteCondition(ExecuteThreadPoolType* tp, uint threadId) {
 	ADD_SELECTORS("ContextEventTP::runExecuteCondition");
 	ScopedLock sl(readyExecuteEventQueueMutex);
+	// a resumed event already holds its contexts, so it goes before new ones
+	if( !readyResumeQueue.empty() ) {
+		resumingCoroutines[threadId] = readyResumeQueue.front();
+		readyResumeQueue.pop_front();
+		return true;
+	}
 	if( readyExecuteEventQueue.empty() ) {
 		return false;
 	}
@@ -252,8 +456,80 @@ bool mace::ContextEventTP::runExecuteCondition(ExecuteThreadPoolType* tp, uint t
 
 void mace::ContextEventTP::runExecuteProcessUnlocked(ExecuteThreadPoolType* tp, uint threadId) {
 	ADD_SELECTORS("ContextEventTP::runDeliverExecuteProcessUnlocked");
+	Coroutine* co = resumingCoroutines[threadId];
+	if( co != NULL ) {
+		resumingCoroutines[threadId] = NULL;
+		runCoroutine(co);
+		return;
+	}
 	ContextEvent& ce = tp->data(threadId);
-	ce.fire();
+	executeEvent(ce);
+}
+
+void mace::ContextEventTP::executeEvent( mace::ContextEvent& ce ) {
+	if( coroutineStackSize == 0 ) {
+		ce.fire();
+		return;
+	}
+	CoroutineEvent* ev = new CoroutineEvent();
+	ev->event = ce;
+	ev->tp = this;
+	ev->worker = runningWorker;
+	ev->ownSpecific = NULL;
+	ev->threadSpecific = NULL;
+	ce.param = NULL;
+	Coroutine* co = new Coroutine(&ContextEventTP::fireCoroutineEvent, ev, &ContextEventTP::scheduleCoroutine, coroutineStackSize);
+	co->setSwitchHooks(&ContextEventTP::switchInCoroutine, &ContextEventTP::switchOutCoroutine);
+	runCoroutine(co);
+}
+
+void mace::ContextEventTP::runCoroutine( Coroutine* co ) {
+	CoroutineEvent* ev = static_cast<CoroutineEvent*>(co->getArg());
+	// once resume() returns false a wakeup may already be resuming it elsewhere
+	if( co->resume() ) {
+		ThreadStructure::releaseThreadSpecific(ev->ownSpecific);
+		delete ev;
+		delete co;
+	}
+}
+
+void mace::ContextEventTP::fireCoroutineEvent( void* arg ) {
+	static_cast<CoroutineEvent*>(arg)->event.fire();
+}
+
+void mace::ContextEventTP::scheduleCoroutine( Coroutine* co ) {
+	CoroutineEvent* ev = static_cast<CoroutineEvent*>(co->getArg());
+	ContextEventTP* self = ev->tp;
+	if( ev->worker != NULL ) {
+		AffinityWorker& w = *ev->worker;
+		ScopedLock wl(w.mutex);
+		if( !w.halting ) {
+			w.resumeQueue.push_back(co);
+			if( w.sleeping ) {
+				pthread_cond_signal(&w.cond);
+			}
+			return;
+		}
+	}
+	ScopedLock sl(self->readyExecuteEventQueueMutex);
+	self->readyResumeQueue.push_back(co);
+	sl.unlock();
+	self->signalSharedExecuteThread();
+}
+
+void mace::ContextEventTP::switchInCoroutine( Coroutine* co ) {
+	CoroutineEvent* ev = static_cast<CoroutineEvent*>(co->getArg());
+	const uint8_t threadType = ThreadStructure::getThreadType();
+	ev->threadSpecific = ThreadStructure::exchangeThreadSpecific(ev->ownSpecific);
+	if( ev->ownSpecific == NULL ) {
+		ThreadStructure::setThreadType(threadType);
+	}
+}
+
+void mace::ContextEventTP::switchOutCoroutine( Coroutine* co ) {
+	CoroutineEvent* ev = static_cast<CoroutineEvent*>(co->getArg());
+	ev->ownSpecific = ThreadStructure::exchangeThreadSpecific(ev->threadSpecific);
+	ev->threadSpecific = NULL;
 }
 
 bool mace::ContextEventTP::runCommitCondition(CommitThreadPoolType* tp, uint threadId) {
@@ -301,6 +577,9 @@ void mace::ContextEventTP::enqueueReadyCreateEvent( const HeadEventDispatch::Hea
 
 void mace::ContextEventTP::enqueueReadyExecuteEvent( const mace::ContextEvent& event ) {
 	ADD_SELECTORS("ContextEventTP::enqueueReadyExecuteEvent");
+	if( enqueueAffinityEvent(event) ) {
+		return;
+	}
 	ScopedLock sl(readyExecuteEventQueueMutex);
 	// macedbg(1) << "Put a new execute event into the ready queue!" << Log::endl;
 	readyExecuteEventQueue.push_back(event);
@@ -308,6 +587,26 @@ void mace::ContextEventTP::enqueueReadyExecuteEvent( const mace::ContextEvent& e
 	signalSharedExecuteThread();
 }
 
+uint32_t mace::ContextEventTP::getQueueDepth() {
+	ScopedLock sl(readyExecuteEventQueueMutex);
+	uint32_t depth = readyExecuteEventQueue.size() + readyResumeQueue.size();
+	sl.unlock();
+
+	ScopedLock sl2(readyCreateEventQueueMutex);
+	depth += readyCreateEventQueue.size();
+	sl2.unlock();
+
+	ScopedLock sl3(readyCommitEventQueueMutex);
+	depth += readyCommitEventQueue.size();
+	sl3.unlock();
+
+	for( uint32_t i = 0; i < affinityWorkers.size(); i++ ) {
+		ScopedLock wl(affinityWorkers[i]->mutex);
+		depth += affinityWorkers[i]->readyQueue.size() + affinityWorkers[i]->resumeQueue.size();
+	}
+	return depth;
+}
+
 void mace::ContextEventTP::enqueueReadyCommitEvent( const mace::ContextCommitEvent& event ) {
 	ADD_SELECTORS("ContextEventTP::enqueueReadyCommitEvent");
 	ScopedLock sl(readyCommitEventQueueMutex);
@@ -4,6 +4,8 @@
 #include "ContextBaseClass.h"
 #include "Message.h"
 #include "ThreadPool.h"
+#include "ContextAffinity.h"
+#include "Coroutine.h"
 /**
  * \file ContextDispatch.h
  * \brief declares the ContextEventTP class
@@ -129,8 +131,63 @@ private:
   void runCommitProcessFinish(CommitThreadPoolType* tp, uint threadId);
 
 
+  // Optional pinned workers: each owns a set of contexts and runs their
+  // ready async events to completion on one CPU
+  struct AffinityWorker {
+    mace::deque<mace::ContextEvent> readyQueue;
+    std::deque<Coroutine*> resumeQueue; ///< its events' coroutines that are ready to go on
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    ContextEventTP* tp;
+    bool sleeping;
+    bool halting; ///< protected by mutex
+    bool blocked; ///< waiting for a routine call to return, protected by mutex
+  };
+  std::vector<AffinityWorker*> affinityWorkers;
+  ContextAffinityMap* affinity;
+  pthread_mutex_t affinityMutex;
+  uint64_t lastRebalance;
+  static __thread AffinityWorker* runningWorker; ///< the worker running on this thread, if any
+
+  static void* startAffinityWorker(void* arg);
+  void runAffinityWorker(uint32_t index);
+  /// return false if the event is not run by a pinned worker
+  bool enqueueAffinityEvent( const mace::ContextEvent& event );
+  /// moves the events and coroutines queued on \c w to the shared pool. Called with \c w.mutex locked
+  void requeueAffinityEvents( AffinityWorker& w );
+  static void blockAffinityWorker( bool blocking );
+  void haltAndWaitAffinity();
+
+  // Optional coroutines: an event waiting for a routine to return gives its
+  // thread back to the pool, and is resumed from readyResumeQueue, or from
+  // the resume queue of the pinned worker it started on
+  struct CoroutineEvent {
+    mace::ContextEvent event;
+    ContextEventTP* tp;
+    AffinityWorker* worker; ///< the pinned worker that runs the event, or NULL
+    void* ownSpecific; ///< the event's ThreadStructure data while it is switched out
+    void* threadSpecific; ///< the data of the thread it runs on while it is switched in
+  };
+  size_t coroutineStackSize;
+  std::deque<Coroutine*> readyResumeQueue; ///< protected by readyExecuteEventQueueMutex
+  std::vector<Coroutine*> resumingCoroutines; ///< the coroutine each execute thread is to resume
+
+  /// runs the event, in a new coroutine if they are enabled
+  void executeEvent( mace::ContextEvent& event );
+  void runCoroutine( Coroutine* co );
+  static void fireCoroutineEvent( void* arg );
+  static void scheduleCoroutine( Coroutine* co );
+  static void switchInCoroutine( Coroutine* co );
+  static void switchOutCoroutine( Coroutine* co );
+
 public:
-  ContextEventTP( uint32_t minThreadSize, uint32_t maxThreadSize  );
+  /**
+   * @param affinityThreads if not 0, the number of pinned workers that run
+   * async events, each for the contexts assigned to it
+   * @param coroutineStackSize if not 0, events run in coroutines with stacks of this many bytes
+   * */
+  ContextEventTP( uint32_t minThreadSize, uint32_t maxThreadSize, uint32_t affinityThreads = 0, size_t coroutineStackSize = 0 );
   void enqueueReadyCreateEvent( const HeadEventDispatch::HeadEvent& cEvent );
   void enqueueReadyExecuteEvent( const mace::ContextEvent& eEvent );
   void enqueueReadyCommitEvent( const mace::ContextCommitEvent& event );
@@ -138,6 +195,9 @@ public:
   void signalSharedCreateThread();
   void signalSharedExecuteThread();
   void signalSharedCommitThread();
+
+  /// return the number of events waiting for a thread of this pool
+  uint32_t getQueueDepth();
 };
 
 }
@@ -8,6 +8,7 @@
 #include "pthread.h"
 #include "ThreadStructure.h"
 #include "m_map.h"
+#include "EventTrace.h"
 // uses snapshot by default
 
 #define  MARK_RESERVED NULL
@@ -25,7 +26,6 @@ public:
   OrderID myEventId;
 private:
   pthread_mutex_t& _context_ticketbooth;
-  pthread_cond_t threadCond;
   bool toRelease;
     
 public:
@@ -69,7 +69,6 @@ public:
           downgradeToNone(WRITE_MODE);
         } else { // read or write mode
           macedbg(1) << "ContextId=" << ctx.contextId << " EventId=" << myEventId << " mode = "<< (uint16_t)requestedMode << Log::endl;
-          pthread_cond_init( &threadCond, NULL );
           upgradeFromNone(); 
         }
         //macedbg(1) << "[" <<context.contextName <<"] CONTINUING.  priorMode " << (int16_t)priorMode << " requestedMode " << (int16_t)requestedMode << " executeEventTicket " << executeEventTicket << Log::endl;
@@ -91,12 +90,9 @@ public:
     static void notifyMigrationEvent( ContextBaseClass& context ){
       ADD_SELECTORS("ContextLock::notifyMigrationEvent");
       
-      if ( !context.conditionVariables.empty() ){
-        mace::ContextBaseClass::QueueItemType const& top =  context.conditionVariables.top();
-        if(  top.first == context.now_serving_execute_ticket) {
-          macedbg(1) << "[" << context.contextName<<"] Signalling CV " << top.second << " for ticket " << context.now_serving_execute_ticket << Log::endl;
-          pthread_cond_broadcast(top.second); 
-        }
+      if ( context.executeWaiters.hasWaiters(context.now_serving_execute_ticket) ){
+        macedbg(1) << "[" << context.contextName<<"] Waking waiters for ticket " << context.now_serving_execute_ticket << Log::endl;
+        context.executeWaiters.notify(context.now_serving_execute_ticket);
       }
     }
   
@@ -105,18 +101,10 @@ private:
     static void notifyNext( ContextBaseClass& context ){
       ADD_SELECTORS("ContextLock::notifyNext");
         //bypassEvent(context);
-        if ( !context.conditionVariables.empty() ){
-          mace::ContextBaseClass::QueueItemType const& top =  context.conditionVariables.top();
-          if(  top.first == context.now_serving_execute_ticket) {
-            macedbg(1) << "[" << context.contextName<<"] Signalling CV " << top.second << " for ticket " << context.now_serving_execute_ticket << Log::endl;
-            pthread_cond_broadcast(top.second); // only signal if this is a reader -- writers should signal on commit only.
-          }else{
-            //context.signalContextThreadPool();
-            ASSERTMSG(context.conditionVariables.empty() || top.first > context.now_serving_execute_ticket, "conditionVariables map contains CV for ticket already served!!!");
-          }
-        } else {
-          //context.signalContextThreadPool();
-          ASSERTMSG(context.conditionVariables.empty() || context.conditionVariables.top().first > context.now_serving_execute_ticket, "conditionVariables map contains CV for ticket already served!!!");
+        // hand off directly to the event holding the next ticket, if it is already waiting
+        if ( context.executeWaiters.hasWaiters(context.now_serving_execute_ticket) ){
+          macedbg(1) << "[" << context.contextName<<"] Waking waiters for ticket " << context.now_serving_execute_ticket << Log::endl;
+          context.executeWaiters.notify(context.now_serving_execute_ticket);
         }
     }
     static void nullTicketNoLock(ContextBaseClass& context) {// chuangw: OK, I think.
@@ -192,7 +180,10 @@ private:
       ASSERTMSG ( executeTicket > 0, "In ContextLock::upgradeFromNone: the execute ticket is invalid" );
 
       if( !context.checkReEnterEvent(myEventId) ) {
-        ticketBoothWait(requestedMode);
+        {
+          EventTrace::Span span(EventTrace::LOCK_WAIT, myEventId, context.contextId);
+          ticketBoothWait(requestedMode);
+        }
         if (requestedMode == READ_MODE) {
           ASSERT(context.numWriters == 0);
         
@@ -204,16 +195,8 @@ private:
           if( context.numReaders > 1 ) {
             macedbg(1) << "In context("<< context.contextName <<"), numReaders=" << context.numReaders << Log::endl;
           }
-          // wake up the next waiting thread (which has the next smallest ticket number)
-          if ( !context.conditionVariables.empty() ){
-          //bypassEvent(context);
-            if(  context.conditionVariables.top().first == context.now_serving_execute_ticket) {
-              //macedbg(1) << "[" << context.contextName <<"] Now signalling ticket number " << context.now_serving_execute_ticket << " (my eventId is " << myEventId << " )" << Log::endl;
-              pthread_cond_broadcast(context.conditionVariables.top().second); // only signal if this is a reader -- writers should signal on commit only.
-            }
-          } else {
-            ASSERTMSG(context.conditionVariables.empty() || context.conditionVariables.top().first > context.now_serving_execute_ticket, "conditionVariables map contains CV for ticket already served!!!");
-          }
+          // wake up the next waiting thread (which has the next smallest ticket number), so readers run together
+          context.executeWaiters.notify(context.now_serving_execute_ticket);
         } else if (requestedMode == WRITE_MODE) {
           //Acquire write lock
           ASSERT(context.numReaders == 0);
@@ -248,39 +231,20 @@ private:
 
       uint64_t executeTicket = context.getExecuteEventTicket(myEventId);
       ASSERT( executeTicket > 0 );
-      if ( executeTicket > context.now_serving_execute_ticket ||
-          ( requestedMode == READ_MODE && (context.numWriters != 0) ) ||
-          ( requestedMode == WRITE_MODE && (context.numReaders != 0 || context.numWriters != 0) ) ||
-          ( requestedMode == MIGRATION_MODE && context.execute_now_committing_ticket != executeTicket )
-         ) {
-        macedbg(2)<< "[" << context.contextName << "] Storing condition variable " << &threadCond << " at eventId " <<  executeTicket << Log::endl;
-        context.conditionVariables.push( std::pair<uint64_t, pthread_cond_t*>( executeTicket, &threadCond ) );
-      }
-
-
       while ( executeTicket > context.now_serving_execute_ticket ||
           ( requestedMode == READ_MODE && (context.numWriters != 0) ) ||
           ( requestedMode == WRITE_MODE && (context.numReaders != 0 || context.numWriters != 0) ) ||
           ( requestedMode == MIGRATION_MODE && context.execute_now_committing_ticket != executeTicket )
           )    {
 
-        macedbg(2)<< "[" << context.contextName << "] Waiting for my turn on cv " << &threadCond << ".  myEventId " << myEventId << " wait until ticket " << executeTicket 
+        macedbg(2)<< "[" << context.contextName << "] Waiting for my turn.  myEventId " << myEventId << " wait until ticket " << executeTicket 
           << ", now_serving " << context.now_serving_execute_ticket << " requestedMode " << (int16_t)requestedMode << " numWriters " << context.numWriters << " numReaders " 
           << context.numReaders << Log::endl;
-        pthread_cond_wait(&threadCond, &_context_ticketbooth);
+        context.executeWaiters.wait(executeTicket, _context_ticketbooth);
       }
 
       macedbg(2) << "[" << context.contextName<< "] event " << myEventId << " being served! executeTicket = "<< executeTicket << Log::endl;
 
-      //If we added our cv to the map, it should be the front, since all earlier tickets have been served.
-      if (!context.conditionVariables.empty() && context.conditionVariables.top().first ==  executeTicket) {
-        macedbg(2) << "[" << context.contextName<<"] Erasing our cv from the map." << Log::endl;
-        context.conditionVariables.pop();
-      }
-      else if (!context.conditionVariables.empty()) {
-        macedbg(2) << "[" << context.contextName<<"] FYI, first cv in map is for ticket " << context.conditionVariables.top().first << Log::endl;
-      }
-
       ASSERT(executeTicket <= context.now_serving_execute_ticket); //Remove once working.
 
       if( requestedMode == READ_MODE) {
@@ -365,50 +329,27 @@ private:
         context.uncommittedEvents.second = READ_MODE;
 
         bypassEvent(context);
-        if (!context.conditionVariables.empty() && context.conditionVariables.top().first == context.now_serving_execute_ticket) {
-          macedbg(1) << "[" << context.contextName<<"] Signalling CV " << context.conditionVariables.top().second << " for ticket " << context.now_serving_execute_ticket << Log::endl;
-          pthread_cond_broadcast(context.conditionVariables.top().second); // only signal if this is a reader -- writers should signal on commit only.
-        }
-        else {
-          ASSERTMSG(context.conditionVariables.empty() || context.conditionVariables.top().first > context.now_serving_execute_ticket, "conditionVariables map contains CV for ticket already served!!!");
-        }
+        notifyNext(context);
     }
     void commitOrderWait() {
       ADD_SELECTORS("ContextLock::commitOrderWait");
       uint64_t executeTicket = context.getExecuteEventTicket(myEventId);
       ASSERT( executeTicket > 0 );
       
-      if ( executeTicket > context.execute_now_committing_ticket ) {
-        macedbg(1)<< "[" << context.contextName << "] Storing condition variable " << &threadCond << " at ticket " <<  executeTicket << Log::endl;
-        context.commitConditionVariables.push( std::pair< uint64_t, pthread_cond_t*>( executeTicket, &threadCond ) );
-      }
       while ( executeTicket > context.execute_now_committing_ticket) {
-        macedbg(1)<< "[" <<  context.contextName << "] Waiting for my turn on cv " << &threadCond << ".  myEventId " << myEventId << " wait until ticket " << executeTicket << ", now_committing " << context.execute_now_committing_ticket << Log::endl;
+        macedbg(1)<< "[" <<  context.contextName << "] Waiting for my turn.  myEventId " << myEventId << " wait until ticket " << executeTicket << ", now_committing " << context.execute_now_committing_ticket << Log::endl;
 
-        pthread_cond_wait(&(threadCond), &_context_ticketbooth);
+        context.commitWaiters.wait(executeTicket, _context_ticketbooth);
       }
 
       macedbg(1) << "[" <<  context.contextName<<"] Ticket " << executeTicket << " being committed at context '" <<context.contextName << "'! executeTicket = "<< executeTicket << Log::endl;
 
-      //If we added our cv to the map, it should be the front, since all earlier tickets have been served.
-      if ( !context.commitConditionVariables.empty() && context.commitConditionVariables.top().first ==  executeTicket) {
-        macedbg(1)<<  "[" << context.contextName << "] Erasing our cv from the map." << Log::endl;
-        context.commitConditionVariables.pop();
-      }
-      else if ( !context.commitConditionVariables.empty()) {
-        macedbg(1)<<  "[" << context.contextName << "] FYI, first cv in map is for ticket " << context.commitConditionVariables.top().first << Log::endl;
-      }
       ASSERT(executeTicket == context.execute_now_committing_ticket); //Remove once working.
 
       context.execute_now_committing_ticket = executeTicket+1;
 
-      if ( !context.commitConditionVariables.empty() && context.commitConditionVariables.top().first == context.execute_now_committing_ticket) {
-        macedbg(1)<<  "[" << context.contextName << "] Now signalling ticket number " << context.execute_now_committing_ticket << ", CV "<< context.commitConditionVariables.top().second << " (my ticket is " << executeTicket << " )" << Log::endl;
-        pthread_cond_broadcast(context.commitConditionVariables.top().second); // only signal if this is a reader -- writers should signal on commit only.
-      }
-      else {
-        ASSERTMSG(context.commitConditionVariables.empty() || context.commitConditionVariables.top().first > context.execute_now_committing_ticket, "conditionVariables map contains CV for ticket already served!!!");
-      }
+      macedbg(1)<<  "[" << context.contextName << "] Now handing off to ticket number " << context.execute_now_committing_ticket << " (my ticket is " << executeTicket << " )" << Log::endl;
+      context.commitWaiters.notify(context.execute_now_committing_ticket);
     }
 };
 
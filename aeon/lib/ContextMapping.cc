@@ -372,6 +372,33 @@ std::pair< bool , uint32_t> mace::ContextMapping::updateMapping( const mace::Mac
   ADD_SELECTORS ("ContextMapping::updateMapping");
   ScopedLock sl (alock);
 
+  bool newNode = moveContext( node, context );
+  current_version ++;
+  macedbg(1) << "current_version increased to " << current_version << Log::endl;
+
+  return std::pair< bool, uint32_t >( newNode, nContexts );
+}
+
+uint32_t mace::ContextMapping::updateMapping( const mace::map< mace::string, mace::MaceAddr >& moves ){
+  ADD_SELECTORS ("ContextMapping::updateMapping");
+  ScopedLock sl (alock);
+
+  uint32_t moved = 0;
+  for( mace::map< mace::string, mace::MaceAddr >::const_iterator iter = moves.begin(); iter != moves.end(); iter++ ){
+    if( _hasContext( iter->first ) && mapping[ findIDByName(iter->first) ].addr == iter->second ){
+      continue;
+    }
+    moveContext( iter->second, iter->first );
+    moved ++;
+  }
+  if( moved > 0 ){
+    current_version ++;
+    macedbg(1) << "current_version increased to " << current_version << " after moving " << moved << " contexts" << Log::endl;
+  }
+  return moved;
+}
+
+bool mace::ContextMapping::moveContext( const mace::MaceAddr & node, const mace::string & context ){
   if( _hasContext( context ) ){
     const uint32_t contextID = findIDByName( context );
     mace::MaceAddr oldNode = mapping[ contextID ].addr;
@@ -393,10 +420,7 @@ std::pair< bool , uint32_t> mace::ContextMapping::updateMapping( const mace::Mac
 
   nodes[ node ] ++;
   nodeInfos[ node ].addContext( context );
-  current_version ++;
-  macedbg(1) << "current_version increased to " << current_version << Log::endl;
-
-  return std::pair< bool, uint32_t >( newNode, nContexts );
+  return newNode;
 }
 
 /**************************************** class ContextNodeInformation *********************************************************/
@@ -550,6 +550,14 @@ namespace mace {
 
     }
     std::pair< bool , uint32_t> updateMapping (const mace::MaceAddr & node, const mace::string & context);
+    /**
+     * move a set of contexts at once (e.g. a migration plan). Unlike calling
+     * updateMapping() per context, this creates a single new mapping version.
+     *
+     * @param moves the new node of each context
+     * @return the number of contexts whose node changed
+     * */
+    uint32_t updateMapping (const mace::map< mace::string, mace::MaceAddr >& moves);
     // create a new mapping for a context not mapped before.
     // @return a pair of the MaceAddr as well as the numbercal ID of the context
     const std::pair< mace::MaceAddr, uint32_t> newMapping( const mace::string& contextName, const mace::ElasticityRule& rule, 
@@ -737,6 +745,8 @@ namespace mace {
       }
       return parent;
     }
+    // move one context to node, without bumping the version. Caller holds alock.
+    bool moveContext(const mace::MaceAddr & node, const mace::string & context);
     // add a new context entry into mapping
     void insertMapping(const mace::string& contextName, const mace::MaceAddr& addr){
       ASSERT( !_hasContext( contextName ) );
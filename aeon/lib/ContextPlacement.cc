@@ -0,0 +1,563 @@
+/* 
+ * ContextPlacement.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <algorithm>
+#include <sstream>
+
+#include "ContextPlacement.h"
+
+/****************************** class ContextInteractionGraph ******************************/
+uint32_t mace::ContextInteractionGraph::addServer(const std::string& name, double capacity, double baseLoad) {
+  std::map<std::string, uint32_t>::iterator i = serverIds.find(name);
+  uint32_t id;
+  if (i == serverIds.end()) {
+    id = servers.size();
+    serverIds[name] = id;
+    servers.push_back(Server());
+    servers[id].name = name;
+  }
+  else {
+    id = i->second;
+  }
+  servers[id].capacity = capacity;
+  servers[id].baseLoad = baseLoad;
+  return id;
+}
+
+uint32_t mace::ContextInteractionGraph::addContext(const std::string& name, double weight, uint32_t server, bool pinned) {
+  std::map<std::string, uint32_t>::iterator i = contextIds.find(name);
+  uint32_t id;
+  if (i == contextIds.end()) {
+    id = contexts.size();
+    contextIds[name] = id;
+    contexts.push_back(Context());
+    edges.push_back(EdgeMap());
+    contexts[id].name = name;
+  }
+  else {
+    id = i->second;
+  }
+  contexts[id].weight = weight;
+  contexts[id].server = server;
+  contexts[id].pinned = pinned;
+  return id;
+}
+
+void mace::ContextInteractionGraph::addInteraction(const std::string& a, const std::string& b, uint64_t count) {
+  std::map<std::string, uint32_t>::const_iterator ia = contextIds.find(a);
+  std::map<std::string, uint32_t>::const_iterator ib = contextIds.find(b);
+  if (ia == contextIds.end() || ib == contextIds.end() || ia->second == ib->second || count == 0) {
+    return;
+  }
+  edges[ia->second][ib->second] += count;
+  edges[ib->second][ia->second] += count;
+}
+
+uint32_t mace::ContextInteractionGraph::getServerId(const std::string& name) const {
+  std::map<std::string, uint32_t>::const_iterator i = serverIds.find(name);
+  return (i == serverIds.end()) ? servers.size() : i->second;
+}
+
+uint32_t mace::ContextInteractionGraph::getContextId(const std::string& name) const {
+  std::map<std::string, uint32_t>::const_iterator i = contextIds.find(name);
+  return (i == contextIds.end()) ? contexts.size() : i->second;
+}
+
+std::vector<uint32_t> mace::ContextInteractionGraph::currentAssignment() const {
+  std::vector<uint32_t> assignment(contexts.size());
+  for (uint32_t i = 0; i < contexts.size(); i++) {
+    assignment[i] = contexts[i].server;
+  }
+  return assignment;
+}
+
+uint64_t mace::ContextInteractionGraph::cutWeight(const std::vector<uint32_t>& assignment) const {
+  uint64_t cut = 0;
+  for (uint32_t i = 0; i < edges.size(); i++) {
+    for (EdgeMap::const_iterator e = edges[i].upper_bound(i); e != edges[i].end(); e++) {
+      if (assignment[i] != assignment[e->first]) {
+        cut += e->second;
+      }
+    }
+  }
+  return cut;
+}
+
+uint64_t mace::ContextInteractionGraph::totalWeight() const {
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < edges.size(); i++) {
+    for (EdgeMap::const_iterator e = edges[i].upper_bound(i); e != edges[i].end(); e++) {
+      total += e->second;
+    }
+  }
+  return total;
+}
+
+std::vector<double> mace::ContextInteractionGraph::serverLoads(const std::vector<uint32_t>& assignment) const {
+  std::vector<double> loads(servers.size());
+  for (uint32_t s = 0; s < servers.size(); s++) {
+    loads[s] = servers[s].baseLoad;
+  }
+  for (uint32_t i = 0; i < contexts.size(); i++) {
+    loads[assignment[i]] += contexts[i].weight;
+  }
+  return loads;
+}
+
+void mace::ContextInteractionGraph::clear() {
+  servers.clear();
+  contexts.clear();
+  edges.clear();
+  serverIds.clear();
+  contextIds.clear();
+}
+
+void mace::ContextInteractionGraph::print(std::ostream& out) const {
+  for (uint32_t s = 0; s < servers.size(); s++) {
+    out << "server " << servers[s].name << " " << servers[s].capacity << " " << servers[s].baseLoad << "\n";
+  }
+  for (uint32_t i = 0; i < contexts.size(); i++) {
+    out << "context " << contexts[i].name << " " << contexts[i].weight << " " << servers[contexts[i].server].name
+        << (contexts[i].pinned ? " pinned" : "") << "\n";
+  }
+  for (uint32_t i = 0; i < edges.size(); i++) {
+    for (EdgeMap::const_iterator e = edges[i].upper_bound(i); e != edges[i].end(); e++) {
+      out << "interaction " << contexts[i].name << " " << contexts[e->first].name << " " << e->second << "\n";
+    }
+  }
+  out << "end" << std::endl;
+}
+
+bool mace::ContextInteractionGraph::read(std::istream& in, std::string& error) {
+  clear();
+  error.clear();
+  bool found = false;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    std::string kind;
+    if (!(is >> kind) || kind[0] == '#') {
+      continue;
+    }
+    found = true;
+    if (kind == "end") {
+      return true;
+    }
+    else if (kind == "server") {
+      std::string name;
+      double capacity = 0, baseLoad = 0;
+      if (!(is >> name >> capacity)) {
+        error = "malformed line: " + line;
+        return false;
+      }
+      is >> baseLoad;
+      addServer(name, capacity, baseLoad);
+    }
+    else if (kind == "context") {
+      std::string name, server, flag;
+      double weight = 0;
+      if (!(is >> name >> weight >> server) || !hasServer(server)) {
+        error = "malformed line or unknown server: " + line;
+        return false;
+      }
+      is >> flag;
+      addContext(name, weight, getServerId(server), flag == "pinned");
+    }
+    else if (kind == "interaction") {
+      std::string a, b;
+      uint64_t count = 0;
+      if (!(is >> a >> b >> count)) {
+        error = "malformed line: " + line;
+        return false;
+      }
+      addInteraction(a, b, count);
+    }
+    else {
+      error = "unknown line: " + line;
+      return false;
+    }
+  }
+  return found;
+}
+
+/****************************** class ContextPartitioner ******************************/
+/// one level of the multilevel partitioning
+struct mace::ContextPartitioner::Level {
+  std::vector<double> weight;
+  std::vector<int32_t> pinned; ///< server of a pinned vertex, or -1
+  std::vector< std::vector<uint64_t> > affinity; ///< migrationCost times the contexts on each server, per vertex
+  std::vector< std::map<uint32_t, uint64_t> > edges;
+  std::vector<uint32_t> home; ///< current server of the contexts in the vertex
+  std::vector<uint32_t> parent; ///< vertex in the next coarser level
+  std::vector<uint32_t> part;
+
+  uint32_t size() const { return weight.size(); }
+  void resize(uint32_t n, uint32_t servers) {
+    weight.assign(n, 0);
+    pinned.assign(n, -1);
+    affinity.assign(n, std::vector<uint64_t>(servers, 0));
+    edges.assign(n, std::map<uint32_t, uint64_t>());
+    home.assign(n, 0);
+    part.assign(n, 0);
+  }
+};
+
+namespace {
+  struct HeavierFirst {
+    const std::vector<double>& weight;
+    HeavierFirst(const std::vector<double>& w) : weight(w) { }
+    bool operator()(uint32_t a, uint32_t b) const {
+      return weight[a] > weight[b] || (weight[a] == weight[b] && a < b);
+    }
+  };
+
+  struct FewerEdgesFirst {
+    const std::vector< std::map<uint32_t, uint64_t> >& edges;
+    FewerEdgesFirst(const std::vector< std::map<uint32_t, uint64_t> >& e) : edges(e) { }
+    bool operator()(uint32_t a, uint32_t b) const {
+      return edges[a].size() < edges[b].size() || (edges[a].size() == edges[b].size() && a < b);
+    }
+  };
+
+  double loadRatio(double load, double limit) {
+    return (limit > 0) ? load / limit : (load > 0 ? 1e300 : 0);
+  }
+}
+
+mace::ContextPartitioner::ContextPartitioner(double imbalance, uint64_t migrationCost, uint32_t refinePasses) :
+  imbalance(imbalance), migrationCost(migrationCost), refinePasses(refinePasses) {
+}
+
+std::vector<uint32_t> mace::ContextPartitioner::partition(const ContextInteractionGraph& graph) const {
+  const uint32_t n = graph.contextCount();
+  const uint32_t servers = graph.serverCount();
+  if (n == 0 || servers == 0) {
+    return std::vector<uint32_t>(n, 0);
+  }
+
+  // when the servers cannot hold everything, spread the excess in proportion to capacity
+  double capacity = 0, demand = 0, movable = 0;
+  std::vector<double> baseLoads(servers);
+  for (uint32_t s = 0; s < servers; s++) {
+    capacity += graph.getServer(s).capacity;
+    baseLoads[s] = graph.getServer(s).baseLoad;
+    demand += baseLoads[s];
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    demand += graph.getContext(i).weight;
+    if (!graph.getContext(i).pinned) {
+      movable += graph.getContext(i).weight;
+    }
+  }
+  const double scale = (capacity > 0 && demand > capacity) ? demand / capacity : 1;
+  std::vector<double> limits(servers);
+  for (uint32_t s = 0; s < servers; s++) {
+    limits[s] = graph.getServer(s).capacity * scale * (1 + imbalance);
+  }
+
+  Level finest;
+  finest.resize(n, servers);
+  for (uint32_t i = 0; i < n; i++) {
+    const ContextInteractionGraph::Context& ctx = graph.getContext(i);
+    finest.weight[i] = ctx.weight;
+    finest.pinned[i] = ctx.pinned ? (int32_t)ctx.server : -1;
+    finest.affinity[i][ctx.server] = migrationCost;
+    finest.edges[i] = graph.getEdges(i);
+    finest.home[i] = ctx.server;
+  }
+
+  // coarse vertices may not outweigh what a server should hold, or nothing could balance them
+  const double maxWeight = movable / (2 * servers);
+
+  // improve on the current placement, and partition from scratch; keep the better
+  multilevel(finest, true, maxWeight, limits, baseLoads);
+  std::vector<uint32_t> repartitioned = finest.part;
+  double overload;
+  uint64_t cost;
+  evaluate(finest, limits, baseLoads, overload, cost);
+
+  multilevel(finest, false, maxWeight, limits, baseLoads);
+  double scratchOverload;
+  uint64_t scratchCost;
+  evaluate(finest, limits, baseLoads, scratchOverload, scratchCost);
+  if (overload < scratchOverload || (overload == scratchOverload && cost <= scratchCost)) {
+    return repartitioned;
+  }
+  return finest.part;
+}
+
+std::vector<mace::ContextMove> mace::ContextPartitioner::plan(const ContextInteractionGraph& graph, const std::vector<uint32_t>& assignment) {
+  std::vector<ContextMove> moves;
+  for (uint32_t i = 0; i < graph.contextCount(); i++) {
+    const ContextInteractionGraph::Context& ctx = graph.getContext(i);
+    if (!ctx.pinned && assignment[i] != ctx.server) {
+      ContextMove move;
+      move.contextName = ctx.name;
+      move.fromServer = ctx.server;
+      move.toServer = assignment[i];
+      move.weight = ctx.weight;
+      moves.push_back(move);
+    }
+  }
+  return moves;
+}
+
+void mace::ContextPartitioner::multilevel(Level& finest, bool fromCurrent, double maxWeight, const std::vector<double>& limits,
+    const std::vector<double>& baseLoads) const {
+  const uint32_t smallest = std::max((uint32_t)16, 4 * (uint32_t)limits.size());
+  std::vector<Level> levels(1, finest);
+  while (levels.back().size() > smallest) {
+    Level coarse;
+    if (!coarsen(levels.back(), coarse, fromCurrent, maxWeight)) {
+      break;
+    }
+    levels.push_back(coarse);
+  }
+
+  Level& coarsest = levels.back();
+  if (fromCurrent) {
+    coarsest.part = coarsest.home;
+  }
+  else {
+    initialPartition(coarsest, limits, baseLoads);
+  }
+  refine(coarsest, limits, baseLoads);
+
+  for (int l = (int)levels.size() - 2; l >= 0; l--) {
+    Level& fine = levels[l];
+    const Level& coarse = levels[l + 1];
+    for (uint32_t v = 0; v < fine.size(); v++) {
+      fine.part[v] = coarse.part[fine.parent[v]];
+    }
+    refine(fine, limits, baseLoads);
+  }
+  finest.part = levels[0].part;
+}
+
+bool mace::ContextPartitioner::coarsen(Level& fine, Level& coarse, bool sameServer, double maxWeight) const {
+  const uint32_t n = fine.size();
+  const uint32_t servers = fine.affinity.empty() ? 0 : fine.affinity[0].size();
+
+  // heavy edge matching, visiting the vertices with fewest choices first.  To
+  // refine the current placement only vertices on the same server are
+  // matched, so that the placement remains a partition of every level.
+  std::vector<uint32_t> order(n);
+  for (uint32_t v = 0; v < n; v++) {
+    order[v] = v;
+  }
+  std::sort(order.begin(), order.end(), FewerEdgesFirst(fine.edges));
+
+  std::vector<int64_t> match(n, -1);
+  for (uint32_t k = 0; k < n; k++) {
+    const uint32_t v = order[k];
+    if (match[v] != -1) {
+      continue;
+    }
+    match[v] = v;
+    if (fine.pinned[v] != -1) {
+      continue;
+    }
+    int64_t best = -1;
+    uint64_t bestWeight = 0;
+    for (std::map<uint32_t, uint64_t>::const_iterator e = fine.edges[v].begin(); e != fine.edges[v].end(); e++) {
+      const uint32_t u = e->first;
+      if (match[u] == -1 && fine.pinned[u] == -1 && (!sameServer || fine.home[u] == fine.home[v]) && e->second > bestWeight &&
+          fine.weight[v] + fine.weight[u] <= maxWeight) {
+        best = u;
+        bestWeight = e->second;
+      }
+    }
+    if (best != -1) {
+      match[v] = best;
+      match[best] = v;
+    }
+  }
+
+  fine.parent.assign(n, n);
+  uint32_t count = 0;
+  for (uint32_t v = 0; v < n; v++) {
+    if (fine.parent[v] == n) {
+      fine.parent[v] = count;
+      fine.parent[match[v]] = count;
+      count++;
+    }
+  }
+  if (count * 20 > n * 19) {
+    // less than 5% smaller: coarsening has converged
+    return false;
+  }
+
+  coarse.resize(count, servers);
+  for (uint32_t v = 0; v < n; v++) {
+    const uint32_t c = fine.parent[v];
+    coarse.weight[c] += fine.weight[v];
+    coarse.home[c] = fine.home[v];
+    if (fine.pinned[v] != -1) {
+      coarse.pinned[c] = fine.pinned[v];
+    }
+    for (uint32_t s = 0; s < servers; s++) {
+      coarse.affinity[c][s] += fine.affinity[v][s];
+    }
+    for (std::map<uint32_t, uint64_t>::const_iterator e = fine.edges[v].begin(); e != fine.edges[v].end(); e++) {
+      const uint32_t cu = fine.parent[e->first];
+      if (cu != c) {
+        coarse.edges[c][cu] += e->second;
+      }
+    }
+  }
+  return true;
+}
+
+void mace::ContextPartitioner::initialPartition(Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads) const {
+  const uint32_t n = level.size();
+  const uint32_t servers = limits.size();
+  std::vector<double> loads(baseLoads);
+  std::vector<bool> placed(n, false);
+
+  std::vector<uint32_t> order;
+  for (uint32_t v = 0; v < n; v++) {
+    if (level.pinned[v] != -1) {
+      level.part[v] = level.pinned[v];
+      loads[level.part[v]] += level.weight[v];
+      placed[v] = true;
+    }
+    else {
+      order.push_back(v);
+    }
+  }
+  std::sort(order.begin(), order.end(), HeavierFirst(level.weight));
+
+  // place heavy vertices first, each next to what it talks to most, where it fits
+  std::vector<uint64_t> score(servers);
+  for (uint32_t k = 0; k < order.size(); k++) {
+    const uint32_t v = order[k];
+    const double w = level.weight[v];
+    score = level.affinity[v];
+    for (std::map<uint32_t, uint64_t>::const_iterator e = level.edges[v].begin(); e != level.edges[v].end(); e++) {
+      if (placed[e->first]) {
+        score[level.part[e->first]] += e->second;
+      }
+    }
+
+    int64_t best = -1;
+    for (uint32_t s = 0; s < servers; s++) {
+      if (loads[s] + w > limits[s]) {
+        continue;
+      }
+      if (best == -1 || score[s] > score[best] ||
+          (score[s] == score[best] && loadRatio(loads[s] + w, limits[s]) < loadRatio(loads[best] + w, limits[best]))) {
+        best = s;
+      }
+    }
+    if (best == -1) {
+      // nothing fits: least overloaded
+      best = 0;
+      for (uint32_t s = 1; s < servers; s++) {
+        if (loadRatio(loads[s] + w, limits[s]) < loadRatio(loads[best] + w, limits[best])) {
+          best = s;
+        }
+      }
+    }
+    level.part[v] = best;
+    loads[best] += w;
+    placed[v] = true;
+  }
+}
+
+void mace::ContextPartitioner::refine(Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads) const {
+  const uint32_t n = level.size();
+  const uint32_t servers = limits.size();
+  std::vector<double> loads(baseLoads);
+  for (uint32_t v = 0; v < n; v++) {
+    loads[level.part[v]] += level.weight[v];
+  }
+
+  std::vector<int64_t> conn(servers);
+  for (uint32_t pass = 0; pass < refinePasses; pass++) {
+    uint32_t moved = 0;
+    for (uint32_t v = 0; v < n; v++) {
+      if (level.pinned[v] != -1) {
+        continue;
+      }
+      const uint32_t own = level.part[v];
+      const double w = level.weight[v];
+      for (uint32_t s = 0; s < servers; s++) {
+        conn[s] = level.affinity[v][s];
+      }
+      for (std::map<uint32_t, uint64_t>::const_iterator e = level.edges[v].begin(); e != level.edges[v].end(); e++) {
+        conn[level.part[e->first]] += e->second;
+      }
+
+      // an overloaded server sheds vertices even when that raises the cut
+      const bool overloaded = loads[own] > limits[own];
+      int64_t best = -1;
+      int64_t bestGain = 0;
+      for (uint32_t s = 0; s < servers; s++) {
+        if (s == own || loads[s] + w > limits[s]) {
+          continue;
+        }
+        const int64_t gain = conn[s] - conn[own];
+        if ((best == -1 && (overloaded || gain > 0)) || (best != -1 && gain > bestGain) ||
+            (best != -1 && gain == bestGain && loadRatio(loads[s], limits[s]) < loadRatio(loads[best], limits[best]))) {
+          best = s;
+          bestGain = gain;
+        }
+      }
+      if (best != -1) {
+        level.part[v] = best;
+        loads[own] -= w;
+        loads[best] += w;
+        moved++;
+      }
+    }
+    if (moved == 0) {
+      break;
+    }
+  }
+}
+
+void mace::ContextPartitioner::evaluate(const Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads,
+    double& overload, uint64_t& cost) const {
+  std::vector<double> loads(baseLoads);
+  cost = 0;
+  for (uint32_t v = 0; v < level.size(); v++) {
+    loads[level.part[v]] += level.weight[v];
+    cost += level.affinity[v][level.home[v]] - level.affinity[v][level.part[v]];
+    for (std::map<uint32_t, uint64_t>::const_iterator e = level.edges[v].upper_bound(v); e != level.edges[v].end(); e++) {
+      if (level.part[e->first] != level.part[v]) {
+        cost += e->second;
+      }
+    }
+  }
+  overload = 0;
+  for (uint32_t s = 0; s < limits.size(); s++) {
+    overload += std::max(loads[s] - limits[s], 0.0);
+  }
+}
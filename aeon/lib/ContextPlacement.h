@@ -0,0 +1,183 @@
+/* 
+ * ContextPlacement.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * \file ContextPlacement.h
+ * \brief Declares the context interaction graph and the partitioner used to place contexts on servers
+ */
+
+#ifndef _MACE_CONTEXT_PLACEMENT_H
+#define _MACE_CONTEXT_PLACEMENT_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief weighted graph of contexts, the servers they run on, and how much they interact.
+ *
+ * Vertices are contexts weighted by their CPU time; an edge weighs the
+ * number of events and routines exchanged by two contexts in a period.
+ * Contexts that may not be moved (e.g. contexts of other servers that a
+ * local context talks to) are pinned to their current server.
+ *
+ * A graph can be printed to and read back from a line-oriented text form,
+ * so that graphs recorded by eMonitor can be replayed offline:
+ * \code
+ * server <name> <capacity> <base load>
+ * context <name> <cpu time> <server name> [pinned]
+ * interaction <context> <context> <count>
+ * end
+ * \endcode
+ */
+class ContextInteractionGraph {
+public:
+  struct Server {
+    std::string name;
+    double capacity; ///< CPU time the server can give to contexts in a period
+    double baseLoad; ///< CPU time used by work that is not in the graph
+  };
+
+  struct Context {
+    std::string name;
+    double weight;
+    uint32_t server; ///< current server
+    bool pinned;
+  };
+
+  typedef std::map<uint32_t, uint64_t> EdgeMap;
+
+private:
+  std::vector<Server> servers;
+  std::vector<Context> contexts;
+  std::vector<EdgeMap> edges;
+  std::map<std::string, uint32_t> serverIds;
+  std::map<std::string, uint32_t> contextIds;
+
+public:
+  /// adds a server, or updates it if \c name is known, and returns its index
+  uint32_t addServer(const std::string& name, double capacity, double baseLoad = 0);
+  /// adds a context, or updates it if \c name is known, and returns its index
+  uint32_t addContext(const std::string& name, double weight, uint32_t server, bool pinned = false);
+  /// adds \c count interactions between two known contexts; self interactions are ignored
+  void addInteraction(const std::string& a, const std::string& b, uint64_t count);
+
+  bool hasContext(const std::string& name) const { return contextIds.find(name) != contextIds.end(); }
+  bool hasServer(const std::string& name) const { return serverIds.find(name) != serverIds.end(); }
+  uint32_t getServerId(const std::string& name) const;
+  uint32_t getContextId(const std::string& name) const;
+
+  uint32_t serverCount() const { return servers.size(); }
+  uint32_t contextCount() const { return contexts.size(); }
+  const Server& getServer(uint32_t id) const { return servers[id]; }
+  const Context& getContext(uint32_t id) const { return contexts[id]; }
+  const EdgeMap& getEdges(uint32_t id) const { return edges[id]; }
+
+  /// return the server of every context, indexed by context
+  std::vector<uint32_t> currentAssignment() const;
+  /// return the total weight of edges between contexts on different servers
+  uint64_t cutWeight(const std::vector<uint32_t>& assignment) const;
+  /// return the total weight of all edges
+  uint64_t totalWeight() const;
+  /// return the load of every server, base load included
+  std::vector<double> serverLoads(const std::vector<uint32_t>& assignment) const;
+
+  void clear();
+  void print(std::ostream& out) const;
+  /// reads one graph, up to its \c end line; return false at end of input or on a malformed line
+  bool read(std::istream& in, std::string& error);
+};
+
+/// a context to migrate to carry out a placement
+struct ContextMove {
+  std::string contextName;
+  uint32_t fromServer;
+  uint32_t toServer;
+  double weight;
+};
+
+/**
+ * \brief computes a balanced, min-cut placement of a ContextInteractionGraph.
+ *
+ * Multilevel partitioning, in the style of METIS: the graph is coarsened by
+ * repeatedly merging heavily connected pairs of contexts, the coarsest graph
+ * is placed, and the placement is projected back level by level, moving
+ * vertices between servers whenever that lowers the cut without exceeding
+ * the server's capacity.  This is done twice, as in adaptive repartitioning:
+ * once placing the coarsest graph from scratch, and once merging only
+ * contexts of the same server and starting from the current placement; the
+ * better of the two placements is returned.
+ *
+ * To keep the migration plan small, each context counts migrationCost
+ * interactions with its current server, so it only moves when that saves
+ * more than migrationCost interactions (or relieves an overloaded server).
+ */
+class ContextPartitioner {
+public:
+  /// \param imbalance how far above capacity a server may be loaded, as a fraction of its capacity
+  /// \param migrationCost interactions a context must save to be moved from its current server
+  ContextPartitioner(double imbalance = 0.05, uint64_t migrationCost = 0, uint32_t refinePasses = 8);
+
+  /// return the server of every context, indexed by context
+  std::vector<uint32_t> partition(const ContextInteractionGraph& graph) const;
+  /// return the contexts whose server in \c assignment is not their current server
+  static std::vector<ContextMove> plan(const ContextInteractionGraph& graph, const std::vector<uint32_t>& assignment);
+
+private:
+  struct Level;
+
+  double imbalance;
+  uint64_t migrationCost;
+  uint32_t refinePasses;
+
+  void multilevel(Level& finest, bool fromCurrent, double maxWeight, const std::vector<double>& limits,
+    const std::vector<double>& baseLoads) const;
+  bool coarsen(Level& fine, Level& coarse, bool sameServer, double maxWeight) const;
+  void initialPartition(Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads) const;
+  void refine(Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads) const;
+  /// computes how far servers exceed their limits, and the cut plus the cost of migrations
+  void evaluate(const Level& level, const std::vector<double>& limits, const std::vector<double>& baseLoads,
+    double& overload, uint64_t& cost) const;
+};
+
+/** @} */
+
+}
+
+#endif // _MACE_CONTEXT_PLACEMENT_H
@@ -305,6 +305,7 @@ void ContextService::handleInternalMessages( mace::InternalMessage const& messag
     case mace::InternalMessage::ASYNC_EVENT:{
       mace::AsyncEvent_Message* h = static_cast< mace::AsyncEvent_Message*>( message.getHelper() );
       macedbg(1) << "Received an async message for " << message.getTargetContextName() << Log::endl;
+      mace::EventTrace::adopt( h->getEvent().eventId, message.getMsgID().traceFlags );
       mace::ContextBaseClass* ctxObj = getContextObjByName(message.getTargetContextName());
 
       if( handleMessageToMigratingAndNullContext(ctxObj, message, src) ) {
@@ -326,6 +327,7 @@ void ContextService::handleInternalMessages( mace::InternalMessage const& messag
     }
     case mace::InternalMessage::ROUTINE:{
       mace::Routine_Message* m = static_cast< mace::Routine_Message* >( message.getHelper() );
+      mace::EventTrace::adopt( m->getEvent().eventId, message.getMsgID().traceFlags );
 
       mace::ContextBaseClass* ctxObj = getContextObjByName(message.getTargetContextName());
       if( handleMessageToMigratingAndNullContext(ctxObj, message, src) ) {
@@ -589,6 +591,10 @@ void ContextService::handleInternalMessages( mace::InternalMessage const& messag
     }
     case mace::InternalMessage::COMMIT_CONTEXT_MIGRATION: {
       mace::commit_context_migration_Message* m = static_cast<mace::commit_context_migration_Message*>( message.getHelper() );
+      // contexts moved by a migration plan are already in its mapping version, which the plan publishes once all of them arrived
+      if( HeadEventDispatch::HeadEventTP::commitPlannedContextMigration( m->eventId.ticket, m->contextName ) ){
+        break;
+      }
       // update ContextMapping after migration
       contextMapping.updateMapping( m->destAddr, m->contextName );
 
@@ -1350,6 +1356,7 @@ void ContextService::__beginMethod( const uint32_t targetContextID, mace::vector
   } else {
     mace::ContextLock __contextLock( *thisContext, ThreadStructure::myEventID(), isRelease, mace::ContextLock::WRITE_MODE); // acquire context lock.
   } 
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, event.eventId, targetContextID);
 
   thisContext->setCurrentEventOp( event.eventOpInfo );
   uint64_t ver = (this->contextStructure).getDAGNodeVersion( thisContext->contextName );
@@ -1378,6 +1385,7 @@ void ContextService::__finishBroadcastTransition() const {
   if( contextInfoCollectFlag>0 ){
     (ctxObj->runtimeInfo).stopEvent(currentEvent.eventId);
   }
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, currentEvent.eventId);
 
   mace::vector<mace::EventOperationInfo> ownershipOpInfos = ctxObj->extractOwnershipOpInfos(currentEvent.eventId);
   if( ownershipOpInfos.size() > 0 ) {
@@ -1401,6 +1409,7 @@ void ContextService::__finishTransition(mace::ContextBaseClass* oldContext) cons
   if( contextInfoCollectFlag > 0 ){
     (thisContext->runtimeInfo).stopEvent(currentEvent.eventId);
   }
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, currentEvent.eventId);
 
   mace::vector<mace::EventOperationInfo> ownershipOpInfos = thisContext->extractOwnershipOpInfos(currentEvent.eventId);
   if( ownershipOpInfos.size() > 0 ) {
@@ -1531,6 +1540,12 @@ void ContextService::requestContextMigrationCommon(const uint8_t serviceID, cons
   HeadEventDispatch::HeadEventTP::executeContextMigrationEvent(const_cast<ContextService*>(this), serviceID, contextName, destNode, rootOnly );
 }
 
+void ContextService::requestContextsMigrationCommon(const uint8_t serviceID, const mace::map< mace::string, MaceAddr >& plan){
+  ADD_SELECTORS("ContextService::requestContextsMigrationCommon");
+  ASSERTMSG( contextMapping.getHead() == Util::getMaceAddr(), "Context migration is requested, but this physical node is not head node." );
+  macedbg(1) << "Migrating contexts " << plan << Log::endl;
+  HeadEventDispatch::HeadEventTP::executeContextsMigrationEvent(const_cast<ContextService*>(this), serviceID, plan );
+}
 
 void ContextService::handle__event_MigrateContext( void *p ){
   // This function must be executed on headnode
@@ -1670,6 +1685,104 @@ void ContextService::handle__event_MigrateContext( void *p ){
 
   delete msg;
 }
+void ContextService::handle__event_MigrateContexts( void *p ){
+  // This function must be executed on headnode
+  ADD_SELECTORS("ContextService::handle__event_MigrateContexts");
+
+  mace::__event_MigrateContexts *msg = static_cast< mace::__event_MigrateContexts * >( p );
+  ThreadStructure::setEventID( msg->eventId );
+
+  mace::Event& newEvent = ThreadStructure::myEvent( );
+  newEvent.newEventID( mace::Event::MIGRATIONEVENT );
+  newEvent.initialize3( msg->plan.empty()? mace::string(""): msg->plan.begin()->first, contextMapping.getCurrentVersion() );
+  newEvent.addServiceID(instanceUniqueID);
+  const uint64_t prevContextMappingVersion = newEvent.eventContextMappingVersion;
+
+  // 1. Split the plan into the contexts each destination receives and the streams each origin sends.
+  //    Contexts that do not exist yet only get their default mapping, and contexts already at their destination are ignored.
+  const ContextMapping& ctxmapSnapshot = contextMapping.getLatestContextMapping( );
+  mace::map< mace::string, MaceAddr > moves;
+  mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> > destContexts;
+  mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> > origContexts;
+  mace::map< mace::MaceAddr, mace::map< mace::MaceAddr, mace::set<uint32_t> > > streams;
+  mace::map< mace::MaceAddr, mace::list<mace::string> > servContext;
+  for( mace::map< mace::string, MaceAddr >::const_iterator pIter = msg->plan.begin(); pIter != msg->plan.end(); pIter++ ){
+    const mace::string& contextName = pIter->first;
+    const MaceAddr& destNode = pIter->second;
+    if( !contextMapping.hasContext( contextName ) ){
+      maceerr << "Requested context " << contextName << " does not exist. Set it as the default mapping when the context is created in the future." << Log::endl;
+      servContext[ destNode ].push_back( contextName );
+      continue;
+    }
+    const MaceAddr& origNode = mace::ContextMapping::getNodeByContext( ctxmapSnapshot, contextName );
+    if( origNode == destNode ){
+      continue;
+    }
+    const uint32_t ctxId = mace::ContextMapping::hasContext2( ctxmapSnapshot, contextName );
+    moves[ contextName ] = destNode;
+    destContexts[ destNode ][ ctxId ] = contextName;
+    origContexts[ origNode ][ ctxId ] = contextName;
+    streams[ origNode ][ destNode ].insert( ctxId );
+  }
+  if( servContext.size() > 0 ) {
+    contextMapping.loadMapping( servContext );
+  }
+  if( moves.empty() ){
+    HeadEventDispatch::HeadEventTP::commitGlobalEvent( newEvent.eventId.ticket ); // commit
+    delete msg;
+    return;
+  }
+  macedbg(1) << "Migrate " << moves.size() << " contexts from " << origContexts.size() << " nodes to " << destContexts.size() << " nodes" << Log::endl;
+
+  // 2. Every destination holds messages to its incoming contexts.
+  HeadEventDispatch::HeadEventTP::setMigrationPlan( this, newEvent.eventId, destContexts );
+
+  // 3. Move all contexts in a single mapping version, which is kept unpublished until the plan is done.
+  contextMapping.setUpdateFlag(false);
+  contextMapping.updateMapping( moves );
+  newEvent.eventContextMappingVersion = contextMapping.getCurrentVersion();
+  const mace::ContextMapping* ctxmapCopy = contextMapping.getCtxMapCopy( ); 
+
+  // 4. Create the context objects at the destinations.
+  mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> >::const_iterator dIter = destContexts.begin();
+  for(; dIter != destContexts.end(); dIter++ ){
+    if( isLocal( dIter->first ) ){
+      for( mace::map< uint32_t, mace::string >::const_iterator osIt = dIter->second.begin(); osIt != dIter->second.end(); osIt++ ){
+        mace::ContextBaseClass* thisContext = createContextObjectWrapper( newEvent.eventId, osIt->second, osIt->first, contextMapping.getLatestMappingVersion(), true );
+        const mace::vector<mace::string> dominateContexts = contextStructure.getDominateContexts(thisContext->contextName);
+        mace::string dominator = contextStructure.getUpperBoundContextName(thisContext->contextName);
+        uint64_t ver = contextStructure.getDAGNodeVersion(thisContext->contextName);
+        ASSERT( ver > 0 );
+        thisContext->initializeDominator( thisContext->contextName, dominator, ver, dominateContexts);
+      }
+    } else {
+      mace::vector< mace::pair<mace::string, mace::string> > ownershipPairs; 
+      mace::map<mace::string, uint64_t> vers;
+      send__event_AllocateContextObjectMsg( newEvent.eventId, *ctxmapCopy, dIter->first, dIter->second, mace::Event::MIGRATIONEVENT, 
+        contextMapping.getLatestMappingVersion(), ownershipPairs, vers ); 
+    }
+  }
+
+  // 5. Stream the contexts and wait until every one of them arrived.
+  HeadEventDispatch::HeadEventTP::waitingForMigrationPlan( this, streams, ThreadStructure::myEvent(), prevContextMappingVersion, 
+    *ctxmapCopy, newEvent.eventId );
+
+  // 6. Publish the new mapping and let origins and destinations release the messages they held.
+  macedbg(1) << "Release the latest ContextMapping("<< contextMapping.getCurrentVersion() <<")!" << Log::endl;
+  contextMapping.setUpdateFlag(true);
+  const mace::ContextMapping& ctxMapping = contextMapping.getLatestContextMapping();
+  for( dIter = destContexts.begin(); dIter != destContexts.end(); dIter++ ){
+    send__event_MigrationControlMsg( dIter->first, mace::MigrationControl_Message::MIGRATION_DONE, newEvent.eventId.ticket, dIter->second, ctxMapping );
+  }
+  for( dIter = origContexts.begin(); dIter != origContexts.end(); dIter++ ){
+    send__event_MigrationControlMsg( dIter->first, mace::MigrationControl_Message::MIGRATION_DONE, newEvent.eventId.ticket, dIter->second, ctxMapping );
+  }
+  HeadEventDispatch::HeadEventTP::commitGlobalEvent( newEvent.eventId.ticket );
+
+  delete ctxmapCopy;
+  delete msg;
+}
+
 void ContextService::sendAsyncSnapshot( __asyncExtraField const& extra, mace::string const& thisContextID, mace::ContextBaseClass* const& thisContext ){
   //ThreadStructure::myEvent().eventID = extra.event.eventID;
   mace::Event& myEvent = ThreadStructure::myEvent();
@@ -2014,7 +2127,7 @@ void ContextService::executeEventBroadcastRequest( mace::AsyncEvent_Message* req
   ASSERT( ctxObj != NULL );
 
   if( contextInfoCollectFlag>0 ){
-      (ctxObj->runtimeInfo).addCalleeContext( extra.targetContextID, extra.methodName );
+      (ctxObj->runtimeInfo).addCalleeContext( event.eventId, extra.targetContextID, extra.methodName );
   }
   macedbg(1) << "Event("<< event.eventId <<") make a broadcast call to context("<< extra.targetContextID <<") from context("<< ctxObj->contextName <<")!" << Log::endl;
 
@@ -2262,7 +2375,7 @@ void ContextService::send__event_commit( MaceAddr const& destNode, mace::Event c
 
   void ContextService::send__event_asyncEvent( mace::MaceAddr const& dest, mace::AsyncEvent_Message* const eventObject, mace::string const& ctxName ) {
     ADD_SELECTORS("ContextService::send__event_asyncEvent");
-    mace::InternalMessageID msgId( Util::getMaceAddr(), ctxName, 0);
+    mace::InternalMessageID msgId( Util::getMaceAddr(), ctxName, 0, mace::EventTrace::flagsFor(eventObject->getEvent().eventId) );
     mace::InternalMessage msg( eventObject, msgId, instanceUniqueID );
     forwardInternalMessage(dest, msg);
   }
@@ -3251,7 +3364,7 @@ void ContextService::handle__event_MigrationControl( const mace::MigrationContro
     }
 
     releaseBlockedMessageForMigration(migrateContexts);
-    elasticityMonitor->wrapupCurrentContextMigration();
+    elasticityMonitor->wrapupCurrentContextMigration(migrateContexts);
   } else if (type == mace::MigrationControl_Message::MIGRATION_PREPARE_RECV_CONTEXTS ) {
     macedbg(1) << "Migrating event ticket = " << msg->ticket << Log::endl;
     const mace::map<uint32_t, mace::string>& migrate_contexts = msg->migrate_contexts;
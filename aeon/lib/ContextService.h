@@ -27,6 +27,7 @@
 #include "ElasticPolicy.h"
 #include "eMonitor.h"
 #include "ControlMessageChannel.h"
+#include "EventTrace.h"
 
 /**
  * \file ContextService.h
@@ -139,6 +140,35 @@ public:
     }
     void sqlize(mace::LogNode* __node) const { }
 
+    std::string serializeStr() const { 
+      mace::string str;
+      return str;
+    }
+    void deserializeStr(const std::string& __s) throw (mace::SerializationException) { }
+  };
+  class __event_MigrateContexts: public Message, public PrintPrintable {
+  public:
+    __event_MigrateContexts( mace::OrderID const& eventId, uint8_t const serviceID, mace::map< mace::string, MaceAddr > const& plan ):
+      eventId( eventId ), serviceID( serviceID ), plan( plan ){}
+    const mace::OrderID eventId;
+    const uint8_t serviceID;
+    const mace::map< mace::string, MaceAddr > plan; ///< destination of each migrating context
+    static const uint8_t messageType = 255;
+    static uint8_t getMsgType() { return messageType; }
+    uint8_t getType() const { return NullEventMessage::getMsgType(); }
+
+    std::string toString() const { 
+      mace::string str;
+      return str;
+    }
+    void print(std::ostream& __out) const { }
+    size_t getSerializedSize() const { return 0; }
+    void serialize(std::string& str) const { }
+    int deserialize(std::istream& __mace_in) throw (mace::SerializationException) { 
+      return 0;
+    }
+    void sqlize(mace::LogNode* __node) const { }
+
     std::string serializeStr() const { 
       mace::string str;
       return str;
@@ -250,8 +280,13 @@ public:
 
     uint32_t minThreadSize = params::get<uint32_t>("MIN_CONTEXT_THREADS", 2);
     uint32_t maxThreadSize = params::get<uint32_t>("MAX_CONTEXT_THREADS", 8);
-    macedbg(1) << "minThreadSize=" << minThreadSize << ", maxThreadSize=" << maxThreadSize << Log::endl;
-    contextEventDispatcher = new mace::ContextEventTP(  minThreadSize, maxThreadSize );
+    uint32_t affinityThreads = params::get<uint32_t>("CONTEXT_AFFINITY_WORKERS", 0);
+    uint32_t coroutineStackSize = 0;
+    if( params::get<bool>("CONTEXT_COROUTINES", false) ) {
+      coroutineStackSize = params::get<uint32_t>("CONTEXT_COROUTINE_STACK_SIZE", mace::Coroutine::DEFAULT_STACK_SIZE);
+    }
+    macedbg(1) << "minThreadSize=" << minThreadSize << ", maxThreadSize=" << maxThreadSize << ", affinityThreads=" << affinityThreads << ", coroutineStackSize=" << coroutineStackSize << Log::endl;
+    contextEventDispatcher = new mace::ContextEventTP(  minThreadSize, maxThreadSize, affinityThreads, coroutineStackSize );
 
     // uint32_t channelThreadSize = params::get<uint32_t>("CONTROL_CHANNEL_THREADS", 2);
     // eventExecutionControlChannel = new EventExecutionControlMessageChannel( this, channelThreadSize );
@@ -414,6 +449,16 @@ protected:
    * @param rootOnly whether or not to migrate the subcontexts as well.
    * */
   void requestContextMigrationCommon(const uint8_t serviceID, const mace::string& contextID, const MaceAddr& destNode, const bool rootOnly);
+  /**
+   * Migrate a set of contexts under one global event.
+   * The contexts are streamed from every origin to every destination in parallel, and the head publishes one new context mapping
+   * version once all of them have arrived, instead of one version per context. Contexts that do not exist yet are mapped to
+   * their destination as in requestContextMigrationCommon().
+   *
+   * @param serviceID the numerical ID of the target service
+   * @param plan the destination node of each context
+   * */
+  void requestContextsMigrationCommon(const uint8_t serviceID, const mace::map< mace::string, MaceAddr >& plan);
   /**
    * initialize context mapping. This is supposed to be called in service constructor.
    *
@@ -607,12 +652,9 @@ private:
 
   void scaleTo(const uint32_t& n) {
     mace::map<mace::string, mace::MaceAddr> newMapping = contextMapping.scaleTo(n);
-
-    for( mace::map<mace::string, mace::MaceAddr>::iterator iter=newMapping.begin(); iter!=newMapping.end(); iter++ ){
-      MaceAddr dest = iter->second;
-      mace::string contextName = iter->first;
+    if( !newMapping.empty() ){
       uint8_t service = 0;
-      requestContextMigrationCommon(service, contextName, dest , true);
+      requestContextsMigrationCommon(service, newMapping);
     }
   }
   
@@ -1056,6 +1098,7 @@ public:
   void checkAndUpdateContextMapping(const uint64_t contextMappingVer);
   void checkAndUpdateContextStructure(const uint64_t contextStructureVer);
   void handle__event_MigrateContext( void *p );
+  void handle__event_MigrateContexts( void *p );
   void downgradeBroadcastEvent( mace::string const& ctxName, mace::OrderID const& eventId, mace::OrderID const& bEventId, 
     mace::map<mace::string, mace::set<mace::string> > const& cpRelations, mace::set<mace::string> const& targetContextNames ) const;
 
@@ -1162,6 +1205,7 @@ public:
   void signalSharedCreateThread() { contextEventDispatcher->signalSharedCreateThread(); }
   void signalSharedExecuteThread() { contextEventDispatcher->signalSharedExecuteThread(); }
   void signalSharedCommitThread() { contextEventDispatcher->signalSharedCommitThread(); }
+  uint32_t getEventQueueDepth() const { return contextEventDispatcher->getQueueDepth(); }
 
   // Ownership methods
   void createNewOwnership(mace::string const& pContextName, mace::string const& cContextName );
@@ -1535,6 +1579,7 @@ class __ScopedRoutine__ {
     if( _service->contextInfoCollectFlag > 0 ){
       (ctxObj->runtimeInfo).stopEvent(event.eventId);
     }
+    mace::EventTrace::end(mace::EventTrace::EXECUTE, event.eventId);
     
     mace::vector<mace::EventOperationInfo> ownershipOpInfos = ctxObj->extractOwnershipOpInfos(event.eventId);
     if( ownershipOpInfos.size() > 0 ) {
@@ -1640,7 +1685,7 @@ protected:
 
       if( service->contextInfoCollectFlag > 0 ){
         (myContextObj->runtimeInfo).stopEvent(event.eventId);
-        (myContextObj->runtimeInfo).addCalleeContext(targetContextName, methodName);
+        (myContextObj->runtimeInfo).addCalleeContext(event.eventId, targetContextName, methodName);
       }
 
       mace::vector<mace::EventOperationInfo> ownershipOpInfos = myContextObj->extractOwnershipOpInfos(event.eventId);
@@ -1723,7 +1768,8 @@ public:
     const mace::Event& event = routine_msg->getEvent();
     const mace::string toContextName = event.eventOpInfo.toContextName;
     macedbg(1) << "Event("<< event.eventId <<") make a routine call to context("<< toContextName <<")!" << Log::endl;
-    mace::InternalMessageID msgId( Util::getMaceAddr(), toContextName, 0 );
+    EventTrace::Span span(EventTrace::ROUTINE, event.eventId, ThreadStructure::myContext()->contextId);
+    mace::InternalMessageID msgId( Util::getMaceAddr(), toContextName, 0, EventTrace::flagsFor(event.eventId) );
     InternalMessage im(routine_msg, msgId, sid);
     service->forwardInternalMessage(cm.getDestination(), im);
 
@@ -1764,10 +1810,10 @@ public:
     Routine_Message* routine_msg = static_cast<Routine_Message*>(message);
     const mace::Event& event = routine_msg->getEvent();
     const mace::string toContextName = event.eventOpInfo.toContextName;
-    mace::InternalMessageID msgId( Util::getMaceAddr(), event.eventOpInfo.toContextName, 0 );
+    mace::InternalMessageID msgId( Util::getMaceAddr(), event.eventOpInfo.toContextName, 0, EventTrace::flagsFor(event.eventId) );
     macedbg(1) << "Event("<< event.eventId <<") op("<< event.eventOpInfo <<") make a routine call to context("<< toContextName <<")!" << Log::endl;
 
-
+    EventTrace::Span span(EventTrace::ROUTINE, event.eventId, ThreadStructure::myContext()->contextId);
     InternalMessage im(routine_msg, msgId, sid);
     service->forwardInternalMessage(cm.getDestination(), im);
     
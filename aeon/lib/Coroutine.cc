@@ -0,0 +1,150 @@
+/* 
+ * Coroutine.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include "Coroutine.h"
+#include "ScopedLock.h"
+#include "massert.h"
+
+/**
+ * \file Coroutine.cc
+ * \brief Defines the stackful coroutines that context events run in
+ */
+
+namespace mace {
+
+namespace {
+  __thread Coroutine* running = NULL;
+
+  // mapping a stack costs a few system calls, so a few are kept for reuse
+  const size_t MAX_FREE_STACKS = 64;
+  pthread_mutex_t freeStacksMutex = PTHREAD_MUTEX_INITIALIZER;
+  std::vector<std::pair<char*, size_t> > freeStacks;
+
+  size_t pageSize() {
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  char* allocateStack(size_t size) {
+    ScopedLock sl(freeStacksMutex);
+    for (size_t i = 0; i < freeStacks.size(); i++) {
+      if (freeStacks[i].second == size) {
+        char* stack = freeStacks[i].first;
+        freeStacks[i] = freeStacks.back();
+        freeStacks.pop_back();
+        return stack;
+      }
+    }
+    sl.unlock();
+
+    void* p = mmap(NULL, size + pageSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERTMSG(p != MAP_FAILED, "Cannot map a coroutine stack");
+    // the lowest page stays unmapped so that an overflow faults
+    ASSERT(mprotect(p, pageSize(), PROT_NONE) == 0);
+    return (char*)p + pageSize();
+  }
+
+  void releaseStack(char* stack, size_t size) {
+    ScopedLock sl(freeStacksMutex);
+    if (freeStacks.size() < MAX_FREE_STACKS) {
+      freeStacks.push_back(std::make_pair(stack, size));
+      return;
+    }
+    sl.unlock();
+    munmap(stack - pageSize(), size + pageSize());
+  }
+}
+
+Coroutine::Coroutine(EntryFP entry, void* arg, SwitchFP scheduler, size_t stackSize) :
+  entry(entry), arg(arg), scheduler(scheduler), switchIn(NULL), switchOut(NULL),
+  stack(NULL), stackSize((stackSize + pageSize() - 1) / pageSize() * pageSize()), done(false),
+  afterYield(NULL), afterYieldArg(NULL) {
+  stack = allocateStack(this->stackSize);
+  ASSERT(getcontext(&context) == 0);
+  context.uc_stack.ss_sp = stack;
+  context.uc_stack.ss_size = this->stackSize;
+  context.uc_link = &caller;
+  makecontext(&context, &Coroutine::trampoline, 0);
+}
+
+Coroutine::~Coroutine() {
+  ASSERTMSG(running != this, "A coroutine cannot delete itself");
+  releaseStack(stack, stackSize);
+}
+
+void Coroutine::trampoline() {
+  Coroutine* co = running;
+  co->entry(co->arg);
+  co->done = true;
+  // returning switches to uc_link, the caller of the last resume()
+}
+
+bool Coroutine::resume() {
+  ASSERT(!done);
+  Coroutine* previous = running;
+  if (switchIn != NULL) {
+    switchIn(this);
+  }
+  running = this;
+  ASSERT(swapcontext(&caller, &context) == 0);
+  running = previous;
+  if (switchOut != NULL) {
+    switchOut(this);
+  }
+
+  // after the action another thread may resume the coroutine, so read it first
+  const bool finished = done;
+  ActionFP action = afterYield;
+  void* actionArg = afterYieldArg;
+  afterYield = NULL;
+  afterYieldArg = NULL;
+  if (action != NULL) {
+    action(actionArg);
+  }
+  return finished;
+}
+
+void Coroutine::yield(ActionFP action, void* actionArg) {
+  Coroutine* co = running;
+  ASSERTMSG(co != NULL, "yield() called outside of a coroutine");
+  co->afterYield = action;
+  co->afterYieldArg = actionArg;
+  ASSERT(swapcontext(&co->context, &co->caller) == 0);
+}
+
+Coroutine* Coroutine::current() {
+  return running;
+}
+
+}
@@ -0,0 +1,121 @@
+/* 
+ * Coroutine.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <stddef.h>
+#include <ucontext.h>
+
+/**
+ * \file Coroutine.h
+ * \brief Declares the stackful coroutines that context events run in
+ */
+
+#ifndef _MACE_COROUTINE_H
+#define _MACE_COROUTINE_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief a function running on its own stack, which can suspend itself and be resumed later by any thread.
+ *
+ * resume() runs the coroutine on the calling thread until it returns or
+ * calls yield().  A suspended coroutine is woken by calling schedule(),
+ * which hands it to the scheduler function given to the constructor; that
+ * function must arrange for some thread to call resume() again.
+ *
+ * yield() takes an action that runs on the resuming thread after the
+ * coroutine has been switched out, which is the place to release a lock
+ * protecting the condition it waits for: once the action has run the
+ * coroutine may be resumed, by another thread, at any time, so the caller
+ * of resume() must not touch the coroutine after a resume() that returns
+ * false.  The switch hooks run on the resuming thread just before the
+ * coroutine is switched in and just after it is switched out, to swap any
+ * thread specific state that should follow the coroutine.
+ */
+class Coroutine {
+public:
+  typedef void (*EntryFP)(void* arg);
+  typedef void (*SwitchFP)(Coroutine* co);
+  typedef void (*ActionFP)(void* arg);
+
+  static const size_t DEFAULT_STACK_SIZE = 256 * 1024;
+
+private:
+  EntryFP entry;
+  void* arg;
+  SwitchFP scheduler;
+  SwitchFP switchIn;
+  SwitchFP switchOut;
+  ucontext_t context;
+  ucontext_t caller;
+  char* stack;
+  size_t stackSize;
+  bool done;
+  ActionFP afterYield;
+  void* afterYieldArg;
+
+  static void trampoline();
+  // no copies: the stack is owned by one coroutine
+  Coroutine(const Coroutine&);
+  Coroutine& operator=(const Coroutine&);
+
+public:
+  /**
+   * @param entry the function to run, called with \c arg
+   * @param scheduler called by schedule() to have the coroutine resumed
+   * @param stackSize bytes of stack, below a guard page
+   */
+  Coroutine(EntryFP entry, void* arg, SwitchFP scheduler = NULL, size_t stackSize = DEFAULT_STACK_SIZE);
+  ~Coroutine();
+
+  void setSwitchHooks(SwitchFP in, SwitchFP out) { switchIn = in; switchOut = out; }
+
+  /// runs the coroutine until it yields or returns. @return true if it has returned
+  bool resume();
+  /// asks the scheduler to resume the suspended coroutine
+  void schedule() { scheduler(this); }
+
+  /// suspends the calling coroutine, running \c action(\c actionArg) once it is switched out
+  static void yield(ActionFP action = NULL, void* actionArg = NULL);
+  /// return the coroutine running on this thread, or NULL
+  static Coroutine* current();
+
+  void* getArg() const { return arg; }
+  bool isDone() const { return done; }
+};
+
+/** @} */
+
+}
+#endif // _MACE_COROUTINE_H
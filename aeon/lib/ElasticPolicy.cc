@@ -40,26 +40,27 @@ int mace::EventAccessInfo::deserialize(std::istream & is) throw (mace::Serializa
   return serializedByteSize;
 }
 
-void mace::EventAccessInfo::addFromEventAccess(const uint64_t execute_time, const mace::string& create_ctx_name, const uint64_t& msg_size ) {
-  totalFromEventCount ++;
+void mace::EventAccessInfo::addFromEventAccess(const uint64_t execute_time, const mace::string& create_ctx_name, const uint64_t& msg_size, 
+    const uint64_t count ) {
+  totalFromEventCount += count;
   totalEventExecuteTime += execute_time;
 
   if( fromContextCounts.find(create_ctx_name) == fromContextCounts.end() ) {
-    fromContextCounts[create_ctx_name] = 1;
+    fromContextCounts[create_ctx_name] = count;
     fromMessagesSize[create_ctx_name] = msg_size;
   } else {
-    fromContextCounts[create_ctx_name] ++;
+    fromContextCounts[create_ctx_name] += count;
     fromMessagesSize[create_ctx_name] += msg_size;
   }
 }
 
-void mace::EventAccessInfo::addToEventAccess( const mace::string& to_ctx_name ) {
-  totalToEventCount ++;
+void mace::EventAccessInfo::addToEventAccess( const mace::string& to_ctx_name, const uint64_t count ) {
+  totalToEventCount += count;
   
   if( toContextCounts.find(to_ctx_name) == toContextCounts.end() ) {
-    toContextCounts[to_ctx_name] = 1;
+    toContextCounts[to_ctx_name] = count;
   } else {
-    toContextCounts[to_ctx_name] ++;
+    toContextCounts[to_ctx_name] += count;
   }
 }
 
@@ -130,7 +131,230 @@ int mace::EventRuntimeInfo::deserialize(std::istream & is) throw (mace::Serializ
 }
 
 /*****************************class ContextRuntimeInfo**********************************************/
+namespace {
+  // names of contexts and methods seen in samples; ids are never reused
+  pthread_rwlock_t internLock = PTHREAD_RWLOCK_INITIALIZER;
+  std::map<mace::string, uint32_t> internIds;
+  std::vector<mace::string> internNames;
+}
+
+uint32_t mace::ContextRuntimeInfo::internName( const mace::string& name ) {
+  pthread_rwlock_rdlock( &internLock );
+  std::map<mace::string, uint32_t>::const_iterator iter = internIds.find( name );
+  if( iter != internIds.end() ) {
+    uint32_t id = iter->second;
+    pthread_rwlock_unlock( &internLock );
+    return id;
+  }
+  pthread_rwlock_unlock( &internLock );
+
+  pthread_rwlock_wrlock( &internLock );
+  std::pair< std::map<mace::string, uint32_t>::iterator, bool > inserted = internIds.insert( std::make_pair(name, (uint32_t)internNames.size()) );
+  if( inserted.second ) {
+    internNames.push_back( name );
+  }
+  uint32_t id = inserted.first->second;
+  pthread_rwlock_unlock( &internLock );
+  return id;
+}
+
+mace::string mace::ContextRuntimeInfo::getInternedName( const uint32_t id ) {
+  pthread_rwlock_rdlock( &internLock );
+  ASSERT( id < internNames.size() );
+  mace::string name = internNames[id];
+  pthread_rwlock_unlock( &internLock );
+  return name;
+}
+
+uint32_t mace::ContextRuntimeInfo::getSampleRate() {
+  static const uint32_t rate = std::max( params::get<uint32_t>("CONTEXT_INFO_SAMPLE_RATE", 1), (uint32_t)1 );
+  return rate;
+}
+
+bool mace::ContextRuntimeInfo::isSampled( const mace::OrderID& eventId ) {
+  const uint32_t rate = getSampleRate();
+  if( rate == 1 ) {
+    return true;
+  }
+  // spread consecutive tickets, so that periodic event patterns are not aliased
+  uint64_t h = (eventId.ticket ^ ((uint64_t)eventId.ctxId << 40)) * 0x9E3779B97F4A7C15ULL;
+  return (h >> 32) % rate == 0;
+}
+
+// runtimeInfoMutex should be locked
+uint32_t mace::ContextRuntimeInfo::nameId( const mace::string& name ) {
+  NameIdMap::const_iterator iter = nameIds.find( name );
+  if( iter != nameIds.end() ) {
+    return iter->second;
+  }
+  const uint32_t id = internName( name );
+  nameIds[ name ] = id;
+  return id;
+}
+
+namespace {
+  uint32_t sampledEventSlot( const mace::OrderID& eventId, const uint32_t slots ) {
+    return (uint32_t)( (eventId.ticket * 31 + eventId.ctxId) % slots );
+  }
+}
+
+// runtimeInfoMutex should be locked
+mace::ContextRuntimeInfo::SampledEvent* mace::ContextRuntimeInfo::findSampledEvent( const mace::OrderID& eventId, bool create ) {
+  const uint32_t start = sampledEventSlot( eventId, SAMPLED_EVENT_SLOTS );
+  // the table is never more than MAX_SAMPLED_EVENTS full, so a probe always ends at a free slot
+  for( uint32_t i = 0; i < SAMPLED_EVENT_SLOTS; i++ ) {
+    SampledEvent& sampled = sampledEvents[ (start + i) % SAMPLED_EVENT_SLOTS ];
+    if( sampled.used ) {
+      if( sampled.eventId.ctxId == eventId.ctxId && sampled.eventId.ticket == eventId.ticket ) {
+        return &sampled;
+      }
+      continue;
+    }
+    if( !create ) {
+      return NULL;
+    }
+    if( usedEvents >= MAX_SAMPLED_EVENTS ) {
+      droppedSamples ++;
+      return NULL;
+    }
+    usedEvents ++;
+    sampled.used = true;
+    sampled.eventId = eventId;
+    sampled.isTargetContext = false;
+    sampled.methodId = 0;
+    sampled.createContextId = 0;
+    sampled.executeTimestamp = 0;
+    sampled.executeTime = 0;
+    sampled.messageSize = 0;
+    sampled.startTimestamp = TimeUtil::monotimeu();
+    return &sampled;
+  }
+  return NULL;
+}
+
+// runtimeInfoMutex should be locked
+void mace::ContextRuntimeInfo::eraseSampledEvent( uint32_t slot ) {
+  sampledEvents[ slot ].used = false;
+  usedEvents --;
+  // move later events of the probe run back into the hole, unless that would
+  // put them ahead of their own home slot
+  uint32_t i = slot;
+  while( true ) {
+    i = (i + 1) % SAMPLED_EVENT_SLOTS;
+    SampledEvent& sampled = sampledEvents[ i ];
+    if( !sampled.used ) {
+      return;
+    }
+    const uint32_t home = sampledEventSlot( sampled.eventId, SAMPLED_EVENT_SLOTS );
+    const bool homeAfterHole = ( slot <= i ) ? ( home > slot && home <= i ) : ( home > slot || home <= i );
+    if( !homeAfterHole ) {
+      sampledEvents[ slot ] = sampled;
+      sampled.used = false;
+      slot = i;
+    }
+  }
+}
+
+void mace::ContextRuntimeInfo::addSample( const uint8_t kind, const uint32_t first, const uint32_t second, const uint64_t executeTime, 
+    const uint64_t messageSize ) {
+  const uint32_t start = (first * 31 + second * 17 + kind) % COUNTER_SLOTS;
+  for( uint32_t pass = 0; pass < 2; pass++ ) {
+    for( uint32_t i = 0; i < COUNTER_SLOTS; i++ ) {
+      SampleCounter& c = sampleCounters[ (start + i) % COUNTER_SLOTS ];
+      if( c.kind == 0 ) {
+        c.kind = kind;
+        c.first = first;
+        c.second = second;
+        usedCounters ++;
+      } else if( c.kind != kind || c.first != first || c.second != second ) {
+        continue;
+      }
+      c.count ++;
+      c.executeTime += executeTime;
+      c.messageSize += messageSize;
+      return;
+    }
+    // the table is full: fold it into the maps and start over
+    aggregateSamples();
+  }
+}
+
+// runtimeInfoMutex should be locked
+void mace::ContextRuntimeInfo::aggregateSamples() {
+  ADD_SELECTORS("ContextRuntimeInfo::aggregateSamples");
+  if( usedEvents > 0 ) {
+    // events that were aborted or migrated away never commit here
+    const uint64_t now = TimeUtil::monotimeu();
+    for( uint32_t i = 0; i < SAMPLED_EVENT_SLOTS; i++ ) {
+      // erasing may move a later event into slot i, so check it again
+      while( sampledEvents[i].used && now - sampledEvents[i].startTimestamp > SAMPLED_EVENT_TIMEOUT ) {
+        eraseSampledEvent( i );
+        droppedSamples ++;
+      }
+    }
+  }
+  if( droppedSamples > 0 ) {
+    macewarn << "context(" << contextName << ") dropped " << droppedSamples << " sampled events" << Log::endl;
+    droppedSamples = 0;
+  }
+  if( usedCounters == 0 ) {
+    return;
+  }
+  const uint64_t rate = getSampleRate();
+  for( uint32_t i = 0; i < COUNTER_SLOTS; i++ ) {
+    SampleCounter& c = sampleCounters[i];
+    if( c.kind == 0 ) {
+      continue;
+    }
+    const mace::string first = getInternedName( c.first );
+    const mace::string second = getInternedName( c.second );
+    if( c.kind == FROM_ACCESS ) {
+      if( eventAccessInfos.find(first) == eventAccessInfos.end() ) {
+        eventAccessInfos[first] = EventAccessInfo( first, true );
+      }
+      eventAccessInfos[first].addFromEventAccess( c.executeTime * rate, second, c.messageSize * rate, c.count * rate );
+    } else if( c.kind == TO_ACCESS ) {
+      if( eventAccessInfos.find(first) == eventAccessInfos.end() ) {
+        eventAccessInfos[first] = EventAccessInfo( first, false );
+      }
+      eventAccessInfos[first].addToEventAccess( second, c.count * rate );
+    } else if( c.kind == CALLER ) {
+      contextInterInfos[first].addCallerContext( second, c.count * rate );
+    } else if( c.kind == CALLEE ) {
+      contextInterInfos[first].addCalleeContext( second, c.count * rate );
+    }
+    c.kind = 0;
+    c.count = 0;
+    c.executeTime = 0;
+    c.messageSize = 0;
+  }
+  usedCounters = 0;
+}
+
+void mace::ContextRuntimeInfo::clearSamples() {
+  for( uint32_t i = 0; i < SAMPLED_EVENT_SLOTS; i++ ) {
+    sampledEvents[i].used = false;
+  }
+  usedEvents = 0;
+  for( uint32_t i = 0; i < COUNTER_SLOTS; i++ ) {
+    sampleCounters[i].kind = 0;
+    sampleCounters[i].count = 0;
+    sampleCounters[i].executeTime = 0;
+    sampleCounters[i].messageSize = 0;
+  }
+  usedCounters = 0;
+  droppedSamples = 0;
+}
+
 mace::ContextRuntimeInfo& mace::ContextRuntimeInfo::operator=( mace::ContextRuntimeInfo const& orig ){
+  // copy what orig has sampled, but not its events in flight
+  if( this != &orig ) {
+    mace::ContextRuntimeInfo& o = const_cast<mace::ContextRuntimeInfo&>(orig);
+    ScopedLock sl(o.runtimeInfoMutex);
+    o.aggregateSamples();
+  }
+  clearSamples();
+
   contextName = orig.contextName;
 
   curPeriodStartTimestamp = orig.curPeriodStartTimestamp;
@@ -153,6 +377,11 @@ mace::ContextRuntimeInfo& mace::ContextRuntimeInfo::operator=( mace::ContextRunt
 }
 
 void mace::ContextRuntimeInfo::serialize(std::string& str) const{
+  {
+    mace::ContextRuntimeInfo* self = const_cast<mace::ContextRuntimeInfo*>(this);
+    ScopedLock sl(self->runtimeInfoMutex);
+    self->aggregateSamples();
+  }
   mace::serialize( str, &contextName );
 
   mace::serialize( str, &curPeriodStartTimestamp );
@@ -199,105 +428,94 @@ void mace::ContextRuntimeInfo::clear() {
   markerStartTimestamp.clear();
   markerTotalTimeperiod.clear();
   markerTotalCount.clear();
+
+  clearSamples();
 }
 
 void mace::ContextRuntimeInfo::runEvent( const mace::Event& event ){
   ADD_SELECTORS("ContextRuntimeInfo::runEvent");
+  if( !isSampled(event.eventId) ) {
+    return;
+  }
   ScopedLock sl(runtimeInfoMutex);
-  mace::map<mace::OrderID, EventRuntimeInfo>::iterator iter = eventRuntimeInfos.find(event.eventId);
-  if( iter == eventRuntimeInfos.end() ){
-    EventRuntimeInfo eventRuntimeInfo(event.eventId, event.eventMethodType);
-
-    if( this->contextName == event.target_ctx_name ){
-      eventRuntimeInfo.isTargetContext = true;
-    } else {
-      eventRuntimeInfo.isTargetContext = false;
+  SampledEvent* sampled = findSampledEvent( event.eventId, false );
+  if( sampled == NULL ){
+    sampled = findSampledEvent( event.eventId, true );
+    if( sampled == NULL ) {
+      return;
     }
-    eventRuntimeInfo.createContextName = event.create_ctx_name;
-    eventRuntimeInfos[event.eventId] = eventRuntimeInfo;
-    // macedbg(1) << "Create EventRuntimeInfo for event("<< event.eventId <<") in context("<< this->contextName <<")!" << Log::endl;
+    sampled->methodId = nameId( event.eventMethodType );
+    sampled->isTargetContext = ( this->contextName == event.target_ctx_name );
+    sampled->createContextId = nameId( event.create_ctx_name );
   } 
   // contexts interaction
   if( this->contextName != event.target_ctx_name ){
     const mace::string& methodType = event.eventOpInfo.methodName;
     const mace::string& callerContext = event.eventOpInfo.fromContextName;
 
-    if( contextInterInfos.find(callerContext) == contextInterInfos.end() ){
-      ContetxtInteractionInfo ctxInterInfo;
-      contextInterInfos[callerContext] = ctxInterInfo;
-    }
-    contextInterInfos[callerContext].addCallerContext( methodType, 1 );
+    addSample( CALLER, nameId(callerContext), nameId(methodType) );
     macedbg(1) << "Add routine("<< methodType <<") context("<< callerContext <<") -> context("<< contextName <<")!" << Log::endl;
   }
   
-  eventRuntimeInfos[event.eventId].curEventExecuteTimestamp = TimeUtil::timeu();
+  sampled->executeTimestamp = TimeUtil::monotimeu();
 }
 
 void mace::ContextRuntimeInfo::addEventMessageSize( const mace::Event& event, const uint64_t msg_size ) {
   ADD_SELECTORS("ContextRuntimeInfo::addEventMessageSize");
+  if( !isSampled(event.eventId) ) {
+    return;
+  }
   macedbg(1) << "event("<< event.eventId <<"): eventMethodType=" << event.eventMethodType << ", msgSize=" << msg_size << Log::endl; 
   ScopedLock sl(runtimeInfoMutex);
-  mace::map<mace::OrderID, EventRuntimeInfo>::iterator iter = eventRuntimeInfos.find(event.eventId);
-  if( iter == eventRuntimeInfos.end() ){
-    EventRuntimeInfo eventRuntimeInfo(event.eventId, event.eventMethodType);
-
-    if( this->contextName == event.target_ctx_name ){
-      eventRuntimeInfo.isTargetContext = true;
-    } else {
-      eventRuntimeInfo.isTargetContext = false;
+  SampledEvent* sampled = findSampledEvent( event.eventId, false );
+  if( sampled == NULL ){
+    sampled = findSampledEvent( event.eventId, true );
+    if( sampled == NULL ) {
+      return;
     }
-    eventRuntimeInfo.createContextName = event.create_ctx_name;
-    eventRuntimeInfos[event.eventId] = eventRuntimeInfo;
-    // macedbg(1) << "Create EventRuntimeInfo for event("<< event.eventId <<") in context("<< this->contextName <<")!" << Log::endl;
+    sampled->methodId = nameId( event.eventMethodType );
+    sampled->isTargetContext = ( this->contextName == event.target_ctx_name );
+    sampled->createContextId = nameId( event.create_ctx_name );
   }
 
-  eventRuntimeInfos[event.eventId].messageSize = msg_size;
+  sampled->messageSize = msg_size;
 }
 
 void mace::ContextRuntimeInfo::stopEvent( const mace::OrderID& eventId ) {
   ADD_SELECTORS("ContextRuntimeInfo::stopEvent");
-  // macedbg(1) << "To stop event " << eventId << " in context("<< this->contextName <<")" << Log::endl;
+  if( !isSampled(eventId) ) {
+    return;
+  }
   ScopedLock sl(runtimeInfoMutex);
-  if( eventRuntimeInfos.find(eventId) == eventRuntimeInfos.end()) {
+  SampledEvent* sampled = findSampledEvent( eventId, false );
+  if( sampled == NULL ) {
     return;
   }
-  eventRuntimeInfos[eventId].curEventExecuteTime += TimeUtil::timeu() - eventRuntimeInfos[eventId].curEventExecuteTimestamp;
+  sampled->executeTime += TimeUtil::monotimeu() - sampled->executeTimestamp;
 }
 
-void mace::ContextRuntimeInfo::addCalleeContext( mace::string const& calleeContext, mace::string const& methodType ){
-  ScopedLock sl(runtimeInfoMutex);
-  if( contextInterInfos.find(calleeContext) == contextInterInfos.end() ){
-    ContetxtInteractionInfo ctxInterInfo;
-    contextInterInfos[calleeContext] = ctxInterInfo;
+void mace::ContextRuntimeInfo::addCalleeContext( mace::OrderID const& eventId, mace::string const& calleeContext, mace::string const& methodType ){
+  if( !isSampled(eventId) ) {
+    return;
   }
-  contextInterInfos[calleeContext].addCalleeContext( methodType, 1 );
+  ScopedLock sl(runtimeInfoMutex);
+  addSample( CALLEE, nameId(calleeContext), nameId(methodType) );
 }
   
 void mace::ContextRuntimeInfo::commitEvent( const mace::OrderID& eventId ) {
   ADD_SELECTORS("ContextRuntimeInfo::commitEvent");
+  if( !isSampled(eventId) ) {
+    return;
+  }
   ScopedLock sl(runtimeInfoMutex);
-  mace::map<mace::OrderID, EventRuntimeInfo>::iterator iter = eventRuntimeInfos.find(eventId);
-
-  if( iter != eventRuntimeInfos.end() ){
-    //macedbg(1) << "To delete EventRuntimeInfo for " << eventId << " in context("<< this->contextName <<")" << Log::endl;
-    EventRuntimeInfo& eventRuntimeInfo = iter->second;
-    if( !eventRuntimeInfo.isTargetContext ){
-      return;
-    }
-
-    macedbg(1) << "Event("<< eventRuntimeInfo.eventMethodType <<"): context("<< eventRuntimeInfo.createContextName <<") -> context("<< contextName <<")!" << Log::endl;
+  SampledEvent* sampled = findSampledEvent( eventId, false );
 
-    if( eventAccessInfos.find(eventRuntimeInfo.eventMethodType) == eventAccessInfos.end() ){
-      EventAccessInfo eventAccessInfo( eventRuntimeInfo.eventMethodType, eventRuntimeInfo.isTargetContext );
-      eventAccessInfo.addFromEventAccess(eventRuntimeInfo.curEventExecuteTime, eventRuntimeInfo.createContextName, 
-        eventRuntimeInfo.messageSize);
-      eventAccessInfos[eventRuntimeInfo.eventMethodType] = eventAccessInfo;
-    } else {
-      eventAccessInfos[eventRuntimeInfo.eventMethodType].addFromEventAccess(eventRuntimeInfo.curEventExecuteTime, 
-        eventRuntimeInfo.createContextName, eventRuntimeInfo.messageSize );
+  if( sampled != NULL ){
+    if( sampled->isTargetContext ){
+      macedbg(1) << "Event("<< eventId <<"): context("<< getInternedName(sampled->createContextId) <<") -> context("<< contextName <<")!" << Log::endl;
+      addSample( FROM_ACCESS, sampled->methodId, sampled->createContextId, sampled->executeTime, sampled->messageSize );
     }
-
-    eventRuntimeInfos.erase(iter);
+    eraseSampledEvent( sampled - sampledEvents );
   }
 }
 
@@ -312,15 +530,12 @@ void mace::ContextRuntimeInfo::addCoaccessContext( mace::string const& context )
 
 void mace::ContextRuntimeInfo::addToEventAccess( const mace::string& method_type, const mace::string& to_ctx_name ) {
   ScopedLock sl(runtimeInfoMutex);
-  if( eventAccessInfos.find(method_type) == eventAccessInfos.end() ) {
-    EventAccessInfo info(method_type, false);
-    eventAccessInfos[ method_type ] = info;
-  } 
-  eventAccessInfos[ method_type ].addToEventAccess(to_ctx_name);
+  addSample( TO_ACCESS, nameId(method_type), nameId(to_ctx_name) );
 }
 
 uint64_t mace::ContextRuntimeInfo::getCPUTime() {
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   uint64_t cpu_time = 0;
   for( mace::map<mace::string, EventAccessInfo>::const_iterator iter = eventAccessInfos.begin(); iter != eventAccessInfos.end(); 
       iter ++ ) {
@@ -342,6 +557,7 @@ mace::string mace::ContextRuntimeInfo::getCoaccessContext( mace::string const& c
 
 uint32_t mace::ContextRuntimeInfo::getConnectionStrength( const mace::ContextMapping& snapshot, const mace::MaceAddr& addr ) {
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   uint32_t strength = 0;
   for( mace::map<mace::string, ContetxtInteractionInfo>::const_iterator iter = contextInterInfos.begin(); iter != contextInterInfos.end();
       iter ++ ) {
@@ -355,6 +571,7 @@ uint32_t mace::ContextRuntimeInfo::getConnectionStrength( const mace::ContextMap
 mace::vector<mace::string> mace::ContextRuntimeInfo::getInterctContextNames( mace::string const& context_type ) {
   ADD_SELECTORS("ContextRuntimeInfo::getInterctContextNames");
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::vector<mace::string> inter_ctx_names;
   for( mace::map<mace::string, ContetxtInteractionInfo>::const_iterator iter = contextInterInfos.begin(); iter != contextInterInfos.end();
       iter ++ ) {
@@ -372,6 +589,7 @@ mace::vector<mace::string> mace::ContextRuntimeInfo::getInterctContextNames( mac
 mace::vector<mace::string> mace::ContextRuntimeInfo::getEventInterctContextNames( mace::string const& context_type ) {
   ADD_SELECTORS("ContextRuntimeInfo::getEventInterctContextNames");
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::vector<mace::string> inter_ctx_names;
 
   mace::map< mace::string, uint64_t> context_eaccess_counts;
@@ -447,7 +665,7 @@ void mace::ContextRuntimeInfo::printRuntimeInformation(const uint64_t& total_ctx
 
 void mace::ContextRuntimeInfo::markStartTimestamp( mace::string const& marker ) {
   ScopedLock sl(runtimeInfoMutex);
-  markerStartTimestamp[ marker ] = TimeUtil::timeu();
+  markerStartTimestamp[ marker ] = TimeUtil::monotimeu();
 }
 
 void mace::ContextRuntimeInfo::markEndTimestamp( mace::string const& marker ) {
@@ -456,7 +674,7 @@ void mace::ContextRuntimeInfo::markEndTimestamp( mace::string const& marker ) {
     return;
   }
 
-  uint64_t time_period = TimeUtil::timeu() - markerStartTimestamp[marker];
+  uint64_t time_period = TimeUtil::monotimeu() - markerStartTimestamp[marker];
   if( markerTotalTimeperiod.find(marker) == markerTotalTimeperiod.end() ){
     markerTotalTimeperiod[ marker ] = time_period;
     markerTotalCount[ marker ] = 1;
@@ -468,6 +686,7 @@ void mace::ContextRuntimeInfo::markEndTimestamp( mace::string const& marker ) {
 
 mace::map< mace::MaceAddr, uint64_t > mace::ContextRuntimeInfo::getServerInteractionCount( mace::ContextMapping const& snapshot ) {
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::map< mace::MaceAddr, uint64_t > servers_comm_count;
 
   for( mace::map<mace::string, EventAccessInfo>::iterator iter1 = eventAccessInfos.begin(); iter1 != eventAccessInfos.end(); iter1 ++ ){
@@ -505,6 +724,7 @@ mace::map< mace::MaceAddr, uint64_t > mace::ContextRuntimeInfo::getServerInterac
 mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getEstimateContextsInteractionSize() {
   ADD_SELECTORS("ContextRuntimeInfo::getEstimateContextsInteractionSize");
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::map< mace::string, uint64_t > ctxs_inter_size;
 
   uint64_t total_remote_msg_size;
@@ -569,6 +789,7 @@ mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getEstimateContext
 
 mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getContextInteractionCount() {
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::map< mace::string, uint64_t > ctxs_comm_count;
 
   for( mace::map<mace::string, EventAccessInfo>::iterator iter1 = eventAccessInfos.begin(); iter1 != eventAccessInfos.end(); iter1 ++ ){
@@ -604,6 +825,7 @@ mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getContextInteract
 mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getFromAccessCountByTypes( const mace::set<mace::string>& context_types ) {
   ADD_SELECTORS("ContextRuntimeInfo::getFromAccessCountByTypes");
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::map< mace::string, uint64_t > ctxs_comm_count;
 
   for( mace::map<mace::string, EventAccessInfo>::iterator iter1 = eventAccessInfos.begin(); iter1 != eventAccessInfos.end(); iter1 ++ ){
@@ -650,6 +872,7 @@ mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getFromAccessCount
 mace::map< mace::string, uint64_t > mace::ContextRuntimeInfo::getToAccessCountByTypes( const mace::set<mace::string>& context_types ) {
   ADD_SELECTORS("ContextRuntimeInfo::getToAccessCountByTypes");
   ScopedLock sl(runtimeInfoMutex);
+  aggregateSamples();
   mace::map< mace::string, uint64_t > ctxs_comm_count;
 
   for( mace::map<mace::string, EventAccessInfo>::iterator iter1 = eventAccessInfos.begin(); iter1 != eventAccessInfos.end(); iter1 ++ ){
@@ -4,6 +4,8 @@
 // including headers
 #include "mace.h"
 #include "m_map.h"
+#include "mhash_map.h"
+#include "hash_string.h"
 #include "event.h"
 #include "eMonitor.h"
 
@@ -38,8 +40,8 @@ public:
 
   void printNode(PrintNode& pr, const std::string& name) const { }  
 
-  void addFromEventAccess(const uint64_t execute_time, const mace::string& create_ctx_name, const uint64_t& msg_size );
-  void addToEventAccess(const mace::string& to_ctx_name ); 
+  void addFromEventAccess(const uint64_t execute_time, const mace::string& create_ctx_name, const uint64_t& msg_size, const uint64_t count = 1 );
+  void addToEventAccess(const mace::string& to_ctx_name, const uint64_t count = 1 ); 
   mace::map< mace::string, uint64_t > getFromEventAccessCount( const mace::string& context_type ) const;
   mace::map< mace::string, uint64_t > getFromEventAccessCount() const { return fromContextCounts; }
   mace::map< mace::string, uint64_t > getToEventAccessCount() const { return toContextCounts; }
@@ -100,6 +102,19 @@ public:
   // void addCalleeContext( mace::string const& calleeContext, mace::string const& methodType);
 };
 
+/**
+ * Runtime statistics of one context, used by eMonitor and the elasticity
+ * policies.
+ *
+ * Only one in CONTEXT_INFO_SAMPLE_RATE events (chosen by event id, so an event
+ * is sampled in every context it touches or in none) is recorded.  Samples go
+ * into fixed-size open-addressed tables, one of the events in flight keyed by
+ * event id and one of counters keyed by names interned once per context, so
+ * recording an event allocates nothing.  The counters are folded into the maps
+ * below, scaled by the sample rate, when the maps are read.  Events dropped
+ * because the in-flight table was full or because they never committed here
+ * are logged at that point.
+ */
 class ContextRuntimeInfo: public Serializable, public PrintPrintable {
 public:
   pthread_mutex_t runtimeInfoMutex;
@@ -123,9 +138,61 @@ public:
 
   mace::map< mace::string, uint64_t > coaccessContextsCount;
 
+private:
+  static const uint32_t SAMPLED_EVENT_SLOTS = 128; ///< slots of the in-flight event table
+  static const uint32_t MAX_SAMPLED_EVENTS = SAMPLED_EVENT_SLOTS * 3 / 4; ///< sampled events in flight in this context
+  static const uint64_t SAMPLED_EVENT_TIMEOUT = 60 * 1000 * 1000; ///< usecs before an event that never commits is dropped
+  static const uint32_t COUNTER_SLOTS = 128; ///< distinct counters between two aggregations
+
+  static const uint8_t FROM_ACCESS = 1; ///< event method, creating context
+  static const uint8_t TO_ACCESS = 2; ///< event method, accessed context
+  static const uint8_t CALLER = 3; ///< calling context, method
+  static const uint8_t CALLEE = 4; ///< called context, method
+
+  struct SampledEvent {
+    bool used;
+    mace::OrderID eventId;
+    bool isTargetContext;
+    uint32_t methodId;
+    uint32_t createContextId;
+    uint64_t executeTimestamp;
+    uint64_t executeTime;
+    uint64_t messageSize;
+    uint64_t startTimestamp;
+  };
+  typedef mace::hash_map<mace::string, uint32_t, mace::SoftState, hash_string> NameIdMap;
+
+  struct SampleCounter {
+    uint8_t kind;
+    uint32_t first;
+    uint32_t second;
+    uint64_t count;
+    uint64_t executeTime;
+    uint64_t messageSize;
+  };
+
+  SampledEvent sampledEvents[SAMPLED_EVENT_SLOTS];
+  uint32_t usedEvents;
+  SampleCounter sampleCounters[COUNTER_SLOTS];
+  uint32_t usedCounters;
+  uint64_t droppedSamples; ///< sampled events lost to a full or expired event table, logged by aggregateSamples
+  NameIdMap nameIds; ///< ids of the names this context has interned
+
+  SampledEvent* findSampledEvent( const mace::OrderID& eventId, bool create );
+  void eraseSampledEvent( uint32_t slot );
+  uint32_t nameId( const mace::string& name );
+  void addSample( const uint8_t kind, const uint32_t first, const uint32_t second, const uint64_t executeTime = 0, 
+    const uint64_t messageSize = 0 );
+  void aggregateSamples();
+  void clearSamples();
+
+  static uint32_t internName( const mace::string& name );
+  static mace::string getInternedName( const uint32_t id );
+
 public:
   ContextRuntimeInfo(): curPeriodStartTimestamp(0), curPeriodEndTimestamp(0), timePeriod(0) { 
     pthread_mutex_init( &runtimeInfoMutex, NULL );
+    clearSamples();
   }
 
   ~ContextRuntimeInfo() {
@@ -145,13 +212,22 @@ public:
   void clear();
 
   void setTimePeriod(const uint64_t timePeriod) { this->timePeriod = timePeriod; }
-  void setContextName(const mace::string& contextName) { this->contextName = contextName; }
+  void setContextName(const mace::string& contextName) { 
+    ScopedLock sl(runtimeInfoMutex);
+    this->contextName = contextName; 
+    nameId( contextName );
+  }
+
 
+  /// returns how many events each sampled event stands for (CONTEXT_INFO_SAMPLE_RATE, default 1)
+  static uint32_t getSampleRate();
+  /// returns true if the runtime information of \c eventId is collected
+  static bool isSampled( const mace::OrderID& eventId );
 
   void runEvent( const mace::Event& event );
   void addEventMessageSize( const mace::Event& event, const uint64_t msg_size );
   void stopEvent( const mace::OrderID& eventId );
-  void addCalleeContext( mace::string const& calleeContext, mace::string const& methodType );
+  void addCalleeContext( mace::OrderID const& eventId, mace::string const& calleeContext, mace::string const& methodType );
   void commitEvent( const mace::OrderID& eventId );
   void addCoaccessContext( mace::string const& context );
 
@@ -21,6 +21,7 @@
 #include "Printable.h"
 #include "Message.h"
 #include "Accumulator.h"
+#include "EventArena.h"
 #include <boost/shared_ptr.hpp>
 
 // class ContextStructure;
@@ -627,6 +628,9 @@ public:
     typedef mace::vector< EventUpcallWrapper > DeferredUpcallType;
     typedef mace::map<uint32_t, uint64_t> EventOrderTicketType;
 
+    static void* operator new(size_t size) { return mace::EventArena::allocate(size); }
+    static void operator delete(void* p) { mace::EventArena::release(p); }
+
     /**
      * Default constructor. 
      * Initialize the event ID to zero, and set type to UNDEFEVENT
@@ -0,0 +1,206 @@
+/* 
+ * EventArena.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "EventArena.h"
+#include "massert.h"
+
+/**
+ * \file EventArena.cc
+ * \brief Defines the per-thread arena for objects that live as long as an event
+ */
+
+namespace mace {
+
+namespace {
+  struct Chunk {
+    volatile uint32_t refs;
+    bool large;
+    Chunk* next;
+  };
+
+  // A chunk in use starts with this many references; the owner hands back the
+  // ones it did not use when it retires the chunk, so that allocating needs no
+  // atomic increment and the count cannot reach zero while the owner holds it.
+  const uint32_t OWNER_BIAS = 1u << 30;
+  const size_t ALIGNMENT = 16;
+  const size_t HEADER_SIZE = (sizeof(Chunk) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+  volatile size_t heapChunkCount = 0;
+
+  struct ThreadArena {
+    Chunk* current;
+    char* next;
+    char* end;
+    uint32_t count;
+    Chunk* freeList;
+    size_t freeCount;
+  };
+
+  __thread ThreadArena* arena = NULL;
+  pthread_key_t arenaKey;
+  pthread_once_t arenaKeyOnce = PTHREAD_ONCE_INIT;
+
+  Chunk* newChunk(size_t size, bool large) {
+    void* p = NULL;
+    if (posix_memalign(&p, EventArena::CHUNK_SIZE, size) != 0) {
+      throw std::bad_alloc();
+    }
+    if (!large) {
+      __sync_fetch_and_add(&heapChunkCount, 1);
+    }
+    Chunk* c = static_cast<Chunk*>(p);
+    c->large = large;
+    c->next = NULL;
+    return c;
+  }
+
+  void freeChunk(Chunk* c) {
+    if (!c->large) {
+      __sync_fetch_and_sub(&heapChunkCount, 1);
+    }
+    free(c);
+  }
+
+  void recycle(ThreadArena* a, Chunk* c) {
+    if (a != NULL && !c->large && a->freeCount < EventArena::MAX_FREE_CHUNKS) {
+      c->next = a->freeList;
+      a->freeList = c;
+      a->freeCount++;
+      return;
+    }
+    freeChunk(c);
+  }
+
+  void retireCurrent(ThreadArena* a) {
+    Chunk* c = a->current;
+    if (c == NULL) {
+      return;
+    }
+    a->current = NULL;
+    a->next = a->end = NULL;
+    if (__sync_sub_and_fetch(&c->refs, OWNER_BIAS - a->count) == 0) {
+      recycle(a, c);
+    }
+  }
+
+  void destroyArena(void* p) {
+    ThreadArena* a = static_cast<ThreadArena*>(p);
+    arena = NULL;
+    retireCurrent(a);
+    while (a->freeList != NULL) {
+      Chunk* c = a->freeList;
+      a->freeList = c->next;
+      freeChunk(c);
+    }
+    delete a;
+  }
+
+  void createArenaKey() {
+    ASSERT(pthread_key_create(&arenaKey, destroyArena) == 0);
+  }
+
+  ThreadArena* threadArena() {
+    if (arena == NULL) {
+      pthread_once(&arenaKeyOnce, createArenaKey);
+      arena = new ThreadArena();
+      arena->current = NULL;
+      arena->next = arena->end = NULL;
+      arena->count = 0;
+      arena->freeList = NULL;
+      arena->freeCount = 0;
+      ASSERT(pthread_setspecific(arenaKey, arena) == 0);
+    }
+    return arena;
+  }
+}
+
+void* EventArena::allocate(size_t size) {
+  size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  if (size == 0) {
+    size = ALIGNMENT;
+  }
+  if (size > MAX_ALLOCATION) {
+    Chunk* c = newChunk(HEADER_SIZE + size, true);
+    c->refs = 1;
+    return (char*)c + HEADER_SIZE;
+  }
+
+  ThreadArena* a = threadArena();
+  if (a->current == NULL || a->next + size > a->end) {
+    retireCurrent(a);
+    Chunk* c = a->freeList;
+    if (c != NULL) {
+      a->freeList = c->next;
+      a->freeCount--;
+    }
+    else {
+      c = newChunk(CHUNK_SIZE, false);
+    }
+    c->refs = OWNER_BIAS;
+    a->current = c;
+    a->next = (char*)c + HEADER_SIZE;
+    a->end = (char*)c + CHUNK_SIZE;
+    a->count = 0;
+  }
+  void* p = a->next;
+  a->next += size;
+  a->count++;
+  return p;
+}
+
+void EventArena::release(void* p) {
+  if (p == NULL) {
+    return;
+  }
+  // every allocation lies within CHUNK_SIZE of the start of its aligned chunk
+  Chunk* c = (Chunk*)((uintptr_t)p & ~(uintptr_t)(CHUNK_SIZE - 1));
+  if (__sync_sub_and_fetch(&c->refs, 1) == 0) {
+    recycle(arena, c);
+  }
+}
+
+void EventArena::retire() {
+  if (arena != NULL) {
+    retireCurrent(arena);
+  }
+}
+
+size_t EventArena::heapChunks() {
+  return heapChunkCount;
+}
+
+size_t EventArena::freeChunks() {
+  return (arena == NULL) ? 0 : arena->freeCount;
+}
+
+}
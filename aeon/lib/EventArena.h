@@ -0,0 +1,132 @@
+/* 
+ * EventArena.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <stddef.h>
+#include <new>
+
+/**
+ * \file EventArena.h
+ * \brief Declares the per-thread arena for objects that live as long as an event
+ */
+
+#ifndef _MACE_EVENT_ARENA_H
+#define _MACE_EVENT_ARENA_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief per-thread bump allocator for the transient objects of an event.
+ *
+ * Each thread carves allocations out of its own chunk, so allocating takes
+ * no lock and no atomic operation.  A chunk counts the allocations still
+ * live in it; release() may be called from any thread and decrements that
+ * count, and once the owner has moved on to another chunk and the count
+ * reaches zero the whole chunk goes back to the releasing thread's cache in
+ * one step.  ContextBaseClass::commitEvent calls retire() so that the
+ * objects of one event share chunks with as few later events as possible.
+ *
+ * Requests larger than MAX_ALLOCATION get a chunk of their own.  Memory is
+ * only reused once every object in a chunk is gone, so objects that outlive
+ * their event should not come from here.
+ */
+class EventArena {
+public:
+  static const size_t CHUNK_SIZE = 32 * 1024; ///< size and alignment of a chunk
+  static const size_t MAX_ALLOCATION = 2 * 1024;
+  static const size_t MAX_FREE_CHUNKS = 8; ///< chunks each thread keeps for reuse
+
+  static void* allocate(size_t size);
+  static void release(void* p);
+  /// start a new chunk for the next allocation of this thread
+  static void retire();
+
+  /// number of chunks, including cached ones, currently obtained from the heap by all threads
+  static size_t heapChunks();
+  /// number of chunks cached by this thread
+  static size_t freeChunks();
+}; // EventArena
+
+/**
+ * \brief standard allocator over EventArena, for the Alloc parameter of mace containers.
+ *
+ * All instances are interchangeable, so containers using it may be
+ * swapped and assigned freely.  Use it only for containers that are
+ * destroyed with the event: one node kept longer pins its whole chunk.
+ */
+template<class T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template<class U>
+  struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator() { }
+  ArenaAllocator(const ArenaAllocator&) { }
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>&) { }
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+
+  pointer allocate(size_type n, const void* hint = 0) {
+    return static_cast<pointer>(EventArena::allocate(n * sizeof(T)));
+  }
+  void deallocate(pointer p, size_type n) {
+    EventArena::release(p);
+  }
+  size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+  void construct(pointer p, const T& val) { new(p) T(val); }
+  void destroy(pointer p) { p->~T(); }
+}; // ArenaAllocator
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+/** @} */
+
+}
+#endif // _MACE_EVENT_ARENA_H
@@ -0,0 +1,247 @@
+/* 
+ * EventTrace.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+
+#include "maceConfig.h"
+#include "mace-macros.h"
+#include "EventTrace.h"
+#include "Metrics.h"
+#include "RandomUtil.h"
+#include "ScopedLock.h"
+#include "ThreadStructure.h"
+#include "TimeUtil.h"
+#include "params.h"
+
+namespace {
+  const char* const SPAN_NAMES[] = {
+    "unknown", "ticket", "head_create", "lock_wait", "execute", "routine", "commit"
+  };
+}
+
+namespace mace {
+
+const char EventTrace::MAGIC[8] = { 'M', 'A', 'C', 'E', 'T', 'R', 'C', '1' };
+const uint8_t EventTrace::SAMPLED;
+const unsigned EventTrace::OpenSpans::MAX;
+
+volatile bool EventTrace::configured = false;
+bool EventTrace::enabled = false;
+uint32_t EventTrace::rate = 0;
+volatile size_t EventTrace::sampledCount = 0;
+volatile uint64_t EventTrace::sampledKeys[EventTrace::SAMPLED_SLOTS];
+std::string EventTrace::buffer;
+FILE* EventTrace::out = NULL;
+pthread_mutex_t EventTrace::tlock = PTHREAD_MUTEX_INITIALIZER;
+
+void EventTrace::configure() {
+  ScopedLock sl(tlock);
+  if (configured) {
+    return;
+  }
+  if (params::get<bool>("EVENT_TRACE", false)) {
+    std::ostringstream os;
+    os << "eventtrace." << getpid() << ".bin";
+    std::string path = params::get<std::string>("EVENT_TRACE_FILE", os.str());
+    uint32_t r = params::get<uint32_t>("EVENT_TRACE_RATE", 100);
+    sl.unlock();
+    try {
+      open(path, r);
+    }
+    catch (const IOException& e) {
+      Log::err() << "EventTrace: cannot open " << path << ": " << e << Log::endl;
+    }
+    sl.lock();
+  }
+  configured = true;
+} // configure
+
+void EventTrace::open(const std::string& path, uint32_t r) throw(IOException) {
+  ScopedLock sl(tlock);
+  if (out != NULL) {
+    flushLocked();
+    fclose(out);
+  }
+  out = fopen(path.c_str(), "w");
+  if (out == NULL) {
+    enabled = false;
+    configured = true;
+    throw IOException("cannot open " + path + ": " + strerror(errno));
+  }
+  uint32_t pid = getpid();
+  fwrite(MAGIC, sizeof(MAGIC), 1, out);
+  fwrite(&pid, sizeof(pid), 1, out);
+  rate = r;
+  for (size_t i = 0; i < SAMPLED_SLOTS; i++) {
+    sampledKeys[i] = 0;
+  }
+  sampledCount = 0;
+  enabled = true;
+  configured = true;
+} // open
+
+void EventTrace::close() {
+  ScopedLock sl(tlock);
+  enabled = false;
+  if (out != NULL) {
+    flushLocked();
+    fclose(out);
+    out = NULL;
+  }
+} // close
+
+void EventTrace::flush() {
+  ScopedLock sl(tlock);
+  flushLocked();
+} // flush
+
+void EventTrace::flushLocked() {
+  if (out != NULL && !buffer.empty()) {
+    fwrite(buffer.data(), buffer.size(), 1, out);
+    fflush(out);
+  }
+  buffer.clear();
+} // flushLocked
+
+uint64_t EventTrace::now() {
+  return TimeUtil::timeu();
+} // now
+
+void EventTrace::sampleNewEvent(const OrderID& id, uint32_t contextId) {
+  if (!isEnabled() || rate == 0 || RandomUtil::randInt(rate) != 0) {
+    return;
+  }
+  insertSampled(id);
+  uint64_t t = now();
+  record(TICKET, id, contextId, t, t);
+} // sampleNewEvent
+
+void EventTrace::adopt(const OrderID& id, uint8_t flags) {
+  if ((flags & SAMPLED) && isEnabled() && !lookup(id)) {
+    insertSampled(id);
+  }
+} // adopt
+
+void EventTrace::insertSampled(const OrderID& id) {
+  // the table is direct mapped: at one in EVENT_TRACE_RATE, an event is
+  // almost always finished before a newer one lands on its slot
+  const uint64_t k = sampledKey(id);
+  sampledKeys[(k >> 32) & (SAMPLED_SLOTS - 1)] = k;
+  __sync_synchronize();
+  __sync_fetch_and_add(&sampledCount, 1);
+} // insertSampled
+
+void EventTrace::record(SpanType type, const OrderID& id, uint32_t contextId, uint64_t begin, uint64_t end) {
+  if (!isSampled(id)) {
+    return;
+  }
+  Record r;
+  memset(&r, 0, sizeof(r));
+  r.begin = begin;
+  r.end = end;
+  r.ticket = id.ticket;
+  r.ctxId = id.ctxId;
+  r.contextId = contextId;
+  r.thread = metricsShard();
+  r.type = type;
+  append(r);
+} // record
+
+void EventTrace::append(const Record& r) {
+  ScopedLock sl(tlock);
+  if (out == NULL) {
+    return;
+  }
+  buffer.append((const char*)&r, sizeof(r));
+  if (buffer.size() >= BUFFER_SIZE) {
+    flushLocked();
+  }
+} // append
+
+void EventTrace::begin(SpanType type, const OrderID& id, uint32_t contextId) {
+  if (!isSampled(id)) {
+    return;
+  }
+  OpenSpans& open = ThreadStructure::openTraceSpans();
+  if (open.count >= OpenSpans::MAX) {
+    // the outermost span is the likeliest to have been left open
+    memmove(open.spans, open.spans + 1, (OpenSpans::MAX - 1) * sizeof(OpenSpans::Span));
+    open.count--;
+  }
+  OpenSpans::Span& s = open.spans[open.count++];
+  s.begin = now();
+  s.ticket = id.ticket;
+  s.ctxId = id.ctxId;
+  s.contextId = contextId;
+  s.type = type;
+} // begin
+
+void EventTrace::end(SpanType type, const OrderID& id) {
+  OpenSpans& open = ThreadStructure::openTraceSpans();
+  for (unsigned i = open.count; i > 0; i--) {
+    const OpenSpans::Span& s = open.spans[i - 1];
+    if (s.type == type && s.ticket == id.ticket && s.ctxId == id.ctxId) {
+      // spans opened after this one were never ended, so they go too
+      open.count = i - 1;
+      record(type, id, s.contextId, s.begin, now());
+      return;
+    }
+  }
+} // end
+
+void EventTrace::readFile(const std::string& path, uint32_t& pid, std::vector<Record>& records) throw(IOException) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (f == NULL) {
+    throw IOException("cannot open " + path + ": " + strerror(errno));
+  }
+  char magic[sizeof(MAGIC)];
+  if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      fread(&pid, sizeof(pid), 1, f) != 1) {
+    fclose(f);
+    throw IOException(path + " is not an event trace file");
+  }
+  Record r;
+  while (fread(&r, sizeof(r), 1, f) == 1) {
+    records.push_back(r);
+  }
+  fclose(f);
+} // readFile
+
+const char* EventTrace::spanName(uint8_t type) {
+  if (type > COMMIT) {
+    return SPAN_NAMES[0];
+  }
+  return SPAN_NAMES[type];
+} // spanName
+
+} // namespace mace
@@ -0,0 +1,214 @@
+/* 
+ * EventTrace.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _MACE_EVENTTRACE_H
+#define _MACE_EVENTTRACE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Event.h"
+#include "Exception.h"
+
+/**
+ * \file EventTrace.h
+ * \brief declares the EventTrace sampled per-event span recorder
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief records timed spans of the lifecycle of a sample of events to a
+ * compact binary trace file.
+ *
+ * An event is sampled when its create ticket is issued, with probability
+ * 1/EVENT_TRACE_RATE.  The decision travels with the event: messages sent
+ * on behalf of a sampled event carry SAMPLED in their InternalMessageID, and
+ * the receiving node adopts the event so its spans are recorded there too.
+ * Spans are keyed by the event's OrderID, so the files of all nodes can be
+ * merged into one timeline (see tools/eventtrace2json).
+ *
+ * Tracing is off unless the EVENT_TRACE parameter is set; the file is
+ * EVENT_TRACE_FILE, by default eventtrace.<pid>.bin.  When tracing is off,
+ * isSampled() is a single load and compare; when it is on, it is one more
+ * load from a table of sampled events, without taking a lock.
+ */
+class EventTrace {
+public:
+  enum SpanType {
+    TICKET = 1,  ///< create ticket issued (instant)
+    HEAD_CREATE, ///< waiting for the create ticket to be served and initializing the event
+    LOCK_WAIT,   ///< waiting for the context lock in ContextLock::upgradeFromNone
+    EXECUTE,     ///< executing in a context, from lock grant to release
+    ROUTINE,     ///< a routine call to a remote context, until it returns
+    COMMIT       ///< event committed in a context (instant)
+  };
+
+  static const uint8_t SAMPLED = 0x01; ///< InternalMessageID::traceFlags bit
+
+  /// one span as written to the trace file (host byte order)
+  struct Record {
+    uint64_t begin; ///< usec, TimeUtil::timeu()
+    uint64_t end;
+    uint64_t ticket; ///< OrderID::ticket
+    uint32_t ctxId; ///< OrderID::ctxId
+    uint32_t contextId; ///< context the span happened in, 0 if none
+    uint32_t thread;
+    uint8_t type;
+    uint8_t pad[3];
+  };
+
+  static const char MAGIC[8]; ///< first bytes of a trace file, followed by the uint32_t pid
+
+  /// the spans an event has opened with begin() and not yet ended, innermost last
+  struct OpenSpans {
+    struct Span {
+      uint64_t begin;
+      uint64_t ticket;
+      uint32_t ctxId;
+      uint32_t contextId;
+      uint8_t type;
+    };
+    static const unsigned MAX = 16;
+    Span spans[MAX];
+    unsigned count;
+    OpenSpans() : count(0) { }
+  };
+
+  /// opens \c path and traces one in \c rate events; called from params on first use otherwise
+  static void open(const std::string& path, uint32_t rate) throw(IOException);
+  /// writes out buffered spans and closes the file; tracing is off afterwards
+  static void close();
+  /// writes out buffered spans
+  static void flush();
+
+  static bool isEnabled() {
+    if (!configured) {
+      configure();
+    }
+    return enabled;
+  }
+
+  /// decides whether the event with a newly issued ticket is sampled; records TICKET if so
+  static void sampleNewEvent(const OrderID& id, uint32_t contextId);
+  static bool isSampled(const OrderID& id) {
+    if (!isEnabled() || sampledCount == 0) {
+      return false;
+    }
+    return lookup(id);
+  }
+  /// the traceFlags for a message sent on behalf of \c id
+  static uint8_t flagsFor(const OrderID& id) {
+    return isSampled(id) ? SAMPLED : 0;
+  }
+  /// samples \c id on this node too if \c flags (from a received message) has SAMPLED
+  static void adopt(const OrderID& id, uint8_t flags);
+
+  /// records a span of \c id if it is sampled
+  static void record(SpanType type, const OrderID& id, uint32_t contextId, uint64_t begin, uint64_t end);
+  /**
+   * opens a span of \c id if it is sampled.  Open spans are kept in the
+   * ThreadStructure data of the running event, which follows an event in a
+   * coroutine to whichever thread resumes it, so end() may come from there.
+   */
+  static void begin(SpanType type, const OrderID& id, uint32_t contextId);
+  /// closes the innermost open span matching \c type and \c id, discarding any opened after it
+  static void end(SpanType type, const OrderID& id);
+
+  /// reads every record of the trace file \c path
+  static void readFile(const std::string& path, uint32_t& pid, std::vector<Record>& records) throw(IOException);
+  static const char* spanName(uint8_t type);
+
+  /// \brief records a span covering its own lifetime
+  class Span {
+  public:
+    Span(SpanType type, const OrderID& id, uint32_t contextId) :
+      type(type), id(id), contextId(contextId), start(0) {
+      if (isSampled(id)) {
+        start = now();
+      }
+    }
+    ~Span() {
+      if (start != 0) {
+        record(type, id, contextId, start, now());
+      }
+    }
+  private:
+    const SpanType type;
+    const OrderID id;
+    const uint32_t contextId;
+    uint64_t start;
+  }; // Span
+
+private:
+  /// slots of the sampled table, a power of 2
+  static const size_t SAMPLED_SLOTS = 8192;
+  static const size_t BUFFER_SIZE = 64*1024;
+
+  static void configure();
+  /// a non-zero hash of \c id, which picks its slot and is stored there
+  static uint64_t sampledKey(const OrderID& id) {
+    uint64_t k = id.ticket * 0x9e3779b97f4a7c15ULL ^ (uint64_t)id.ctxId * 0xc2b2ae3d27d4eb4fULL;
+    k ^= k >> 31;
+    return k | 1;
+  }
+  static bool lookup(const OrderID& id) {
+    const uint64_t k = sampledKey(id);
+    return sampledKeys[(k >> 32) & (SAMPLED_SLOTS - 1)] == k;
+  }
+  static void insertSampled(const OrderID& id);
+  static void append(const Record& r);
+  static void flushLocked();
+  static uint64_t now();
+
+  static volatile bool configured;
+  static bool enabled;
+  static uint32_t rate;
+  static volatile size_t sampledCount;
+  /// the keys of sampled events; a newer event takes the slot of an older one
+  static volatile uint64_t sampledKeys[SAMPLED_SLOTS];
+  static std::string buffer;
+  static FILE* out;
+  static pthread_mutex_t tlock;
+}; // EventTrace
+
+/** @} */
+
+} // namespace mace
+
+#endif // _MACE_EVENTTRACE_H
@@ -0,0 +1,96 @@
+/* 
+ * FixedLayout.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _MACE_FIXED_LAYOUT_H
+#define _MACE_FIXED_LAYOUT_H
+
+#include <string.h>
+#include "Serializable.h"
+
+/**
+ * \file FixedLayout.h
+ * \brief declares the pack and unpack functions used by fixed-layout generated messages
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/*
+ * macec gives messages whose serialized fields are all fixed-width a
+ * packed layout: every field sits at an offset known at compile time, so
+ * the message is encoded into one stack buffer and appended with a single
+ * copy, and decoded after a single read and length check.  The bytes are
+ * exactly those of the field-by-field mace::serialize() encoding (network
+ * order integers, bool as one byte, floating point in host order), so
+ * packed and generic peers interoperate.
+ */
+
+inline void packFixed(char* buf, const uint8_t* pitem) { *buf = *pitem; }
+inline void packFixed(char* buf, const int8_t* pitem) { *buf = *pitem; }
+inline void packFixed(char* buf, const bool* pitem) { *buf = *pitem ? 1 : 0; }
+inline void packFixed(char* buf, const uint16_t* pitem) { uint16_t tmp = htons(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const int16_t* pitem) { int16_t tmp = htons(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const uint32_t* pitem) { uint32_t tmp = htonl(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const int32_t* pitem) { int32_t tmp = htonl(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const uint64_t* pitem) { uint64_t tmp = htonll(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const int64_t* pitem) { int64_t tmp = htonll(*pitem); memcpy(buf, &tmp, sizeof(tmp)); }
+inline void packFixed(char* buf, const float* pitem) { memcpy(buf, pitem, sizeof(float)); }
+inline void packFixed(char* buf, const double* pitem) { memcpy(buf, pitem, sizeof(double)); }
+
+inline void unpackFixed(const char* buf, uint8_t* pitem) { *pitem = *buf; }
+inline void unpackFixed(const char* buf, int8_t* pitem) { *pitem = *buf; }
+inline void unpackFixed(const char* buf, bool* pitem) { *pitem = (*buf != 0); }
+inline void unpackFixed(const char* buf, uint16_t* pitem) { memcpy(pitem, buf, sizeof(uint16_t)); *pitem = ntohs(*pitem); }
+inline void unpackFixed(const char* buf, int16_t* pitem) { memcpy(pitem, buf, sizeof(int16_t)); *pitem = ntohs(*pitem); }
+inline void unpackFixed(const char* buf, uint32_t* pitem) { memcpy(pitem, buf, sizeof(uint32_t)); *pitem = ntohl(*pitem); }
+inline void unpackFixed(const char* buf, int32_t* pitem) { memcpy(pitem, buf, sizeof(int32_t)); *pitem = ntohl(*pitem); }
+inline void unpackFixed(const char* buf, uint64_t* pitem) { memcpy(pitem, buf, sizeof(uint64_t)); *pitem = ntohll(*pitem); }
+inline void unpackFixed(const char* buf, int64_t* pitem) { memcpy(pitem, buf, sizeof(int64_t)); *pitem = ntohll(*pitem); }
+inline void unpackFixed(const char* buf, float* pitem) { memcpy(pitem, buf, sizeof(float)); }
+inline void unpackFixed(const char* buf, double* pitem) { memcpy(pitem, buf, sizeof(double)); }
+
+/// read exactly \c size bytes of a packed layout into \c buf, throwing if the stream is short
+inline void readFixed(std::istream& in, char* buf, size_t size) throw(SerializationException) {
+  in.read(buf, size);
+  if (!in) {
+    throw SerializationException("could not read " +
+				 boost::lexical_cast<std::string>(size) + " bytes");
+  }
+}
+
+/** @} */
+
+}
+
+#endif // _MACE_FIXED_LAYOUT_H
@@ -7,6 +7,7 @@
 #include "ContextService.h"
 #include "Log.h"
 #include "mace-macros.h"
+#include "Metrics.h"
 
 
 HeadEventDispatch::EventRequestTSType HeadEventDispatch::eventRequestTime;
@@ -246,6 +247,8 @@ namespace HeadEventDispatch {
 
   pthread_t* HeadEventTP::elasticityHeadThread;
   mace::set<mace::string> HeadEventTP::waitingMigrationContexts;
+  mace::set<mace::string> HeadEventTP::plannedMigrationContexts;
+  uint32_t HeadEventTP::migratingPendingSignals = 0;
 
   HeadTransportTP* _tinst;
   HeadTransportTP* HeadTransportTPInstance() {
@@ -254,11 +257,11 @@ namespace HeadEventDispatch {
 
   void insertEventStartTime(const mace::OrderID& eventID){
     ScopedLock sl( startTimeMutex );
-    eventStartTime[ eventID ] = TimeUtil::timeu() ;
+    eventStartTime[ eventID ] = TimeUtil::monotimeu() ;
   }
   void insertEventRequestTime(const mace::OrderID& eventID){
     ScopedLock sl( requestTimeMutex );
-    eventRequestTime[ eventID ] = TimeUtil::timeu() ;
+    eventRequestTime[ eventID ] = TimeUtil::monotimeu() ;
   }
 
   mace::ContextBaseClass* HeadEvent::getCtxObj() {
@@ -431,7 +434,7 @@ namespace HeadEventDispatch {
     ADD_SELECTORS("HeadEventTP::executeGlobalEventProcess");
     //macedbg(1) << " Start to process global event " << Log::endl;
     
-    req_start_time = TimeUtil::timeu();
+    req_start_time = TimeUtil::monotimeu();
     if(globalEvent->globalEventType == GlobalHeadEvent::GlobalHeadEvent_CREATECONTEXT){
 			req_type = GlobalHeadEvent::GlobalHeadEvent_CREATECONTEXT;
       executeGlobalContextCreateEventProcess();
@@ -443,6 +446,14 @@ namespace HeadEventDispatch {
       HeadContextMigrationEvent* mevent = static_cast<HeadContextMigrationEvent*>(globalEvent->helper);
       _service->handle__event_MigrateContext(mevent->msg);
       mevent->msg = NULL;
+    } else if( globalEvent->globalEventType == GlobalHeadEvent::GlobalHeadEvent_MIGRATION_PLAN) {
+      req_type = GlobalHeadEvent::GlobalHeadEvent_MIGRATION;
+      macedbg(1) << "Start to execute migration plan event: " << globalEvent->ticket << Log::endl;
+      migrating_flag = true;
+      ContextService* _service = static_cast<ContextService*>(globalEvent->cl);
+      HeadContextsMigrationEvent* mevent = static_cast<HeadContextsMigrationEvent*>(globalEvent->helper);
+      _service->handle__event_MigrateContexts(mevent->msg);
+      mevent->msg = NULL;
     } else if( globalEvent->globalEventType == GlobalHeadEvent::GlobalHeadEvent_MODIFY_OWNERSHIP ) {
       req_type = GlobalHeadEvent::GlobalHeadEvent_MODIFY_OWNERSHIP;
       executeGlobalModifyOwnershipEventProcess();
@@ -964,6 +975,20 @@ namespace HeadEventDispatch {
     enqueueGlobalHeadEvent( thisgev );
   }
 
+  void HeadEventTP::executeContextsMigrationEvent(AsyncEventReceiver* cl, uint8_t const serviceID, mace::map< mace::string, MaceAddr > const& plan) {
+    ADD_SELECTORS("HeadEventTP::executeContextsMigrationEvent");
+    ScopedLock sl(executeGlobalEventMutex);
+    const uint64_t ticket = next_ticket ++;
+    macedbg(1) << "Migrating "<< plan.size() <<" contexts event ticket=" << ticket << " now_serving_ticket = " << now_serving_ticket << Log::endl;
+    mace::OrderID eventId(0, ticket);
+
+    mace::__event_MigrateContexts *msg = new mace::__event_MigrateContexts( eventId, serviceID, plan );
+    HeadContextsMigrationEvent* helper = new HeadContextsMigrationEvent(msg);
+
+    GlobalHeadEvent* thisgev = new GlobalHeadEvent(GlobalHeadEvent::GlobalHeadEvent_MIGRATION_PLAN, helper, cl, ticket);
+    enqueueGlobalHeadEvent( thisgev );
+  }
+
   void HeadEventTP::executeModifyOwnershipEvent(AsyncEventReceiver* cl, mace::EventOperationInfo const& eop, mace::string const& ctxName,
       mace::vector<mace::EventOperationInfo> const& ownershipOpInfos) {
     ADD_SELECTORS("HeadEventTP::executeModifyOwnershipEvent");
@@ -980,16 +1005,18 @@ namespace HeadEventDispatch {
     ScopedLock sl( startTimeMutex );
     EventRequestTSType::iterator rit = eventStartTime.find(event.eventId);
     ASSERT( rit != eventStartTime.end() );
-    uint64_t duration = TimeUtil::timeu() - rit->second ;
+    uint64_t duration = TimeUtil::monotimeu() - rit->second ;
     eventStartTime.erase( rit );
     sl.unlock();
 
+    static mace::Histogram* asyncLifeTime = mace::Metrics::histogram(mace::Metrics::ASYNC_EVENT_LIFE_TIME);
+    static mace::Histogram* migrationLifeTime = mace::Metrics::histogram(mace::Metrics::MIGRATION_EVENT_LIFE_TIME);
     switch( event.eventType ){
       case mace::Event::ASYNCEVENT:
-        Accumulator::Instance(Accumulator::ASYNC_EVENT_LIFE_TIME)->accumulate( duration );
+        asyncLifeTime->record( duration );
         break;
       case mace::Event::MIGRATIONEVENT:
-        Accumulator::Instance(Accumulator::MIGRATION_EVENT_LIFE_TIME)->accumulate( duration );
+        migrationLifeTime->record( duration );
         break;
       default:
         break;
@@ -1020,7 +1047,7 @@ namespace HeadEventDispatch {
     if( rit == eventRequestTime.end() ){
       return;
     }
-    uint64_t duration = TimeUtil::timeu() - rit->second ;
+    uint64_t duration = TimeUtil::monotimeu() - rit->second ;
     eventRequestTime.erase( rit );
     sl.unlock();
 
@@ -1030,12 +1057,14 @@ namespace HeadEventDispatch {
       accumulatedEvents ++;
     }
 
+    static Accumulator* asyncReqCommitTime = Accumulator::Instance(Accumulator::ASYNC_EVENT_REQCOMMIT_TIME);
+    static Accumulator* migrationReqCommitTime = Accumulator::Instance(Accumulator::MIGRATION_EVENT_REQCOMMIT_TIME);
     switch( event.eventType ){
       case mace::Event::ASYNCEVENT:
-        Accumulator::Instance(Accumulator::ASYNC_EVENT_REQCOMMIT_TIME)->accumulate( duration );
+        asyncReqCommitTime->accumulate( duration );
         break;
       case mace::Event::MIGRATIONEVENT:
-        Accumulator::Instance(Accumulator::MIGRATION_EVENT_REQCOMMIT_TIME)->accumulate( duration );
+        migrationReqCommitTime->accumulate( duration );
         break;
       default:
         break;
@@ -1049,14 +1078,17 @@ namespace HeadEventDispatch {
     ADD_SELECTORS("HeadEventTP::commitEvents");
 
     if( recordCommitCount ){
-      Accumulator::Instance(Accumulator::EVENT_READY_COMMIT)->accumulate( 1 );
+      static Accumulator* readyCommit = Accumulator::Instance(Accumulator::EVENT_READY_COMMIT);
+      static Accumulator* asyncCommit = Accumulator::Instance(Accumulator::ASYNC_EVENT_COMMIT);
+      static Accumulator* migrationCommit = Accumulator::Instance(Accumulator::MIGRATION_EVENT_COMMIT);
+      readyCommit->accumulate( 1 );
 
       switch( event.eventType ){
         case mace::Event::ASYNCEVENT:
-          Accumulator::Instance(Accumulator::ASYNC_EVENT_COMMIT)->accumulate( 1 );
+          asyncCommit->accumulate( 1 );
           break;
         case mace::Event::MIGRATIONEVENT:
-          Accumulator::Instance(Accumulator::MIGRATION_EVENT_COMMIT)->accumulate( 1 );
+          migrationCommit->accumulate( 1 );
           break;
         default:
           break;
@@ -1097,7 +1129,7 @@ namespace HeadEventDispatch {
         waitingCommitEventIds.insert(ticket);
         return;
       }
-      macedbg(1) << "Current migration("<< ticket <<") period: " << TimeUtil::timeu() - req_start_time << Log::endl;
+      macedbg(1) << "Current migration("<< ticket <<") period: " << TimeUtil::monotimeu() - req_start_time << Log::endl;
       migrating_flag = false;
     }
 
@@ -1111,7 +1143,7 @@ namespace HeadEventDispatch {
   void HeadEventTP::collectGlobalEventInfo() {
     ADD_SELECTORS("HeadEventTP::collectGlobalEventInfo");
 
-    uint64_t latency = TimeUtil::timeu() - req_start_time;
+    uint64_t latency = TimeUtil::monotimeu() - req_start_time;
     total_latency += latency;
     total_req_count ++;
 
@@ -1220,7 +1252,10 @@ namespace HeadEventDispatch {
     _service->send__event_MigrationControlMsg( destNode, mace::MigrationControl_Message::MIGRATION_PREPARE_RECV_CONTEXTS,
       eventId.ticket, migratingContexts, ctxMapping );
 
-    pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    migratingPendingSignals = 1;
+    while( migratingPendingSignals > 0 ){
+      pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    }
     macedbg(1) << "Set migrating contexts: " << my_migratingContexts << Log::endl;
   }
 
@@ -1239,7 +1274,10 @@ namespace HeadEventDispatch {
       _service->send__event_ContextMigrationRequest( addrIter->first, destNode, event, preVersion, addrIter->second, ctxMapping  );
     }
     macedbg(1) << "Waiting migration event enter contexts("<< origContextIdAddrs <<") ticket=" << eventId.ticket << Log::endl;
-    pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    migratingPendingSignals = 1;
+    while( migratingPendingSignals > 0 ){
+      pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    }
     migrating_waiting_flag = false;
 
     uint64_t ticket = 0;
@@ -1262,7 +1300,9 @@ namespace HeadEventDispatch {
       maceerr << "now_serving_ticket=" << now_serving_ticket << " ticket=" << ticket << Log::endl;
     }
     ASSERT(ticket == now_serving_ticket);
-    pthread_cond_signal(&migratingContextCond);
+    if( migratingPendingSignals > 0 && --migratingPendingSignals == 0 ){
+      pthread_cond_signal(&migratingContextCond);
+    }
   } 
 
   void HeadEventTP::deleteMigrationContext( const mace::string& context_name ) {
@@ -1270,6 +1310,76 @@ namespace HeadEventDispatch {
     // waitingMigrationContexts.erase(context_name);
   }
 
+  void HeadEventTP::setMigrationPlan( BaseMaceService* sv, mace::OrderID const& eventId, 
+      mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> > const& destContexts ) {
+    ADD_SELECTORS("HeadEventTP::setMigrationPlan");
+    ContextService* _service = static_cast<ContextService*>(sv);
+    ScopedLock sl(executeGlobalEventMutex);
+    ASSERT( eventId.ticket == now_serving_ticket );
+
+    plannedMigrationContexts.clear();
+    mace::ContextMapping ctxMapping;
+    mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> >::const_iterator dIter = destContexts.begin();
+    for(; dIter != destContexts.end(); dIter++ ) {
+      mace::map<uint32_t, mace::string>::const_iterator cIter = dIter->second.begin();
+      for(; cIter != dIter->second.end(); cIter++ ) {
+        plannedMigrationContexts.insert( cIter->second );
+      }
+      // every destination holds messages to its incoming contexts until the plan is done
+      _service->send__event_MigrationControlMsg( dIter->first, mace::MigrationControl_Message::MIGRATION_PREPARE_RECV_CONTEXTS,
+        eventId.ticket, dIter->second, ctxMapping );
+    }
+
+    migratingPendingSignals = destContexts.size();
+    while( migratingPendingSignals > 0 ){
+      pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    }
+    macedbg(1) << "Destinations are ready for contexts: " << plannedMigrationContexts << Log::endl;
+  }
+
+  void HeadEventTP::waitingForMigrationPlan( BaseMaceService* sv, 
+      mace::map< mace::MaceAddr, mace::map< mace::MaceAddr, mace::set<uint32_t> > > const& streams, mace::Event const& event, 
+      const uint64_t preVersion, mace::ContextMapping const& ctxMapping, mace::OrderID const& eventId ) {
+    ADD_SELECTORS("HeadEventTP::waitingForMigrationPlan");
+    ContextService* _service = static_cast<ContextService*>(sv);
+    ScopedLock sl(executeGlobalEventMutex);
+    ASSERT( eventId.ticket == now_serving_ticket );
+    migrating_waiting_flag = true;
+
+    // each origin releases every context it sends, and every destination commits every context it receives
+    migratingPendingSignals = 2 * plannedMigrationContexts.size();
+
+    // one stream per (origin, destination) pair, so that origins and destinations transfer in parallel
+    mace::map< mace::MaceAddr, mace::map< mace::MaceAddr, mace::set<uint32_t> > >::const_iterator oIter = streams.begin();
+    for(; oIter != streams.end(); oIter++ ) {
+      mace::map< mace::MaceAddr, mace::set<uint32_t> >::const_iterator dIter = oIter->second.begin();
+      for(; dIter != oIter->second.end(); dIter++ ) {
+        macedbg(1) << "Stream " << dIter->second.size() << " contexts from " << oIter->first << " to " << dIter->first << Log::endl;
+        _service->send__event_ContextMigrationRequest( oIter->first, dIter->first, event, preVersion, dIter->second, ctxMapping );
+      }
+    }
+
+    while( migratingPendingSignals > 0 ){
+      pthread_cond_wait( &migratingContextCond, &executeGlobalEventMutex);
+    }
+    migrating_waiting_flag = false;
+    ASSERT( plannedMigrationContexts.empty() );
+    macedbg(1) << "All contexts of migration plan("<< eventId.ticket <<") arrived!" << Log::endl;
+  }
+
+  bool HeadEventTP::commitPlannedContextMigration( const uint64_t ticket, mace::string const& contextName ) {
+    ADD_SELECTORS("HeadEventTP::commitPlannedContextMigration");
+    ScopedLock sl(executeGlobalEventMutex);
+    if( ticket != now_serving_ticket || plannedMigrationContexts.erase( contextName ) == 0 ){
+      return false;
+    }
+    macedbg(1) << "Context("<< contextName <<") of migration plan("<< ticket <<") arrived!" << Log::endl;
+    if( migratingPendingSignals > 0 && --migratingPendingSignals == 0 ){
+      pthread_cond_signal(&migratingContextCond);
+    }
+    return true;
+  }
+
   void HeadEventTP::handleContextOwnershipUpdateReply( mace::set<mace::string> const& ctxNames ) {
     ADD_SELECTORS("HeadEventTP::handleContextOwnershipUpdateReply");
     ScopedLock sl(executingSyncMutex);
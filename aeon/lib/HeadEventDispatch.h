@@ -22,6 +22,7 @@ class AsyncEventReceiver;
 namespace mace{
   class AgentLock;
   class __event_MigrateContext;
+  class __event_MigrateContexts;
 }
 namespace HeadEventDispatch {
   typedef mace::map< mace::OrderID, uint64_t, mace::SoftState> EventRequestTSType;
@@ -87,6 +88,15 @@ namespace HeadEventDispatch {
 
   };
 
+  class HeadContextsMigrationEvent: public GlobalHeadEventHelper {
+  public:
+    mace::__event_MigrateContexts* msg;
+
+    HeadContextsMigrationEvent(): msg(NULL) { }
+    HeadContextsMigrationEvent( mace::__event_MigrateContexts* msg): msg(msg) { }
+
+  };
+
   class HeadExitEvent: public GlobalHeadEventHelper {
   public:
     mace::OrderID exitEventId;
@@ -105,6 +115,7 @@ namespace HeadEventDispatch {
     static const uint8_t GlobalHeadEvent_MIGRATION = 2;
     static const uint8_t GlobalHeadEvent_EXIT = 3;
     static const uint8_t GlobalHeadEvent_MODIFY_OWNERSHIP = 4;
+    static const uint8_t GlobalHeadEvent_MIGRATION_PLAN = 5;
 
   public:
     uint8_t globalEventType;
@@ -298,6 +309,10 @@ private:
     static mace::map< mace::MaceAddr, mace::set<mace::string> > migratingContextsOrigAddrs;
     static mace::MaceAddr destAddr;
     static mace::set<mace::string> waitingMigrationContexts;
+    /// contexts of the running migration plan that have not arrived at their destination yet
+    static mace::set<mace::string> plannedMigrationContexts;
+    /// number of signals the migration thread still waits for
+    static uint32_t migratingPendingSignals;
 
     static mace::map<mace::MaceAddr, mace::string> externalCommContextMap;
 
@@ -487,6 +502,7 @@ private:
       const mace::map< mace::string, uint64_t>& vers);
     
     static void executeContextMigrationEvent(AsyncEventReceiver* cl, uint8_t const serviceID, mace::string const& contextName, MaceAddr const& destNode, bool const rootOnly);
+    static void executeContextsMigrationEvent(AsyncEventReceiver* cl, uint8_t const serviceID, mace::map< mace::string, MaceAddr > const& plan);
     static void executeModifyOwnershipEvent(AsyncEventReceiver* cl, mace::EventOperationInfo const& eop, mace::string const& ctxName,
       mace::vector<mace::EventOperationInfo> const& ownershipOpInfos);
     static void enqueueGlobalHeadEvent(GlobalHeadEvent* ge);
@@ -516,6 +532,14 @@ private:
 
     static void deleteMigrationContext( const mace::string& context_name );
 
+    // migration plan method
+    static void setMigrationPlan( BaseMaceService* sv, mace::OrderID const& eventId, 
+      mace::map< mace::MaceAddr, mace::map<uint32_t, mace::string> > const& destContexts );
+    static void waitingForMigrationPlan( BaseMaceService* sv, 
+      mace::map< mace::MaceAddr, mace::map< mace::MaceAddr, mace::set<uint32_t> > > const& streams, mace::Event const& event, 
+      const uint64_t preVersion, mace::ContextMapping const& ctxMapping, mace::OrderID const& eventId );
+    static bool commitPlannedContextMigration( const uint64_t ticket, mace::string const& contextName );
+
     // elasticity method
     static void* startElasticityThread(void* arg);
     void elasticityrun(uint32_t n);
@@ -3004,9 +3004,10 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
     mace::MaceAddr orig_src;
     mace::string targetContextName;
     uint64_t msgTicket;
+    uint8_t traceFlags; ///< EventTrace flags of the event the message is sent for
 
-    InternalMessageID(): orig_src(), targetContextName(""), msgTicket(0) { }
-    InternalMessageID(mace::MaceAddr const& src, mace::string const& targetContextName, const uint64_t ticket): orig_src(src), targetContextName(targetContextName), msgTicket(ticket) {
+    InternalMessageID(): orig_src(), targetContextName(""), msgTicket(0), traceFlags(0) { }
+    InternalMessageID(mace::MaceAddr const& src, mace::string const& targetContextName, const uint64_t ticket, const uint8_t traceFlags = 0): orig_src(src), targetContextName(targetContextName), msgTicket(ticket), traceFlags(traceFlags) {
 
     }
 
@@ -3014,6 +3015,7 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
         mace::serialize( str, &orig_src );
         mace::serialize( str, &targetContextName );
         mace::serialize( str, &msgTicket );
+        mace::serialize( str, &traceFlags );
     }
 
     virtual int deserialize(std::istream & is) throw (mace::SerializationException){
@@ -3021,6 +3023,7 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
         serializedByteSize += mace::deserialize( is, &orig_src );
         serializedByteSize += mace::deserialize( is, &targetContextName );
         serializedByteSize += mace::deserialize( is, &msgTicket );
+        serializedByteSize += mace::deserialize( is, &traceFlags );
         return serializedByteSize;
     }
 
@@ -3028,7 +3031,8 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
       out<< "InternalMessageID(";
       out<< "orig_src = "; mace::printItem(out, &(orig_src)); out<<", ";
       out<< "targetContextName = "; mace::printItem(out, &(targetContextName)); out<<", ";
-      out<< "msgTicket = "; mace::printItem(out, &(msgTicket)); 
+      out<< "msgTicket = "; mace::printItem(out, &(msgTicket)); out<<", ";
+      out<< "traceFlags = "; mace::printItem(out, &(traceFlags)); 
       out<< ")";
     }
 
@@ -3038,6 +3042,7 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
       mace::printItem( printer, "orig_src", &orig_src );
       mace::printItem( printer, "targetContextName", &targetContextName );
       mace::printItem( printer, "msgTicket", &msgTicket );
+      mace::printItem( printer, "traceFlags", &traceFlags );
       pr.addChild( printer );
     }
 
@@ -3046,6 +3051,7 @@ class ContextMigrationRequest_Message: public InternalMessageHelper, virtual pub
         this->orig_src = orig.orig_src;
         this->targetContextName = orig.targetContextName;
         this->msgTicket = orig.msgTicket;
+        this->traceFlags = orig.traceFlags;
         return *this;
     }
   };
@@ -0,0 +1,109 @@
+/* 
+ * KeyValueStore.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include "KeyValueStore.h"
+#include "LogStructuredStore.h"
+#include <memory>
+
+namespace {
+  class ChunkVisitor : public mace::KeyValueStore::Visitor {
+  public:
+    ChunkVisitor(mace::KeyValueStore::EntryList& out, size_t maxBytes, std::string& next) :
+      out(out), maxBytes(maxBytes), next(next), bytes(0), more(false) { }
+    bool visit(const std::string& key, const std::string& value) {
+      if (bytes >= maxBytes && !out.empty()) {
+        next = key;
+        more = true;
+        return false;
+      }
+      out.push_back(std::make_pair(key, value));
+      bytes += key.size() + value.size();
+      return true;
+    }
+    mace::KeyValueStore::EntryList& out;
+    const size_t maxBytes;
+    std::string& next;
+    size_t bytes;
+    bool more;
+  };
+}
+
+namespace mace {
+
+bool KeyValueStore::scan(const std::string& first, const std::string& last, EntryList& out,
+                         size_t maxBytes, std::string& next) const {
+  ChunkVisitor visitor(out, maxBytes, next);
+  scan(first, last, visitor);
+  return visitor.more;
+}
+
+KeyValueStore* KeyValueStore::create(const std::string& engine, const std::string& path) throw(Exception) {
+  if (engine == "memory") {
+    return new MemoryKeyValueStore();
+  }
+  else if (engine == "lsm") {
+    std::auto_ptr<LogStructuredStore> store(new LogStructuredStore(path));
+    store->open();
+    return store.release();
+  }
+  throw Exception("KeyValueStore: unknown storage engine " + engine);
+}
+
+bool MemoryKeyValueStore::get(const std::string& key, std::string& value) const {
+  DataMap::const_iterator i = data.find(key);
+  if (i == data.end()) {
+    return false;
+  }
+  value = i->second;
+  return true;
+}
+
+bool MemoryKeyValueStore::contains(const std::string& key) const {
+  return data.find(key) != data.end();
+}
+
+void MemoryKeyValueStore::put(const std::string& key, const std::string& value) {
+  data[key] = value;
+}
+
+void MemoryKeyValueStore::erase(const std::string& key) {
+  data.erase(key);
+}
+
+void MemoryKeyValueStore::scan(const std::string& first, const std::string& last, Visitor& visitor) const {
+  DataMap::const_iterator end = last.empty() ? data.end() : data.lower_bound(last);
+  for (DataMap::const_iterator i = data.lower_bound(first); i != end; i++) {
+    if (!visitor.visit(i->first, i->second)) {
+      return;
+    }
+  }
+}
+
+}
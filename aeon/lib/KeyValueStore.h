@@ -0,0 +1,122 @@
+/* 
+ * KeyValueStore.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _KEY_VALUE_STORE_H
+#define _KEY_VALUE_STORE_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "Exception.h"
+
+/**
+ * \file KeyValueStore.h
+ * \brief declares the KeyValueStore storage engine interface and its in-memory engine
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief ordered string-to-string storage engine.
+ *
+ * Keys are ordered bytewise, so range scans return keys in memcmp order.
+ * Engines are created by name through create(), which lets a service choose
+ * the engine from a parameter:
+ *  - \c memory keeps everything in an ordered in-memory map (the default)
+ *  - \c lsm is the log-structured on-disk LogStructuredStore
+ */
+class KeyValueStore {
+public:
+  typedef std::vector<std::pair<std::string, std::string> > EntryList;
+
+  /// callback for scan(); return false to stop the scan early
+  class Visitor {
+  public:
+    virtual bool visit(const std::string& key, const std::string& value) = 0;
+    virtual ~Visitor() {}
+  };
+
+  virtual ~KeyValueStore() {}
+
+  /// sets \c value and returns true if \c key is present
+  virtual bool get(const std::string& key, std::string& value) const = 0;
+  virtual bool contains(const std::string& key) const {
+    std::string value;
+    return get(key, value);
+  }
+  virtual void put(const std::string& key, const std::string& value) = 0;
+  virtual void erase(const std::string& key) = 0;
+
+  /// visits every key in [first, last) in order; an empty \c last means no upper bound
+  virtual void scan(const std::string& first, const std::string& last, Visitor& visitor) const = 0;
+  /// appends the entries of [first, last) to \c out until they exceed about
+  /// \c maxBytes.  Returns true if the range has more entries, in which case
+  /// \c next is the key to resume from.
+  bool scan(const std::string& first, const std::string& last, EntryList& out,
+            size_t maxBytes, std::string& next) const;
+
+  /// number of live keys; engines that cannot count cheaply return an estimate
+  virtual uint64_t approximateCount() const = 0;
+  /// makes every completed put and erase durable, for engines that persist
+  virtual void flush() { }
+
+  /// creates the engine named \c engine, storing its files under \c path if it needs any
+  static KeyValueStore* create(const std::string& engine, const std::string& path) throw(Exception);
+}; // KeyValueStore
+
+/// KeyValueStore engine keeping everything in an ordered in-memory map
+class MemoryKeyValueStore : public KeyValueStore {
+public:
+  bool get(const std::string& key, std::string& value) const;
+  bool contains(const std::string& key) const;
+  void put(const std::string& key, const std::string& value);
+  void erase(const std::string& key);
+  void scan(const std::string& first, const std::string& last, Visitor& visitor) const;
+  using KeyValueStore::scan;
+  uint64_t approximateCount() const { return data.size(); }
+
+private:
+  typedef std::map<std::string, std::string> DataMap;
+  DataMap data;
+}; // MemoryKeyValueStore
+
+/** @} */
+
+}
+
+#endif // _KEY_VALUE_STORE_H
@@ -29,18 +29,19 @@
  * 
  * ----END-OF-LEGAL-STUFF---- */
 #include <pthread.h>
+#include <stdint.h>
 
 #include "TimeUtil.h"
 #include "ScopedLock.h"
 #include "mstring.h"
-#include "m_map.h"
+#include "mhash_map.h"
 
 #ifndef LRUCACHE_H
 #define LRUCACHE_H
 
 /**
  * \file LRUCache.h
- * \brief defines the mace::LRUCache class
+ * \brief defines the mace::LRUCache and mace::ShardedLRUCache classes
  */
 
 
@@ -50,19 +51,27 @@ namespace mace {
  * \brief Provides a cache with a least recently used replacement policy and a map like interface.
  * 
  * The add methods will evict the least recently used non-dirty key.
- * If all the indices are dirty, then the least recently used dirty
- * key will be evicted.
+ * It is an error to add a new key when every entry is dirty.
+ *
+ * Entries are indexed by a hash map and kept on two intrusive doubly
+ * linked lists, one for clean and one for dirty entries, each ordered from
+ * most to least recently used.  Lookups, eviction and the dirty-key
+ * accessors are therefore all O(1).  An entry whose dirty bit changes moves
+ * to the head of its new list.
  * 
  * Use timeouts with caution---if a dirty entry expires, it will be
  * deleted the next time containsKey is called for its entry.  Because
  * dirty entries may be deleted before they have a chance to be
  * cleared, it is advised to not use a timeout when storing dirty data
  * in the cache.
+ *
+ * The cache counts hits and misses of containsKey and get(const K&, D&),
+ * and the entries it evicts to make room.
  * 
  * \warning you MUST call containsKey and check that the result is true
  *       before calling get, operator[], or obtain the key by getLastDirtyKey
  */
-template <typename K, typename D>
+template <typename K, typename D, typename HashFcn = __MACE_BASE_HASH__<K> >
 class LRUCache {
 
   class CacheEntry {
@@ -83,8 +92,14 @@ class LRUCache {
     CacheEntry* next;
   }; // CacheEntry
 
-//   typedef hash_map<K, CacheEntry*, HashFcn, EqualKey> LRUCacheIndexMap;
-  typedef map<K, CacheEntry*, SoftState> LRUCacheIndexMap;
+  /// intrusive list of entries, head is the most recently used
+  struct EntryList {
+    CacheEntry* head;
+    CacheEntry* tail;
+    EntryList() : head(0), tail(0) { }
+  }; // EntryList
+
+  typedef hash_map<K, CacheEntry*, SoftState, HashFcn> LRUCacheIndexMap;
 
 public:
 
@@ -95,8 +110,8 @@ public:
    * timeout.
    */
   LRUCache(unsigned capacity = 32, time_t timeout = 0, bool useLocking = true) :
-    capacity(capacity), timeout(timeout), size(0), dirtyCount(0), cache(0),
-    lockptr(0) {
+    capacity(capacity), timeout(timeout), size(0), dirtyCount(0),
+    hits(0), misses(0), evictions(0), lockptr(0) {
 
     pthread_mutexattr_t ma;
     ASSERT(pthread_mutexattr_init(&ma) == 0);
@@ -110,13 +125,9 @@ public:
 
   virtual ~LRUCache() {
     ASSERT(pthread_mutex_lock(&lrulock) == 0);
-    while (cache != 0) {
-      CacheEntry* tmp = cache;
-      cache = cache->next;
-      indexMap.erase(tmp->index);
-      delete tmp;
-      tmp = 0;
-    }
+    deleteEntries(clean);
+    deleteEntries(dirtyList);
+    indexMap.clear();
     ASSERT(pthread_mutex_unlock(&lrulock) == 0);
     pthread_mutex_destroy(&lrulock);
   } // ~LRUCache
@@ -125,8 +136,6 @@ public:
    * \brief add a new entry to the cache, mark as dirty
    *
    * The add methods will evict the least recently used non-dirty key.
-   * If all the indices are dirty, then the least recently used dirty
-   * key will be evicted.
    */
   void addDirty(const K& index, const D& buf) {
     add(index, buf, true);
@@ -136,8 +145,6 @@ public:
    * \brief add a new entry to the cache, set dirty as specified
    *
    * The add methods will evict the least recently used non-dirty key.
-   * If all the indices are dirty, then the least recently used dirty
-   * key will be evicted.
    */
   void add(const K& index, const D& buf, bool dirty = false) {
     ScopedLock sl(lockptr);
@@ -148,6 +155,7 @@ public:
       // is not, then you lose the dirty data
       CacheEntry* e = i->second;
       e->data = buf;
+      unlink(e);
       if (e->dirty && !dirty) {
 	dirtyCount--;
       }
@@ -155,27 +163,19 @@ public:
 	dirtyCount++;
       }
       e->dirty = dirty;
-      moveToHead(e);
+      linkHead(e);
       return;
     }
 
-    // XXX - jwa - why was this here?  It should be an error to attempt
-    // to insert into a full dirty cache.  If this code was left in
-    // place, the cache would silently lose data---better to assert.
-//     if (isFullDirty()) {
-//       clearDirty(getLastDirtyKey());
-//     }
-    
+    // It is an error to attempt to insert into a full dirty cache,
+    // since the cache would otherwise silently lose data.
     ASSERT(!isFullDirty());
 
     if (size == capacity) {
       // evict the lru non-dirty block
-      CacheEntry* last = cache->prev;
-      while (last->dirty) {
-	last = last->prev;
-      }
-
-      remove(last->index);
+      ASSERT(clean.tail != 0);
+      evictions++;
+      erase(clean.tail->index);
     }
 
     ASSERT(size < capacity);
@@ -187,15 +187,7 @@ public:
 
     time_t now = TimeUtil::time();
     CacheEntry* e = new CacheEntry(index, buf, dirty, now);
-    if (cache == 0) {
-      e->prev = e;
-    }
-    else {
-      e->next = cache;
-      e->prev = cache->prev;
-      cache->prev = e;
-    }
-    cache = e;
+    linkHead(e);
     indexMap[index] = e;
   } // add
 
@@ -209,48 +201,34 @@ public:
     typename LRUCacheIndexMap::iterator i = indexMap.find(index);
     if (i != indexMap.end()) {
       CacheEntry* e = i->second;
-
-      clearDirty(e);
-
-      if (e->next) {
-	e->next->prev = e->prev;
-      }
-      else {
-	cache->prev = e->prev;
-      }
-
-      if (cache == e) {
-	cache = e->next;
-      }
-      else {
-        //Before, this would complete the loop if the first element were removed.
-        e->prev->next = e->next;
+      unlink(e);
+      if (e->dirty) {
+	dirtyCount--;
       }
-
+      indexMap.erase(i);
       delete e;
       e = 0;
-      indexMap.erase(i);
       size--;
 
       ASSERT(indexMap.size() == size);
       if (size == 0) {
-	ASSERT(cache == 0);
+	ASSERT(clean.head == 0 && dirtyList.head == 0);
       }
     }
   } // erase
 
   /**
-   * \brief lookup the value for the given key
-   * \warning you MUST call containsKey and check that the result is true
-   *  before calling get, operator[], or obtain the key by getLastDirtyKey
+   * \brief lookup the value for the given key, returning false if it is not cached
    */
   bool get(const K& index, D& data) {
     ScopedLock sl(lockptr);
     typename LRUCacheIndexMap::iterator i = indexMap.find(index);
     if (i == indexMap.end()) {
+      misses++;
       return false;
     }
     
+    hits++;
     CacheEntry* e = i->second;
     moveToHead(e);
     data = e->data;
@@ -290,10 +268,16 @@ public:
       CacheEntry* e = i->second;
       if ((now - e->init) > timeout) {
 	remove(index);
-	return false;
+	c = false;
       }
     }
 
+    if (c) {
+      hits++;
+    }
+    else {
+      misses++;
+    }
     return c;
   } // containsKey
 
@@ -310,14 +294,7 @@ public:
   /// return the least recently accessed dirty key
   const K& getLastDirtyKey() const {
     ScopedLock sl(lockptr);
-    ASSERT(hasDirty());
-
-    CacheEntry* last = cache->prev;
-    while (!last->dirty) {
-      last = last->prev;
-    }
-
-    return last->index;
+    return getLastDirtyEntry()->index;
   } // getLastDirtyKey
 
   /// return the least recently accessed dirty value
@@ -369,50 +346,225 @@ public:
     return e->data;
   } // getDirty
 
+  /// number of cached entries
+  unsigned getSize() const {
+    ScopedLock sl(lockptr);
+    return size;
+  } // getSize
+
+  unsigned getCapacity() const { return capacity; }
+
+  /// number of lookups that found their key
+  uint64_t getHits() const {
+    ScopedLock sl(lockptr);
+    return hits;
+  } // getHits
+
+  /// number of lookups that did not find their key
+  uint64_t getMisses() const {
+    ScopedLock sl(lockptr);
+    return misses;
+  } // getMisses
+
+  /// number of clean entries evicted to make room for new ones
+  uint64_t getEvictions() const {
+    ScopedLock sl(lockptr);
+    return evictions;
+  } // getEvictions
+
+  void resetStats() {
+    ScopedLock sl(lockptr);
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+  } // resetStats
+
 private:
 
   CacheEntry* getLastDirtyEntry() const {
     ASSERT(hasDirty());
-    CacheEntry* last = cache->prev;
-    while (!last->dirty) {
-      last = last->prev;
-    }
-    return last;
+    return dirtyList.tail;
   }
 
   void clearDirty(CacheEntry* e) {
     if (e->dirty) {
+      unlink(e);
       dirtyCount--;
       e->dirty = false;
+      linkHead(e);
     }
   }
-    
-  void moveToHead(CacheEntry* e) {
-    if (e->index == cache->index) {
-      ASSERT(cache == e);
-      return;
+
+  EntryList& listFor(CacheEntry* e) {
+    return e->dirty ? dirtyList : clean;
+  } // listFor
+
+  void linkHead(CacheEntry* e) {
+    EntryList& l = listFor(e);
+    e->prev = 0;
+    e->next = l.head;
+    if (l.head) {
+      l.head->prev = e;
+    }
+    else {
+      l.tail = e;
+    }
+    l.head = e;
+  } // linkHead
+
+  void unlink(CacheEntry* e) {
+    EntryList& l = listFor(e);
+    if (e->prev) {
+      e->prev->next = e->next;
+    }
+    else {
+      l.head = e->next;
     }
-    e->prev->next = e->next;
     if (e->next) {
       e->next->prev = e->prev;
-      e->prev = cache->prev;
     }
-    e->next = cache;
-    cache->prev = e;
-    cache = e;
+    else {
+      l.tail = e->prev;
+    }
+    e->prev = 0;
+    e->next = 0;
+  } // unlink
+    
+  void moveToHead(CacheEntry* e) {
+    if (listFor(e).head == e) {
+      return;
+    }
+    unlink(e);
+    linkHead(e);
   } // moveToHead
 
+  void deleteEntries(EntryList& l) {
+    while (l.head != 0) {
+      CacheEntry* tmp = l.head;
+      l.head = tmp->next;
+      delete tmp;
+    }
+    l.tail = 0;
+  } // deleteEntries
+
 private:
   unsigned capacity;
   time_t timeout;
   unsigned size;
   unsigned dirtyCount;
-  CacheEntry* cache;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  EntryList clean;
+  EntryList dirtyList;
   LRUCacheIndexMap indexMap;
   mutable pthread_mutex_t lrulock;
   mutable pthread_mutex_t* lockptr;
 };
 
+/**
+ * \brief LRUCache split into independently locked shards for concurrent use.
+ *
+ * Each key lives in the shard chosen by its hash, and each shard is an
+ * LRUCache with an equal part of the capacity, so recency and eviction are
+ * tracked per shard.  Threads touching keys in different shards do not
+ * contend on a lock.  The dirty-entry methods of LRUCache are reached
+ * through getShard().
+ */
+template <typename K, typename D, typename HashFcn = __MACE_BASE_HASH__<K> >
+class ShardedLRUCache {
+public:
+  typedef LRUCache<K, D, HashFcn> Shard;
+
+  ShardedLRUCache(unsigned capacity = 256, unsigned shardCount = 8, time_t timeout = 0) :
+    shardCount(shardCount), shards(new Shard*[shardCount]) {
+    ASSERT(shardCount > 0 && capacity >= shardCount);
+    for (unsigned i = 0; i < shardCount; i++) {
+      shards[i] = new Shard(capacity / shardCount, timeout);
+    }
+  } // ShardedLRUCache
+
+  virtual ~ShardedLRUCache() {
+    for (unsigned i = 0; i < shardCount; i++) {
+      delete shards[i];
+    }
+    delete [] shards;
+  } // ~ShardedLRUCache
+
+  void add(const K& index, const D& buf, bool dirty = false) {
+    getShard(index).add(index, buf, dirty);
+  } // add
+
+  void addDirty(const K& index, const D& buf) {
+    getShard(index).add(index, buf, true);
+  } // addDirty
+
+  void erase(const K& index) {
+    getShard(index).erase(index);
+  } // erase
+
+  inline void remove(const K& index) {
+    erase(index);
+  } // remove
+
+  bool get(const K& index, D& data) {
+    return getShard(index).get(index, data);
+  } // get
+
+  bool containsKey(const K& index) {
+    return getShard(index).containsKey(index);
+  } // containsKey
+
+  /// the shard holding \c index
+  Shard& getShard(const K& index) {
+    // mix the hash so shard choice is independent of the shard's own buckets
+    uint32_t h = (uint32_t)hashFcn(index);
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return *shards[h % shardCount];
+  } // getShard
+
+  unsigned getShardCount() const { return shardCount; }
+
+  unsigned getSize() const {
+    unsigned n = 0;
+    for (unsigned i = 0; i < shardCount; i++) {
+      n += shards[i]->getSize();
+    }
+    return n;
+  } // getSize
+
+  uint64_t getHits() const {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < shardCount; i++) {
+      n += shards[i]->getHits();
+    }
+    return n;
+  } // getHits
+
+  uint64_t getMisses() const {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < shardCount; i++) {
+      n += shards[i]->getMisses();
+    }
+    return n;
+  } // getMisses
+
+  uint64_t getEvictions() const {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < shardCount; i++) {
+      n += shards[i]->getEvictions();
+    }
+    return n;
+  } // getEvictions
+
+private:
+  const unsigned shardCount;
+  Shard** shards;
+  HashFcn hashFcn;
+};
+
 
 } // namespace mace
 
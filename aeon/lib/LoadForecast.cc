@@ -0,0 +1,172 @@
+/* 
+ * LoadForecast.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <cmath>
+#include "LoadForecast.h"
+
+/**
+ * \file LoadForecast.cc
+ * \brief Defines the load forecasting and autoscaling decisions used by eMonitor
+ */
+
+namespace mace {
+
+const double ServerLoadForecast::SATURATED_CPU_USAGE = 90;
+
+LoadForecast::LoadForecast(double alpha, double beta, double gamma, uint32_t season) :
+  alpha(alpha), beta(beta), gamma(gamma), season(season), level(0), trend(0), seasonal(season, 0.0), count(0) {
+}
+
+void LoadForecast::update(double value) {
+  if (count == 0) {
+    level = value;
+    trend = 0;
+  }
+  else {
+    const uint32_t position = season > 0 ? count % season : 0;
+    const double s = season > 0 ? seasonal[position] : 0;
+    const double previous = level;
+    level = alpha * (value - s) + (1 - alpha) * (level + trend);
+    if (count == 1) {
+      trend = level - previous;
+    }
+    else {
+      trend = beta * (level - previous) + (1 - beta) * trend;
+    }
+    if (season > 0) {
+      seasonal[position] = gamma * (value - level) + (1 - gamma) * s;
+    }
+  }
+  count++;
+}
+
+double LoadForecast::forecast(uint32_t steps) const {
+  if (count == 0) {
+    return 0;
+  }
+  double value = level + steps * trend;
+  if (season > 0) {
+    value += seasonal[(count - 1 + steps) % season];
+  }
+  return value;
+}
+
+void LoadForecast::clear() {
+  level = 0;
+  trend = 0;
+  seasonal.assign(season, 0.0);
+  count = 0;
+}
+
+ServerLoadForecast::ServerLoadForecast(double alpha, double beta, double gamma, uint32_t season) :
+  cpu(alpha, beta, gamma, season), rate(alpha, beta, gamma, season), queue(alpha, beta, gamma, season), cpuPerEvent(0) {
+}
+
+void ServerLoadForecast::update(double cpuUsage, double eventRate, double queueDepth) {
+  cpu.update(cpuUsage);
+  rate.update(eventRate);
+  queue.update(queueDepth);
+  // a saturated server runs fewer events than arrive, so it tells nothing about their cost
+  if (eventRate > 0 && cpuUsage < SATURATED_CPU_USAGE) {
+    cpuPerEvent = cpuUsage / eventRate;
+  }
+}
+
+double ServerLoadForecast::forecast(uint32_t steps, double queueLimit) const {
+  // the peak over the horizon: a server must not run out of capacity before the horizon either
+  double load = 0;
+  for (uint32_t step = 0; step <= steps; step++) {
+    double expected = cpu.forecast(step);
+    const double byRate = cpuPerEvent * rate.forecast(step);
+    if (byRate > expected) {
+      expected = byRate;
+    }
+    if (queueLimit > 0 && queue.forecast(step) >= queueLimit && expected < 100) {
+      expected = 100;
+    }
+    if (expected > load) {
+      load = expected;
+    }
+  }
+  return load;
+}
+
+AutoscalePolicy::AutoscalePolicy(double upThreshold, double downThreshold, uint32_t upPeriods, uint32_t downPeriods,
+    uint32_t cooldown) :
+  upThreshold(upThreshold), downThreshold(downThreshold), upPeriods(upPeriods), downPeriods(downPeriods), cooldown(cooldown),
+  above(0), below(0), waiting(0) {
+}
+
+int32_t AutoscalePolicy::decide(double load, uint32_t activeServers, uint32_t maxServers) {
+  if (waiting > 0) {
+    waiting--;
+    return 0;
+  }
+  if (activeServers == 0) {
+    return maxServers > 0 ? 1 : 0;
+  }
+
+  const double perServer = load / activeServers;
+  if (perServer > upThreshold && activeServers < maxServers) {
+    below = 0;
+    if (++above < upPeriods) {
+      return 0;
+    }
+    // enough servers to bring the load to the middle of the band
+    const double target = (upThreshold + downThreshold) / 2;
+    uint32_t needed = target > 0 ? (uint32_t)ceil(load / target) : maxServers;
+    if (needed > maxServers) {
+      needed = maxServers;
+    }
+    above = 0;
+    waiting = cooldown;
+    return needed > activeServers ? needed - activeServers : 1;
+  }
+  if (perServer < downThreshold && activeServers > 1 && load / (activeServers - 1) <= upThreshold) {
+    above = 0;
+    if (++below < downPeriods) {
+      return 0;
+    }
+    below = 0;
+    waiting = cooldown;
+    return -1;
+  }
+  above = 0;
+  below = 0;
+  return 0;
+}
+
+void AutoscalePolicy::clear() {
+  above = 0;
+  below = 0;
+  waiting = 0;
+}
+
+}
@@ -0,0 +1,154 @@
+/* 
+ * LoadForecast.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <vector>
+
+/**
+ * \file LoadForecast.h
+ * \brief Declares the load forecasting and autoscaling decisions used by eMonitor
+ */
+
+#ifndef _MACE_LOAD_FORECAST_H
+#define _MACE_LOAD_FORECAST_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief Holt-Winters exponential smoothing of a signal sampled once per period.
+ *
+ * Keeps a smoothed level, a trend and, when \c season is not zero, an
+ * additive seasonal offset for each of the \c season positions of a cycle.
+ * With \c beta and \c season both zero it is a plain EWMA.
+ */
+class LoadForecast {
+private:
+  double alpha; ///< weight of a new sample in the level
+  double beta; ///< weight of a new level change in the trend
+  double gamma; ///< weight of a new sample in its seasonal offset
+  uint32_t season; ///< periods per cycle, or 0
+  double level;
+  double trend;
+  std::vector<double> seasonal;
+  uint64_t count;
+
+public:
+  LoadForecast(double alpha = 0.5, double beta = 0.3, double gamma = 0.1, uint32_t season = 0);
+
+  /// adds the sample of the next period
+  void update(double value);
+  /// return the value expected \c steps periods after the last sample; forecast(0) is the smoothed current value
+  double forecast(uint32_t steps) const;
+
+  double getLevel() const { return level; }
+  double getTrend() const { return trend; }
+  uint64_t getCount() const { return count; }
+  void clear();
+};
+
+/**
+ * \brief forecasts the load of one server from its CPU usage, event arrival rate and queue depth.
+ *
+ * The load is CPU usage in percent of the server, and may exceed 100 when
+ * more events arrive than the server can run.  Since the CPU usage of a
+ * saturated server stops growing, the CPU forecast is checked against the
+ * load the forecast arrival rate would cause at the CPU cost per event seen
+ * last, and a forecast queue longer than \c queueLimit counts as a
+ * saturated server.
+ */
+class ServerLoadForecast {
+public:
+  static const double SATURATED_CPU_USAGE; ///< percent CPU above which a server counts as saturated
+
+private:
+  LoadForecast cpu;
+  LoadForecast rate;
+  LoadForecast queue;
+  double cpuPerEvent; ///< CPU usage per event per second, in the last period that had events and was not saturated
+
+public:
+  ServerLoadForecast(double alpha = 0.5, double beta = 0.3, double gamma = 0.1, uint32_t season = 0);
+
+  /// adds one period: CPU usage in percent, events per second and events waiting to run
+  void update(double cpuUsage, double eventRate, double queueDepth);
+  /// return the highest load expected from now to \c steps periods ahead
+  double forecast(uint32_t steps, double queueLimit) const;
+  uint64_t getCount() const { return cpu.getCount(); }
+};
+
+/**
+ * \brief turns forecast cluster load into scale-up and scale-down decisions, with hysteresis.
+ *
+ * Loads are in percent of one server.  The cluster scales up when the load
+ * per active server stays above \c upThreshold for \c upPeriods decisions,
+ * adding enough servers to bring it back to the middle of the two
+ * thresholds, and scales down by one server when the load stays below \c
+ * downThreshold for \c downPeriods decisions and would not exceed \c
+ * upThreshold on one server less.  No decision is taken for \c cooldown
+ * decisions after an action, so that its effect shows in the load first.
+ */
+class AutoscalePolicy {
+private:
+  double upThreshold;
+  double downThreshold;
+  uint32_t upPeriods;
+  uint32_t downPeriods;
+  uint32_t cooldown;
+
+  uint32_t above;
+  uint32_t below;
+  uint32_t waiting;
+
+public:
+  AutoscalePolicy(double upThreshold = 70, double downThreshold = 30, uint32_t upPeriods = 2, uint32_t downPeriods = 3,
+      uint32_t cooldown = 3);
+
+  /**
+   * decides for one period.
+   *
+   * @param load the (forecast) load of the cluster, summed over the active servers
+   * @param activeServers the number of active servers
+   * @param maxServers the number of servers that may be active
+   * @return the number of servers to activate, or minus the number of servers to release, or 0
+   */
+  int32_t decide(double load, uint32_t activeServers, uint32_t maxServers);
+  void clear();
+};
+
+/** @} */
+
+}
+
+#endif // _MACE_LOAD_FORECAST_H
@@ -39,7 +39,12 @@ class LockedSignal {
 public:
   LockedSignal() : waiting(false), signalled(false) {
     ASSERT(pthread_mutex_init(&mutex, 0) == 0);
-    ASSERT(pthread_cond_init(&cond, 0) == 0);
+    // time out against the monotonic clock, so setting the time of day does not shorten or stretch waits
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    ASSERT(pthread_cond_init(&cond, &attr) == 0);
+    pthread_condattr_destroy(&attr);
   }
   
   virtual ~LockedSignal() {
@@ -62,12 +67,11 @@ public:
       return lockWait(0);
     }
     else {
-      struct timeval t;
       struct timespec ts;
-      uint64_t fintime = TimeUtil::timeu() + usec;
-      TimeUtil::fillTimeval(fintime, t);
-      ts.tv_sec = t.tv_sec;
-      ts.tv_nsec = t.tv_usec * 1000;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      uint64_t nsec = ts.tv_nsec + (usec % 1000000) * 1000;
+      ts.tv_sec += usec / 1000000 + nsec / 1000000000;
+      ts.tv_nsec = nsec % 1000000000;
       return lockWait(&ts);
     }
   }
@@ -0,0 +1,631 @@
+/* 
+ * LogStructuredStore.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "maceConfig.h"
+#include "mace-macros.h"
+#include "FileUtil.h"
+#include "Log.h"
+#include "ScopedLock.h"
+#include "LogStructuredStore.h"
+
+using namespace std;
+
+namespace {
+  /// segment footer, in host byte order like the write-ahead log
+  struct SegmentFooter {
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint64_t count;
+    uint64_t covers;
+    uint64_t magic;
+  };
+
+  const uint64_t SEGMENT_MAGIC = 0x6d6163656c736d31ULL;
+  const uint32_t TOMBSTONE = 0x80000000;
+  const size_t WRITE_BUFFER_SIZE = 64*1024;
+  const std::string SEGMENT_PREFIX = "seg.";
+  const std::string SEGMENT_SUFFIX = ".sst";
+  const char LOG_PUT = 'P';
+  const char LOG_ERASE = 'D';
+
+  void appendU32(std::string& buf, uint32_t v) {
+    buf.append((const char*)&v, sizeof(v));
+  }
+
+  void appendU64(std::string& buf, uint64_t v) {
+    buf.append((const char*)&v, sizeof(v));
+  }
+
+  void preadFully(int fd, char* buf, size_t len, uint64_t offset, const std::string& path) throw(IOException) {
+    while (len > 0) {
+      ssize_t n = pread(fd, buf, len, offset);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        throw ReadException("LogStructuredStore: short read from " + path);
+      }
+      buf += n;
+      len -= n;
+      offset += n;
+    }
+  }
+
+  bool parseSegmentName(const std::string& name, uint64_t& seq) {
+    if (name.size() <= SEGMENT_PREFIX.size() + SEGMENT_SUFFIX.size() ||
+        name.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) != 0 ||
+        name.compare(name.size() - SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX) != 0) {
+      return false;
+    }
+    std::string digits = name.substr(SEGMENT_PREFIX.size(), name.size() - SEGMENT_PREFIX.size() - SEGMENT_SUFFIX.size());
+    char* end = NULL;
+    seq = strtoull(digits.c_str(), &end, 16);
+    return *end == '\0';
+  }
+
+  /// parses one entry at \c pos of a data block, returning false at the end of the block
+  bool parseEntry(const std::string& block, size_t& pos, std::string& key, std::string& value, bool& deleted) {
+    if (pos + 2*sizeof(uint32_t) > block.size()) {
+      return false;
+    }
+    uint32_t klen, vlen;
+    memcpy(&klen, block.data() + pos, sizeof(klen));
+    memcpy(&vlen, block.data() + pos + sizeof(klen), sizeof(vlen));
+    deleted = (vlen & TOMBSTONE) != 0;
+    vlen &= ~TOMBSTONE;
+    pos += 2*sizeof(uint32_t);
+    key.assign(block, pos, klen);
+    value.assign(block, pos + klen, vlen);
+    pos += klen + vlen;
+    return true;
+  }
+
+  /// streams sorted entries into a new segment file
+  class SegmentWriter {
+  public:
+    SegmentWriter(const std::string& path) :
+      path(path), fd(FileUtil::open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)),
+      offset(0), blockStart(0), count(0) { }
+
+    ~SegmentWriter() {
+      if (fd >= 0) {
+        FileUtil::close(fd);
+      }
+    }
+
+    void add(const std::string& key, const std::string& value, bool deleted) throw(IOException) {
+      if (index.empty() || offset - blockStart >= mace::LogStructuredStore::BLOCK_SIZE) {
+        blockStart = offset;
+        appendU32(indexBuf, key.size());
+        indexBuf.append(key);
+        appendU64(indexBuf, offset);
+        index.push_back(offset);
+      }
+      size_t before = buf.size();
+      appendU32(buf, key.size());
+      appendU32(buf, value.size() | (deleted ? TOMBSTONE : 0));
+      buf.append(key);
+      buf.append(value);
+      offset += buf.size() - before;
+      count++;
+      if (buf.size() >= WRITE_BUFFER_SIZE) {
+        FileUtil::write(fd, buf);
+        buf.clear();
+      }
+    }
+
+    /// writes the index and footer and makes the file durable
+    void finish(uint64_t covers) throw(IOException) {
+      SegmentFooter footer;
+      footer.indexOffset = offset;
+      footer.indexCount = index.size();
+      footer.count = count;
+      footer.covers = covers;
+      footer.magic = SEGMENT_MAGIC;
+      buf.append(indexBuf);
+      buf.append((const char*)&footer, sizeof(footer));
+      FileUtil::write(fd, buf);
+      buf.clear();
+      if (fdatasync(fd) < 0) {
+        throw WriteException("LogStructuredStore: fdatasync " + path + ": " + strerror(errno));
+      }
+      FileUtil::close(fd);
+      fd = -1;
+    }
+
+  private:
+    const std::string path;
+    int fd;
+    std::string buf;
+    std::string indexBuf;
+    std::vector<uint64_t> index;
+    uint64_t offset;
+    uint64_t blockStart;
+    uint64_t count;
+  };
+
+  /// sorted source of entries for scans and compaction
+  class Cursor {
+  public:
+    virtual bool valid() const = 0;
+    virtual const std::string& key() const = 0;
+    virtual const std::string& value() const = 0;
+    virtual bool deleted() const = 0;
+    virtual void next() = 0;
+    virtual ~Cursor() {}
+  };
+
+  class MemtableCursor : public Cursor {
+  public:
+    MemtableCursor(const mace::LogStructuredStore::Memtable& m, const std::string& first) :
+      i(m.lower_bound(first)), end(m.end()) { }
+    bool valid() const { return i != end; }
+    const std::string& key() const { return i->first; }
+    const std::string& value() const { return i->second.value; }
+    bool deleted() const { return i->second.deleted; }
+    void next() { i++; }
+  private:
+    mace::LogStructuredStore::Memtable::const_iterator i;
+    mace::LogStructuredStore::Memtable::const_iterator end;
+  };
+
+  class SegmentCursor : public Cursor {
+  public:
+    SegmentCursor(const mace::LogStructuredStore::Segment& s, const std::string& first) :
+      segment(s), blockIndex(0), pos(0), isValid(false), isDeleted(false) {
+      if (segment.index.empty()) {
+        return;
+      }
+      // start from the last block whose first key is <= first
+      std::vector<std::pair<std::string, uint64_t> >::const_iterator i =
+        std::upper_bound(segment.index.begin(), segment.index.end(), std::make_pair(first, UINT64_MAX));
+      if (i != segment.index.begin()) {
+        i--;
+      }
+      blockIndex = i - segment.index.begin();
+      segment.readBlock(blockIndex, block);
+      next();
+      while (isValid && currentKey < first) {
+        next();
+      }
+    }
+    bool valid() const { return isValid; }
+    const std::string& key() const { return currentKey; }
+    const std::string& value() const { return currentValue; }
+    bool deleted() const { return isDeleted; }
+    void next() {
+      while (!parseEntry(block, pos, currentKey, currentValue, isDeleted)) {
+        if (++blockIndex >= segment.index.size()) {
+          isValid = false;
+          return;
+        }
+        segment.readBlock(blockIndex, block);
+        pos = 0;
+      }
+      isValid = true;
+    }
+  private:
+    const mace::LogStructuredStore::Segment& segment;
+    size_t blockIndex;
+    std::string block;
+    size_t pos;
+    bool isValid;
+    std::string currentKey;
+    std::string currentValue;
+    bool isDeleted;
+  };
+
+  /// merges cursors ordered from newest to oldest, so the newest entry for a key wins
+  class MergeCursor {
+  public:
+    MergeCursor() : current(NULL) { }
+    ~MergeCursor() {
+      for (size_t i = 0; i < cursors.size(); i++) {
+        delete cursors[i];
+      }
+    }
+    void add(Cursor* c) { cursors.push_back(c); }
+    /// positions on the next key, returning false once every cursor is exhausted
+    bool next() {
+      if (current != NULL) {
+        std::string k = current->key();
+        for (size_t i = 0; i < cursors.size(); i++) {
+          if (cursors[i]->valid() && cursors[i]->key() == k) {
+            cursors[i]->next();
+          }
+        }
+      }
+      current = NULL;
+      for (size_t i = 0; i < cursors.size(); i++) {
+        if (cursors[i]->valid() && (current == NULL || cursors[i]->key() < current->key())) {
+          current = cursors[i];
+        }
+      }
+      return current != NULL;
+    }
+    const Cursor& get() const { return *current; }
+  private:
+    std::vector<Cursor*> cursors;
+    Cursor* current;
+  };
+
+  class ReplayHandler : public mace::WriteAheadLog::RecoveryHandler {
+  public:
+    ReplayHandler(mace::LogStructuredStore::Memtable& m, uint64_t& bytes) : memtable(m), bytes(bytes) { }
+    void recoverCheckpoint(uint64_t lsn, const std::string& snapshot) { }
+    void recoverRecord(uint64_t lsn, const std::string& record) {
+      uint32_t klen;
+      memcpy(&klen, record.data() + 1, sizeof(klen));
+      std::string key(record, 1 + sizeof(klen), klen);
+      std::string value(record, 1 + sizeof(klen) + klen);
+      memtable[key] = mace::LogStructuredStore::Entry(value, record[0] == LOG_ERASE);
+      bytes += key.size() + value.size();
+    }
+  private:
+    mace::LogStructuredStore::Memtable& memtable;
+    uint64_t& bytes;
+  };
+}
+
+namespace mace {
+
+void LogStructuredStore::Segment::readBlock(size_t i, std::string& block) const throw(IOException) {
+  uint64_t start = index[i].second;
+  uint64_t end = (i + 1 < index.size()) ? index[i + 1].second : dataEnd;
+  block.resize(end - start);
+  preadFully(fd, &block[0], block.size(), start, path);
+}
+
+LogStructuredStore::LogStructuredStore(const std::string& dir, uint64_t memtableSize,
+                                       uint32_t maxSegments, bool syncWrites) :
+  dir(dir), memtableSize(memtableSize), maxSegments(maxSegments), syncWrites(syncWrites),
+  wal(dir + "/wal", memtableSize), memtableBytes(0), nextSeq(1) {
+  pthread_mutex_init(&lock, NULL);
+} // LogStructuredStore
+
+LogStructuredStore::~LogStructuredStore() {
+  close();
+  pthread_mutex_destroy(&lock);
+} // ~LogStructuredStore
+
+std::string LogStructuredStore::segmentPath(uint64_t seq) const {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%016" PRIx64 "%s", SEGMENT_PREFIX.c_str(), seq, SEGMENT_SUFFIX.c_str());
+  return dir + "/" + name;
+}
+
+void LogStructuredStore::open() throw(IOException) {
+  ADD_SELECTORS("LogStructuredStore::open");
+  ScopedLock sl(lock);
+  if (!FileUtil::fileIsDir(dir)) {
+    FileUtil::mkdir(dir, S_IRWXU, true);
+  }
+
+  StringList names;
+  FileUtil::readDir(dir, names, true);
+  uint64_t covered = 0;
+  for (StringList::const_iterator i = names.begin(); i != names.end(); i++) {
+    uint64_t seq;
+    if (parseSegmentName(*i, seq)) {
+      Segment* s = loadSegment(seq, dir + "/" + *i);
+      segments.insert(segments.begin(), s);
+      covered = std::max(covered, s->covers);
+      nextSeq = std::max(nextSeq, seq + 1);
+    }
+    else if (i->size() > 4 && i->compare(i->size() - 4, 4, ".tmp") == 0) {
+      // an unfinished flush or compaction
+      FileUtil::unlink(dir + "/" + *i);
+    }
+  }
+
+  // a compaction that finished before a crash leaves its inputs behind
+  for (SegmentList::iterator i = segments.begin(); i != segments.end(); ) {
+    if ((*i)->seq <= covered) {
+      macedbg(1) << "removing compacted segment " << (*i)->path << Log::endl;
+      FileUtil::close((*i)->fd);
+      FileUtil::unlink((*i)->path);
+      delete *i;
+      i = segments.erase(i);
+    }
+    else {
+      i++;
+    }
+  }
+
+  ReplayHandler handler(memtable, memtableBytes);
+  wal.open(handler);
+  maceout << "opened " << dir << " with " << segments.size() << " segments and "
+          << memtable.size() << " logged keys" << Log::endl;
+} // open
+
+void LogStructuredStore::close() {
+  ScopedLock sl(lock);
+  if (wal.isOpen()) {
+    wal.close();
+  }
+  for (SegmentList::iterator i = segments.begin(); i != segments.end(); i++) {
+    FileUtil::close((*i)->fd);
+    delete *i;
+  }
+  segments.clear();
+  memtable.clear();
+  memtableBytes = 0;
+} // close
+
+LogStructuredStore::Segment* LogStructuredStore::loadSegment(uint64_t seq, const std::string& path) throw(IOException) {
+  Segment* s = new Segment();
+  s->seq = seq;
+  s->path = path;
+  s->fd = FileUtil::open(path, O_RDONLY);
+  try {
+    struct stat sbuf;
+    FileUtil::fstat(s->fd, sbuf);
+    SegmentFooter footer;
+    if ((size_t)sbuf.st_size < sizeof(footer)) {
+      throw ReadException("LogStructuredStore: truncated segment " + path);
+    }
+    preadFully(s->fd, (char*)&footer, sizeof(footer), sbuf.st_size - sizeof(footer), path);
+    if (footer.magic != SEGMENT_MAGIC || footer.indexOffset > sbuf.st_size - sizeof(footer)) {
+      throw ReadException("LogStructuredStore: corrupt segment " + path);
+    }
+    s->covers = footer.covers;
+    s->count = footer.count;
+    s->dataEnd = footer.indexOffset;
+
+    std::string buf(sbuf.st_size - sizeof(footer) - footer.indexOffset, '\0');
+    if (!buf.empty()) {
+      preadFully(s->fd, &buf[0], buf.size(), footer.indexOffset, path);
+    }
+    size_t pos = 0;
+    for (uint64_t i = 0; i < footer.indexCount; i++) {
+      uint32_t klen;
+      uint64_t offset;
+      if (pos + sizeof(klen) > buf.size()) {
+        throw ReadException("LogStructuredStore: corrupt index in " + path);
+      }
+      memcpy(&klen, buf.data() + pos, sizeof(klen));
+      pos += sizeof(klen);
+      if (pos + klen + sizeof(offset) > buf.size()) {
+        throw ReadException("LogStructuredStore: corrupt index in " + path);
+      }
+      std::string key(buf, pos, klen);
+      pos += klen;
+      memcpy(&offset, buf.data() + pos, sizeof(offset));
+      pos += sizeof(offset);
+      s->index.push_back(std::make_pair(key, offset));
+    }
+  }
+  catch (const IOException& e) {
+    FileUtil::close(s->fd);
+    delete s;
+    throw;
+  }
+  return s;
+} // loadSegment
+
+void LogStructuredStore::apply(const std::string& key, const std::string& value, bool deleted) {
+  Entry& e = memtable[key];
+  e.value = value;
+  e.deleted = deleted;
+  memtableBytes += key.size() + value.size();
+} // apply
+
+void LogStructuredStore::write(const std::string& key, const std::string& value, bool deleted) {
+  std::string record;
+  record.reserve(1 + sizeof(uint32_t) + key.size() + value.size());
+  record.push_back(deleted ? LOG_ERASE : LOG_PUT);
+  appendU32(record, key.size());
+  record.append(key);
+  record.append(value);
+
+  ScopedLock sl(lock);
+  uint64_t lsn = wal.append(record);
+  apply(key, value, deleted);
+  if (syncWrites) {
+    wal.sync(lsn);
+  }
+  if (memtableBytes >= memtableSize) {
+    flushMemtableLocked();
+  }
+} // write
+
+void LogStructuredStore::put(const std::string& key, const std::string& value) {
+  write(key, value, false);
+} // put
+
+void LogStructuredStore::erase(const std::string& key) {
+  write(key, "", true);
+} // erase
+
+bool LogStructuredStore::get(const std::string& key, std::string& value) const {
+  ScopedLock sl(lock);
+  return getLocked(key, value);
+} // get
+
+bool LogStructuredStore::getLocked(const std::string& key, std::string& value) const {
+  Memtable::const_iterator m = memtable.find(key);
+  if (m != memtable.end()) {
+    if (m->second.deleted) {
+      return false;
+    }
+    value = m->second.value;
+    return true;
+  }
+
+  std::string block, k, v;
+  for (SegmentList::const_iterator i = segments.begin(); i != segments.end(); i++) {
+    const Segment& s = **i;
+    std::vector<std::pair<std::string, uint64_t> >::const_iterator b =
+      std::upper_bound(s.index.begin(), s.index.end(), std::make_pair(key, UINT64_MAX));
+    if (b == s.index.begin()) {
+      continue;
+    }
+    s.readBlock(b - s.index.begin() - 1, block);
+    size_t pos = 0;
+    bool deleted;
+    while (parseEntry(block, pos, k, v, deleted)) {
+      if (k == key) {
+        if (deleted) {
+          return false;
+        }
+        value = v;
+        return true;
+      }
+      if (key < k) {
+        break;
+      }
+    }
+  }
+  return false;
+} // getLocked
+
+void LogStructuredStore::scan(const std::string& first, const std::string& last, Visitor& visitor) const {
+  ScopedLock sl(lock);
+  MergeCursor merge;
+  merge.add(new MemtableCursor(memtable, first));
+  for (SegmentList::const_iterator i = segments.begin(); i != segments.end(); i++) {
+    merge.add(new SegmentCursor(**i, first));
+  }
+  while (merge.next()) {
+    const Cursor& c = merge.get();
+    if (!last.empty() && c.key() >= last) {
+      return;
+    }
+    if (!c.deleted() && !visitor.visit(c.key(), c.value())) {
+      return;
+    }
+  }
+} // scan
+
+uint64_t LogStructuredStore::approximateCount() const {
+  ScopedLock sl(lock);
+  uint64_t n = memtable.size();
+  for (SegmentList::const_iterator i = segments.begin(); i != segments.end(); i++) {
+    n += (*i)->count;
+  }
+  return n;
+} // approximateCount
+
+void LogStructuredStore::flush() {
+  wal.sync();
+} // flush
+
+void LogStructuredStore::flushMemtable() throw(IOException) {
+  ScopedLock sl(lock);
+  flushMemtableLocked();
+} // flushMemtable
+
+void LogStructuredStore::flushMemtableLocked() throw(IOException) {
+  ADD_SELECTORS("LogStructuredStore::flushMemtable");
+  if (memtable.empty()) {
+    return;
+  }
+  uint64_t lsn = wal.getLastLSN();
+  uint64_t seq = nextSeq++;
+  std::string path = segmentPath(seq);
+  SegmentWriter writer(path + ".tmp");
+  // tombstones are kept, since older segments may still hold the key
+  for (Memtable::const_iterator i = memtable.begin(); i != memtable.end(); i++) {
+    writer.add(i->first, i->second.value, i->second.deleted);
+  }
+  writer.finish(0);
+  FileUtil::rename(path + ".tmp", path);
+  int dfd = FileUtil::open(dir, O_RDONLY);
+  fsync(dfd);
+  FileUtil::close(dfd);
+
+  segments.insert(segments.begin(), loadSegment(seq, path));
+  macedbg(1) << "flushed " << memtable.size() << " keys to " << path << Log::endl;
+  memtable.clear();
+  memtableBytes = 0;
+  wal.checkpoint(lsn, "");
+
+  if (segments.size() > maxSegments) {
+    compactLocked();
+  }
+} // flushMemtableLocked
+
+void LogStructuredStore::compact() throw(IOException) {
+  ScopedLock sl(lock);
+  compactLocked();
+} // compact
+
+void LogStructuredStore::compactLocked() throw(IOException) {
+  ADD_SELECTORS("LogStructuredStore::compact");
+  if (segments.size() < 2) {
+    return;
+  }
+  uint64_t seq = nextSeq++;
+  std::string path = segmentPath(seq);
+  {
+    SegmentWriter writer(path + ".tmp");
+    MergeCursor merge;
+    for (SegmentList::const_iterator i = segments.begin(); i != segments.end(); i++) {
+      merge.add(new SegmentCursor(**i, ""));
+    }
+    // the merge covers the oldest segment, so tombstones have nothing left to hide
+    while (merge.next()) {
+      const Cursor& c = merge.get();
+      if (!c.deleted()) {
+        writer.add(c.key(), c.value(), false);
+      }
+    }
+    writer.finish(segments.front()->seq);
+  }
+  FileUtil::rename(path + ".tmp", path);
+  int dfd = FileUtil::open(dir, O_RDONLY);
+  fsync(dfd);
+  FileUtil::close(dfd);
+
+  Segment* merged = loadSegment(seq, path);
+  for (SegmentList::iterator i = segments.begin(); i != segments.end(); i++) {
+    FileUtil::close((*i)->fd);
+    FileUtil::unlink((*i)->path);
+    delete *i;
+  }
+  segments.clear();
+  segments.push_back(merged);
+  maceout << "compacted into " << path << " with " << merged->count << " keys" << Log::endl;
+} // compactLocked
+
+size_t LogStructuredStore::getSegmentCount() const {
+  ScopedLock sl(lock);
+  return segments.size();
+} // getSegmentCount
+
+}
@@ -0,0 +1,156 @@
+/* 
+ * LogStructuredStore.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _LOG_STRUCTURED_STORE_H
+#define _LOG_STRUCTURED_STORE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Exception.h"
+#include "KeyValueStore.h"
+#include "WriteAheadLog.h"
+
+/**
+ * \file LogStructuredStore.h
+ * \brief declares the LogStructuredStore on-disk KeyValueStore engine
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief log-structured KeyValueStore engine.
+ *
+ * Writes go to a WriteAheadLog and to an in-memory sorted memtable.  Once the
+ * memtable passes the flush threshold it is written out as an immutable sorted
+ * segment file (<tt>seg.<seq>.sst</tt>) and the log is checkpointed past it.
+ * Each segment carries a sparse index with one key per data block, which is
+ * kept in memory, so a point lookup reads at most one block per segment.
+ * Lookups check the memtable and then the segments from newest to oldest;
+ * erase() writes a tombstone that hides older values.  Scans merge the
+ * memtable and every segment in key order.
+ *
+ * When there are more than the maximum number of segments they are all
+ * compacted into one, which drops tombstones and overwritten values.
+ *
+ * By default put() and erase() only buffer the log record, and flush() makes
+ * them durable; pass \c syncWrites to sync the log on every write instead.
+ * All methods are thread safe, but a scan Visitor must not call back into the
+ * store.
+ */
+class LogStructuredStore : public KeyValueStore {
+public:
+  static const uint64_t DEFAULT_MEMTABLE_SIZE = 4*1024*1024;
+  static const uint32_t DEFAULT_MAX_SEGMENTS = 4;
+  static const uint32_t BLOCK_SIZE = 4096;
+
+  LogStructuredStore(const std::string& dir, uint64_t memtableSize = DEFAULT_MEMTABLE_SIZE,
+                     uint32_t maxSegments = DEFAULT_MAX_SEGMENTS, bool syncWrites = false);
+  virtual ~LogStructuredStore();
+
+  /// creates the directory if needed, loads the segment indexes and replays the log
+  void open() throw(IOException);
+  void close();
+
+  bool get(const std::string& key, std::string& value) const;
+  void put(const std::string& key, const std::string& value);
+  void erase(const std::string& key);
+  void scan(const std::string& first, const std::string& last, Visitor& visitor) const;
+  using KeyValueStore::scan;
+  uint64_t approximateCount() const;
+  void flush();
+
+  /// writes the memtable out as a new segment
+  void flushMemtable() throw(IOException);
+  /// merges every segment into one
+  void compact() throw(IOException);
+
+  size_t getSegmentCount() const;
+  const std::string& getDirectory() const { return dir; }
+
+  /// memtable value, with \c deleted set for a tombstone
+  struct Entry {
+    std::string value;
+    bool deleted;
+    Entry() : deleted(false) { }
+    Entry(const std::string& value, bool deleted) : value(value), deleted(deleted) { }
+  };
+  typedef std::map<std::string, Entry> Memtable;
+
+  /// an immutable sorted segment file and its in-memory block index
+  struct Segment {
+    uint64_t seq;
+    uint64_t covers;
+    uint64_t count;
+    uint64_t dataEnd;
+    std::string path;
+    int fd;
+    std::vector<std::pair<std::string, uint64_t> > index;
+    Segment() : seq(0), covers(0), count(0), dataEnd(0), fd(-1) { }
+    /// reads the data block \c i into \c block
+    void readBlock(size_t i, std::string& block) const throw(IOException);
+  };
+  typedef std::vector<Segment*> SegmentList;
+
+private:
+  void apply(const std::string& key, const std::string& value, bool deleted);
+  void write(const std::string& key, const std::string& value, bool deleted);
+  bool getLocked(const std::string& key, std::string& value) const;
+  std::string segmentPath(uint64_t seq) const;
+  Segment* loadSegment(uint64_t seq, const std::string& path) throw(IOException);
+  void flushMemtableLocked() throw(IOException);
+  void compactLocked() throw(IOException);
+
+  const std::string dir;
+  const uint64_t memtableSize;
+  const uint32_t maxSegments;
+  const bool syncWrites;
+  WriteAheadLog wal;
+  Memtable memtable;
+  uint64_t memtableBytes;
+  /// segments ordered from newest to oldest
+  SegmentList segments;
+  uint64_t nextSeq;
+  mutable pthread_mutex_t lock;
+}; // LogStructuredStore
+
+/** @} */
+
+}
+
+#endif // _LOG_STRUCTURED_STORE_H
@@ -58,7 +58,7 @@ namespace mace {
       static MonotoneTimeImpl* mt;
 
       virtual MonotoneTime getTime() {
-        return TimeUtil::timeu();
+        return TimeUtil::monotimeu();
       }
 
       virtual ~MonotoneTimeImpl() {
@@ -0,0 +1,239 @@
+/* 
+ * MessageDispatch.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _MACE_MESSAGE_DISPATCH_H
+#define _MACE_MESSAGE_DISPATCH_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <new>
+
+#include "Message.h"
+#include "ScopedLock.h"
+
+/**
+ * \file MessageDispatch.h
+ * \brief declares the MessageDispatchTable and MessagePool used by generated services
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief table of handlers indexed by message type number.
+ *
+ * Generated services build one of these per dispatcher (async events,
+ * broadcast events, routines, method deserialization) the first time it
+ * runs, so dispatching a message is one indexed load and an indirect call
+ * rather than a switch over every message the service declares.  Types
+ * without a handler map to NULL.
+ */
+template<typename F>
+class MessageDispatchTable {
+public:
+  static const unsigned SIZE = 256;
+
+  MessageDispatchTable() {
+    for (unsigned i = 0; i < SIZE; i++) {
+      handlers[i] = NULL;
+    }
+  }
+
+  void set(uint8_t type, F handler) { handlers[type] = handler; }
+  F get(uint8_t type) const { return handlers[type]; }
+
+private:
+  F handlers[SIZE];
+}; // MessageDispatchTable
+
+/// factory for a message of type \c T, as registered in method deserialization tables
+template<class T>
+Message* newMessage() {
+  return new T;
+}
+
+/**
+ * \brief free list of blocks sized for one type, used as the class
+ * allocator of generated messages and their field stores.
+ *
+ * A message deserialized for one delivery reuses the memory of one deleted
+ * after an earlier delivery instead of going back to the heap.  Each thread
+ * keeps up to LOCAL_FREE blocks of its own, so the common allocate/release
+ * pair takes no lock.  A thread whose list is full moves half of it to a
+ * shared overflow list, and a thread whose list is empty takes a batch back
+ * from there, so blocks released by the transport threads still feed the
+ * threads that allocate.  When a thread exits, a pthread key destructor
+ * moves its list to the overflow list.  At most MAX_FREE blocks are held by
+ * one thread and the overflow list together; beyond that blocks are freed.
+ * Requests of any other size (from a derived class) bypass the pool.
+ */
+template<class T>
+class MessagePool {
+public:
+  static const size_t MAX_FREE = 1024;
+  static const size_t LOCAL_FREE = 64;
+
+  static void* allocate(size_t size) {
+    if (pooled(size)) {
+      if (localHead == NULL) {
+        refill();
+      }
+      if (localHead != NULL) {
+        Block* b = localHead;
+        localHead = b->next;
+        localCount--;
+        return b;
+      }
+    }
+    return ::operator new(size);
+  }
+
+  static void release(void* p, size_t size) {
+    if (p == NULL) {
+      return;
+    }
+    if (pooled(size) && (localCount < LOCAL_FREE || spill())) {
+      track();
+      Block* b = static_cast<Block*>(p);
+      b->next = localHead;
+      localHead = b;
+      localCount++;
+      return;
+    }
+    ::operator delete(p);
+  }
+
+  /// number of blocks held for reuse by the calling thread and the overflow list
+  static size_t size() {
+    ScopedLock sl(lock);
+    return localCount + count;
+  }
+
+private:
+  struct Block {
+    Block* next;
+  };
+
+  static bool pooled(size_t size) {
+    return size == sizeof(T) && sizeof(T) >= sizeof(Block);
+  }
+
+  /// moves up to half a local list from the overflow list to this thread
+  static void refill() {
+    track();
+    ScopedLock sl(lock);
+    while (head != NULL && localCount < LOCAL_FREE / 2) {
+      Block* b = head;
+      head = b->next;
+      count--;
+      b->next = localHead;
+      localHead = b;
+      localCount++;
+    }
+  }
+
+  /// moves half of this thread's list to the overflow list, returning false if it is full
+  static bool spill() {
+    ScopedLock sl(lock);
+    size_t moved = 0;
+    while (moved < LOCAL_FREE / 2 && count < MAX_FREE - LOCAL_FREE) {
+      Block* b = localHead;
+      localHead = b->next;
+      localCount--;
+      b->next = head;
+      head = b;
+      count++;
+      moved++;
+    }
+    return moved > 0;
+  }
+
+  /// registers the calling thread's list to be flushed when the thread exits
+  static void track() {
+    if (!tracked) {
+      pthread_once(&keyOnce, createKey);
+      pthread_setspecific(key, &localHead);
+      tracked = true;
+    }
+  }
+
+  static void createKey() {
+    pthread_key_create(&key, flush);
+  }
+
+  /// key destructor: moves the exiting thread's list to the overflow list
+  static void flush(void*) {
+    ScopedLock sl(lock);
+    while (localHead != NULL) {
+      Block* b = localHead;
+      localHead = b->next;
+      localCount--;
+      if (count < MAX_FREE - LOCAL_FREE) {
+        b->next = head;
+        head = b;
+        count++;
+      }
+      else {
+        ::operator delete(b);
+      }
+    }
+    tracked = false;
+  }
+
+  static pthread_mutex_t lock;
+  static Block* head;
+  static size_t count;
+  static pthread_once_t keyOnce;
+  static pthread_key_t key;
+  static __thread Block* localHead;
+  static __thread size_t localCount;
+  static __thread bool tracked;
+}; // MessagePool
+
+template<class T> const size_t MessagePool<T>::MAX_FREE;
+template<class T> const size_t MessagePool<T>::LOCAL_FREE;
+template<class T> pthread_mutex_t MessagePool<T>::lock = PTHREAD_MUTEX_INITIALIZER;
+template<class T> typename MessagePool<T>::Block* MessagePool<T>::head = NULL;
+template<class T> size_t MessagePool<T>::count = 0;
+template<class T> pthread_once_t MessagePool<T>::keyOnce = PTHREAD_ONCE_INIT;
+template<class T> pthread_key_t MessagePool<T>::key;
+template<class T> __thread typename MessagePool<T>::Block* MessagePool<T>::localHead = NULL;
+template<class T> __thread size_t MessagePool<T>::localCount = 0;
+template<class T> __thread bool MessagePool<T>::tracked = false;
+
+/** @} */
+
+}
+
+#endif // _MACE_MESSAGE_DISPATCH_H
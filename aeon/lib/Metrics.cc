@@ -0,0 +1,264 @@
+/* 
+ * Metrics.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <string.h>
+#include <sstream>
+
+#include "maceConfig.h"
+#include "Accumulator.h"
+#include "mace-macros.h"
+#include "Metrics.h"
+#include "ScopedLock.h"
+#include "SysUtil.h"
+#include "ThreadCreate.h"
+#include "TimeUtil.h"
+
+namespace {
+  unsigned nextShard = 0;
+  __thread unsigned threadShard = 0;
+}
+
+namespace mace {
+
+const std::string Metrics::NETWORK_READ = "NETWORK_READ";
+const std::string Metrics::TCP_WRITE = "TCP_WRITE";
+const std::string Metrics::ASYNC_EVENT_LIFE_TIME = "ASYNC_EVENT_LIFE_TIME";
+const std::string Metrics::MIGRATION_EVENT_LIFE_TIME = "MIGRATION_EVENT_LIFE_TIME";
+
+Metrics::CounterMap Metrics::counters;
+Metrics::HistogramMap Metrics::histograms;
+pthread_mutex_t Metrics::mlock = PTHREAD_MUTEX_INITIALIZER;
+bool Metrics::isLogging = false;
+pthread_t Metrics::mthread;
+
+unsigned metricsShard() {
+  if (threadShard == 0) {
+    threadShard = __sync_add_and_fetch(&nextShard, 1);
+  }
+  return threadShard;
+} // metricsShard
+
+Counter::Counter(const std::string& name) :
+  name(name), logId(Log::getId("Accumulator::" + name)), lastLogged(0) {
+  memset(shards, 0, sizeof(shards));
+} // Counter
+
+uint64_t Counter::get() const {
+  uint64_t r = 0;
+  for (unsigned i = 0; i < SHARDS; i++) {
+    r += shards[i].value;
+  }
+  return r;
+} // get
+
+Histogram::Histogram(const std::string& name) :
+  name(name), logId(Log::getId("Accumulator::" + name)) {
+  memset(shards, 0, sizeof(shards));
+} // Histogram
+
+uint64_t Histogram::bucketLow(unsigned b) {
+  unsigned group = b >> SUB_BUCKET_BITS;
+  if (group == 0) {
+    return b;
+  }
+  return (uint64_t)(SUB_BUCKETS + (b & (SUB_BUCKETS - 1))) << (group - 1);
+} // bucketLow
+
+uint64_t Histogram::bucketHigh(unsigned b) {
+  if (b == BUCKETS - 1) {
+    return UINT64_MAX;
+  }
+  return bucketLow(b + 1) - 1;
+} // bucketHigh
+
+void Histogram::snapshot(std::vector<uint64_t>& counts) const {
+  counts.assign(BUCKETS, 0);
+  for (unsigned s = 0; s < SHARDS; s++) {
+    for (unsigned b = 0; b < BUCKETS; b++) {
+      counts[b] += shards[s].counts[b];
+    }
+  }
+} // snapshot
+
+uint64_t Histogram::getCount() const {
+  uint64_t r = 0;
+  for (unsigned s = 0; s < SHARDS; s++) {
+    for (unsigned b = 0; b < BUCKETS; b++) {
+      r += shards[s].counts[b];
+    }
+  }
+  return r;
+} // getCount
+
+uint64_t Histogram::getSum() const {
+  uint64_t r = 0;
+  for (unsigned s = 0; s < SHARDS; s++) {
+    r += shards[s].sum;
+  }
+  return r;
+} // getSum
+
+double Histogram::getMean() const {
+  uint64_t count = getCount();
+  return count == 0 ? 0.0 : (double)getSum() / count;
+} // getMean
+
+uint64_t Histogram::percentile(double p) const {
+  std::vector<uint64_t> counts;
+  snapshot(counts);
+  uint64_t total = 0;
+  for (unsigned b = 0; b < BUCKETS; b++) {
+    total += counts[b];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  // rank of the requested value, counting from 1
+  uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (unsigned b = 0; b < BUCKETS; b++) {
+    seen += counts[b];
+    if (seen >= rank) {
+      return bucketHigh(b);
+    }
+  }
+  return bucketHigh(BUCKETS - 1);
+} // percentile
+
+uint64_t Histogram::getMax() const {
+  std::vector<uint64_t> counts;
+  snapshot(counts);
+  for (unsigned b = BUCKETS; b > 0; b--) {
+    if (counts[b - 1] > 0) {
+      return bucketHigh(b - 1);
+    }
+  }
+  return 0;
+} // getMax
+
+void Histogram::reset() {
+  memset(shards, 0, sizeof(shards));
+} // reset
+
+Counter* Metrics::counter(const std::string& name) {
+  ScopedLock sl(mlock);
+  CounterMap::iterator i = counters.find(name);
+  if (i != counters.end()) {
+    return i->second;
+  }
+  Counter* c = new Counter(name);
+  counters[name] = c;
+  return c;
+} // counter
+
+Histogram* Metrics::histogram(const std::string& name) {
+  ScopedLock sl(mlock);
+  HistogramMap::iterator i = histograms.find(name);
+  if (i != histograms.end()) {
+    return i->second;
+  }
+  Histogram* h = new Histogram(name);
+  histograms[name] = h;
+  return h;
+} // histogram
+
+void Metrics::dumpAll() {
+  ADD_SELECTORS("Metrics::dumpAll");
+  ScopedLock sl(mlock);
+  for (CounterMap::const_iterator i = counters.begin(); i != counters.end(); i++) {
+    maceLog("accumulator %s amount %" PRIu64, i->first.c_str(), i->second->get());
+  }
+  for (HistogramMap::const_iterator i = histograms.begin(); i != histograms.end(); i++) {
+    const Histogram* h = i->second;
+    maceLog("histogram %s count %" PRIu64 " mean %.1f p50 %" PRIu64 " p99 %" PRIu64
+            " p999 %" PRIu64 " max %" PRIu64, i->first.c_str(), h->getCount(), h->getMean(),
+            h->percentile(50), h->percentile(99), h->percentile(99.9), h->getMax());
+  }
+} // dumpAll
+
+void Metrics::logAll() {
+  ScopedLock sl(mlock);
+  logAllLocked(false);
+} // logAll
+
+void Metrics::logAllLocked(bool resetCounterDiffs) {
+  for (CounterMap::iterator i = counters.begin(); i != counters.end(); i++) {
+    Counter* c = i->second;
+    uint64_t total = c->get();
+    // same record as Accumulator::logAll, so existing log readers keep working
+    Log::binaryLog(c->logId, AccumulatorLogObject(c->name, total, total - c->lastLogged));
+    if (resetCounterDiffs) {
+      c->lastLogged = total;
+    }
+  }
+  for (HistogramMap::const_iterator i = histograms.begin(); i != histograms.end(); i++) {
+    const Histogram* h = i->second;
+    Log::log(h->logId) << "count=" << h->getCount() << " mean=" << h->getMean()
+                       << " p50=" << h->percentile(50) << " p99=" << h->percentile(99)
+                       << " p999=" << h->percentile(99.9) << Log::endl;
+  }
+} // logAllLocked
+
+void* Metrics::startLoggingThread(void* arg) {
+  uint64_t interval = *(uint64_t*)arg;
+
+  while (isLogging) {
+    SysUtil::sleepu(interval);
+    ScopedLock sl(mlock);
+    logAllLocked(true);
+  }
+
+  return 0;
+} // startLoggingThread
+
+void Metrics::startLogging(uint64_t interval) {
+  static uint64_t sint = 0;
+  ScopedLock sl(mlock);
+  if (isLogging) {
+    return;
+  }
+  isLogging = true;
+  sint = interval;
+  pthread_attr_t threadAttr;
+  pthread_attr_init(&threadAttr);
+  pthread_attr_setdetachstate(&threadAttr, PTHREAD_CREATE_JOINABLE);
+
+  runNewThread(&mthread, Metrics::startLoggingThread, &sint, &threadAttr);
+} // startLogging
+
+void Metrics::stopLogging() {
+  isLogging = false;
+} // stopLogging
+
+}
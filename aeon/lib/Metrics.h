@@ -0,0 +1,208 @@
+/* 
+ * Metrics.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _MACE_METRICS_H
+#define _MACE_METRICS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Log.h"
+
+/**
+ * \file Metrics.h
+ * \brief declares the sharded Counter and Histogram metrics and their Metrics registry
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/// index of the calling thread's shard, assigned round robin on first use
+unsigned metricsShard();
+
+/**
+ * \brief counter sharded across threads so concurrent add() calls do not
+ * contend on a lock or a cache line.
+ *
+ * Obtain one from Metrics::counter() once and keep the pointer; add() is an
+ * atomic increment of the calling thread's shard and get() sums the shards.
+ */
+class Counter {
+public:
+  static const unsigned SHARDS = 32;
+
+  void add(uint64_t amount) {
+    __sync_fetch_and_add(&shards[metricsShard() % SHARDS].value, amount);
+  }
+  void increment() { add(1); }
+  /// sum over all shards; concurrent adds may or may not be included
+  uint64_t get() const;
+  const std::string& getName() const { return name; }
+
+private:
+  friend class Metrics;
+  /// one cache line per shard
+  struct Shard {
+    uint64_t value;
+    char pad[64 - sizeof(uint64_t)];
+  };
+
+  Counter(const std::string& name);
+
+  const std::string name;
+  log_id_t logId;
+  uint64_t lastLogged;
+  Shard shards[SHARDS];
+}; // Counter
+
+/**
+ * \brief log-bucketed histogram of non-negative values, such as latencies
+ * in microseconds, reporting percentiles without storing samples.
+ *
+ * Like an HDR histogram, each power of two is split into 2^SUB_BUCKET_BITS
+ * linear buckets, so a percentile is within 1/16 of the true value.  Values
+ * of 2^MAX_BITS and above fall in the last bucket.  Each thread records into
+ * its own shard of bucket counts, so record() takes no lock.
+ */
+class Histogram {
+public:
+  static const unsigned SUB_BUCKET_BITS = 4;
+  static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const unsigned MAX_BITS = 40;
+  static const unsigned BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+  static const unsigned SHARDS = 8;
+
+  void record(uint64_t value) {
+    Shard& s = shards[metricsShard() % SHARDS];
+    __sync_fetch_and_add(&s.counts[bucketFor(value)], 1);
+    __sync_fetch_and_add(&s.sum, value);
+  }
+
+  uint64_t getCount() const;
+  uint64_t getSum() const;
+  double getMean() const;
+  /// the value below which \c p percent of the recorded values fall, for p in [0, 100]
+  uint64_t percentile(double p) const;
+  /// upper bound of the highest non-empty bucket
+  uint64_t getMax() const;
+  /// clears every bucket; values recorded concurrently may be lost
+  void reset();
+  const std::string& getName() const { return name; }
+
+  static unsigned bucketFor(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    unsigned e = 63 - __builtin_clzll(value);
+    if (e >= MAX_BITS) {
+      return BUCKETS - 1;
+    }
+    unsigned shift = e - SUB_BUCKET_BITS;
+    return ((shift + 1) << SUB_BUCKET_BITS) + ((value >> shift) & (SUB_BUCKETS - 1));
+  }
+  /// smallest value that falls in bucket \c b
+  static uint64_t bucketLow(unsigned b);
+  /// largest value that falls in bucket \c b
+  static uint64_t bucketHigh(unsigned b);
+
+private:
+  friend class Metrics;
+  struct Shard {
+    uint64_t counts[BUCKETS];
+    uint64_t sum;
+  };
+
+  Histogram(const std::string& name);
+  void snapshot(std::vector<uint64_t>& counts) const;
+
+  const std::string name;
+  log_id_t logId;
+  Shard shards[SHARDS];
+}; // Histogram
+
+/**
+ * \brief registry of named counters and histograms.
+ *
+ * Registration takes a lock and a map lookup, so resolve each metric once
+ * and keep the handle:
+ * \code
+ * static mace::Counter* reads = mace::Metrics::counter(mace::Metrics::NETWORK_READ);
+ * reads->add(r);
+ * \endcode
+ *
+ * startLogging() periodically logs each metric to the selector
+ * "Accumulator::NAME", the one it used as an Accumulator: counters as the
+ * same AccumulatorLogObject records (total and change since the last log),
+ * histograms as their count, mean and p50/p99/p999.
+ */
+class Metrics {
+public:
+  static const std::string NETWORK_READ; ///< bytes read by all transports
+  static const std::string TCP_WRITE; ///< bytes written by TCP transports
+  static const std::string ASYNC_EVENT_LIFE_TIME; ///< usec from creation to commit of async events
+  static const std::string MIGRATION_EVENT_LIFE_TIME; ///< usec from creation to commit of migration events
+
+  /// returns the counter registered as \c name, creating it if needed
+  static Counter* counter(const std::string& name);
+  /// returns the histogram registered as \c name, creating it if needed
+  static Histogram* histogram(const std::string& name);
+
+  static void dumpAll(); ///< prints all metrics to selector "Metrics::dumpAll"
+  static void logAll(); ///< prints all metrics to their own selectors
+  /// begins the logging thread; does nothing if it is already running
+  static void startLogging(uint64_t interval = 1*1000*1000);
+  static void stopLogging();
+
+private:
+  typedef std::map<std::string, Counter*> CounterMap;
+  typedef std::map<std::string, Histogram*> HistogramMap;
+
+  static void* startLoggingThread(void* arg);
+  static void logAllLocked(bool resetCounterDiffs);
+
+  static CounterMap counters;
+  static HistogramMap histograms;
+  static pthread_mutex_t mlock;
+  static bool isLogging;
+  static pthread_t mthread;
+}; // Metrics
+
+/** @} */
+
+}
+
+#endif // _MACE_METRICS_H
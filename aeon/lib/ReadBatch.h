@@ -0,0 +1,78 @@
+/* 
+ * ReadBatch.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+
+/**
+ * \file ReadBatch.h
+ * \brief Declares mace::ReadBatch, which decides when a read-only event may join the readers admitted to a context
+ */
+
+#ifndef _MACE_READBATCH_H
+#define _MACE_READBATCH_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief tracks the run of read-only events admitted to a context ahead of now_serving.
+ *
+ * A reader may join only if the last execute ticket issued went to a reader
+ * admitted through the batch.  Tickets taken any other way (migration,
+ * requireExecuteTicket, events added straight to the order) advance the next
+ * ticket past it, which closes the batch without having to be reported here.
+ */
+class ReadBatch {
+public:
+  ReadBatch() : lastReaderTicket(0) { }
+
+  /// true if a read-only event may be admitted with \c nextTicket while \c nowServing is being served
+  bool canJoin(bool readOnly, uint64_t nextTicket, uint64_t nowServing, uint64_t maxBatch) const {
+    return readOnly && lastReaderTicket != 0 && lastReaderTicket + 1 == nextTicket &&
+      nextTicket - nowServing < maxBatch;
+  }
+
+  /// records that \c ticket was issued through the batch admission path
+  void admitted(uint64_t ticket, bool readOnly) {
+    lastReaderTicket = readOnly ? ticket : 0;
+  }
+
+private:
+  uint64_t lastReaderTicket;
+}; // ReadBatch
+
+/** @} */
+
+}
+#endif // _MACE_READBATCH_H
@@ -34,6 +34,7 @@
 #include "ThreadStructure.h"
 
 #include "mace.h"
+#include "EventTrace.h"
 
 Scheduler* Scheduler::scheduler = 0;
 
@@ -60,6 +61,7 @@ void Scheduler::haltScheduler() {
       assert(pthread_join(scheduler->schedulerThread, NULL) == 0);
     }
   }
+  mace::EventTrace::flush();
   Log::flush();
 } // haltScheduler
 
@@ -67,7 +69,7 @@ uint64_t Scheduler::schedule(TimerHandler& timer, uint64_t time, bool abs) {
   ADD_SELECTORS("Scheduler::schedule");
   ScopedLock sl(slock);
   if (!abs) {
-    time += TimeUtil::timeu();
+    time += TimeUtil::monotimeu();
   }
 
   //   maceout << "scheduling " << timer.getId() << " for " << time << Log::endl;
@@ -127,7 +129,7 @@ void Scheduler::runSchedulerThread() {
       sig.wait();
       continue;
     }
-    uint64_t now = TimeUtil::timeu();
+    uint64_t now = TimeUtil::monotimeu();
     uint64_t sleeptime = next - now;
 //     macedbg(1) << "now=" << now << " sleeptime=" << sleeptime << " next=" << next << Log::endl;
     if ((now + CLOCK_RESOLUTION) > next) {
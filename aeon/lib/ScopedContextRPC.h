@@ -9,6 +9,7 @@
 #include "m_map.h"
 #include "mstring.h"
 #include "ThreadStructure.h"
+#include "Coroutine.h"
 namespace mace{
 /**
  * \brief provides a scoped RPC mechanism
@@ -32,14 +33,17 @@ namespace mace{
  * uint32_t rv = 1;
  * mace::ScopedContextRPC::wakeupWithValue( srcContextID, rv );
  * \endcode
+ *
+ * A caller running in a Coroutine does not block its thread: it yields, and
+ * the wakeup schedules the coroutine to be resumed.
  * */
 class ScopedContextRPC{
 public:
-  ScopedContextRPC():isReturned(false),eventId(ThreadStructure::myEventID()){
+  ScopedContextRPC():isReturned(false),eventId(ThreadStructure::myEventID()),coroutine(Coroutine::current()){
     ADD_SELECTORS("ScopedContextRPC::(constructor)");
     pthread_cond_init( &cond , NULL );
     pthread_mutex_lock(&awaitingReturnMutex);
-    awaitingReturnMapping[eventId].push_back( &cond );
+    awaitingReturnMapping[eventId].push_back( this );
     macedbg(1)<<"event "<< eventId << " will be waiting for RPC return"<<Log::endl;
   }
   ~ScopedContextRPC(){
@@ -55,7 +59,7 @@ public:
         returnValueMapping.erase( retvalIt );
       }
     }
-    std::map< mace::OrderID, std::vector< pthread_cond_t* > >::iterator condIt = awaitingReturnMapping.find( eventId );
+    std::map< mace::OrderID, std::vector< ScopedContextRPC* > >::iterator condIt = awaitingReturnMapping.find( eventId );
     condIt->second.pop_back();
     if( condIt->second.empty() ){
       awaitingReturnMapping.erase( condIt );
@@ -81,21 +85,21 @@ public:
     ADD_SELECTORS("ScopedContextRPC::wakeup");
     macedbg(1)<<"wake up event "<< eventId << " with no return value"<<Log::endl;
     pthread_mutex_lock(&awaitingReturnMutex);
-    std::map< mace::OrderID, std::vector< pthread_cond_t* > >::iterator cond_iter = awaitingReturnMapping.find( eventId );
+    std::map< mace::OrderID, std::vector< ScopedContextRPC* > >::iterator cond_iter = awaitingReturnMapping.find( eventId );
     ASSERTMSG( cond_iter != awaitingReturnMapping.end(), "Conditional variable not found" );
     ASSERTMSG( !cond_iter->second.empty(), "Conditional variable not found due to empty stack" );
-    pthread_cond_signal( cond_iter->second.back() );
+    cond_iter->second.back()->signal();
     pthread_mutex_unlock(&awaitingReturnMutex);
   }
   static void wakeupWithValue( const mace::OrderID& eventId, const mace::string& retValue ){
     ADD_SELECTORS("ScopedContextRPC::wakeupWithValue");
     macedbg(1)<<"wake up event "<< eventId << " with return value"<<Log::endl;
     pthread_mutex_lock(&awaitingReturnMutex);
-    std::map< mace::OrderID, std::vector< pthread_cond_t* > >::iterator cond_iter = awaitingReturnMapping.find( eventId );
+    std::map< mace::OrderID, std::vector< ScopedContextRPC* > >::iterator cond_iter = awaitingReturnMapping.find( eventId );
     ASSERTMSG( cond_iter != awaitingReturnMapping.end(), "Conditional variable not found" );
     ASSERTMSG( !cond_iter->second.empty(), "Conditional variable not found due to empty stack" );
     returnValueMapping[ eventId ].push_back( retValue );
-    pthread_cond_signal( cond_iter->second.back() );
+    cond_iter->second.back()->signal();
     pthread_mutex_unlock(&awaitingReturnMutex);
   }
   static void wakeupWithValue( const mace::string& retValue, mace::Event const& event ){
@@ -104,12 +108,12 @@ public:
     mace::string event_str;
     mace::serialize( event_str, &event );
     pthread_mutex_lock(&awaitingReturnMutex);
-    std::map< mace::OrderID, std::vector< pthread_cond_t* > >::iterator cond_iter = awaitingReturnMapping.find( event.getEventID() );
+    std::map< mace::OrderID, std::vector< ScopedContextRPC* > >::iterator cond_iter = awaitingReturnMapping.find( event.getEventID() );
     ASSERTMSG( cond_iter != awaitingReturnMapping.end(), "Conditional variable not found" );
     ASSERTMSG( !cond_iter->second.empty(), "Conditional variable not found due to empty stack" );
     returnValueMapping[ event.getEventID() ].push_back( retValue );
     returnValueMapping[ event.getEventID() ].back().append( event_str );
-    pthread_cond_signal( cond_iter->second.back() );
+    cond_iter->second.back()->signal();
     pthread_mutex_unlock(&awaitingReturnMutex);
   }
   static void setTransportThreads(uint32_t threads ){
@@ -118,24 +122,54 @@ public:
   static void setAsyncThreads(uint32_t threads ){
     asyncThreads = threads;
   }
+  /// called with true before a caller outside a coroutine blocks its thread, and with false once it is woken
+  typedef void (*BlockingFP)( bool blocking );
+  static void setBlockingHook( BlockingFP hook ){
+    blockingHook = hook;
+  }
 
 private:
   void wait(){
-    pthread_cond_wait( &cond, &awaitingReturnMutex );
+    if( coroutine == NULL ){
+      if( blockingHook != NULL ){
+        blockingHook( true );
+      }
+      pthread_cond_wait( &cond, &awaitingReturnMutex );
+      if( blockingHook != NULL ){
+        blockingHook( false );
+      }
+    }else{
+      // the mutex is released once the coroutine is off the stack, so the wakeup can not resume it early
+      Coroutine::yield( unlockAwaitingReturn, NULL );
+      pthread_mutex_lock(&awaitingReturnMutex);
+    }
+  }
+  // called with awaitingReturnMutex locked
+  void signal(){
+    if( coroutine == NULL ){
+      pthread_cond_signal( &cond );
+    }else{
+      coroutine->schedule();
+    }
+  }
+  static void unlockAwaitingReturn( void* ){
+    pthread_mutex_unlock(&awaitingReturnMutex);
   }
   bool isReturned;
   const mace::OrderID eventId;
+  Coroutine* const coroutine;
   pthread_cond_t cond;
   std::map< mace::OrderID, std::vector< mace::string > >::iterator returnValue_iter;
   std::istringstream in;
 
   static std::map< mace::OrderID, std::vector< mace::string > > returnValueMapping;
-  static std::map< mace::OrderID, std::vector< pthread_cond_t* > > awaitingReturnMapping;
+  static std::map< mace::OrderID, std::vector< ScopedContextRPC* > > awaitingReturnMapping;
   static pthread_mutex_t awaitingReturnMutex;
   static uint32_t waitTransportThreads;
   static uint32_t waitAsyncThreads;
   static uint32_t transportThreads;
   static uint32_t asyncThreads;
+  static BlockingFP blockingHook;
 }; // ScopedContextRPC
 
 }
@@ -65,12 +65,12 @@ public:
    * \param enabled if false the timer does nothing
    */
   ScopedTimer(uint64_t& t, bool enabled = true, TimeList* l = 0) :
-    timer(t), start(enabled ? TimeUtil::timeu() : 0),
+    timer(t), start(enabled ? TimeUtil::monotimeu() : 0),
     enabled(enabled), times(l) { }
   /// on destruction, if enabled, adds the current time - start time to time from contructor.
   ~ScopedTimer() {
     if (enabled) {
-      uint64_t diff = TimeUtil::timeu() - start;
+      uint64_t diff = TimeUtil::monotimeu() - start;
       timer += diff;
       if (times) {
 	times->push_back(diff);
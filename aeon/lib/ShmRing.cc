@@ -0,0 +1,156 @@
+/* 
+ * ShmRing.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <string.h>
+#include "ShmRing.h"
+
+/**
+ * \file ShmRing.cc
+ * \brief Defines a single producer, single consumer message ring in shared memory
+ */
+
+namespace mace {
+
+size_t ShmRing::segmentSize(size_t capacity) {
+  return sizeof(Header) + capacity;
+}
+
+ShmRing::ShmRing(void* base, size_t size, bool initialize) :
+  header((Header*)base), data((char*)base + sizeof(Header)), capacity(size - sizeof(Header)) {
+  if (initialize) {
+    header->head = 0;
+    header->tail = 0;
+    header->capacity = capacity;
+    header->waiting = 0;
+    __sync_synchronize();
+    header->magic = MAGIC;
+  }
+}
+
+bool ShmRing::isValid() const {
+  return header->magic == MAGIC && header->capacity == capacity;
+}
+
+bool ShmRing::fits(size_t len) const {
+  return len + sizeof(uint32_t) <= capacity;
+}
+
+void ShmRing::copyIn(uint64_t pos, const char* buf, size_t len) {
+  size_t offset = pos % capacity;
+  size_t first = (len < capacity - offset) ? len : capacity - offset;
+  memcpy(data + offset, buf, first);
+  memcpy(data, buf + first, len - first);
+}
+
+void ShmRing::copyOut(uint64_t pos, char* buf, size_t len) const {
+  size_t offset = pos % capacity;
+  size_t first = (len < capacity - offset) ? len : capacity - offset;
+  memcpy(buf, data + offset, first);
+  memcpy(buf + first, data, len - first);
+}
+
+bool ShmRing::push(const std::string* const* parts, size_t n, bool& wasEmpty) {
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++) {
+    len += parts[i]->size();
+  }
+  const uint64_t head = header->head;
+  uint64_t tail = header->tail;
+  if (head - tail + sizeof(uint32_t) + len > capacity) {
+    // flag the ring before looking again, so a pop in between either makes
+    // room we see here or sees the flag and wakes us
+    header->waiting = 1;
+    __sync_synchronize();
+    tail = header->tail;
+    if (head - tail + sizeof(uint32_t) + len > capacity) {
+      wasEmpty = false;
+      return false;
+    }
+  }
+
+  uint32_t prefix = len;
+  copyIn(head, (const char*)&prefix, sizeof(prefix));
+  uint64_t pos = head + sizeof(prefix);
+  for (size_t i = 0; i < n; i++) {
+    copyIn(pos, parts[i]->data(), parts[i]->size());
+    pos += parts[i]->size();
+  }
+  // the data must be visible before the new head, and the head before the tail is checked
+  __sync_synchronize();
+  header->head = pos;
+  __sync_synchronize();
+  wasEmpty = (header->tail == head);
+  return true;
+}
+
+bool ShmRing::pop(std::string& msg) throw(ReadException) {
+  const uint64_t tail = header->tail;
+  __sync_synchronize();
+  const uint64_t head = header->head;
+  if (head == tail) {
+    return false;
+  }
+  __sync_synchronize();
+  // the peer owns head and the length prefixes, so neither is trusted
+  const uint64_t used = head - tail;
+  uint32_t len = 0;
+  if (used < sizeof(len) || used > capacity) {
+    throw ReadException("ShmRing: bad write position from peer");
+  }
+  copyOut(tail, (char*)&len, sizeof(len));
+  if (len > used - sizeof(len)) {
+    throw ReadException("ShmRing: message length beyond the pushed data");
+  }
+  msg.resize(len);
+  if (len > 0) {
+    copyOut(tail + sizeof(len), &msg[0], len);
+  }
+  __sync_synchronize();
+  header->tail = tail + sizeof(len) + len;
+  __sync_synchronize();
+  return true;
+}
+
+bool ShmRing::producerWaiting() {
+  // tail was advanced before this look, the mirror of push()
+  __sync_synchronize();
+  if (header->waiting == 0) {
+    return false;
+  }
+  header->waiting = 0;
+  __sync_synchronize();
+  return true;
+}
+
+uint64_t ShmRing::size() const {
+  return header->head - header->tail;
+}
+
+}
@@ -0,0 +1,127 @@
+/* 
+ * ShmRing.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+
+#include "Exception.h"
+
+/**
+ * \file ShmRing.h
+ * \brief Declares a single producer, single consumer message ring in shared memory
+ */
+
+#ifndef _MACE_SHM_RING_H
+#define _MACE_SHM_RING_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief a ring of length-prefixed messages in a memory segment shared by two processes.
+ *
+ * One process pushes and the other pops; neither takes a lock.  The segment
+ * starts with the read and write positions, on separate cache lines,
+ * followed by the data.  push() copies the parts of a message straight into
+ * the ring, and reports whether the ring was empty, which is when the
+ * consumer may have stopped polling and must be woken.  A consumer that
+ * pops until pop() fails never misses a message pushed without a wakeup.
+ * Likewise a push() that finds the ring full leaves a flag that
+ * producerWaiting() reports to the consumer once it has made room.
+ */
+class ShmRing {
+private:
+  struct Header {
+    volatile uint64_t head; ///< bytes written, only advanced by the producer
+    char pad0[56];
+    volatile uint64_t tail; ///< bytes read, only advanced by the consumer
+    char pad1[56];
+    uint64_t capacity;
+    uint32_t magic;
+    volatile uint32_t waiting; ///< set by a producer that found the ring full
+  };
+
+  Header* header;
+  char* data;
+  uint64_t capacity;
+
+  void copyIn(uint64_t pos, const char* buf, size_t len);
+  void copyOut(uint64_t pos, char* buf, size_t len) const;
+
+public:
+  static const uint32_t MAGIC = 0x6d616365;
+
+  /// return the size of a segment holding \c capacity bytes of messages
+  static size_t segmentSize(size_t capacity);
+
+  /**
+   * @param base the mapped segment
+   * @param size the size of the segment
+   * @param initialize true for the process creating the segment, false to attach to it
+   */
+  ShmRing(void* base, size_t size, bool initialize);
+
+  /// false if the segment was not initialized as a ring of its size
+  bool isValid() const;
+  /// true if a message of \c len bytes can ever fit in the ring
+  bool fits(size_t len) const;
+
+  /**
+   * appends the concatenation of \c parts[0..n) as one message.
+   *
+   * @param wasEmpty set if the consumer must be woken
+   * @return false, pushing nothing, if the ring has no room for it now; the
+   * consumer's next producerWaiting() after it pops then returns true
+   */
+  bool push(const std::string* const* parts, size_t n, bool& wasEmpty);
+  /**
+   * removes the oldest message into \c msg.
+   *
+   * @return false if the ring is empty
+   * @throws ReadException if the peer wrote a length beyond what it pushed
+   */
+  bool pop(std::string& msg) throw(ReadException);
+  /// true, once, if a push() failed for lack of room since the last call; call after popping
+  bool producerWaiting();
+
+  /// return the bytes in use, including length prefixes
+  uint64_t size() const;
+  bool empty() const { return size() == 0; }
+};
+
+/** @} */
+
+}
+#endif // _MACE_SHM_RING_H
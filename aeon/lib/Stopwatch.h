@@ -83,12 +83,12 @@ class Stopwatch {
   /// set the start time
   void start() {
     ASSERT(startTime == 0);
-    startTime = TimeUtil::timeu();
+    startTime = TimeUtil::monotimeu();
   }
   /// set a potential stop time
   void mark() {
     ASSERT(startTime != 0);
-    markTime = TimeUtil::timeu();
+    markTime = TimeUtil::monotimeu();
   }
   /// accumulate markTime - startTime on the watch
   void confirm() {
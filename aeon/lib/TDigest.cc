@@ -0,0 +1,226 @@
+/* 
+ * TDigest.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <math.h>
+#include <algorithm>
+
+#include "TDigest.h"
+
+namespace mace {
+
+TDigest::TDigest(double compression) :
+  compression(compression < 10 ? 10 : compression),
+  bufferSize((size_t)(5 * (compression < 10 ? 10 : compression))),
+  total(0), sum(0), min(0), max(0), reverseMerge(false) {
+  buffer.reserve(bufferSize);
+}
+
+void TDigest::update(double value, double weight) {
+  if (weight <= 0) {
+    return;
+  }
+  if (total == 0 || value < min) {
+    min = value;
+  }
+  if (total == 0 || value > max) {
+    max = value;
+  }
+  total += weight;
+  sum += value * weight;
+  buffer.push_back(Centroid(value, weight));
+  if (buffer.size() >= bufferSize) {
+    compress();
+  }
+}
+
+void TDigest::merge(const TDigest& other) {
+  if (other.total == 0) {
+    return;
+  }
+  if (total == 0 || other.min < min) {
+    min = other.min;
+  }
+  if (total == 0 || other.max > max) {
+    max = other.max;
+  }
+  total += other.total;
+  sum += other.sum;
+  buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+  buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+  if (buffer.size() >= bufferSize) {
+    compress();
+  }
+}
+
+void TDigest::reset() {
+  centroids.clear();
+  buffer.clear();
+  total = 0;
+  sum = 0;
+  min = 0;
+  max = 0;
+}
+
+uint64_t TDigest::getCount() const {
+  return (uint64_t)total;
+}
+
+double TDigest::getMin() const {
+  return min;
+}
+
+double TDigest::getMax() const {
+  return max;
+}
+
+double TDigest::getAvg() const {
+  return total == 0 ? 0 : sum / total;
+}
+
+size_t TDigest::getCentroidCount() const {
+  compress();
+  return centroids.size();
+}
+
+double TDigest::limit(double q) const {
+  // scale function k(q) = compression / (2 pi) * asin(2q - 1); a centroid
+  // may grow until k increases by one from where it starts
+  const double k = compression / (2 * M_PI) * asin(2 * q - 1) + 1;
+  if (k >= compression / 4) {
+    return 1;
+  }
+  return (sin(k * 2 * M_PI / compression) + 1) / 2;
+}
+
+void TDigest::compress() const {
+  if (buffer.empty()) {
+    return;
+  }
+  scratch.clear();
+  scratch.insert(scratch.end(), centroids.begin(), centroids.end());
+  scratch.insert(scratch.end(), buffer.begin(), buffer.end());
+  buffer.clear();
+  std::sort(scratch.begin(), scratch.end());
+  // sweeping in the same direction every time biases one tail, so
+  // alternate, as the reference implementation does
+  if (reverseMerge) {
+    std::reverse(scratch.begin(), scratch.end());
+  }
+
+  centroids.clear();
+  Centroid cur = scratch[0];
+  double before = 0;
+  double maxWeight = limit(0) * total;
+  for (size_t i = 1; i < scratch.size(); i++) {
+    const Centroid& c = scratch[i];
+    if (before + cur.weight + c.weight <= maxWeight) {
+      cur.weight += c.weight;
+      cur.mean += (c.mean - cur.mean) * c.weight / cur.weight;
+    }
+    else {
+      before += cur.weight;
+      centroids.push_back(cur);
+      cur = c;
+      maxWeight = limit(before / total) * total;
+    }
+  }
+  centroids.push_back(cur);
+  if (reverseMerge) {
+    std::reverse(centroids.begin(), centroids.end());
+  }
+  reverseMerge = !reverseMerge;
+}
+
+double TDigest::percentileToValue(double percentile) const {
+  compress();
+  if (centroids.empty()) {
+    return 0;
+  }
+  if (percentile <= 0) {
+    return min;
+  }
+  if (percentile >= 1) {
+    return max;
+  }
+
+  // each centroid's mean is taken to sit at the middle of its weight, and
+  // values are interpolated linearly between neighbouring centroids, and
+  // between the outer centroids and the min and max
+  const double index = percentile * total;
+  const Centroid& first = centroids.front();
+  if (index < first.weight / 2) {
+    return min + (first.mean - min) * index / (first.weight / 2);
+  }
+  double before = 0;
+  for (size_t i = 0; i + 1 < centroids.size(); i++) {
+    const Centroid& a = centroids[i];
+    const Centroid& b = centroids[i + 1];
+    const double centerA = before + a.weight / 2;
+    const double centerB = before + a.weight + b.weight / 2;
+    if (index < centerB) {
+      return a.mean + (b.mean - a.mean) * (index - centerA) / (centerB - centerA);
+    }
+    before += a.weight;
+  }
+  const Centroid& last = centroids.back();
+  const double centerLast = total - last.weight / 2;
+  return std::min(max, last.mean + (max - last.mean) * (index - centerLast) / (last.weight / 2));
+}
+
+double TDigest::valueToPercentile(double value) const {
+  compress();
+  if (centroids.empty() || value < min) {
+    return 0;
+  }
+  if (value >= max) {
+    return 1;
+  }
+
+  const Centroid& first = centroids.front();
+  if (value < first.mean) {
+    return (first.weight / 2) * (value - min) / (first.mean - min) / total;
+  }
+  double before = 0;
+  for (size_t i = 0; i + 1 < centroids.size(); i++) {
+    const Centroid& a = centroids[i];
+    const Centroid& b = centroids[i + 1];
+    if (value < b.mean) {
+      const double centerA = before + a.weight / 2;
+      const double centerB = before + a.weight + b.weight / 2;
+      return (centerA + (centerB - centerA) * (value - a.mean) / (b.mean - a.mean)) / total;
+    }
+    before += a.weight;
+  }
+  const Centroid& last = centroids.back();
+  const double centerLast = total - last.weight / 2;
+  return (centerLast + (last.weight / 2) * (value - last.mean) / (max - last.mean)) / total;
+}
+
+} // namespace mace
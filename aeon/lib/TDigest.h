@@ -0,0 +1,113 @@
+/* 
+ * TDigest.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <vector>
+
+/**
+ * \file TDigest.h
+ * \brief Declares mace::TDigest, a constant-memory percentile estimator
+ */
+
+#ifndef _MACE_TDIGEST_H
+#define _MACE_TDIGEST_H
+
+namespace mace {
+
+/**
+ * \addtogroup Filters
+ * @{
+ */
+
+/**
+ * \brief estimates percentiles of a stream of values in constant memory.
+ *
+ * A merging t-digest (Dunning and Ertl): values are buffered, and each time
+ * the buffer fills they are sorted into a list of centroids (mean, weight).
+ * Centroids near the median may absorb many values while those at the tails
+ * stay small, so extreme percentiles such as p99.9 remain accurate.  The
+ * number of centroids is bounded by about compression/2 whatever the number
+ * of values, and two digests can be merged, e.g. to combine per-second
+ * digests into a rolling window.
+ *
+ * The interface follows StatisticalFilter, so it can replace one that was
+ * only used for percentiles.  A TDigest is not thread safe.
+ */
+class TDigest {
+public:
+  /// higher compression keeps more centroids and gives more accurate percentiles
+  TDigest(double compression = 200);
+
+  void update(double value, double weight = 1); ///< adds \c value to the digest
+  void merge(const TDigest& other); ///< adds all values of \c other to this digest
+  void reset(); ///< removes all values
+
+  uint64_t getCount() const; ///< return the number of values
+  double getMin() const; ///< return the smallest value (0 if empty)
+  double getMax() const; ///< return the largest value (0 if empty)
+  double getAvg() const; ///< return the average value (0 if empty)
+  /// return the estimated value at \c percentile, in [0, 1]
+  double percentileToValue(double percentile) const;
+  /// return the estimated fraction of values at or below \c value
+  double valueToPercentile(double value) const;
+  /// return the number of centroids, after merging any buffered values
+  size_t getCentroidCount() const;
+
+private:
+  struct Centroid {
+    double mean;
+    double weight;
+    Centroid(double mean, double weight) : mean(mean), weight(weight) { }
+    bool operator<(const Centroid& other) const { return mean < other.mean; }
+  };
+  typedef std::vector<Centroid> CentroidList;
+
+  /// merges the buffered values into the centroids
+  void compress() const;
+  /// the largest cumulative fraction a centroid starting at \c q may reach
+  double limit(double q) const;
+
+  double compression;
+  size_t bufferSize;
+  mutable CentroidList centroids;
+  mutable CentroidList buffer;
+  mutable CentroidList scratch;
+  double total;
+  double sum;
+  double min;
+  double max;
+  mutable bool reverseMerge; ///< direction of the next compress()
+}; // TDigest
+
+/** @} */
+
+} // namespace mace
+
+#endif // _MACE_TDIGEST_H
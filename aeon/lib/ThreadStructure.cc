@@ -87,6 +87,13 @@ void ThreadStructure::ThreadSpecific::releaseThreadSpecificMemory(){
   }
 }
 
+ThreadStructure::ThreadSpecific* ThreadStructure::ThreadSpecific::exchange( ThreadSpecific* ts ){
+  pthread_once(&keyOnce, initKey);
+  ThreadSpecific* t = (ThreadSpecific*)pthread_getspecific(pkey);
+  assert(pthread_setspecific(pkey, ts) == 0);
+  return t;
+}
+
 void ThreadStructure::ThreadSpecific::initKey() {
 		assert(pthread_key_create(&pkey, NULL) == 0);
 } // initKey
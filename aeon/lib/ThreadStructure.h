@@ -13,6 +13,7 @@
 #include "mset.h"
 
 #include "Event.h"
+#include "EventTrace.h"
 
 /**
  * \file ThreadStructure.h
@@ -44,6 +45,20 @@ class ThreadStructure {
     static void releaseThreadSpecificMemory(){
       ThreadSpecific::releaseThreadSpecificMemory();
     }
+
+    /**
+     * installs \c ts, returned by an earlier call, as the thread specific
+     * data of this thread and returns the one it replaces.  NULL gives the
+     * thread fresh data.  Lets an event running in a coroutine keep its
+     * state when it moves between threads.
+     * */
+    static void* exchangeThreadSpecific( void* ts ){
+      return ThreadSpecific::exchange( static_cast<ThreadSpecific*>(ts) );
+    }
+    /// deletes thread specific data returned by exchangeThreadSpecific()
+    static void releaseThreadSpecific( void* ts ){
+      delete static_cast<ThreadSpecific*>(ts);
+    }
     
     /// returns a new ticket which is monotonically increasing
     static mace::OrderID newTicket(mace::ContextBaseClass* contextObj);
@@ -337,6 +352,12 @@ class ThreadStructure {
         return  t->getThreadType();
     }
 
+    /// the EventTrace spans opened by the current event
+    static mace::EventTrace::OpenSpans& openTraceSpans(){
+        ThreadSpecific *t = ThreadSpecific::init();
+        return  t->openTraceSpans();
+    }
+
     /// \todo not implemented yet
     static bool isNoneContext(){
         return false; // TODO: not completed
@@ -386,6 +407,7 @@ class ThreadStructure {
         ~ThreadSpecific();
         static ThreadSpecific* init();
         static void releaseThreadSpecificMemory();
+        static ThreadSpecific* exchange( ThreadSpecific* ts );
         const mace::OrderID& myEventID() const;
         mace::Event& myEvent();
         const uint64_t getEventContextMappingVersion() const;
@@ -423,6 +445,7 @@ class ThreadStructure {
         void initializeEventStack();
         void setThreadType( const uint8_t type );
         uint8_t getThreadType();
+        mace::EventTrace::OpenSpans& openTraceSpans() { return traceSpans; }
 
       private:
         static void initKey();
@@ -441,6 +464,7 @@ class ThreadStructure {
 
         mace::deque< uint8_t > serviceStack;
         uint8_t threadType; ///< thread type is defined when the thread is start/created
+        mace::EventTrace::OpenSpans traceSpans;
     }; // ThreadSpecific
 };
 #endif
@@ -0,0 +1,124 @@
+/* 
+ * TicketWaitRing.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "TicketWaitRing.h"
+
+namespace {
+  const int32_t MAX_SPINS = 100; // as glibc's MAX_ADAPTIVE_COUNT
+
+  /// spinning only helps if the thread handing off can run at the same time
+  int32_t maxSpins() {
+    static const int32_t spins = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? MAX_SPINS : 0;
+    return spins;
+  }
+
+  inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  /// sleeps while *addr == value; returns early on any wakeup
+  inline void sleepOn(volatile int32_t* addr, int32_t value) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+    if (*addr == value) {
+      sched_yield();
+    }
+#endif
+  }
+
+  inline void wakeAll(volatile int32_t* addr) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+  }
+}
+
+namespace mace {
+
+TicketWaitRing::TicketWaitRing() : spins(0) { }
+
+TicketWaitRing::TicketWaitRing(const TicketWaitRing& other) : spins(0) { }
+
+void TicketWaitRing::wait(uint64_t ticket, pthread_mutex_t& mutex) {
+  Slot& slot = slots[ticket % SLOTS];
+  // read under the mutex, so a notify after we release it is never missed
+  const int32_t sequence = slot.sequence;
+  slot.waiters++;
+  pthread_mutex_unlock(&mutex);
+
+  // same adaptation as glibc's adaptive mutexes: spin up to twice the recent
+  // average, and move the average an eighth of the way towards this wait
+  const int32_t limit = (spins * 2 + 10 < maxSpins()) ? spins * 2 + 10 : maxSpins();
+  int32_t count = 0;
+  while (slot.sequence == sequence && count < limit) {
+    cpuRelax();
+    count++;
+  }
+  spins += (count - spins) / 8;
+
+  if (slot.sequence == sequence) {
+    __sync_fetch_and_add(&slot.sleepers, 1);
+    while (slot.sequence == sequence) {
+      sleepOn(&slot.sequence, sequence);
+    }
+    __sync_fetch_and_sub(&slot.sleepers, 1);
+  }
+
+  pthread_mutex_lock(&mutex);
+  slot.waiters--;
+}
+
+void TicketWaitRing::notify(uint64_t ticket) {
+  Slot& slot = slots[ticket % SLOTS];
+  if (slot.waiters == 0) {
+    return;
+  }
+  // the full barrier orders the increment before reading sleepers; a waiter
+  // that registers as a sleeper afterwards sees the new sequence and does not block
+  __sync_fetch_and_add(&slot.sequence, 1);
+  if (slot.sleepers > 0) {
+    wakeAll(&slot.sequence);
+  }
+}
+
+} // namespace mace
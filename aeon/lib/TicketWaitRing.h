@@ -0,0 +1,102 @@
+/* 
+ * TicketWaitRing.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <inttypes.h>
+#include <pthread.h>
+
+/**
+ * \file TicketWaitRing.h
+ * \brief Declares mace::TicketWaitRing, used by ContextLock to park threads until their ticket is served
+ */
+
+#ifndef _MACE_TICKETWAITRING_H
+#define _MACE_TICKETWAITRING_H
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief parks threads waiting for a ticket, and hands off directly to the
+ * waiters of the next ticket.
+ *
+ * Waiters are hashed by ticket into a fixed ring of slots.  Each slot has a
+ * sequence word: a waiter records it, releases the caller's mutex, spins
+ * briefly and then sleeps on the word (a futex on Linux) until notify()
+ * advances it.  notify() only touches the slot of the ticket being handed
+ * off, and only makes a system call if a thread is actually asleep there, so
+ * a handoff to a spinning successor costs no system call at all.
+ *
+ * The spin budget adapts to how long handoffs have recently taken, so short
+ * critical sections are handed off while the successor is still spinning and
+ * long ones quickly fall back to sleeping.  On a single processor waiters
+ * never spin.
+ *
+ * Both wait() and notify() must be called holding the mutex that protects
+ * the ticket state.  Tickets that collide in the ring share a slot; their
+ * waiters may wake up spuriously and must recheck their condition, just as
+ * with pthread_cond_wait().
+ */
+class TicketWaitRing {
+public:
+  static const uint32_t SLOTS = 64; ///< number of slots, tickets are hashed modulo this
+
+  TicketWaitRing();
+  /// a copy starts with no waiters, like a newly constructed ring
+  TicketWaitRing(const TicketWaitRing& other);
+  TicketWaitRing& operator=(const TicketWaitRing& other) { return *this; }
+
+  /// releases \c mutex and waits until \c ticket is notified (or spuriously), then reacquires \c mutex
+  void wait(uint64_t ticket, pthread_mutex_t& mutex);
+  /// wakes the threads waiting for \c ticket
+  void notify(uint64_t ticket);
+  /// returns true if a thread is waiting in the slot of \c ticket
+  bool hasWaiters(uint64_t ticket) const { return slots[ticket % SLOTS].waiters > 0; }
+
+private:
+  struct Slot {
+    volatile int32_t sequence; ///< advanced by each notify
+    volatile int32_t sleepers; ///< threads blocked in the kernel on \c sequence
+    uint32_t waiters; ///< threads waiting in this slot, protected by the caller's mutex
+    Slot() : sequence(0), sleepers(0), waiters(0) { }
+  };
+
+  Slot slots[SLOTS];
+  volatile int32_t spins; ///< recent average spin count needed before a handoff
+}; // TicketWaitRing
+
+/** @} */
+
+} // namespace mace
+
+#endif // _MACE_TICKETWAITRING_H
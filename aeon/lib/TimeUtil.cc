@@ -28,8 +28,89 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * 
  * ----END-OF-LEGAL-STUFF---- */
+#include <pthread.h>
+#include <stdlib.h>
 #include "TimeUtil.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define MACE_TSC_CLOCK
+#endif
+
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+#ifndef CLOCK_MONOTONIC_COARSE
+#define CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC
+#endif
+
+namespace {
+  uint64_t clockNsec(clockid_t c) {
+    struct timespec ts;
+    clock_gettime(c, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+
+#ifdef MACE_TSC_CLOCK
+  /// how long calibrate() counts TSC ticks against CLOCK_MONOTONIC_RAW
+  const uint64_t CALIBRATION_NSEC = 10*1000*1000;
+
+  /// TSC reading at nsecBase, and nanoseconds per tick as 32.32 fixed point
+  struct TscCalibration {
+    bool usable;
+    uint64_t tscBase;
+    uint64_t nsecBase;
+    uint64_t mult;
+  };
+
+  TscCalibration tsc = { false, 0, 0, 0 };
+  pthread_once_t tscOnce = PTHREAD_ONCE_INIT;
+
+  inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+  }
+
+  /// an invariant TSC ticks at a constant rate in every P- and C-state
+  bool hasInvariantTsc() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) {
+      return false;
+    }
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return d & (1 << 8);
+  }
+
+  void calibrate() {
+    if (!hasInvariantTsc() || getenv("MACE_NO_TSC") != NULL) {
+      return;
+    }
+    uint64_t n0 = clockNsec(CLOCK_MONOTONIC_RAW);
+    uint64_t t0 = rdtsc();
+    uint64_t n1;
+    do {
+      n1 = clockNsec(CLOCK_MONOTONIC_RAW);
+    } while (n1 - n0 < CALIBRATION_NSEC);
+    uint64_t t1 = rdtsc();
+    // below 100MHz something is wrong (e.g. a virtualized TSC); don't trust it
+    if (t1 - t0 < CALIBRATION_NSEC / 10) {
+      return;
+    }
+    tsc.mult = ((n1 - n0) << 32) / (t1 - t0);
+    tsc.tscBase = t1;
+    tsc.nsecBase = n1;
+    tsc.usable = true;
+  }
+
+  uint64_t tscNsec() {
+    uint64_t d = rdtsc() - tsc.tscBase;
+    // split so that neither product overflows for any realistic uptime
+    return tsc.nsecBase + (d >> 32) * tsc.mult + (((d & 0xffffffff) * tsc.mult) >> 32);
+  }
+#endif
+}
+
 TimeUtil& TimeUtil::Instance() {
   if (_inst == NULL) {
     _inst = new TimeUtil();
@@ -47,6 +128,29 @@ time_t TimeUtil::timeImpl() {
   return ::time(0);
 }
 
+uint64_t TimeUtil::monotimeuImpl() {
+#ifdef MACE_TSC_CLOCK
+  pthread_once(&tscOnce, calibrate);
+  if (tsc.usable) {
+    return tscNsec() / 1000;
+  }
+#endif
+  return clockNsec(CLOCK_MONOTONIC_RAW) / 1000;
+} // monotimeuImpl
+
+uint64_t TimeUtil::coarsetimeuImpl() {
+  return clockNsec(CLOCK_MONOTONIC_COARSE) / 1000;
+} // coarsetimeuImpl
+
+bool TimeUtil::isTscClock() {
+#ifdef MACE_TSC_CLOCK
+  pthread_once(&tscOnce, calibrate);
+  return tsc.usable;
+#else
+  return false;
+#endif
+} // isTscClock
+
 void TimeUtil::fillTimeval(uint64_t t, struct timeval& tv) {
   tv.tv_sec = t / 1000000;
   tv.tv_usec = t % 1000000;
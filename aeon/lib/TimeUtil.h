@@ -57,6 +57,15 @@ namespace mace {
  *
  * Implemented using virtual functions to allow the simulator to provide
  * alternate implementations of the time functions.
+ *
+ * timeu() is the wall clock, and can jump when the clock is set.  Use
+ * monotimeu() to measure durations and to schedule timers: it reads the
+ * TSC when the CPU has an invariant one, calibrated against
+ * CLOCK_MONOTONIC_RAW on first use, and CLOCK_MONOTONIC_RAW otherwise.
+ * coarsetimeu() is cheaper still (CLOCK_MONOTONIC_COARSE, a few ms of
+ * resolution) for timestamps where precision does not matter.  Neither
+ * has a meaningful origin, and the two should not be compared with each
+ * other.
  */
 class TimeUtil {
   protected:
@@ -66,10 +75,15 @@ class TimeUtil {
 
     virtual uint64_t timeuImpl(); 
     virtual time_t timeImpl();
+    virtual uint64_t monotimeuImpl();
+    virtual uint64_t coarsetimeuImpl();
 
   public:
     static uint64_t timeu() { return Instance().timeuImpl(); } ///< return the current time as microseconds.
     static time_t time() { return Instance().timeImpl(); } ///< return the current time as seconds.
+    static uint64_t monotimeu() { return Instance().monotimeuImpl(); } ///< return microseconds on a clock that never jumps.
+    static uint64_t coarsetimeu() { return Instance().coarsetimeuImpl(); } ///< return microseconds on a cheap, low resolution clock that never jumps.
+    static bool isTscClock(); ///< return whether monotimeu() reads the TSC.
 
     static double timed(); ///< return the current time as a double value in seconds and partial microseconds.
     static void fillTimeval(uint64_t t, struct timeval& tv); ///< fills a timeval based on a timestamp t.
@@ -0,0 +1,410 @@
+/* 
+ * WriteAheadLog.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "maceConfig.h"
+#include "mace-macros.h"
+#include "FileUtil.h"
+#include "Log.h"
+#include "ScopedLock.h"
+#include "WriteAheadLog.h"
+
+using namespace std;
+
+namespace {
+  /// on-disk record header, in host byte order since the log never leaves the machine
+  struct RecordHeader {
+    uint32_t length;
+    uint32_t crc;
+    uint64_t lsn;
+  };
+
+  const std::string SEGMENT_PREFIX = "wal.";
+  const std::string SEGMENT_SUFFIX = ".log";
+  const std::string CHECKPOINT_PREFIX = "checkpoint.";
+
+  uint32_t crcTable[256];
+  pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+  void initCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      crcTable[i] = c;
+    }
+  }
+
+  uint32_t crc32(uint32_t crc, const char* buf, size_t len) {
+    pthread_once(&crcTableOnce, initCrcTable);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+      crc = crcTable[(crc ^ (uint8_t)buf[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+
+  class CollectingHandler : public mace::WriteAheadLog::RecoveryHandler {
+  public:
+    CollectingHandler(uint64_t& lsn, std::string& snapshot, std::vector<std::string>& records) :
+      lsn(lsn), snapshot(snapshot), records(records) { }
+    void recoverCheckpoint(uint64_t l, const std::string& s) {
+      lsn = l;
+      snapshot = s;
+    }
+    void recoverRecord(uint64_t l, const std::string& r) {
+      records.push_back(r);
+    }
+  private:
+    uint64_t& lsn;
+    std::string& snapshot;
+    std::vector<std::string>& records;
+  };
+
+  class LatestHandler : public mace::WriteAheadLog::RecoveryHandler {
+  public:
+    LatestHandler(uint64_t& lsn, std::string& state) : lsn(lsn), state(state) { }
+    void recoverCheckpoint(uint64_t l, const std::string& s) {
+      lsn = l;
+      state = s;
+    }
+    void recoverRecord(uint64_t l, const std::string& r) {
+      lsn = l;
+      state = r;
+    }
+  private:
+    uint64_t& lsn;
+    std::string& state;
+  };
+
+  uint32_t recordCrc(uint64_t lsn, const char* payload, size_t len) {
+    return crc32(crc32(0, (const char*)&lsn, sizeof(lsn)), payload, len);
+  }
+
+  bool parseNumberedName(const std::string& name, const std::string& prefix, const std::string& suffix, uint64_t& n) {
+    if (name.size() <= prefix.size() + suffix.size() ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+      return false;
+    }
+    std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    char* end = NULL;
+    n = strtoull(digits.c_str(), &end, 16);
+    return *end == '\0';
+  }
+}
+
+namespace mace {
+
+WriteAheadLog::WriteAheadLog(const std::string& dir, uint64_t segmentSize) :
+  dir(dir), segmentSize(segmentSize), fd(-1), segmentBytes(0),
+  lastLSN(0), durableLSN(0), checkpointLSN(0), syncCount(0), flushing(false), failed(false) {
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&flushed, NULL);
+} // WriteAheadLog
+
+WriteAheadLog::~WriteAheadLog() {
+  close();
+  pthread_cond_destroy(&flushed);
+  pthread_mutex_destroy(&lock);
+} // ~WriteAheadLog
+
+std::string WriteAheadLog::segmentPath(uint64_t firstLSN) const {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%016" PRIx64 "%s", SEGMENT_PREFIX.c_str(), firstLSN, SEGMENT_SUFFIX.c_str());
+  return dir + "/" + name;
+}
+
+std::string WriteAheadLog::checkpointPath(uint64_t lsn) const {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%016" PRIx64, CHECKPOINT_PREFIX.c_str(), lsn);
+  return dir + "/" + name;
+}
+
+void WriteAheadLog::open(RecoveryHandler& handler) throw(IOException) {
+  ADD_SELECTORS("WriteAheadLog::open");
+  ScopedLock sl(lock);
+  ASSERT(fd < 0);
+
+  if (!FileUtil::fileIsDir(dir)) {
+    FileUtil::mkdir(dir, S_IRWXU, true);
+  }
+
+  StringList names;
+  FileUtil::readDir(dir, names, true);
+  segments.clear();
+  checkpointLSN = 0;
+  std::string checkpointName;
+  for (StringList::const_iterator i = names.begin(); i != names.end(); i++) {
+    uint64_t n;
+    if (parseNumberedName(*i, SEGMENT_PREFIX, SEGMENT_SUFFIX, n)) {
+      segments.push_back(Segment(n, dir + "/" + *i));
+    }
+    else if (parseNumberedName(*i, CHECKPOINT_PREFIX, "", n) && n >= checkpointLSN) {
+      // older checkpoints are left over from a crash during checkpoint()
+      checkpointLSN = n;
+      checkpointName = *i;
+    }
+  }
+
+  if (!checkpointName.empty()) {
+    handler.recoverCheckpoint(checkpointLSN, FileUtil::loadFile(dir + "/" + checkpointName));
+  }
+  lastLSN = checkpointLSN;
+  for (size_t i = 0; i < segments.size(); i++) {
+    replaySegment(segments[i], handler, i + 1 == segments.size());
+  }
+  durableLSN = lastLSN;
+
+  maceout << "recovered " << dir << " checkpoint " << checkpointLSN << " last lsn " << lastLSN
+          << " from " << segments.size() << " segments" << Log::endl;
+
+  // keep appending to the newest segment, so only the last one can ever hold a torn record
+  openSegment(segments.empty() ? lastLSN + 1 : segments.back().firstLSN);
+} // open
+
+void WriteAheadLog::open(uint64_t& lsn, std::string& snapshot, std::vector<std::string>& records) throw(IOException) {
+  lsn = 0;
+  snapshot.clear();
+  records.clear();
+  CollectingHandler handler(lsn, snapshot, records);
+  open(handler);
+} // open
+
+void WriteAheadLog::openLatest(uint64_t& lsn, std::string& state) throw(IOException) {
+  lsn = 0;
+  state.clear();
+  LatestHandler handler(lsn, state);
+  open(handler);
+} // openLatest
+
+void WriteAheadLog::replaySegment(const Segment& segment, RecoveryHandler& handler, bool last) throw(IOException) {
+  ADD_SELECTORS("WriteAheadLog::replaySegment");
+  std::string data = FileUtil::loadFile(segment.path);
+  size_t pos = 0;
+  while (pos + sizeof(RecordHeader) <= data.size()) {
+    RecordHeader h;
+    memcpy(&h, data.data() + pos, sizeof(h));
+    const char* payload = data.data() + pos + sizeof(h);
+    if (pos + sizeof(h) + h.length > data.size() || h.crc != recordCrc(h.lsn, payload, h.length)) {
+      break;
+    }
+    if (h.lsn > checkpointLSN) {
+      if (h.lsn != lastLSN + 1) {
+        maceerr << "lsn gap in " << segment.path << ": expected " << lastLSN + 1 << " found " << h.lsn << Log::endl;
+        throw FileException("WriteAheadLog: lsn gap in " + segment.path);
+      }
+      handler.recoverRecord(h.lsn, std::string(payload, h.length));
+      lastLSN = h.lsn;
+    }
+    pos += sizeof(h) + h.length;
+  }
+  if (pos != data.size()) {
+    if (!last) {
+      throw FileException("WriteAheadLog: corrupt record in the middle of " + segment.path);
+    }
+    // a crash in the middle of a write leaves a torn record; it was never acknowledged
+    maceout << "truncating torn tail of " << segment.path << " at " << pos << " of " << data.size() << Log::endl;
+    int tfd = FileUtil::open(segment.path, O_WRONLY);
+    FileUtil::ftruncate(tfd, pos);
+    fdatasync(tfd);
+    FileUtil::close(tfd);
+  }
+} // replaySegment
+
+void WriteAheadLog::openSegment(uint64_t firstLSN) throw(IOException) {
+  if (fd >= 0) {
+    FileUtil::close(fd);
+  }
+  std::string path = segmentPath(firstLSN);
+  fd = FileUtil::open(path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+  struct stat sbuf;
+  FileUtil::fstat(fd, sbuf);
+  segmentBytes = sbuf.st_size;
+  if (segments.empty() || segments.back().firstLSN != firstLSN) {
+    segments.push_back(Segment(firstLSN, path));
+  }
+  syncDirectory();
+} // openSegment
+
+void WriteAheadLog::syncDirectory() throw(IOException) {
+  int dfd = FileUtil::open(dir, O_RDONLY);
+  fsync(dfd);
+  FileUtil::close(dfd);
+} // syncDirectory
+
+void WriteAheadLog::close() {
+  if (!isOpen()) {
+    return;
+  }
+  sync();
+  ScopedLock sl(lock);
+  FileUtil::close(fd);
+  fd = -1;
+} // close
+
+uint64_t WriteAheadLog::append(const std::string& record) throw(IOException) {
+  ScopedLock sl(lock);
+  ASSERT(fd >= 0);
+  if (failed) {
+    throw WriteException("WriteAheadLog: " + dir + " failed on an earlier write");
+  }
+  RecordHeader h;
+  h.length = record.size();
+  h.lsn = ++lastLSN;
+  h.crc = recordCrc(h.lsn, record.data(), record.size());
+  buffer.append((const char*)&h, sizeof(h));
+  buffer.append(record);
+  return h.lsn;
+} // append
+
+void WriteAheadLog::sync() throw(IOException) {
+  sync(getLastLSN());
+} // sync
+
+void WriteAheadLog::sync(uint64_t lsn) throw(IOException) {
+  ScopedLock sl(lock);
+  ASSERT(lsn <= lastLSN);
+  while (durableLSN < lsn) {
+    if (flushing) {
+      // somebody else is writing; their flush may already cover us
+      pthread_cond_wait(&flushed, &lock);
+      continue;
+    }
+    if (failed) {
+      throw WriteException("WriteAheadLog: " + dir + " failed on an earlier write");
+    }
+
+    // become the flusher for everything appended so far
+    flushing = true;
+    std::string out;
+    out.swap(buffer);
+    const uint64_t upto = lastLSN;
+    const int wfd = fd;
+    sl.unlock();
+
+    try {
+      FileUtil::write(wfd, out);
+      if (fdatasync(wfd) < 0) {
+        throw WriteException("WriteAheadLog: fdatasync " + dir + ": " + strerror(errno));
+      }
+    }
+    catch (const IOException& e) {
+      sl.lock();
+      // none of out is durable: cut off whatever part of it reached the
+      // segment, and write it again ahead of the records appended since
+      try {
+        FileUtil::ftruncate(wfd, segmentBytes);
+        buffer.insert(0, out);
+      }
+      catch (const IOException& te) {
+        // a retry would follow a torn record that replay stops at
+        failed = true;
+      }
+      flushing = false;
+      pthread_cond_broadcast(&flushed);
+      throw;
+    }
+
+    sl.lock();
+    segmentBytes += out.size();
+    durableLSN = upto;
+    syncCount++;
+    if (segmentBytes >= segmentSize) {
+      openSegment(upto + 1);
+    }
+    flushing = false;
+    pthread_cond_broadcast(&flushed);
+  }
+} // sync
+
+void WriteAheadLog::checkpoint(uint64_t lsn, const std::string& snapshot) throw(IOException) {
+  ADD_SELECTORS("WriteAheadLog::checkpoint");
+  sync(lsn);
+
+  std::string path = checkpointPath(lsn);
+  std::string tmp = path + ".tmp";
+  int cfd = FileUtil::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  FileUtil::write(cfd, snapshot);
+  fsync(cfd);
+  FileUtil::close(cfd);
+  FileUtil::rename(tmp, path);
+  syncDirectory();
+
+  ScopedLock sl(lock);
+  uint64_t oldCheckpoint = checkpointLSN;
+  if (lsn <= oldCheckpoint) {
+    FileUtil::unlink(path);
+    return;
+  }
+  checkpointLSN = lsn;
+  if (oldCheckpoint > 0) {
+    FileUtil::unlink(checkpointPath(oldCheckpoint));
+  }
+
+  // a segment is obsolete when the next one starts at or before the checkpoint
+  size_t obsolete = 0;
+  while (obsolete + 1 < segments.size() && segments[obsolete + 1].firstLSN <= lsn + 1) {
+    FileUtil::unlink(segments[obsolete].path);
+    obsolete++;
+  }
+  segments.erase(segments.begin(), segments.begin() + obsolete);
+  macedbg(1) << "checkpoint at " << lsn << " removed " << obsolete << " segments" << Log::endl;
+} // checkpoint
+
+uint64_t WriteAheadLog::getLastLSN() const {
+  ScopedLock sl(lock);
+  return lastLSN;
+}
+
+uint64_t WriteAheadLog::getDurableLSN() const {
+  ScopedLock sl(lock);
+  return durableLSN;
+}
+
+uint64_t WriteAheadLog::getCheckpointLSN() const {
+  ScopedLock sl(lock);
+  return checkpointLSN;
+}
+
+uint64_t WriteAheadLog::getSyncCount() const {
+  ScopedLock sl(lock);
+  return syncCount;
+}
+
+}
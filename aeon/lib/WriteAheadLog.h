@@ -0,0 +1,168 @@
+/* 
+ * WriteAheadLog.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef _WRITE_AHEAD_LOG_H
+#define _WRITE_AHEAD_LOG_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+#include "Exception.h"
+#include <vector>
+
+/**
+ * \file WriteAheadLog.h
+ * \brief declares the WriteAheadLog class, an append-only durable record log
+ */
+
+namespace mace {
+
+/**
+ * \addtogroup Utils
+ * @{
+ */
+
+/**
+ * \brief append-only log of opaque records with group commit, segment
+ * rotation and checkpointing.
+ *
+ * Records are numbered by a log sequence number (LSN) starting at 1.
+ * append() only buffers the record; it becomes durable once a sync() covering
+ * its LSN returns.  A single sync() writes and fdatasync()s every record
+ * appended so far, so callers that append many records and sync once pay for
+ * one disk flush.  When several threads call sync() concurrently, one of them
+ * does the flush for all of them and the others wait for it (group commit).
+ * A sync() that fails cuts the segment back to its last durable record and
+ * keeps the records buffered for the next sync(); if the segment cannot be
+ * cut back, the log fails and rejects every later append() and sync().
+ *
+ * The log lives in a directory of segment files named
+ * <tt>wal.<first lsn>.log</tt>; a new segment is started once the current one
+ * exceeds the segment size.  checkpoint() stores a snapshot of the state
+ * covering every record up to some LSN and deletes the segments that only hold
+ * older records.  open() replays the newest checkpoint and then every later
+ * record through a RecoveryHandler, truncating a torn record at the tail.
+ *
+ * Common usage:
+ * \code
+ * WriteAheadLog wal("/var/lib/acceptor", 64*1024*1024);
+ * wal.open(handler);
+ * uint64_t lsn = wal.append(record);
+ * // ... append more records
+ * wal.sync(lsn);   // everything up to lsn is now on disk
+ * \endcode
+ */
+class WriteAheadLog {
+public:
+  /// receives the recovered state from open()
+  class RecoveryHandler {
+  public:
+    /// called at most once, before any record, with the newest checkpoint
+    virtual void recoverCheckpoint(uint64_t lsn, const std::string& snapshot) = 0;
+    /// called for each durable record newer than the checkpoint, in LSN order
+    virtual void recoverRecord(uint64_t lsn, const std::string& record) = 0;
+    virtual ~RecoveryHandler() {}
+  };
+
+  static const uint64_t DEFAULT_SEGMENT_SIZE = 64*1024*1024;
+
+  WriteAheadLog(const std::string& dir, uint64_t segmentSize = DEFAULT_SEGMENT_SIZE);
+  virtual ~WriteAheadLog();
+
+  /// creates the directory if needed and replays its contents into \c handler
+  void open(RecoveryHandler& handler) throw(IOException);
+  /// convenience form of open() that hands back the newest checkpoint (empty
+  /// and lsn 0 if none) and every record after it
+  void open(uint64_t& checkpointLSN, std::string& snapshot, std::vector<std::string>& records) throw(IOException);
+  /// form of open() for logs whose every record is a full state: hands back
+  /// only the newest of the checkpoint and the records (empty and lsn 0 if
+  /// none), without keeping the others in memory
+  void openLatest(uint64_t& lsn, std::string& state) throw(IOException);
+  /// flushes pending records and closes the current segment
+  void close();
+  bool isOpen() const { return fd >= 0; }
+
+  /// buffers a record and returns its LSN; it is not durable until synced
+  uint64_t append(const std::string& record) throw(IOException);
+  /// returns once every record up to \c lsn is on disk
+  void sync(uint64_t lsn) throw(IOException);
+  /// returns once every record appended so far is on disk
+  void sync() throw(IOException);
+
+  /// durably stores \c snapshot as covering every record up to \c lsn and
+  /// deletes the segments made obsolete by it
+  void checkpoint(uint64_t lsn, const std::string& snapshot) throw(IOException);
+
+  uint64_t getLastLSN() const;
+  uint64_t getDurableLSN() const;
+  uint64_t getCheckpointLSN() const;
+  /// number of fdatasync calls issued, i.e. number of group commits
+  uint64_t getSyncCount() const;
+  const std::string& getDirectory() const { return dir; }
+
+private:
+  struct Segment {
+    uint64_t firstLSN;
+    std::string path;
+    Segment(uint64_t firstLSN, const std::string& path) : firstLSN(firstLSN), path(path) { }
+  };
+  typedef std::vector<Segment> SegmentList;
+
+  std::string segmentPath(uint64_t firstLSN) const;
+  std::string checkpointPath(uint64_t lsn) const;
+  void openSegment(uint64_t firstLSN) throw(IOException);
+  void replaySegment(const Segment& segment, RecoveryHandler& handler, bool last) throw(IOException);
+  void syncDirectory() throw(IOException);
+
+  const std::string dir;
+  const uint64_t segmentSize;
+
+  mutable pthread_mutex_t lock;
+  pthread_cond_t flushed;
+
+  int fd;
+  uint64_t segmentBytes;
+  SegmentList segments;
+  std::string buffer;     ///< encoded records not yet handed to the kernel
+  uint64_t lastLSN;
+  uint64_t durableLSN;
+  uint64_t checkpointLSN;
+  uint64_t syncCount;
+  bool flushing;
+  bool failed;            ///< a failed write left a torn record in the segment
+
+}; // WriteAheadLog
+
+/** @} */
+
+}
+
+#endif // _WRITE_AHEAD_LOG_H
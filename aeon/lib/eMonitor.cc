@@ -1,12 +1,14 @@
 #include "eMonitor.h"
 #include "SysUtil.h"
 #include "ContextService.h"
+#include "ContextPlacement.h"
 
 #include "stdlib.h"
 #include "stdio.h"
 #include "math.h"
 #include "sys/types.h"
 #include "sys/sysinfo.h"
+#include <fstream>
 
 /******************************* class ElasticityBehaviorEvent ***********************************************************/
 void mace::ElasticityBehaviorEvent::deleteHelper() {
@@ -79,6 +81,7 @@ void mace::ServerRuntimeInfo::serialize(std::string& str) const{
   mace::serialize( str, &contextMigrationThreshold );
   mace::serialize( str, &contextsNumber );
   mace::serialize( str, &totalClientRequestNumber );
+  mace::serialize( str, &queueDepth );
 }
 
 int mace::ServerRuntimeInfo::deserialize(std::istream & is) throw (mace::SerializationException){
@@ -88,6 +91,7 @@ int mace::ServerRuntimeInfo::deserialize(std::istream & is) throw (mace::Seriali
   serializedByteSize += mace::deserialize( is, &contextMigrationThreshold );
   serializedByteSize += mace::deserialize( is, &contextsNumber );
   serializedByteSize += mace::deserialize( is, &totalClientRequestNumber );
+  serializedByteSize += mace::deserialize( is, &queueDepth );
   return serializedByteSize;
 }
 
@@ -97,7 +101,8 @@ void mace::ServerRuntimeInfo::print(std::ostream& out) const {
   out<< "totalCPUTime="; mace::printItem(out, &(totalCPUTime) ); out<<", ";
   out<< "contextMigrationThreshold="; mace::printItem(out, &(contextMigrationThreshold) ); out<<", ";
   out<< "contextsNumber="; mace::printItem(out, &(contextsNumber) ); out<<", ";
-  out<< "totalClientRequestNumber="; mace::printItem(out, &(totalClientRequestNumber) );
+  out<< "totalClientRequestNumber="; mace::printItem(out, &(totalClientRequestNumber) ); out<<", ";
+  out<< "queueDepth="; mace::printItem(out, &(queueDepth) );
   out<< ")";
 }
 
@@ -172,7 +177,7 @@ void mace::ServersRuntimeInfo::scaleup( const uint64_t& n ) {
 
 }
 
-mace::vector< mace::pair<MaceAddr, MaceAddr> > mace::ServersRuntimeInfo::scaledown() {
+mace::vector< mace::pair<MaceAddr, MaceAddr> > mace::ServersRuntimeInfo::scaledown( const uint64_t& n ) {
 	ADD_SELECTORS("ServersRuntimeInfo::scaledown");
 	mace::vector<mace::MaceAddr> sorted_servers;
 	mace::map<mace::MaceAddr, double> servers_cpu;
@@ -201,7 +206,7 @@ mace::vector< mace::pair<MaceAddr, MaceAddr> > mace::ServersRuntimeInfo::scaledo
 	
 	int hi = 0;
 	int ti = sorted_servers.size() - 1;
-	while( hi < ti ) {
+	while( hi < ti && sd_servers.size() < n ) {
 		const mace::MaceAddr& haddr = sorted_servers[hi];
 		const mace::MaceAddr& taddr = sorted_servers[ti];
 
@@ -491,6 +496,8 @@ pthread_cond_t elasticityBehaviorSignal = PTHREAD_COND_INITIALIZER;
 
 const uint32_t mace::eMonitor::MAJOR_HANDLER_THREAD_ID;
 const double mace::eMonitor::MIGRATION_THRESHOLD_STEP;
+const double mace::eMonitor::CPU_BUSY_THREAHOLD;
+const double mace::eMonitor::CPU_IDLE_THREAHOLD;
 
 mace::eMonitor::eMonitor( AsyncEventReceiver* sv, const uint32_t& period_time, const mace::set<mace::string>& manange_contexts ): 
 		sv(sv), isGEM(false), periodTime(period_time), manageContextTypes(manange_contexts), migratingContextName(""), 
@@ -506,6 +513,10 @@ mace::eMonitor::eMonitor( AsyncEventReceiver* sv, const uint32_t& period_time, c
 	eConfig = new ElasticityConfiguration();
 	pthread_mutex_init( &migrationMutex, NULL );
 
+	autoscalePolicy = AutoscalePolicy( params::get<double>("AUTOSCALE_UP_THRESHOLD", CPU_BUSY_THREAHOLD), 
+		params::get<double>("AUTOSCALE_DOWN_THRESHOLD", CPU_IDLE_THREAHOLD), params::get<uint32_t>("AUTOSCALE_UP_PERIODS", 2), 
+		params::get<uint32_t>("AUTOSCALE_DOWN_PERIODS", 3), params::get<uint32_t>("AUTOSCALE_COOLDOWN", 3) );
+
 	if( period_time > 0 ) {
 		ASSERT(  pthread_create( &collectorKey , NULL, eMonitor::startInfoCollectorThread, static_cast<void*>(this) ) == 0 );
 	}
@@ -753,6 +764,7 @@ void mace::eMonitor::processContextElasticity( const mace::string& marker, const
 		ctx_runtime_info.contextExecTime = contexts[i]->getCPUTime() * 0.000001;
 		ctx_runtime_info.fromAccessCount = contexts[i]->getFromAccessCountByTypes(manageContextTypes);
 		ctx_runtime_info.toAccessCount = contexts[i]->getToAccessCountByTypes(manageContextTypes);
+		ctx_runtime_info.interactionCount = contexts[i]->getContextsInterCount();
 		predictTotalClientRequests += ctx_runtime_info.getTotalClientRequestNumber();
 
 		contextsRuntimeInfo[ contexts[i]->contextName ] = ctx_runtime_info;
@@ -761,7 +773,8 @@ void mace::eMonitor::processContextElasticity( const mace::string& marker, const
 	sl.unlock();
 
 
-	ServerRuntimeInfo server_info( currentcpuUsage, total_cpu_time, contextMigrationThreshold, contexts.size(), predictTotalClientRequests );
+	ServerRuntimeInfo server_info( currentcpuUsage, total_cpu_time, contextMigrationThreshold, contexts.size(), predictTotalClientRequests,
+		_service->getEventQueueDepth() );
 
 	macedbg(1) << "Server's CPU usage: " << currentcpuUsage << Log::endl;
 	
@@ -785,7 +798,13 @@ void mace::eMonitor::processContextElasticity( const mace::string& marker, const
 	const mace::map<mace::MaceAddr, mace::ServerRuntimeInfo>& servers_info = serversRuntimeInfo.getActiveServersInfo(isGEM);
 	macedbg(1) << "Have updated all servers' information: " << servers_info << Log::endl;
 
-	this->processContextElasticityRules( marker, contexts );
+	// "rules" follows the elasticity policies; "partition" places all contexts by partitioning their interaction graph
+	static const mace::string placement = params::get<mace::string>("ELASTICITY_PLACEMENT", "rules");
+	if( placement == "partition" ) {
+		this->processContextElasticityByPartition( contexts );
+	} else {
+		this->processContextElasticityRules( marker, contexts );
+	}
 	// this->processContextElasticityByInteraction( contexts );
 	
 	for( uint32_t i=0; i<contexts.size(); i++ ) {
@@ -1271,6 +1290,8 @@ void mace::eMonitor::updateServerInfo(const mace::MaceAddr& src, const mace::Ser
 		// 	} 
 		// }
 
+		this->autoscale( skip_addrs );
+
 		const mace::set<mace::MaceAddr>& servers = serversRuntimeInfo.getServerAddrs();
 		servers_info = serversRuntimeInfo.getActiveServersInfo(isGEM);
 
@@ -1291,6 +1312,64 @@ void mace::eMonitor::updateServerInfo(const mace::MaceAddr& src, const mace::Ser
 	}
 }
 
+void mace::eMonitor::autoscale( mace::set<mace::MaceAddr>& skip_addrs ) {
+	ADD_SELECTORS("eMonitor::autoscale");
+	// "none" leaves the number of active servers alone; "reactive" scales on the CPU usage of this period, 
+	// "predictive" on the load forecast AUTOSCALE_HORIZON periods ahead
+	static const mace::string mode = params::get<mace::string>("ELASTICITY_AUTOSCALE", "none");
+	if( mode == "none" ) {
+		return;
+	}
+	static const uint32_t horizon = params::get<uint32_t>("AUTOSCALE_HORIZON", 2);
+	static const double queue_limit = params::get<double>("AUTOSCALE_QUEUE_LIMIT", 1000);
+	static const double alpha = params::get<double>("AUTOSCALE_ALPHA", 0.5);
+	static const double beta = params::get<double>("AUTOSCALE_BETA", 0.3);
+	static const double gamma = params::get<double>("AUTOSCALE_GAMMA", 0.1);
+	static const uint32_t season = params::get<uint32_t>("AUTOSCALE_SEASON", 0);
+
+	ContextService* _service = static_cast<ContextService*>(sv);
+	mace::map< mace::MaceAddr, mace::ServerRuntimeInfo> servers_info = serversRuntimeInfo.getActiveServersInfo(isGEM);
+	double load = 0.0;
+	for( mace::map< mace::MaceAddr, mace::ServerRuntimeInfo>::const_iterator iter = servers_info.begin(); iter != servers_info.end(); 
+			iter ++ ) {
+		const mace::ServerRuntimeInfo& server_info = iter->second;
+		if( mode == "reactive" ) {
+			load += server_info.CPUUsage;
+			continue;
+		}
+
+		std::map< mace::MaceAddr, ServerLoadForecast >::iterator fIter = serverLoadForecasts.find( iter->first );
+		if( fIter == serverLoadForecasts.end() ) {
+			fIter = serverLoadForecasts.insert( std::make_pair(iter->first, ServerLoadForecast(alpha, beta, gamma, season)) ).first;
+		}
+		const double event_rate = (periodTime > 0)? (double)server_info.totalClientRequestNumber / periodTime: 0.0;
+		fIter->second.update( server_info.CPUUsage, event_rate, server_info.queueDepth );
+		const double server_load = fIter->second.forecast( horizon, queue_limit );
+		macedbg(1) << "Server("<< iter->first <<") CPU usage: " << server_info.CPUUsage << ", forecast load: " << server_load << Log::endl;
+		load += server_load;
+	}
+
+	const int32_t action = autoscalePolicy.decide( load, servers_info.size(), serversRuntimeInfo.getServerAddrs().size() );
+	macedbg(1) << "Load of " << servers_info.size() << " active servers: " << load << ", scale action: " << action << Log::endl;
+	if( action > 0 ) {
+		serversRuntimeInfo.scaleup( action );
+	} else if( action < 0 ) {
+		mace::vector< mace::pair<MaceAddr, MaceAddr> > scaledown_servers = serversRuntimeInfo.scaledown( -action );
+		servers_info = serversRuntimeInfo.getActiveServersInfo(isGEM);
+		for( uint32_t i=0; i<scaledown_servers.size(); i++ ) {
+			const mace::pair<MaceAddr, MaceAddr>& sd_server = scaledown_servers[i];
+			_service->send__elasticity_serverInfoReply( sd_server.first, mace::eMonitor::MAJOR_HANDLER_THREAD_ID, servers_info, 
+				mace::ServersRuntimeInfo::SCALE_DOWN, sd_server.second );
+			_service->send__elasticity_serverInfoReply( sd_server.second, mace::eMonitor::MAJOR_HANDLER_THREAD_ID, servers_info, 
+				mace::ServersRuntimeInfo::NO_ACTION, sd_server.second );
+
+			skip_addrs.insert( sd_server.first );
+			skip_addrs.insert( sd_server.second );
+			serverLoadForecasts.erase( sd_server.first );
+		}
+	}
+}
+
 void mace::eMonitor::enqueueContextMigrationQuery( const mace::MaceAddr& src, const mace::vector<mace::MigrationContextInfo>& m_contexts_info ) {
 	ADD_SELECTORS("eMonitor::enqueueContextMigrationQuery");
 	ScopedLock sl(migrationMutex);
@@ -1353,6 +1432,11 @@ void mace::eMonitor::processContextsMigrationQuery() {
 					accept_m_ctxs.push_back( m_ctx_info.contextName );
 				}
 				
+			} else if( m_ctx_info.specialRequirement == mace::MigrationContextInfo::PLACEMENT ) {
+				// the source has already checked the plan against this server's capacity
+				predictCPUTime += m_ctx_info.contextExecTime;
+				accept_m_ctxs.push_back( m_ctx_info.contextName );
+
 			} else if( m_ctx_info.specialRequirement == mace::MigrationContextInfo::IDLE_NET ) {
 				uint64_t src_creq_count = serversRuntimeInfo.getServerClienRequestNumber( src );
 				uint64_t ctx_creq_count = m_ctx_info.getTotalClientRequestNumber();
@@ -1645,6 +1729,100 @@ void mace::eMonitor::processContextsMigrationQueryReply( const mace::MaceAddr& d
 	}
 }
 
+void mace::eMonitor::processContextElasticityByPartition( std::vector<mace::ContextBaseClass*>& contexts ) {
+	ADD_SELECTORS("eMonitor::processContextElasticityByPartition");
+	static const uint64_t migration_cost = params::get<uint64_t>("PLACEMENT_MIGRATION_COST", 10);
+	static const double imbalance = params::get<double>("PLACEMENT_IMBALANCE", 0.05);
+	static const mace::string graph_log = params::get<mace::string>("PLACEMENT_GRAPH_LOG", "");
+
+	const mace::map<mace::MaceAddr, mace::ServerRuntimeInfo>& servers_info = serversRuntimeInfo.getActiveServersInfo(isGEM);
+	ContextService* _service = static_cast<ContextService*>(sv);
+	const mace::ContextMapping& snapshot = _service->getLatestContextMapping();
+
+	double local_ctx_exec_time = 0.0;
+	for( std::map< mace::string, ContextRuntimeInfoForElasticity >::const_iterator iter = contextsRuntimeInfo.begin(); 
+			iter != contextsRuntimeInfo.end(); iter ++ ) {
+		local_ctx_exec_time += (iter->second).contextExecTime;
+	}
+
+	// servers are loaded up to CPU_BUSY_THREAHOLD; what they run besides the managed contexts stays put
+	mace::ContextInteractionGraph graph;
+	mace::map< mace::MaceAddr, uint32_t > server_ids;
+	std::vector< mace::MaceAddr > server_addrs;
+	for( mace::map< mace::MaceAddr, mace::ServerRuntimeInfo >::const_iterator iter = servers_info.begin(); iter != servers_info.end(); 
+			iter++) {
+		std::ostringstream name;
+		name << iter->first;
+		std::string server_name = name.str();
+		std::replace( server_name.begin(), server_name.end(), ' ', '_' );
+
+		double base_load = (iter->second).totalCPUTime * (iter->second).CPUUsage * 0.01;
+		if( iter->first == Util::getMaceAddr() ) {
+			base_load = std::max( base_load - local_ctx_exec_time, 0.0 );
+		}
+		server_ids[ iter->first ] = graph.addServer( server_name, (iter->second).totalCPUTime * mace::eMonitor::CPU_BUSY_THREAHOLD * 0.01, 
+			base_load );
+		server_addrs.push_back( iter->first );
+	}
+	if( server_ids.find(Util::getMaceAddr()) == server_ids.end() ) {
+		return;
+	}
+	const uint32_t local_id = server_ids[ Util::getMaceAddr() ];
+
+	for( std::map< mace::string, ContextRuntimeInfoForElasticity >::const_iterator iter = contextsRuntimeInfo.begin(); 
+			iter != contextsRuntimeInfo.end(); iter ++ ) {
+		graph.addContext( iter->first, (iter->second).contextExecTime, local_id );
+	}
+	// contexts of other servers that local contexts talk to are part of the graph, but stay where they are
+	for( std::map< mace::string, ContextRuntimeInfoForElasticity >::const_iterator iter1 = contextsRuntimeInfo.begin(); 
+			iter1 != contextsRuntimeInfo.end(); iter1 ++ ) {
+		const mace::map< mace::string, uint64_t >& inter_count = (iter1->second).interactionCount;
+		for( mace::map< mace::string, uint64_t >::const_iterator iter2 = inter_count.begin(); iter2 != inter_count.end(); iter2 ++ ) {
+			if( !graph.hasContext(iter2->first) ) {
+				mace::map< mace::MaceAddr, uint32_t >::const_iterator s_iter = server_ids.find( mace::ContextMapping::getNodeByContext(snapshot, iter2->first) );
+				if( s_iter == server_ids.end() ) {
+					continue;
+				}
+				graph.addContext( iter2->first, 0, s_iter->second, true );
+			}
+			graph.addInteraction( iter1->first, iter2->first, iter2->second );
+		}
+	}
+
+	if( !graph_log.empty() ) {
+		std::ofstream out( graph_log.c_str(), std::ios::app );
+		graph.print( out );
+	}
+
+	mace::ContextPartitioner partitioner( imbalance, migration_cost );
+	std::vector<uint32_t> assignment = partitioner.partition( graph );
+	std::vector<mace::ContextMove> moves = mace::ContextPartitioner::plan( graph, assignment );
+	macedbg(1) << "Placement of "<< contextsRuntimeInfo.size() <<" contexts: cut "<< graph.cutWeight(graph.currentAssignment()) <<" -> " 
+		<< graph.cutWeight(assignment) <<", "<< moves.size() <<" migrations" << Log::endl;
+
+	mace::map< mace::MaceAddr, mace::vector<mace::MigrationContextInfo> > migrationContextsInfo;
+	mace::set< mace::string > moved_contexts;
+	for( uint32_t i=0; i<moves.size(); i++ ) {
+		const ContextRuntimeInfoForElasticity& ctx_runtime_info = contextsRuntimeInfo[ moves[i].contextName ];
+		mace::MigrationContextInfo migration_ctx_info( moves[i].contextName, ctx_runtime_info.avgLatency, ctx_runtime_info.contextExecTime, 
+			ctx_runtime_info.fromAccessCount, ctx_runtime_info.fromMessageSize, ctx_runtime_info.count );
+		migration_ctx_info.specialRequirement = mace::MigrationContextInfo::PLACEMENT;
+		migrationContextsInfo[ server_addrs[moves[i].toServer] ].push_back( migration_ctx_info );
+		moved_contexts.insert( moves[i].contextName );
+	}
+	for( std::map< mace::string, ContextRuntimeInfoForElasticity >::const_iterator iter = contextsRuntimeInfo.begin(); 
+			iter != contextsRuntimeInfo.end(); iter ++ ) {
+		if( moved_contexts.count(iter->first) == 0 ) {
+			predictLocalContexts.insert( iter->first );
+		}
+	}
+
+	for( mace::map< mace::MaceAddr, mace::vector<mace::MigrationContextInfo> >::iterator iter = migrationContextsInfo.begin(); 
+			iter != migrationContextsInfo.end(); iter++ ){
+		_service->send__elasticity_contextMigrationQuery( iter->first, iter->second );
+	}
+}
+
 void mace::eMonitor::processNextContextsExchangeRequest() {
 	ADD_SELECTORS("eMonitor::processNextContextsExchangeRequest");
 	ScopedLock sl(migrationMutex);
@@ -1971,10 +2149,13 @@ void mace::eMonitor::processContextMigration(){
 	}
 }
 
-void mace::eMonitor::wrapupCurrentContextMigration() {
+void mace::eMonitor::wrapupCurrentContextMigration(const mace::set<mace::string>& migratedContexts) {
 	ADD_SELECTORS("eMonitor::wrapupCurrentContextMigration");
 	ScopedLock sl(migrationMutex);
-	ASSERT( migratingContextName != "" );
+	// contexts moved by a migration plan of the head are not requested by this monitor
+	if( migratingContextName == "" || migratedContexts.count(migratingContextName) == 0 ) {
+		return;
+	}
 	macedbg(1) << "Finish context("<< migratingContextName <<") migration!" << Log::endl;
 	contextMigrationRequests.erase( migratingContextName );
 	migratingContextName = "";
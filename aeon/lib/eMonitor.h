@@ -5,6 +5,7 @@
 #include "Message.h"
 #include "pthread.h"
 #include "ThreadPool.h"
+#include "LoadForecast.h"
 /**
  * \file ContextDispatch.h
  * \brief declares the ContextEventTP class
@@ -141,12 +142,14 @@ public:
   double contextMigrationThreshold;
   uint32_t contextsNumber;
   uint64_t totalClientRequestNumber;
+  uint32_t queueDepth; ///< events waiting for an execution thread
 
 public:
-  ServerRuntimeInfo(): CPUUsage(0.0), totalCPUTime(0.0), contextMigrationThreshold(0.0), contextsNumber(0), totalClientRequestNumber(0) { }
+  ServerRuntimeInfo(): CPUUsage(0.0), totalCPUTime(0.0), contextMigrationThreshold(0.0), contextsNumber(0), totalClientRequestNumber(0), queueDepth(0) { }
   ServerRuntimeInfo( const double& cpu_usage, const double& total_cpu_time, const double& ctx_migration_threshold, const uint32_t& n_ctx,
-    const uint64_t& client_req_number ): CPUUsage(cpu_usage), totalCPUTime( total_cpu_time ), contextMigrationThreshold(ctx_migration_threshold), 
-    contextsNumber(n_ctx), totalClientRequestNumber(client_req_number) { }
+    const uint64_t& client_req_number, const uint32_t& queue_depth = 0 ): CPUUsage(cpu_usage), totalCPUTime( total_cpu_time ), 
+    contextMigrationThreshold(ctx_migration_threshold), contextsNumber(n_ctx), totalClientRequestNumber(client_req_number), 
+    queueDepth(queue_depth) { }
   ~ServerRuntimeInfo() { }
 
   virtual void serialize(std::string& str) const;
@@ -191,7 +194,7 @@ public:
   uint64_t getServerClienRequestNumber( const mace::MaceAddr& addr );
 
   void scaleup( const uint64_t& n );
-  mace::vector< mace::pair<MaceAddr, MaceAddr> > scaledown();
+  mace::vector< mace::pair<MaceAddr, MaceAddr> > scaledown( const uint64_t& n );
 };
 
 class MigrationContextInfo: public Serializable, public PrintPrintable {
@@ -201,6 +204,7 @@ public:
   static const uint8_t MAX_LATENCY = 2;
   static const uint8_t BUSY_CPU = 3;
   static const uint8_t IDLE_NET = 4;
+  static const uint8_t PLACEMENT = 5; ///< proposed by the placement engine; accepted if the destination has spare CPU
 
 public:
   mace::string contextName;
@@ -267,6 +271,7 @@ public:
   mace::map< mace::string, uint64_t > fromMessageSize;
 
   mace::map< mace::string, uint64_t > toAccessCount;
+  mace::map< mace::string, uint64_t > interactionCount;
 
   double currLatency;
   double contextExecTime;
@@ -335,6 +340,10 @@ private:
   uint64_t scaleOpType;
   mace::MaceAddr scaledownAddr;
 
+  // Elasticity control - autoscaling, on the GEM
+  std::map< mace::MaceAddr, ServerLoadForecast > serverLoadForecasts;
+  AutoscalePolicy autoscalePolicy;
+
   // Elasticity control - exchange contexts
   mace::map< mace::MaceAddr, mace::vector< mace::pair<mace::string, uint64_t> > > exchangeContexts;
   mace::map< mace::MaceAddr, uint64_t > exchangeBenefits;
@@ -418,7 +427,7 @@ public:
   // migration
   void requestContextMigration(const mace::string& contextName, const MaceAddr& destNode);
   void processContextMigration();
-  void wrapupCurrentContextMigration();
+  void wrapupCurrentContextMigration(const mace::set<mace::string>& migratedContexts);
 
 private:
   CPUInformation getCurrentCPUInfo() const;
@@ -439,6 +448,8 @@ private:
 
   void processContextElasticityRules( const mace::string& marker, std::vector<mace::ContextBaseClass*>& contexts );
   void processContextElasticityByInteraction(std::vector<mace::ContextBaseClass*>& contexts);
+  void processContextElasticityByPartition(std::vector<mace::ContextBaseClass*>& contexts);
+  void autoscale( mace::set<mace::MaceAddr>& skip_addrs );
   void processNextContextsExchangeRequest();
   void processExchangeContextsQuery();
   void processExchangeContextsQueryReply( const mace::MaceAddr& dest, const mace::vector<mace::string>& contexts );
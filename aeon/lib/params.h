@@ -64,6 +64,8 @@ namespace params {
   static const std::string MACE_PORT = "MACE_PORT";  ///< Sets the default port for addresses 
   static const std::string MACE_BIND_LOCAL_ADDRESS = "MACE_BIND_LOCAL_ADDRESS"; ///< 1 or 0, sets whether to additionally bind to the local address rather than inaddr any.
   static const std::string MACE_TRANSPORT_DISABLE_TRANSLATION = "MACE_TRANSPORT_DISABLE_TRANSLATION"; ///< 1 or 0, sets whether to have the transport re-write source addresses for hosts using the auto-forwarding transport features.
+  static const std::string MACE_TRANSPORT_SHM = "MACE_TRANSPORT_SHM"; ///< 1 or 0, sets whether the TCP transport sends to processes on the same host through shared memory.
+  static const std::string MACE_TRANSPORT_SHM_RING_SIZE = "MACE_TRANSPORT_SHM_RING_SIZE"; ///< Bytes in each shared memory ring between two processes.
   static const std::string MACE_ALL_HOSTS_REACHABLE = "MACE_ALL_HOSTS_REACHABLE"; ///< When set allows the transport to skip overhead when not doing NAT
   static const std::string MACE_CERT_FILE = "MACE_CERT_FILE"; ///< Tell the transport where the certificate file is
   static const std::string MACE_PRIVATE_KEY_FILE = "MACE_PRIVATE_KEY_FILE"; ///< Tell the transport where the private key is
@@ -0,0 +1,105 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include "ScopedLock.h"
+#include "AsyncFileBlockManager.h"
+
+namespace {
+  const std::string FILE_NAME = "AsyncFileBlockManager_test.dat";
+  const size_t BLOCK_SIZE = 4096;
+  const uint64_t BLOCKS = 64;
+
+  std::string blockFor(uint64_t i) {
+    return std::string(BLOCK_SIZE, 'a' + i % 26);
+  }
+
+  class CountingCallback : public AsyncFileBlockManager::Callback {
+  public:
+    CountingCallback() : reads(0), writes(0), errors(0) {
+      pthread_mutex_init(&lock, NULL);
+    }
+    ~CountingCallback() {
+      pthread_mutex_destroy(&lock);
+    }
+    void blockRead(uint64_t index, char* buffer, ssize_t result) {
+      ScopedLock sl(lock);
+      reads++;
+      if (result != (ssize_t)BLOCK_SIZE || std::string(buffer, result) != blockFor(index)) {
+        errors++;
+      }
+    }
+    void blockWritten(uint64_t index, const char* buffer, ssize_t result) {
+      ScopedLock sl(lock);
+      writes++;
+      if (result != (ssize_t)BLOCK_SIZE) {
+        errors++;
+      }
+    }
+    pthread_mutex_t lock;
+    int reads;
+    int writes;
+    int errors;
+  };
+
+  void writeAndReadBack(bool useUring) {
+    unlink(FILE_NAME.c_str());
+    std::vector<std::string> blocks;
+    for (uint64_t i = 0; i < BLOCKS; i++) {
+      blocks.push_back(blockFor(i));
+    }
+
+    CountingCallback cb;
+    {
+      AsyncFileBlockManager bm(8, 4, 16, useUring);
+      bm.setBlockSize(BLOCK_SIZE);
+      bm.open(FILE_NAME, "w");
+      for (uint64_t i = 0; i < BLOCKS; i++) {
+        bm.writeBlock(i, blocks[i].data(), blocks[i].size(), &cb);
+      }
+      bm.submit();
+      BOOST_REQUIRE_EQUAL( bm.flush(), 0 );
+      BOOST_REQUIRE_EQUAL( cb.writes, (int)BLOCKS );
+      // requests are sent in batches of at most the queue depth
+      BOOST_REQUIRE( bm.getSubmitCount() >= BLOCKS / 8 );
+      bm.close();
+    }
+
+    AsyncFileBlockManager bm(8, 4, 16, useUring);
+    bm.setBlockSize(BLOCK_SIZE);
+    bm.open(FILE_NAME, "r");
+    BOOST_REQUIRE_EQUAL( bm.getBlockCount(), BLOCKS );
+    std::vector<char> buf(BLOCK_SIZE * BLOCKS);
+    for (uint64_t i = 0; i < BLOCKS; i++) {
+      bm.readBlock(i, &buf[i * BLOCK_SIZE], &cb);
+    }
+    bm.drain();
+    BOOST_REQUIRE_EQUAL( cb.reads, (int)BLOCKS );
+    BOOST_REQUIRE_EQUAL( cb.errors, 0 );
+
+    for (uint64_t i = 0; i < 8; i++) {
+      bm.prefetchBlock(i);
+    }
+    for (uint64_t i = 0; i < BLOCKS; i++) {
+      bm.prefetchBlock(i + 8);
+      BOOST_REQUIRE( bm.getBlock(i) == blocks[i] );
+    }
+    bm.close();
+    unlink(FILE_NAME.c_str());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_AsyncFileBlockManager )
+
+BOOST_AUTO_TEST_CASE( ThreadPool )
+{
+  writeAndReadBack(false);
+}
+
+BOOST_AUTO_TEST_CASE( Uring )
+{
+  // falls back to the thread pool where io_uring is unavailable
+  writeAndReadBack(true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
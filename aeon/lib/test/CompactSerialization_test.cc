@@ -0,0 +1,108 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "CompactSerialization.h"
+
+namespace {
+  template<typename T>
+  T roundTrip(const T& in, size_t* size = NULL) {
+    std::string str;
+    mace::serializeCompact(str, &in);
+    if (size) {
+      *size = str.size();
+    }
+    std::istringstream is(str);
+    T out;
+    int n = mace::deserializeCompact(is, &out);
+    BOOST_REQUIRE_EQUAL( n, (int)str.size() );
+    return out;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_CompactSerialization )
+
+BOOST_AUTO_TEST_CASE( Varints )
+{
+  size_t sz;
+  BOOST_REQUIRE_EQUAL( roundTrip<uint32_t>(0, &sz), 0u );
+  BOOST_REQUIRE_EQUAL( sz, 1u );
+  BOOST_REQUIRE_EQUAL( roundTrip<uint32_t>(127, &sz), 127u );
+  BOOST_REQUIRE_EQUAL( sz, 1u );
+  BOOST_REQUIRE_EQUAL( roundTrip<uint32_t>(128, &sz), 128u );
+  BOOST_REQUIRE_EQUAL( sz, 2u );
+  BOOST_REQUIRE_EQUAL( roundTrip<uint64_t>(UINT64_MAX, &sz), UINT64_MAX );
+  BOOST_REQUIRE_EQUAL( sz, 10u );
+  BOOST_REQUIRE_EQUAL( roundTrip<int32_t>(-1, &sz), -1 );
+  BOOST_REQUIRE_EQUAL( sz, 1u );
+  BOOST_REQUIRE_EQUAL( roundTrip<int64_t>(INT64_MIN), INT64_MIN );
+  BOOST_REQUIRE_EQUAL( roundTrip<int16_t>(-300), -300 );
+  BOOST_REQUIRE_EQUAL( roundTrip<mace::string>("compact"), "compact" );
+  // non-integers use the default encoding
+  BOOST_REQUIRE_EQUAL( roundTrip<double>(0.5), 0.5 );
+}
+
+BOOST_AUTO_TEST_CASE( OutOfRangeThrows )
+{
+  std::string str;
+  mace::serializeVarint(str, 70000);
+  std::istringstream is(str);
+  uint16_t v;
+  BOOST_REQUIRE_THROW( mace::deserializeCompact(is, &v), mace::SerializationException );
+
+  std::istringstream truncated(std::string("\x80", 1));
+  uint32_t w;
+  BOOST_REQUIRE_THROW( mace::deserializeCompact(truncated, &w), mace::SerializationException );
+}
+
+BOOST_AUTO_TEST_CASE( OversizedLengthThrows )
+{
+  // a length far beyond the bytes that follow is refused before allocating
+  std::string str;
+  mace::serializeVarint(str, 0xffffffffu);
+  str.append("abc");
+  std::istringstream is(str);
+  mace::string s;
+  BOOST_REQUIRE_THROW( mace::deserializeCompact(is, &s), mace::SerializationException );
+
+  std::istringstream vs(str);
+  mace::vector<uint32_t> v;
+  BOOST_REQUIRE_THROW( mace::deserializeCompact(vs, &v), mace::SerializationException );
+
+  // an exact fit is still accepted
+  BOOST_REQUIRE_EQUAL( roundTrip<mace::string>("abc"), "abc" );
+  mace::vector<uint32_t> three(3, 7);
+  BOOST_REQUIRE( roundTrip(three) == three );
+}
+
+BOOST_AUTO_TEST_CASE( DeltaKeys )
+{
+  mace::map<uint64_t, uint32_t> m;
+  for (uint64_t k = 1000000000000ULL; k < 1000000000000ULL + 1000; k += 10) {
+    m[k] = (uint32_t)(k % 7);
+  }
+  size_t sz;
+  BOOST_REQUIRE( roundTrip(m, &sz) == m );
+  // size, first key in 6 bytes, then one byte per delta and one per value
+  BOOST_REQUIRE_EQUAL( sz, 1 + 6 + 1 + 2 * (m.size() - 1) );
+  std::string fixed;
+  mace::serialize(fixed, &m);
+  BOOST_REQUIRE( sz * 5 < fixed.size() );
+
+  mace::set<int32_t> s;
+  s.insert(-5);
+  s.insert(0);
+  s.insert(INT32_MAX);
+  BOOST_REQUIRE( roundTrip(s) == s );
+
+  mace::map<mace::string, uint64_t> versions;
+  versions["globalContext"] = 3;
+  versions["Server[1]"] = 12;
+  BOOST_REQUIRE( roundTrip(versions) == versions );
+
+  mace::vector<mace::pair<uint32_t, uint64_t> > v;
+  v.push_back(mace::pair<uint32_t, uint64_t>(1, 2));
+  v.push_back(mace::pair<uint32_t, uint64_t>(3, 4));
+  BOOST_REQUIRE( roundTrip(v) == v );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
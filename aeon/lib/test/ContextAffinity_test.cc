@@ -0,0 +1,86 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "ContextAffinity.h"
+
+BOOST_AUTO_TEST_SUITE( lib_ContextAffinity )
+
+BOOST_AUTO_TEST_CASE( SpreadsContexts )
+{
+  mace::ContextAffinityMap affinity(4);
+  std::vector<uint32_t> count(4, 0);
+  for (uint32_t id = 0; id < 4000; id++) {
+    uint32_t w = affinity.getWorker(id);
+    BOOST_REQUIRE(w < 4);
+    BOOST_CHECK_EQUAL(affinity.getWorker(id), w);
+    count[w]++;
+  }
+  for (uint32_t w = 0; w < 4; w++) {
+    BOOST_CHECK(count[w] > 600);
+    BOOST_CHECK(count[w] < 1400);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( AddingWorkerMovesFewContexts )
+{
+  mace::ContextAffinityMap four(4);
+  mace::ContextAffinityMap five(5);
+  uint32_t moved = 0;
+  for (uint32_t id = 0; id < 4000; id++) {
+    uint32_t w = five.getWorker(id);
+    if (w != 4 && w != four.getWorker(id)) {
+      moved++;
+    }
+  }
+  // only the contexts taken by the new worker move
+  BOOST_CHECK_EQUAL(moved, 0u);
+}
+
+BOOST_AUTO_TEST_CASE( RebalanceMovesHotContexts )
+{
+  mace::ContextAffinityMap affinity(2);
+  // four equally hot contexts, all on the same worker
+  std::vector<uint32_t> hot;
+  for (uint32_t id = 0; hot.size() < 4; id++) {
+    if (affinity.getWorker(id) == 0) {
+      hot.push_back(id);
+    }
+  }
+  for (size_t i = 0; i < hot.size(); i++) {
+    affinity.record(hot[i], 100);
+  }
+  BOOST_CHECK_EQUAL(affinity.getLoad(0), 400u);
+  BOOST_CHECK_EQUAL(affinity.getLoad(1), 0u);
+
+  BOOST_CHECK_EQUAL(affinity.rebalance(), 2u);
+  uint32_t onFirst = 0;
+  for (size_t i = 0; i < hot.size(); i++) {
+    if (affinity.getWorker(hot[i]) == 0) {
+      onFirst++;
+    }
+  }
+  BOOST_CHECK_EQUAL(onFirst, 2u);
+  BOOST_CHECK_EQUAL(affinity.getLoad(0), 0u);
+
+  // balanced load moves nothing, and contexts stay where they were moved
+  for (size_t i = 0; i < hot.size(); i++) {
+    affinity.record(hot[i], 100);
+  }
+  BOOST_CHECK_EQUAL(affinity.rebalance(), 0u);
+  BOOST_CHECK_EQUAL(affinity.getLoad(0), 0u);
+  for (size_t i = 0; i < hot.size(); i++) {
+    affinity.record(hot[i], 100);
+  }
+  BOOST_CHECK_EQUAL(affinity.getLoad(0), 200u);
+  BOOST_CHECK_EQUAL(affinity.getLoad(1), 200u);
+}
+
+BOOST_AUTO_TEST_CASE( SingleHotContextStays )
+{
+  mace::ContextAffinityMap affinity(2);
+  affinity.record(7, 1000);
+  // moving the only busy context would just move the hot spot
+  BOOST_CHECK_EQUAL(affinity.rebalance(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include "ContextPlacement.h"
+
+namespace {
+  /// two groups of four contexts, each group chatty inside, spread across two servers
+  void buildTwoGroups(mace::ContextInteractionGraph& graph, bool mixed) {
+    graph.addServer("s0", 10);
+    graph.addServer("s1", 10);
+    for (uint32_t i = 0; i < 8; i++) {
+      std::ostringstream name;
+      name << "C[" << i << "]";
+      // mixed: even contexts on s0, odd on s1; otherwise each group on its own server
+      uint32_t server = mixed ? i % 2 : i / 4;
+      graph.addContext(name.str(), 2, server);
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+      for (uint32_t j = i + 1; j < 8; j++) {
+        std::ostringstream a, b;
+        a << "C[" << i << "]";
+        b << "C[" << j << "]";
+        graph.addInteraction(a.str(), b.str(), (i / 4 == j / 4) ? 100 : 1);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_ContextPlacement )
+
+BOOST_AUTO_TEST_CASE( ColocatesInteractingContexts )
+{
+  mace::ContextInteractionGraph graph;
+  buildTwoGroups(graph, true);
+  BOOST_CHECK_EQUAL(graph.cutWeight(graph.currentAssignment()), 8u * 100 + 8u);
+
+  mace::ContextPartitioner partitioner(0.05, 10);
+  std::vector<uint32_t> assignment = partitioner.partition(graph);
+  BOOST_CHECK_EQUAL(graph.cutWeight(assignment), 16u);
+  for (uint32_t i = 1; i < 4; i++) {
+    BOOST_CHECK_EQUAL(assignment[i], assignment[0]);
+    BOOST_CHECK_EQUAL(assignment[4 + i], assignment[4]);
+  }
+  BOOST_CHECK(assignment[0] != assignment[4]);
+  // half of the contexts are already where they belong
+  BOOST_CHECK_EQUAL(mace::ContextPartitioner::plan(graph, assignment).size(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE( KeepsAGoodPlacement )
+{
+  mace::ContextInteractionGraph graph;
+  buildTwoGroups(graph, false);
+  mace::ContextPartitioner partitioner(0.05, 10);
+  std::vector<uint32_t> assignment = partitioner.partition(graph);
+  BOOST_CHECK(mace::ContextPartitioner::plan(graph, assignment).empty());
+}
+
+BOOST_AUTO_TEST_CASE( RespectsCapacity )
+{
+  mace::ContextInteractionGraph graph;
+  graph.addServer("s0", 4);
+  graph.addServer("s1", 4);
+  graph.addServer("s2", 4);
+  const char* names[] = { "A", "B", "C", "D", "E", "F" };
+  for (uint32_t i = 0; i < 6; i++) {
+    graph.addContext(names[i], 2, 0);
+  }
+  for (uint32_t i = 1; i < 6; i++) {
+    graph.addInteraction(names[0], names[i], 50);
+  }
+
+  mace::ContextPartitioner partitioner(0, 0);
+  std::vector<uint32_t> assignment = partitioner.partition(graph);
+  std::vector<double> loads = graph.serverLoads(assignment);
+  for (uint32_t s = 0; s < 3; s++) {
+    BOOST_CHECK_LE(loads[s], 4.0);
+  }
+  // A stays with one of its partners
+  BOOST_CHECK_EQUAL(graph.cutWeight(assignment), 4u * 50);
+}
+
+BOOST_AUTO_TEST_CASE( PinnedContextsStay )
+{
+  mace::ContextInteractionGraph graph;
+  graph.addServer("s0", 10);
+  graph.addServer("s1", 10);
+  graph.addContext("local", 1, 0);
+  graph.addContext("remote", 1, 1, true);
+  graph.addInteraction("local", "remote", 100);
+
+  mace::ContextPartitioner partitioner(0.05, 10);
+  std::vector<uint32_t> assignment = partitioner.partition(graph);
+  BOOST_CHECK_EQUAL(assignment[1], 1u);
+  std::vector<mace::ContextMove> moves = mace::ContextPartitioner::plan(graph, assignment);
+  BOOST_REQUIRE_EQUAL(moves.size(), 1u);
+  BOOST_CHECK_EQUAL(moves[0].contextName, "local");
+  BOOST_CHECK_EQUAL(moves[0].toServer, 1u);
+}
+
+BOOST_AUTO_TEST_CASE( PrintAndRead )
+{
+  mace::ContextInteractionGraph graph;
+  buildTwoGroups(graph, true);
+  graph.addContext("P", 1, 1, true);
+  graph.addInteraction("P", "C[0]", 7);
+
+  std::stringstream text;
+  graph.print(text);
+  graph.print(text);
+
+  mace::ContextInteractionGraph copy;
+  std::string error;
+  for (int round = 0; round < 2; round++) {
+    BOOST_REQUIRE(copy.read(text, error));
+    BOOST_CHECK_EQUAL(copy.contextCount(), graph.contextCount());
+    BOOST_CHECK_EQUAL(copy.totalWeight(), graph.totalWeight());
+    BOOST_CHECK_EQUAL(copy.cutWeight(copy.currentAssignment()), graph.cutWeight(graph.currentAssignment()));
+    BOOST_CHECK(copy.getContext(copy.getContextId("P")).pinned);
+  }
+  BOOST_CHECK(!copy.read(text, error));
+  BOOST_CHECK(error.empty());
+
+  std::istringstream bad("server s0 1\ncontext X 1 nowhere\n");
+  BOOST_CHECK(!copy.read(bad, error));
+  BOOST_CHECK(!error.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <pthread.h>
+#include "Coroutine.h"
+
+namespace {
+  struct Steps {
+    int count;
+    bool yielded;
+    mace::Coroutine* inside;
+    pthread_t thread;
+  };
+
+  void countTo3(void* arg) {
+    Steps* s = (Steps*)arg;
+    s->inside = mace::Coroutine::current();
+    for (int i = 0; i < 3; i++) {
+      s->count++;
+      mace::Coroutine::yield();
+    }
+    s->count++;
+  }
+
+  void markYielded(void* arg) {
+    Steps* s = (Steps*)arg;
+    // runs on the resuming thread, outside the coroutine
+    BOOST_CHECK(mace::Coroutine::current() == NULL);
+    s->yielded = true;
+  }
+
+  void yieldOnce(void* arg) {
+    Steps* s = (Steps*)arg;
+    mace::Coroutine::yield(markYielded, s);
+    s->thread = pthread_self();
+    s->count++;
+  }
+
+  mace::Coroutine* scheduled = NULL;
+  void remember(mace::Coroutine* co) {
+    scheduled = co;
+  }
+
+  int switches = 0;
+  void switchIn(mace::Coroutine* co) {
+    switches++;
+  }
+  void switchOut(mace::Coroutine* co) {
+    switches--;
+  }
+
+  void* resumeThread(void* arg) {
+    mace::Coroutine* co = (mace::Coroutine*)arg;
+    return (void*)(long)co->resume();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_Coroutine )
+
+BOOST_AUTO_TEST_CASE( YieldAndResume )
+{
+  Steps s = { 0, false, NULL };
+  mace::Coroutine co(countTo3, &s);
+  BOOST_CHECK(mace::Coroutine::current() == NULL);
+  for (int i = 1; i <= 3; i++) {
+    BOOST_CHECK(!co.resume());
+    BOOST_CHECK_EQUAL(s.count, i);
+    BOOST_CHECK(!co.isDone());
+  }
+  BOOST_CHECK(co.resume());
+  BOOST_CHECK_EQUAL(s.count, 4);
+  BOOST_CHECK(co.isDone());
+  BOOST_CHECK(s.inside == &co);
+  BOOST_CHECK(mace::Coroutine::current() == NULL);
+}
+
+BOOST_AUTO_TEST_CASE( ResumeOnAnotherThread )
+{
+  Steps s = { 0, false, NULL };
+  mace::Coroutine co(yieldOnce, &s, remember);
+  co.setSwitchHooks(switchIn, switchOut);
+  BOOST_CHECK(!co.resume());
+  BOOST_CHECK(s.yielded);
+  BOOST_CHECK_EQUAL(s.count, 0);
+  BOOST_CHECK_EQUAL(switches, 0);
+
+  co.schedule();
+  BOOST_CHECK(scheduled == &co);
+
+  pthread_t t;
+  void* finished = NULL;
+  BOOST_REQUIRE(pthread_create(&t, NULL, resumeThread, &co) == 0);
+  pthread_join(t, &finished);
+  BOOST_CHECK(finished != NULL);
+  BOOST_CHECK_EQUAL(s.count, 1);
+  BOOST_CHECK(pthread_equal(s.thread, t));
+  BOOST_CHECK_EQUAL(switches, 0);
+}
+
+BOOST_AUTO_TEST_CASE( ManyCoroutines )
+{
+  // stacks are reused once coroutines are deleted
+  for (int round = 0; round < 3; round++) {
+    std::vector<Steps> steps(1000);
+    std::vector<mace::Coroutine*> cos;
+    for (size_t i = 0; i < steps.size(); i++) {
+      steps[i].count = 0;
+      cos.push_back(new mace::Coroutine(countTo3, &steps[i], NULL, 16 * 1024));
+    }
+    bool all = false;
+    while (!all) {
+      all = true;
+      for (size_t i = 0; i < cos.size(); i++) {
+        if (!cos[i]->isDone()) {
+          cos[i]->resume();
+          all = false;
+        }
+      }
+    }
+    for (size_t i = 0; i < cos.size(); i++) {
+      BOOST_CHECK_EQUAL(steps[i].count, 4);
+      delete cos[i];
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
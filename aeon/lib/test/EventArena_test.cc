@@ -0,0 +1,125 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <pthread.h>
+#include <vector>
+#include "EventArena.h"
+#include "m_map.h"
+#include "mstring.h"
+
+namespace {
+  void* releaseAll(void* arg) {
+    std::vector<void*>* blocks = static_cast<std::vector<void*>*>(arg);
+    for (size_t i = 0; i < blocks->size(); i++) {
+      mace::EventArena::release((*blocks)[i]);
+    }
+    return NULL;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_EventArena )
+
+BOOST_AUTO_TEST_CASE( ChunkRecycledAfterRetire )
+{
+  mace::EventArena::retire();
+  std::vector<void*> blocks;
+  for (int i = 0; i < 100; i++) {
+    char* p = static_cast<char*>(mace::EventArena::allocate(40));
+    BOOST_CHECK_EQUAL((size_t)p % 16, 0u);
+    memset(p, i, 40);
+    blocks.push_back(p);
+  }
+  for (int i = 0; i < 100; i++) {
+    BOOST_CHECK_EQUAL(((char*)blocks[i])[39], (char)i);
+  }
+  const size_t cached = mace::EventArena::freeChunks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    mace::EventArena::release(blocks[i]);
+  }
+  // the owner still holds the chunk until it moves on
+  BOOST_CHECK_EQUAL(mace::EventArena::freeChunks(), cached);
+  mace::EventArena::retire();
+  BOOST_CHECK_EQUAL(mace::EventArena::freeChunks(), cached + 1);
+
+  // and the next allocation reuses it
+  const size_t heap = mace::EventArena::heapChunks();
+  void* p = mace::EventArena::allocate(16);
+  BOOST_CHECK_EQUAL(mace::EventArena::freeChunks(), cached);
+  BOOST_CHECK_EQUAL(mace::EventArena::heapChunks(), heap);
+  mace::EventArena::release(p);
+  mace::EventArena::retire();
+}
+
+BOOST_AUTO_TEST_CASE( LiveObjectsKeepChunk )
+{
+  mace::EventArena::retire();
+  void* kept = mace::EventArena::allocate(100);
+  void* dropped = mace::EventArena::allocate(100);
+  const size_t cached = mace::EventArena::freeChunks();
+  mace::EventArena::retire();
+  mace::EventArena::release(dropped);
+  BOOST_CHECK_EQUAL(mace::EventArena::freeChunks(), cached);
+  mace::EventArena::release(kept);
+  BOOST_CHECK_EQUAL(mace::EventArena::freeChunks(), cached + 1);
+}
+
+BOOST_AUTO_TEST_CASE( LargeAndFull )
+{
+  const size_t heap = mace::EventArena::heapChunks();
+  void* large = mace::EventArena::allocate(mace::EventArena::MAX_ALLOCATION + 1);
+  memset(large, 1, mace::EventArena::MAX_ALLOCATION + 1);
+  mace::EventArena::release(large);
+  BOOST_CHECK_EQUAL(mace::EventArena::heapChunks(), heap);
+
+  // filling more than a chunk moves on to another
+  std::vector<void*> blocks;
+  for (size_t n = 0; n < 3 * mace::EventArena::CHUNK_SIZE; n += 1024) {
+    blocks.push_back(mace::EventArena::allocate(1024));
+  }
+  BOOST_CHECK(mace::EventArena::heapChunks() + mace::EventArena::freeChunks() >= heap + 3);
+  for (size_t i = 0; i < blocks.size(); i++) {
+    mace::EventArena::release(blocks[i]);
+  }
+  mace::EventArena::retire();
+}
+
+BOOST_AUTO_TEST_CASE( ReleaseFromOtherThread )
+{
+  mace::EventArena::retire();
+  std::vector<void*> blocks;
+  for (int i = 0; i < 1000; i++) {
+    blocks.push_back(mace::EventArena::allocate(64));
+  }
+  mace::EventArena::retire();
+  const size_t heap = mace::EventArena::heapChunks();
+  pthread_t t;
+  BOOST_REQUIRE(pthread_create(&t, NULL, releaseAll, &blocks) == 0);
+  pthread_join(t, NULL);
+  // the other thread had no cache of its own to keep them in
+  BOOST_CHECK(mace::EventArena::heapChunks() < heap);
+}
+
+BOOST_AUTO_TEST_CASE( Container )
+{
+  typedef mace::map<mace::string, uint64_t, mace::SerializeMap<mace::string, uint64_t>, std::less<mace::string>,
+                    mace::ArenaAllocator<std::pair<const mace::string, uint64_t> > > ArenaMap;
+  ArenaMap m;
+  for (uint64_t i = 0; i < 500; i++) {
+    std::ostringstream os;
+    os << "ctx" << i;
+    m[os.str()] = i;
+  }
+  ArenaMap copy = m;
+  m.clear();
+  BOOST_CHECK_EQUAL(copy.size(), 500u);
+  BOOST_CHECK_EQUAL(copy["ctx42"], 42u);
+
+  std::string buf;
+  mace::serialize(buf, &copy);
+  ArenaMap read;
+  std::istringstream in(buf);
+  mace::deserialize(in, &read);
+  BOOST_CHECK(read == copy);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,177 @@
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "mace.h"
+#include "params.h"
+#include "ContextBaseClass.h"
+#include "ContextLock.h"
+#include "Metrics.h"
+
+// Microbenchmarks for the context side of the event pipeline: the cost of
+// acquiring and releasing a ContextLock in read and write mode, and the cost
+// of taking a snapshot of a context as its state grows.  Everything runs in
+// one thread against a standalone context, so the numbers are the
+// uncontended cost of the runtime itself.
+//
+// Results are written as one JSON document (to stdout, or to the file named
+// by -bench_output) so they can be compared across commits.  The async event
+// and routine measurements need a running service; see the EventPipelineBench
+// service in services/TestCases, which reports in the same format.
+//
+// usage: EventPipeline_bench [-lock_iterations N] [-snapshot_work N] [-bench_output file]
+
+namespace {
+  uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+  }
+
+  /// a context holding a map of entries, snapshotted the way generated contexts are
+  class BenchContext: public mace::ContextBaseClass {
+  public:
+    mace::map<uint32_t, mace::string> entries;
+
+    BenchContext(const mace::string& contextName = "Bench", const uint64_t createTicketNumber = 1):
+      mace::ContextBaseClass(contextName, createTicketNumber, 1, 1, mace::OrderID(), 1, mace::OrderID(), 1, false, 0, 0, 1) { }
+    BenchContext(const BenchContext& _ctx): entries(_ctx.entries) { }
+    virtual ~BenchContext() { }
+
+    void serialize(std::string& __str) const {
+      mace::serialize(__str, &entries);
+    }
+    int deserialize(std::istream& __in) throw (mace::SerializationException) {
+      return mace::deserialize(__in, &entries);
+    }
+
+    void snapshot(const uint64_t& ver) const {
+      BenchContext* _ctx = new BenchContext(*this);
+      mace::ContextBaseClass::snapshot(ver, _ctx);
+    }
+    void setSnapshot(const uint64_t ver, const mace::string& snapshot) {
+      std::istringstream in(snapshot);
+      BenchContext* obj = new BenchContext(this->contextName, 1);
+      mace::deserialize(in, obj);
+      versionMap.push_back(std::make_pair(ver, obj));
+    }
+    void snapshotRelease(const uint64_t& ver) const {
+      while (!versionMap.empty() && versionMap.front().first < ver) {
+        delete versionMap.front().second;
+        versionMap.pop_front();
+      }
+    }
+  };
+
+  void printResult(std::ostream& out, bool& first, const std::string& name, const mace::Histogram* h, const std::string& extra = "") {
+    out << (first ? "" : ",") << "\n    {\"name\":\"" << name << "\""
+        << ",\"unit\":\"ns\""
+        << ",\"count\":" << h->getCount()
+        << ",\"mean\":" << h->getMean()
+        << ",\"p50\":" << h->percentile(50)
+        << ",\"p99\":" << h->percentile(99)
+        << ",\"max\":" << h->getMax()
+        << extra << "}";
+    first = false;
+  }
+
+  void benchContextLock(std::ostream& out, bool& first, int8_t mode, const std::string& modeName, uint64_t iterations) {
+    mace::Histogram* acquire = mace::Metrics::histogram("EventPipeline_bench.contextlock." + modeName + ".acquire");
+    mace::Histogram* release = mace::Metrics::histogram("EventPipeline_bench.contextlock." + modeName + ".release");
+    const int8_t releaseMode = (mode == mace::ContextLock::WRITE_MODE) ? mace::ContextLock::RELEASE_WRITE_MODE : mace::ContextLock::RELEASE_READ_MODE;
+
+    BenchContext ctx;
+    for (uint64_t i = 1; i <= iterations; i++) {
+      mace::OrderID eventId(ctx.contextId, i);
+      ctx.requireExecuteTicket(eventId);
+
+      uint64_t t0 = nowNanos();
+      mace::ContextLock lock(ctx, eventId, true, mode);
+      uint64_t t1 = nowNanos();
+      mace::ContextLock unlock(ctx, eventId, true, releaseMode);
+      uint64_t t2 = nowNanos();
+
+      ctx.commitEvent(eventId);
+      acquire->record(t1 - t0);
+      release->record(t2 - t1);
+    }
+    printResult(out, first, "contextlock." + modeName + ".acquire", acquire);
+    printResult(out, first, "contextlock." + modeName + ".release", release);
+  }
+
+  void benchSnapshot(std::ostream& out, bool& first, uint32_t size, uint64_t work) {
+    std::ostringstream suffix;
+    suffix << size;
+    mace::Histogram* local = mace::Metrics::histogram("EventPipeline_bench.snapshot.local." + suffix.str());
+    mace::Histogram* remote = mace::Metrics::histogram("EventPipeline_bench.snapshot.serialized." + suffix.str());
+
+    BenchContext ctx;
+    const mace::string value(32, 'v');
+    for (uint32_t i = 0; i < size; i++) {
+      ctx.entries[i] = value;
+    }
+
+    // copies of large contexts are slow, so do about the same work per size
+    uint64_t rounds = work / (size + 1);
+    if (rounds < 10) {
+      rounds = 10;
+    }
+    size_t bytes = 0;
+    uint64_t ver = 1;
+    for (uint64_t r = 0; r < rounds; r++, ver++) {
+      // a local reader takes a copy of the context when a writer downgrades
+      uint64_t t0 = nowNanos();
+      ctx.snapshot(ver);
+      ctx.snapshotRelease(ver + 1);
+      uint64_t t1 = nowNanos();
+      local->record(t1 - t0);
+    }
+    for (uint64_t r = 0; r < rounds; r++, ver++) {
+      // a remote reader receives the context serialized
+      uint64_t t0 = nowNanos();
+      std::string str;
+      mace::serialize(str, &ctx);
+      ctx.setSnapshot(ver, str);
+      ctx.snapshotRelease(ver + 1);
+      uint64_t t1 = nowNanos();
+      remote->record(t1 - t0);
+      bytes = str.size();
+    }
+
+    std::ostringstream extra;
+    extra << ",\"entries\":" << size;
+    printResult(out, first, "snapshot.local", local, extra.str());
+    extra << ",\"bytes\":" << bytes;
+    printResult(out, first, "snapshot.serialized", remote, extra.str());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  mace::Init(argc, argv);
+  const uint64_t lockIterations = params::get<uint64_t>("lock_iterations", 200000);
+  const uint64_t snapshotWork = params::get<uint64_t>("snapshot_work", 1 << 18);
+
+  std::ofstream file;
+  if (params::containsKey("bench_output")) {
+    file.open(params::get<std::string>("bench_output").c_str());
+    if (!file) {
+      std::cerr << "cannot open " << params::get<std::string>("bench_output") << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = file.is_open() ? file : std::cout;
+
+  out << "{\n  \"benchmark\":\"EventPipeline_bench\",\n  \"time\":" << TimeUtil::timeu() << ",\n  \"results\":[";
+  bool first = true;
+  benchContextLock(out, first, mace::ContextLock::WRITE_MODE, "write", lockIterations);
+  benchContextLock(out, first, mace::ContextLock::READ_MODE, "read", lockIterations);
+
+  const uint32_t sizes[] = { 0, 16, 256, 4096, 65536 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    benchSnapshot(out, first, sizes[i], snapshotWork);
+  }
+  out << "\n  ]\n}" << std::endl;
+  return 0;
+}
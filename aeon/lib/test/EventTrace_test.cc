@@ -0,0 +1,110 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include <vector>
+#include "EventTrace.h"
+#include "ThreadStructure.h"
+
+BOOST_AUTO_TEST_CASE( SampledSpans )
+{
+  const std::string path = "EventTrace_test.bin";
+  mace::EventTrace::open(path, 1);
+  mace::OrderID id(3, 7);
+  mace::OrderID other(3, 8);
+
+  mace::EventTrace::sampleNewEvent(id, 3);
+  BOOST_REQUIRE( mace::EventTrace::isSampled(id) );
+  BOOST_REQUIRE( !mace::EventTrace::isSampled(other) );
+  BOOST_REQUIRE_EQUAL( mace::EventTrace::flagsFor(id), mace::EventTrace::SAMPLED );
+  BOOST_REQUIRE_EQUAL( mace::EventTrace::flagsFor(other), 0 );
+  {
+    mace::EventTrace::Span lockWait(mace::EventTrace::LOCK_WAIT, id, 5);
+    mace::EventTrace::Span ignored(mace::EventTrace::LOCK_WAIT, other, 5);
+  }
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, id, 5);
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, other, 5);
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, other);
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, id);
+
+  // a message flagged by another node makes the event sampled here too
+  mace::EventTrace::adopt(other, 0);
+  BOOST_REQUIRE( !mace::EventTrace::isSampled(other) );
+  mace::EventTrace::adopt(other, mace::EventTrace::SAMPLED);
+  BOOST_REQUIRE( mace::EventTrace::isSampled(other) );
+  mace::EventTrace::record(mace::EventTrace::COMMIT, other, 5, 10, 10);
+  mace::EventTrace::close();
+  BOOST_REQUIRE( !mace::EventTrace::isSampled(id) );
+
+  uint32_t pid = 0;
+  std::vector<mace::EventTrace::Record> records;
+  mace::EventTrace::readFile(path, pid, records);
+  unlink(path.c_str());
+  BOOST_REQUIRE_EQUAL( pid, (uint32_t)getpid() );
+  BOOST_REQUIRE_EQUAL( records.size(), 4u );
+  BOOST_REQUIRE_EQUAL( records[0].type, mace::EventTrace::TICKET );
+  BOOST_REQUIRE_EQUAL( records[1].type, mace::EventTrace::LOCK_WAIT );
+  BOOST_REQUIRE_EQUAL( records[2].type, mace::EventTrace::EXECUTE );
+  BOOST_REQUIRE_EQUAL( records[3].type, mace::EventTrace::COMMIT );
+  for (size_t i = 0; i < 3; i++) {
+    BOOST_REQUIRE_EQUAL( records[i].ctxId, 3u );
+    BOOST_REQUIRE_EQUAL( records[i].ticket, 7u );
+    BOOST_REQUIRE( records[i].begin <= records[i].end );
+  }
+  BOOST_REQUIRE_EQUAL( records[1].contextId, 5u );
+  BOOST_REQUIRE_EQUAL( records[3].ticket, 8u );
+  BOOST_REQUIRE_EQUAL( std::string(mace::EventTrace::spanName(records[2].type)), "execute" );
+}
+
+namespace {
+  void* endExecuteElsewhere(void* arg) {
+    // the event resumes here with its own thread specific data, as a coroutine would
+    void* mine = ThreadStructure::exchangeThreadSpecific(arg);
+    mace::EventTrace::end(mace::EventTrace::EXECUTE, mace::OrderID(4, 1));
+    ThreadStructure::exchangeThreadSpecific(mine);
+    return NULL;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( SpansFollowTheEvent )
+{
+  const std::string path = "EventTrace_test.bin";
+  mace::EventTrace::open(path, 1);
+  mace::OrderID id(4, 1);
+  mace::OrderID leaked(4, 2);
+  mace::EventTrace::sampleNewEvent(id, 4);
+  mace::EventTrace::sampleNewEvent(leaked, 4);
+
+  // begun in the event's own data, then switched out of this thread
+  void* threadData = ThreadStructure::exchangeThreadSpecific(NULL);
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, id, 5);
+  void* eventData = ThreadStructure::exchangeThreadSpecific(threadData);
+  BOOST_REQUIRE_EQUAL( ThreadStructure::openTraceSpans().count, 0u );
+  pthread_t t;
+  BOOST_REQUIRE_EQUAL( pthread_create(&t, NULL, endExecuteElsewhere, eventData), 0 );
+  pthread_join(t, NULL);
+  ThreadStructure::releaseThreadSpecific(eventData);
+
+  // a span never ended neither blocks the one around it nor fills the stack
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, leaked, 5);
+  mace::EventTrace::begin(mace::EventTrace::ROUTINE, leaked, 5);
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, leaked);
+  BOOST_REQUIRE_EQUAL( ThreadStructure::openTraceSpans().count, 0u );
+  for (unsigned i = 0; i <= mace::EventTrace::OpenSpans::MAX; i++) {
+    mace::EventTrace::begin(mace::EventTrace::ROUTINE, leaked, 5);
+  }
+  mace::EventTrace::begin(mace::EventTrace::EXECUTE, leaked, 5);
+  mace::EventTrace::end(mace::EventTrace::EXECUTE, leaked);
+  mace::EventTrace::close();
+
+  uint32_t pid = 0;
+  std::vector<mace::EventTrace::Record> records;
+  mace::EventTrace::readFile(path, pid, records);
+  unlink(path.c_str());
+  BOOST_REQUIRE_EQUAL( records.size(), 5u );
+  BOOST_REQUIRE_EQUAL( records[2].type, mace::EventTrace::EXECUTE );
+  BOOST_REQUIRE_EQUAL( records[2].ticket, 1u );
+  BOOST_REQUIRE_EQUAL( records[3].type, mace::EventTrace::EXECUTE );
+  BOOST_REQUIRE_EQUAL( records[3].ticket, 2u );
+  BOOST_REQUIRE_EQUAL( records[4].type, mace::EventTrace::EXECUTE );
+}
@@ -0,0 +1,64 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "FixedLayout.h"
+
+BOOST_AUTO_TEST_SUITE( lib_FixedLayout )
+
+BOOST_AUTO_TEST_CASE( PackedMatchesFieldwise )
+{
+  const uint8_t type = 9;
+  const uint16_t port = 5377;
+  const int32_t delta = -123456;
+  const uint64_t key = 0x0102030405060708ULL;
+  const bool found = true;
+  const double ratio = 0.25;
+
+  std::string fieldwise;
+  mace::serialize(fieldwise, &type);
+  mace::serialize(fieldwise, &port);
+  mace::serialize(fieldwise, &delta);
+  mace::serialize(fieldwise, &key);
+  mace::serialize(fieldwise, &found);
+  mace::serialize(fieldwise, &ratio);
+
+  char buf[24];
+  mace::packFixed(buf, &type);
+  mace::packFixed(buf + 1, &port);
+  mace::packFixed(buf + 3, &delta);
+  mace::packFixed(buf + 7, &key);
+  mace::packFixed(buf + 15, &found);
+  mace::packFixed(buf + 16, &ratio);
+  BOOST_REQUIRE_EQUAL( fieldwise, std::string(buf, sizeof(buf)) );
+
+  std::istringstream in(fieldwise);
+  char read[24];
+  mace::readFixed(in, read, sizeof(read));
+  uint8_t t;
+  uint16_t p;
+  int32_t d;
+  uint64_t k;
+  bool f;
+  double r;
+  mace::unpackFixed(read, &t);
+  mace::unpackFixed(read + 1, &p);
+  mace::unpackFixed(read + 3, &d);
+  mace::unpackFixed(read + 7, &k);
+  mace::unpackFixed(read + 15, &f);
+  mace::unpackFixed(read + 16, &r);
+  BOOST_REQUIRE_EQUAL( t, type );
+  BOOST_REQUIRE_EQUAL( p, port );
+  BOOST_REQUIRE_EQUAL( d, delta );
+  BOOST_REQUIRE_EQUAL( k, key );
+  BOOST_REQUIRE_EQUAL( f, found );
+  BOOST_REQUIRE_EQUAL( r, ratio );
+}
+
+BOOST_AUTO_TEST_CASE( ShortReadThrows )
+{
+  std::istringstream in(std::string("abc"));
+  char buf[8];
+  BOOST_REQUIRE_THROW( mace::readFixed(in, buf, sizeof(buf)), mace::SerializationException );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
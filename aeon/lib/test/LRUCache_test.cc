@@ -0,0 +1,74 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "LRUCache.h"
+
+BOOST_AUTO_TEST_SUITE( lib_LRUCache )
+
+BOOST_AUTO_TEST_CASE( EvictsLeastRecentlyUsedClean )
+{
+  mace::LRUCache<int, std::string> cache(3);
+  cache.add(1, "one");
+  cache.add(2, "two");
+  cache.add(3, "three");
+  std::string v;
+  BOOST_REQUIRE( cache.get(1, v) );
+  BOOST_REQUIRE_EQUAL( v, "one" );
+  cache.add(4, "four");
+  BOOST_REQUIRE( !cache.containsKey(2) );
+  BOOST_REQUIRE( cache.containsKey(1) );
+  BOOST_REQUIRE( cache.containsKey(3) );
+  BOOST_REQUIRE( cache.containsKey(4) );
+  BOOST_REQUIRE_EQUAL( cache.getSize(), 3u );
+  BOOST_REQUIRE_EQUAL( cache.getEvictions(), static_cast<uint64_t>(1) );
+  BOOST_REQUIRE_EQUAL( cache.getHits(), static_cast<uint64_t>(4) );
+  BOOST_REQUIRE_EQUAL( cache.getMisses(), static_cast<uint64_t>(1) );
+}
+
+BOOST_AUTO_TEST_CASE( DirtyEntriesAreNotEvicted )
+{
+  mace::LRUCache<unsigned, std::string> cache(3);
+  cache.addDirty(1, "a");
+  cache.add(2, "b");
+  cache.addDirty(3, "c");
+  cache.add(4, "d");
+  BOOST_REQUIRE( !cache.containsKey(2) );
+  BOOST_REQUIRE( cache.containsKey(1) );
+  BOOST_REQUIRE_EQUAL( cache.getLastDirtyKey(), 1u );
+
+  cache.clearDirty(1);
+  BOOST_REQUIRE_EQUAL( cache.getLastDirtyKey(), 3u );
+  cache.addDirty(5, "e");
+  // 4 is now the least recently used clean entry
+  BOOST_REQUIRE( !cache.containsKey(4) );
+  BOOST_REQUIRE( cache.isFullDirty() == false );
+  cache.addDirty(1, "a2");
+  BOOST_REQUIRE( cache.isFullDirty() );
+
+  unsigned k;
+  std::string v;
+  BOOST_REQUIRE( cache.getLastDirty(k, v) );
+  BOOST_REQUIRE_EQUAL( k, 3u );
+  cache.clearLastDirty();
+  cache.erase(5);
+  BOOST_REQUIRE_EQUAL( cache.getLastDirtyKey(), 1u );
+  BOOST_REQUIRE_EQUAL( cache.getDirty(1), "a2" );
+  cache.clearLastDirty();
+  BOOST_REQUIRE( !cache.hasDirty() );
+}
+
+BOOST_AUTO_TEST_CASE( ShardsSplitCapacity )
+{
+  mace::ShardedLRUCache<int, int> cache(64, 4);
+  for (int i = 0; i < 1000; i++) {
+    cache.add(i, i * 2);
+  }
+  BOOST_REQUIRE_EQUAL( cache.getSize(), 64u );
+  BOOST_REQUIRE_EQUAL( cache.getEvictions(), static_cast<uint64_t>(936) );
+  int v;
+  BOOST_REQUIRE( cache.get(999, v) );
+  BOOST_REQUIRE_EQUAL( v, 1998 );
+  BOOST_REQUIRE( !cache.get(0, v) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "LoadForecast.h"
+
+BOOST_AUTO_TEST_SUITE( lib_LoadForecast )
+
+BOOST_AUTO_TEST_CASE( EwmaFollowsLevel )
+{
+  mace::LoadForecast ewma(0.5, 0);
+  BOOST_CHECK_EQUAL(ewma.forecast(1), 0);
+  for (int i = 0; i < 20; i++) {
+    ewma.update(40);
+  }
+  BOOST_CHECK_CLOSE(ewma.forecast(0), 40.0, 0.001);
+  BOOST_CHECK_CLOSE(ewma.forecast(5), 40.0, 0.001);
+
+  ewma.update(80);
+  BOOST_CHECK_CLOSE(ewma.forecast(0), 60.0, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE( TrendExtrapolates )
+{
+  mace::LoadForecast holt(0.5, 0.3);
+  for (int i = 1; i <= 30; i++) {
+    holt.update(10.0 * i);
+  }
+  BOOST_CHECK_CLOSE(holt.getTrend(), 10.0, 1);
+  BOOST_CHECK_CLOSE(holt.forecast(3), 330.0, 1);
+}
+
+BOOST_AUTO_TEST_CASE( SeasonalCycle )
+{
+  const double cycle[] = { 20, 60, 90, 40 };
+  mace::LoadForecast hw(0.3, 0.1, 0.5, 4);
+  for (int i = 0; i < 200; i++) {
+    hw.update(cycle[i % 4]);
+  }
+  // the next sample starts a new cycle
+  for (uint32_t step = 1; step <= 4; step++) {
+    BOOST_CHECK_CLOSE(hw.forecast(step), cycle[(step - 1) % 4], 5);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( ServerLoadFollowsArrivals )
+{
+  mace::ServerLoadForecast server(0.5, 0.3);
+  for (int i = 0; i < 10; i++) {
+    server.update(20, 100, 0);
+  }
+  BOOST_CHECK_CLOSE(server.forecast(2, 1000), 20.0, 1);
+  // arrivals keep growing after the CPU usage stops at 100
+  server.update(50, 250, 0);
+  server.update(80, 400, 0);
+  server.update(100, 600, 0);
+  server.update(100, 800, 0);
+  BOOST_CHECK(server.forecast(1, 1000) > 150);
+
+  // a growing queue means the server is saturated, whatever its CPU usage
+  mace::ServerLoadForecast saturated;
+  for (int i = 0; i < 5; i++) {
+    saturated.update(60, 100, 500.0 * i);
+  }
+  BOOST_CHECK_EQUAL(saturated.forecast(1, 1000), 100);
+  BOOST_CHECK(saturated.forecast(1, 0) < 100);
+}
+
+BOOST_AUTO_TEST_CASE( PolicyHysteresis )
+{
+  mace::AutoscalePolicy policy(70, 30, 2, 3, 2);
+  // one busy period is not enough
+  BOOST_CHECK_EQUAL(policy.decide(160, 2, 10), 0);
+  BOOST_CHECK_EQUAL(policy.decide(100, 2, 10), 0);
+  BOOST_CHECK_EQUAL(policy.decide(160, 2, 10), 0);
+  // the second one scales to 50 per server
+  BOOST_CHECK_EQUAL(policy.decide(160, 2, 10), 2);
+  // cooldown
+  BOOST_CHECK_EQUAL(policy.decide(400, 4, 10), 0);
+  BOOST_CHECK_EQUAL(policy.decide(400, 4, 10), 0);
+
+  // no more servers than there are
+  BOOST_CHECK_EQUAL(policy.decide(400, 4, 5), 0);
+  BOOST_CHECK_EQUAL(policy.decide(400, 4, 5), 1);
+}
+
+BOOST_AUTO_TEST_CASE( PolicyScalesDownSlowly )
+{
+  mace::AutoscalePolicy policy(70, 30, 2, 3, 0);
+  BOOST_CHECK_EQUAL(policy.decide(80, 4, 4), 0);
+  BOOST_CHECK_EQUAL(policy.decide(80, 4, 4), 0);
+  BOOST_CHECK_EQUAL(policy.decide(80, 4, 4), -1);
+  BOOST_CHECK_EQUAL(policy.decide(80, 3, 4), 0);
+  BOOST_CHECK_EQUAL(policy.decide(80, 3, 4), 0);
+  BOOST_CHECK_EQUAL(policy.decide(80, 3, 4), -1);
+  BOOST_CHECK_EQUAL(policy.decide(20, 1, 4), 0);
+
+  // 75 on two servers is under 40 per server, but would be too much for one
+  mace::AutoscalePolicy narrow(70, 40, 2, 1, 0);
+  for (int i = 0; i < 5; i++) {
+    BOOST_CHECK_EQUAL(narrow.decide(75, 2, 4), 0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
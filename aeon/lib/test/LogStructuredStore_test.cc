@@ -0,0 +1,163 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <stdio.h>
+#include "FileUtil.h"
+#include "LogStructuredStore.h"
+
+namespace {
+  const std::string STORE_DIR = "LogStructuredStore_test.d";
+
+  void clearDir(const std::string& dir) {
+    if (FileUtil::fileIsDir(dir)) {
+      StringList names;
+      FileUtil::readDir(dir, names);
+      for (StringList::const_iterator i = names.begin(); i != names.end(); i++) {
+        if (FileUtil::fileIsDir(dir + "/" + *i)) {
+          clearDir(dir + "/" + *i);
+        }
+        else {
+          FileUtil::unlink(dir + "/" + *i);
+        }
+      }
+      FileUtil::rmdir(dir);
+    }
+  }
+
+  std::string keyFor(int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+  }
+
+  std::string valueFor(int i, int version) {
+    return std::string(1 + i % 37, 'a' + (i + version) % 26);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_LogStructuredStore )
+
+BOOST_AUTO_TEST_CASE( ReadsSpanMemtableAndSegments )
+{
+  clearDir(STORE_DIR);
+  mace::LogStructuredStore store(STORE_DIR, 8192, 100);
+  store.open();
+  for (int i = 0; i < 2000; i++) {
+    store.put(keyFor(i), valueFor(i, 0));
+  }
+  for (int i = 0; i < 2000; i += 2) {
+    store.put(keyFor(i), valueFor(i, 1));
+  }
+  for (int i = 0; i < 2000; i += 3) {
+    store.erase(keyFor(i));
+  }
+  BOOST_REQUIRE( store.getSegmentCount() > 1 );
+
+  std::string value;
+  for (int i = 0; i < 2000; i++) {
+    if (i % 3 == 0) {
+      BOOST_REQUIRE( !store.get(keyFor(i), value) );
+    }
+    else {
+      BOOST_REQUIRE( store.get(keyFor(i), value) );
+      BOOST_REQUIRE_EQUAL( value, valueFor(i, i % 2 == 0 ? 1 : 0) );
+    }
+  }
+  BOOST_REQUIRE( !store.get("missing", value) );
+
+  // bounded scan in key order, newest value wins and tombstones are hidden
+  mace::KeyValueStore::EntryList entries;
+  std::string next;
+  BOOST_REQUIRE( !store.scan(keyFor(100), keyFor(200), entries, 1 << 20, next) );
+  BOOST_REQUIRE_EQUAL( entries.size(), static_cast<size_t>(67) );
+  int expected = 100;
+  for (size_t i = 0; i < entries.size(); i++, expected++) {
+    if (expected % 3 == 0) {
+      expected++;
+    }
+    BOOST_REQUIRE_EQUAL( entries[i].first, keyFor(expected) );
+    BOOST_REQUIRE_EQUAL( entries[i].second, valueFor(expected, expected % 2 == 0 ? 1 : 0) );
+  }
+
+  // chunked scan resumes where the previous chunk stopped
+  size_t total = 0;
+  next = "";
+  bool more = true;
+  while (more) {
+    entries.clear();
+    std::string from = next;
+    more = store.scan(from, "", entries, 1024, next);
+    total += entries.size();
+  }
+  BOOST_REQUIRE_EQUAL( total, static_cast<size_t>(1333) );
+}
+
+BOOST_AUTO_TEST_CASE( ReopenRecoversLogAndSegments )
+{
+  clearDir(STORE_DIR);
+  {
+    mace::LogStructuredStore store(STORE_DIR, 8192, 100);
+    store.open();
+    for (int i = 0; i < 1000; i++) {
+      store.put(keyFor(i), valueFor(i, 0));
+    }
+    store.erase(keyFor(999));
+    store.flush();
+  }
+  mace::LogStructuredStore store(STORE_DIR, 8192, 100);
+  store.open();
+  std::string value;
+  for (int i = 0; i < 999; i++) {
+    BOOST_REQUIRE( store.get(keyFor(i), value) );
+    BOOST_REQUIRE_EQUAL( value, valueFor(i, 0) );
+  }
+  BOOST_REQUIRE( !store.get(keyFor(999), value) );
+}
+
+BOOST_AUTO_TEST_CASE( CompactionDropsTombstones )
+{
+  clearDir(STORE_DIR);
+  {
+    mace::LogStructuredStore store(STORE_DIR, 4096, 3);
+    store.open();
+    for (int i = 0; i < 3000; i++) {
+      store.put(keyFor(i % 500), valueFor(i, i / 500));
+    }
+    for (int i = 0; i < 250; i++) {
+      store.erase(keyFor(i));
+    }
+    store.flushMemtable();
+    store.compact();
+    BOOST_REQUIRE_EQUAL( store.getSegmentCount(), static_cast<size_t>(1) );
+    BOOST_REQUIRE_EQUAL( store.approximateCount(), static_cast<uint64_t>(250) );
+  }
+  mace::LogStructuredStore store(STORE_DIR, 4096, 3);
+  store.open();
+  BOOST_REQUIRE_EQUAL( store.getSegmentCount(), static_cast<size_t>(1) );
+  std::string value;
+  for (int i = 0; i < 500; i++) {
+    BOOST_REQUIRE_EQUAL( store.get(keyFor(i), value), i >= 250 );
+    if (i >= 250) {
+      BOOST_REQUIRE_EQUAL( value, valueFor(2500 + i, 5) );
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( MemoryEngineMatchesInterface )
+{
+  mace::KeyValueStore* store = mace::KeyValueStore::create("memory", "");
+  store->put("b", "2");
+  store->put("a", "1");
+  store->put("c", "3");
+  store->erase("c");
+  mace::KeyValueStore::EntryList entries;
+  std::string next;
+  BOOST_REQUIRE( !store->scan("", "", entries, 1024, next) );
+  BOOST_REQUIRE_EQUAL( entries.size(), static_cast<size_t>(2) );
+  BOOST_REQUIRE_EQUAL( entries[0].first, "a" );
+  BOOST_REQUIRE_EQUAL( entries[1].second, "2" );
+  BOOST_REQUIRE_THROW( mace::KeyValueStore::create("bogus", ""), Exception );
+  delete store;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include "MessageDispatch.h"
+
+namespace {
+  // laid out like a macec generated message
+  class PooledMessage : public mace::Message, public mace::PrintPrintable {
+  public:
+    static const uint8_t messageType = 7;
+    uint8_t getType() const { return messageType; }
+    std::string toString() const { return mace::PrintPrintable::toString(); }
+    void print(std::ostream& out) const { out << "PooledMessage()"; }
+    void serialize(std::string& str) const {
+      uint8_t t = messageType;
+      mace::serialize(str, &t);
+    }
+    int deserialize(std::istream& in) throw (mace::SerializationException) {
+      uint8_t t;
+      return mace::deserialize(in, &t);
+    }
+    static void* operator new(size_t size) { return mace::MessagePool<PooledMessage>::allocate(size); }
+    static void operator delete(void* p, size_t size) { mace::MessagePool<PooledMessage>::release(p, size); }
+  };
+
+  class Receiver {
+  public:
+    Receiver() : handled(0) {}
+    void handle(mace::Message* msg) { handled += msg->getType(); }
+    int handled;
+  };
+
+  struct Payload {
+    char bytes[32];
+  };
+  typedef mace::MessagePool<Payload> PayloadPool;
+
+  void* releaseAll(void* arg) {
+    std::vector<void*>* blocks = static_cast<std::vector<void*>*>(arg);
+    for (size_t i = 0; i < blocks->size(); i++) {
+      PayloadPool::release((*blocks)[i], sizeof(Payload));
+    }
+    return NULL;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_MessageDispatch )
+
+BOOST_AUTO_TEST_CASE( PoolReusesBlocks )
+{
+  PooledMessage* m = new PooledMessage;
+  delete m;
+  BOOST_REQUIRE_EQUAL( mace::MessagePool<PooledMessage>::size(), 1u );
+  mace::Message* n = mace::newMessage<PooledMessage>();
+  BOOST_REQUIRE_EQUAL( static_cast<void*>(n), static_cast<void*>(m) );
+  BOOST_REQUIRE_EQUAL( mace::MessagePool<PooledMessage>::size(), 0u );
+  delete n;
+  BOOST_REQUIRE_EQUAL( mace::MessagePool<PooledMessage>::size(), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( PoolIsBounded )
+{
+  const size_t n = mace::MessagePool<PooledMessage>::MAX_FREE + 10;
+  std::vector<PooledMessage*> msgs;
+  for (size_t i = 0; i < n; i++) {
+    msgs.push_back(new PooledMessage);
+  }
+  for (size_t i = 0; i < n; i++) {
+    delete msgs[i];
+  }
+  BOOST_REQUIRE_EQUAL( mace::MessagePool<PooledMessage>::size(), mace::MessagePool<PooledMessage>::MAX_FREE );
+}
+
+BOOST_AUTO_TEST_CASE( OverflowFeedsOtherThreads )
+{
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < 2 * PayloadPool::LOCAL_FREE; i++) {
+    blocks.push_back(PayloadPool::allocate(sizeof(Payload)));
+  }
+  pthread_t releaser;
+  BOOST_REQUIRE_EQUAL( pthread_create(&releaser, NULL, releaseAll, &blocks), 0 );
+  BOOST_REQUIRE_EQUAL( pthread_join(releaser, NULL), 0 );
+  // the releasing thread spilled blocks as its list filled and flushed the rest on exit
+  BOOST_REQUIRE_EQUAL( PayloadPool::size(), 2 * PayloadPool::LOCAL_FREE );
+
+  void* p = PayloadPool::allocate(sizeof(Payload));
+  BOOST_REQUIRE( std::find(blocks.begin(), blocks.end(), p) != blocks.end() );
+  BOOST_REQUIRE_EQUAL( PayloadPool::size(), 2 * PayloadPool::LOCAL_FREE - 1 );
+  PayloadPool::release(p, sizeof(Payload));
+}
+
+BOOST_AUTO_TEST_CASE( TableDispatchesByType )
+{
+  typedef void (Receiver::*HandlerFn)(mace::Message*);
+  mace::MessageDispatchTable<HandlerFn> table;
+  table.set(PooledMessage::messageType, &Receiver::handle);
+  BOOST_REQUIRE( table.get(PooledMessage::messageType + 1) == NULL );
+
+  Receiver r;
+  PooledMessage m;
+  HandlerFn const h = table.get(m.getType());
+  BOOST_REQUIRE( h != NULL );
+  (r.*h)(&m);
+  BOOST_REQUIRE_EQUAL( r.handled, 7 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
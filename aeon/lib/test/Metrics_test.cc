@@ -0,0 +1,65 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <pthread.h>
+#include "Metrics.h"
+
+namespace {
+  const int THREADS = 8;
+  const int ADDS = 100000;
+
+  void* addMany(void* arg) {
+    mace::Counter* c = (mace::Counter*)arg;
+    for (int i = 0; i < ADDS; i++) {
+      c->increment();
+    }
+    return NULL;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_Metrics )
+
+BOOST_AUTO_TEST_CASE( CounterSumsShards )
+{
+  mace::Counter* c = mace::Metrics::counter("Metrics_test::counter");
+  BOOST_REQUIRE( c == mace::Metrics::counter("Metrics_test::counter") );
+  pthread_t threads[THREADS];
+  for (int i = 0; i < THREADS; i++) {
+    pthread_create(&threads[i], NULL, addMany, c);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  BOOST_REQUIRE_EQUAL( c->get(), static_cast<uint64_t>(THREADS * ADDS) );
+}
+
+BOOST_AUTO_TEST_CASE( HistogramBuckets )
+{
+  for (uint64_t v = 0; v < 100000; v += 7) {
+    unsigned b = mace::Histogram::bucketFor(v);
+    BOOST_REQUIRE( mace::Histogram::bucketLow(b) <= v );
+    BOOST_REQUIRE( mace::Histogram::bucketHigh(b) >= v );
+    // relative error is bounded by the sub-bucket resolution
+    BOOST_REQUIRE( mace::Histogram::bucketHigh(b) - mace::Histogram::bucketLow(b) <= v / mace::Histogram::SUB_BUCKETS );
+  }
+  BOOST_REQUIRE_EQUAL( mace::Histogram::bucketFor(UINT64_MAX), mace::Histogram::BUCKETS - 1 );
+}
+
+BOOST_AUTO_TEST_CASE( HistogramPercentiles )
+{
+  mace::Histogram* h = mace::Metrics::histogram("Metrics_test::histogram");
+  for (uint64_t v = 1; v <= 10000; v++) {
+    h->record(v);
+  }
+  BOOST_REQUIRE_EQUAL( h->getCount(), static_cast<uint64_t>(10000) );
+  BOOST_REQUIRE_CLOSE( h->getMean(), 5000.5, 0.001 );
+  BOOST_REQUIRE_CLOSE( (double)h->percentile(50), 5000.0, 100.0 / mace::Histogram::SUB_BUCKETS );
+  BOOST_REQUIRE_CLOSE( (double)h->percentile(99), 9900.0, 100.0 / mace::Histogram::SUB_BUCKETS );
+  BOOST_REQUIRE_CLOSE( (double)h->percentile(99.9), 9990.0, 100.0 / mace::Histogram::SUB_BUCKETS );
+  BOOST_REQUIRE( h->getMax() >= 10000 );
+  h->reset();
+  BOOST_REQUIRE_EQUAL( h->getCount(), static_cast<uint64_t>(0) );
+  BOOST_REQUIRE_EQUAL( h->percentile(50), static_cast<uint64_t>(0) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
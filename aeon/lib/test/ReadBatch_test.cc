@@ -0,0 +1,42 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include "ReadBatch.h"
+
+BOOST_AUTO_TEST_SUITE( lib_ReadBatch )
+
+BOOST_AUTO_TEST_CASE( ReadersJoin )
+{
+  mace::ReadBatch b;
+  // nothing admitted yet: the first reader waits for its turn like anyone else
+  BOOST_CHECK(!b.canJoin(true, 5, 4, 64));
+  b.admitted(5, true);
+  BOOST_CHECK(b.canJoin(true, 6, 5, 64));
+  BOOST_CHECK(!b.canJoin(false, 6, 5, 64));
+  b.admitted(6, true);
+  BOOST_CHECK(b.canJoin(true, 7, 5, 64));
+  // the batch is capped at maxBatch tickets ahead of now_serving
+  BOOST_CHECK(!b.canJoin(true, 7, 5, 2));
+}
+
+BOOST_AUTO_TEST_CASE( WriterClosesBatch )
+{
+  mace::ReadBatch b;
+  b.admitted(5, true);
+  b.admitted(6, false);
+  BOOST_CHECK(!b.canJoin(true, 7, 5, 64));
+}
+
+BOOST_AUTO_TEST_CASE( ReaderAfterMigrationTicket )
+{
+  mace::ReadBatch b;
+  b.admitted(5, true);
+  // a migration takes ticket 6 through requireExecuteTicket, outside the batch
+  const uint64_t next = 7;
+  BOOST_CHECK(!b.canJoin(true, next, 5, 64));
+  // once everything before it has been served a reader starts a new batch
+  b.admitted(next, true);
+  BOOST_CHECK(b.canJoin(true, next + 1, 7, 64));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string.h>
+#include <deque>
+#include <sstream>
+#include "ShmRing.h"
+
+namespace {
+  bool push(mace::ShmRing& ring, const std::string& a, const std::string& b, bool& wasEmpty) {
+    const std::string* parts[] = { &a, &b };
+    return ring.push(parts, 2, wasEmpty);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_ShmRing )
+
+BOOST_AUTO_TEST_CASE( PushPop )
+{
+  std::vector<char> segment(mace::ShmRing::segmentSize(64));
+  mace::ShmRing ring(&segment[0], segment.size(), true);
+  BOOST_CHECK(ring.isValid());
+  BOOST_CHECK(ring.empty());
+
+  bool wasEmpty = false;
+  BOOST_CHECK(push(ring, "head", "er", wasEmpty));
+  BOOST_CHECK(wasEmpty);
+  BOOST_CHECK(push(ring, "", "body", wasEmpty));
+  BOOST_CHECK(!wasEmpty);
+  BOOST_CHECK_EQUAL(ring.size(), 2 * sizeof(uint32_t) + 10);
+
+  mace::ShmRing attached(&segment[0], segment.size(), false);
+  BOOST_CHECK(attached.isValid());
+  std::string m;
+  BOOST_CHECK(attached.pop(m));
+  BOOST_CHECK_EQUAL(m, "header");
+  BOOST_CHECK(attached.pop(m));
+  BOOST_CHECK_EQUAL(m, "body");
+  BOOST_CHECK(!attached.pop(m));
+  BOOST_CHECK(ring.empty());
+}
+
+BOOST_AUTO_TEST_CASE( FullAndWrapAround )
+{
+  std::vector<char> segment(mace::ShmRing::segmentSize(40));
+  mace::ShmRing ring(&segment[0], segment.size(), true);
+  BOOST_CHECK(ring.fits(36));
+  BOOST_CHECK(!ring.fits(37));
+
+  bool wasEmpty;
+  const std::string ten(10, 'x');
+  BOOST_CHECK(push(ring, ten, "", wasEmpty));
+  BOOST_CHECK(push(ring, ten, "", wasEmpty));
+  // 28 of 40 bytes are used
+  BOOST_CHECK(!push(ring, ten, "", wasEmpty));
+
+  std::deque<std::string> expected(2, ten);
+  std::string m;
+  for (int i = 0; i < 100; i++) {
+    // messages and their length prefixes now straddle the end of the ring
+    BOOST_REQUIRE(ring.pop(m));
+    BOOST_CHECK_EQUAL(m, expected.front());
+    expected.pop_front();
+    std::ostringstream os;
+    os << i;
+    BOOST_REQUIRE(push(ring, os.str(), ten.substr(os.str().size()), wasEmpty));
+    BOOST_CHECK(!wasEmpty);
+    expected.push_back(os.str() + ten.substr(os.str().size()));
+  }
+  while (!expected.empty()) {
+    BOOST_REQUIRE(ring.pop(m));
+    BOOST_CHECK_EQUAL(m, expected.front());
+    expected.pop_front();
+  }
+  BOOST_CHECK(!ring.pop(m));
+}
+
+BOOST_AUTO_TEST_CASE( FullRingFlagsProducer )
+{
+  std::vector<char> segment(mace::ShmRing::segmentSize(40));
+  mace::ShmRing ring(&segment[0], segment.size(), true);
+  bool wasEmpty;
+  const std::string ten(10, 'x');
+  BOOST_CHECK(push(ring, ten, "", wasEmpty));
+  BOOST_CHECK(push(ring, ten, "", wasEmpty));
+  BOOST_CHECK(!ring.producerWaiting());
+  BOOST_CHECK(!push(ring, ten, "", wasEmpty));
+
+  std::string m;
+  BOOST_REQUIRE(ring.pop(m));
+  BOOST_CHECK(ring.producerWaiting());
+  BOOST_CHECK(!ring.producerWaiting());
+  BOOST_CHECK(push(ring, ten, "", wasEmpty));
+}
+
+BOOST_AUTO_TEST_CASE( BadLengthRejected )
+{
+  std::vector<char> segment(mace::ShmRing::segmentSize(40));
+  mace::ShmRing ring(&segment[0], segment.size(), true);
+  bool wasEmpty;
+  BOOST_CHECK(push(ring, "four", "", wasEmpty));
+
+  // a peer claims more bytes than it pushed
+  const uint32_t len = 1 << 30;
+  memcpy(&segment[segment.size() - 40], &len, sizeof(len));
+  std::string m;
+  BOOST_CHECK_THROW(ring.pop(m), ReadException);
+  BOOST_CHECK(m.empty());
+}
+
+BOOST_AUTO_TEST_CASE( AcrossProcesses )
+{
+  const size_t size = mace::ShmRing::segmentSize(4096);
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  BOOST_REQUIRE(base != MAP_FAILED);
+  mace::ShmRing ring(base, size, true);
+  const uint32_t count = 100000;
+
+  pid_t child = fork();
+  BOOST_REQUIRE(child >= 0);
+  if (child == 0) {
+    mace::ShmRing producer(base, size, false);
+    for (uint32_t i = 0; i < count; i++) {
+      std::string n((const char*)&i, sizeof(i));
+      std::string pad(i % 100, 'p');
+      bool wasEmpty;
+      while (!push(producer, n, pad, wasEmpty)) {
+        sched_yield();
+      }
+    }
+    _exit(0);
+  }
+
+  std::string m;
+  uint32_t next = 0;
+  bool ordered = true;
+  while (next < count) {
+    if (!ring.pop(m)) {
+      sched_yield();
+      continue;
+    }
+    uint32_t n = 0;
+    memcpy(&n, m.data(), sizeof(n));
+    if (n != next || m.size() != sizeof(n) + next % 100) {
+      ordered = false;
+    }
+    next++;
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  BOOST_CHECK(ordered);
+  BOOST_CHECK(ring.empty());
+  munmap(base, size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <vector>
+#include "TDigest.h"
+
+namespace {
+  const int VALUES = 100000;
+
+  std::vector<double> shuffled() {
+    std::vector<double> v;
+    for (int i = 1; i <= VALUES; i++) {
+      v.push_back(i);
+    }
+    srand(1);
+    std::random_shuffle(v.begin(), v.end());
+    return v;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_TDigest )
+
+BOOST_AUTO_TEST_CASE( Empty )
+{
+  mace::TDigest d;
+  BOOST_REQUIRE_EQUAL(d.getCount(), 0u);
+  BOOST_REQUIRE_EQUAL(d.percentileToValue(0.5), 0);
+  BOOST_REQUIRE_EQUAL(d.valueToPercentile(1), 0);
+}
+
+BOOST_AUTO_TEST_CASE( SmallCountsAreExact )
+{
+  mace::TDigest d;
+  for (int i = 5; i >= 1; i--) {
+    d.update(i);
+  }
+  BOOST_REQUIRE_EQUAL(d.getCount(), 5u);
+  BOOST_REQUIRE_EQUAL(d.getMin(), 1);
+  BOOST_REQUIRE_EQUAL(d.getMax(), 5);
+  BOOST_REQUIRE_EQUAL(d.getAvg(), 3);
+  BOOST_REQUIRE_EQUAL(d.getCentroidCount(), 5u);
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.5), 3, 0.001);
+  BOOST_REQUIRE_EQUAL(d.percentileToValue(0), 1);
+  BOOST_REQUIRE_EQUAL(d.percentileToValue(1), 5);
+}
+
+BOOST_AUTO_TEST_CASE( UniformPercentiles )
+{
+  std::vector<double> v = shuffled();
+  mace::TDigest d;
+  for (size_t i = 0; i < v.size(); i++) {
+    d.update(v[i]);
+  }
+  BOOST_REQUIRE_EQUAL(d.getCount(), (uint64_t)VALUES);
+  BOOST_REQUIRE_LE(d.getCentroidCount(), 200u);
+  // tolerances are percent of the true value
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.5), VALUES * 0.5, 1);
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.9), VALUES * 0.9, 0.5);
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.99), VALUES * 0.99, 0.1);
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.999), VALUES * 0.999, 0.05);
+  BOOST_REQUIRE_CLOSE(d.percentileToValue(0.01), VALUES * 0.01, 2);
+  BOOST_REQUIRE_CLOSE(d.valueToPercentile(VALUES * 0.99), 0.99, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE( SkewedTail )
+{
+  // 99% fast values and a slow 1%, as in a latency distribution
+  mace::TDigest d;
+  for (int i = 0; i < VALUES; i++) {
+    d.update(i % 100 == 0 ? 10000 + i % 1000 : 100 + i % 10);
+  }
+  BOOST_REQUIRE_LE(d.percentileToValue(0.5), 110);
+  BOOST_REQUIRE_GE(d.percentileToValue(0.995), 10000);
+  BOOST_REQUIRE_EQUAL(d.getMax(), 10900);
+}
+
+BOOST_AUTO_TEST_CASE( MergeMatchesSingleDigest )
+{
+  std::vector<double> v = shuffled();
+  mace::TDigest whole;
+  mace::TDigest parts[4];
+  for (size_t i = 0; i < v.size(); i++) {
+    whole.update(v[i]);
+    parts[i % 4].update(v[i]);
+  }
+  mace::TDigest merged;
+  for (int i = 0; i < 4; i++) {
+    merged.merge(parts[i]);
+  }
+  BOOST_REQUIRE_EQUAL(merged.getCount(), whole.getCount());
+  BOOST_REQUIRE_EQUAL(merged.getMin(), whole.getMin());
+  BOOST_REQUIRE_EQUAL(merged.getMax(), whole.getMax());
+  BOOST_REQUIRE_CLOSE(merged.percentileToValue(0.5), whole.percentileToValue(0.5), 1);
+  BOOST_REQUIRE_CLOSE(merged.percentileToValue(0.99), whole.percentileToValue(0.99), 0.1);
+
+  merged.reset();
+  BOOST_REQUIRE_EQUAL(merged.getCount(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include "TicketWaitRing.h"
+
+namespace {
+  const uint64_t THREADS = 8;
+
+  /// tickets are served strictly in order, the way ContextLock serves execute tickets
+  struct TicketBooth {
+    pthread_mutex_t mutex;
+    mace::TicketWaitRing waiters;
+    uint64_t nowServing;
+    std::vector<uint64_t> served;
+    uint64_t rounds; ///< tickets served by each thread
+    uint32_t sleepMicros; ///< time each ticket holds the booth, to force waiters to sleep
+
+    TicketBooth(uint64_t rounds, uint32_t sleepMicros) : nowServing(0), rounds(rounds), sleepMicros(sleepMicros) {
+      pthread_mutex_init(&mutex, NULL);
+    }
+    ~TicketBooth() {
+      pthread_mutex_destroy(&mutex);
+    }
+  };
+
+  struct Worker {
+    TicketBooth* booth;
+    uint64_t id;
+  };
+
+  void* run(void* arg) {
+    Worker* w = static_cast<Worker*>(arg);
+    TicketBooth& booth = *w->booth;
+    // thread i owns tickets i, i + THREADS, ..., so every handoff goes to another thread
+    for (uint64_t ticket = w->id; ticket < THREADS * booth.rounds; ticket += THREADS) {
+      pthread_mutex_lock(&booth.mutex);
+      while (booth.nowServing != ticket) {
+        booth.waiters.wait(ticket, booth.mutex);
+      }
+      booth.served.push_back(ticket);
+      if (booth.sleepMicros > 0) {
+        pthread_mutex_unlock(&booth.mutex);
+        usleep(booth.sleepMicros);
+        pthread_mutex_lock(&booth.mutex);
+      }
+      booth.nowServing++;
+      booth.waiters.notify(booth.nowServing);
+      pthread_mutex_unlock(&booth.mutex);
+    }
+    return NULL;
+  }
+
+  void serveAll(TicketBooth& booth) {
+    pthread_t threads[THREADS];
+    Worker workers[THREADS];
+    for (uint64_t i = 0; i < THREADS; i++) {
+      workers[i].booth = &booth;
+      workers[i].id = i;
+      BOOST_REQUIRE(pthread_create(&threads[i], NULL, run, &workers[i]) == 0);
+    }
+    for (uint64_t i = 0; i < THREADS; i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_TicketWaitRing )
+
+BOOST_AUTO_TEST_CASE( ServesTicketsInOrder )
+{
+  TicketBooth booth(20000, 0);
+  serveAll(booth);
+  BOOST_REQUIRE_EQUAL(booth.served.size(), THREADS * booth.rounds);
+  for (uint64_t i = 0; i < booth.served.size(); i++) {
+    BOOST_REQUIRE_EQUAL(booth.served[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( WakesSleepingWaiters )
+{
+  // long critical sections exhaust the spin budget, so the waiters go to
+  // sleep and each handoff has to wake one
+  TicketBooth booth(50, 200);
+  serveAll(booth);
+  BOOST_REQUIRE_EQUAL(booth.served.size(), THREADS * booth.rounds);
+  for (uint64_t i = 0; i < booth.served.size(); i++) {
+    BOOST_REQUIRE_EQUAL(booth.served[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( NotifyWithoutWaitersIsHarmless )
+{
+  mace::TicketWaitRing ring;
+  BOOST_CHECK(!ring.hasWaiters(1));
+  ring.notify(1);
+  ring.notify(1 + mace::TicketWaitRing::SLOTS);
+  BOOST_CHECK(!ring.hasWaiters(1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
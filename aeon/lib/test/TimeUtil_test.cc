@@ -0,0 +1,34 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include "TimeUtil.h"
+
+BOOST_AUTO_TEST_CASE( MonotonicNeverGoesBack )
+{
+  uint64_t last = TimeUtil::monotimeu();
+  for (int i = 0; i < 1000000; i++) {
+    uint64_t now = TimeUtil::monotimeu();
+    BOOST_REQUIRE( now >= last );
+    last = now;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( MonotonicTracksElapsedTime )
+{
+  // compare against the wall clock over a short sleep; either clock source
+  // (TSC or CLOCK_MONOTONIC_RAW) should agree to well within a millisecond
+  uint64_t m0 = TimeUtil::monotimeu();
+  uint64_t w0 = TimeUtil::timeu();
+  uint64_t c0 = TimeUtil::coarsetimeu();
+  usleep(200*1000);
+  uint64_t m1 = TimeUtil::monotimeu();
+  uint64_t w1 = TimeUtil::timeu();
+  uint64_t c1 = TimeUtil::coarsetimeu();
+
+  BOOST_REQUIRE( m1 - m0 >= 200*1000 );
+  BOOST_REQUIRE_CLOSE( (double)(m1 - m0), (double)(w1 - w0), 0.5 );
+  // the coarse clock may lag by its resolution, a few ms at most
+  BOOST_REQUIRE_CLOSE( (double)(c1 - c0), (double)(m1 - m0), 5.0 );
+  BOOST_TEST_MESSAGE( "TSC clock: " << TimeUtil::isTscClock() );
+}
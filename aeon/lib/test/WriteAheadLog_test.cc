@@ -0,0 +1,208 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE libmace
+#include <boost/test/unit_test.hpp>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileUtil.h"
+#include "WriteAheadLog.h"
+
+namespace {
+  const std::string LOG_DIR = "WriteAheadLog_test.d";
+
+  void clearLogDir() {
+    if (FileUtil::fileIsDir(LOG_DIR)) {
+      StringList names;
+      FileUtil::readDir(LOG_DIR, names);
+      for (StringList::const_iterator i = names.begin(); i != names.end(); i++) {
+        FileUtil::unlink(LOG_DIR + "/" + *i);
+      }
+      FileUtil::rmdir(LOG_DIR);
+    }
+  }
+
+  std::string recordFor(uint64_t i) {
+    return std::string(1 + i % 97, 'a' + i % 26);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( lib_WriteAheadLog )
+
+BOOST_AUTO_TEST_CASE( ReplayAfterReopen )
+{
+  clearLogDir();
+  uint64_t lsn;
+  std::string snapshot;
+  std::vector<std::string> records;
+  {
+    mace::WriteAheadLog wal(LOG_DIR, 4096);
+    wal.open(lsn, snapshot, records);
+    BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(0) );
+    for (uint64_t i = 1; i <= 1000; i++) {
+      BOOST_REQUIRE_EQUAL( wal.append(recordFor(i)), i );
+      if (i % 10 == 0) {
+        wal.sync();
+      }
+    }
+    // group commit: one sync per ten records
+    BOOST_REQUIRE_EQUAL( wal.getSyncCount(), static_cast<uint64_t>(100) );
+    BOOST_REQUIRE_EQUAL( wal.getDurableLSN(), static_cast<uint64_t>(1000) );
+  }
+  mace::WriteAheadLog wal(LOG_DIR, 4096);
+  wal.open(lsn, snapshot, records);
+  BOOST_REQUIRE_EQUAL( lsn, static_cast<uint64_t>(0) );
+  BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(1000) );
+  for (uint64_t i = 1; i <= 1000; i++) {
+    BOOST_REQUIRE_EQUAL( records[i-1], recordFor(i) );
+  }
+  BOOST_REQUIRE_EQUAL( wal.append("next"), static_cast<uint64_t>(1001) );
+}
+
+BOOST_AUTO_TEST_CASE( CheckpointTrimsSegments )
+{
+  clearLogDir();
+  uint64_t lsn;
+  std::string snapshot;
+  std::vector<std::string> records;
+  StringList before;
+  {
+    mace::WriteAheadLog wal(LOG_DIR, 4096);
+    wal.open(lsn, snapshot, records);
+    for (uint64_t i = 1; i <= 1000; i++) {
+      wal.append(recordFor(i));
+      wal.sync();
+    }
+    FileUtil::readDir(LOG_DIR, before);
+    wal.checkpoint(600, "state at 600");
+  }
+  StringList after;
+  FileUtil::readDir(LOG_DIR, after);
+  BOOST_REQUIRE( after.size() < before.size() );
+
+  mace::WriteAheadLog wal(LOG_DIR, 4096);
+  wal.open(lsn, snapshot, records);
+  BOOST_REQUIRE_EQUAL( lsn, static_cast<uint64_t>(600) );
+  BOOST_REQUIRE_EQUAL( snapshot, "state at 600" );
+  BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(400) );
+  BOOST_REQUIRE_EQUAL( records.front(), recordFor(601) );
+}
+
+BOOST_AUTO_TEST_CASE( OpenLatestKeepsNewestState )
+{
+  clearLogDir();
+  uint64_t lsn;
+  std::string state;
+  {
+    mace::WriteAheadLog wal(LOG_DIR, 4096);
+    wal.openLatest(lsn, state);
+    BOOST_REQUIRE_EQUAL( lsn, static_cast<uint64_t>(0) );
+    BOOST_REQUIRE( state.empty() );
+    for (uint64_t i = 1; i <= 100; i++) {
+      wal.append(recordFor(i));
+    }
+    wal.checkpoint(100, "state at 100");
+    wal.sync();
+  }
+  {
+    mace::WriteAheadLog wal(LOG_DIR, 4096);
+    wal.openLatest(lsn, state);
+    BOOST_REQUIRE_EQUAL( lsn, static_cast<uint64_t>(100) );
+    BOOST_REQUIRE_EQUAL( state, "state at 100" );
+    wal.append(recordFor(101));
+    wal.append(recordFor(102));
+    wal.sync();
+  }
+  mace::WriteAheadLog wal(LOG_DIR, 4096);
+  wal.openLatest(lsn, state);
+  BOOST_REQUIRE_EQUAL( lsn, static_cast<uint64_t>(102) );
+  BOOST_REQUIRE_EQUAL( state, recordFor(102) );
+}
+
+BOOST_AUTO_TEST_CASE( TornTailIsDropped )
+{
+  clearLogDir();
+  uint64_t lsn;
+  std::string snapshot;
+  std::vector<std::string> records;
+  {
+    mace::WriteAheadLog wal(LOG_DIR);
+    wal.open(lsn, snapshot, records);
+    for (uint64_t i = 1; i <= 10; i++) {
+      wal.append(recordFor(i));
+    }
+    wal.sync();
+  }
+  StringList names;
+  FileUtil::readDir(LOG_DIR, names, true);
+  int fd = FileUtil::open(LOG_DIR + "/" + names.back(), O_WRONLY | O_APPEND);
+  FileUtil::write(fd, std::string("half a record"));
+  FileUtil::close(fd);
+
+  {
+    mace::WriteAheadLog wal(LOG_DIR);
+    wal.open(lsn, snapshot, records);
+    BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(10) );
+    BOOST_REQUIRE_EQUAL( wal.append(recordFor(11)), static_cast<uint64_t>(11) );
+    wal.sync();
+  }
+  mace::WriteAheadLog wal(LOG_DIR);
+  wal.open(lsn, snapshot, records);
+  BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(11) );
+  BOOST_REQUIRE_EQUAL( records.back(), recordFor(11) );
+  clearLogDir();
+}
+
+BOOST_AUTO_TEST_CASE( FailedSyncIsRetried )
+{
+  clearLogDir();
+  uint64_t lsn;
+  std::string snapshot;
+  std::vector<std::string> records;
+  {
+    mace::WriteAheadLog wal(LOG_DIR);
+    wal.open(lsn, snapshot, records);
+    for (uint64_t i = 1; i <= 10; i++) {
+      wal.append(recordFor(i));
+    }
+    wal.sync();
+
+    StringList names;
+    FileUtil::readDir(LOG_DIR, names, true);
+    std::string segment = LOG_DIR + "/" + names.back();
+    struct stat sbuf;
+    BOOST_REQUIRE_EQUAL( stat(segment.c_str(), &sbuf), 0 );
+    off_t durableSize = sbuf.st_size;
+
+    // the next write gets only partly into the segment
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit limited = saved;
+    limited.rlim_cur = durableSize + 10;
+    setrlimit(RLIMIT_FSIZE, &limited);
+    for (uint64_t i = 11; i <= 20; i++) {
+      wal.append(recordFor(i));
+    }
+    BOOST_REQUIRE_THROW( wal.sync(), IOException );
+    setrlimit(RLIMIT_FSIZE, &saved);
+
+    BOOST_REQUIRE_EQUAL( wal.getDurableLSN(), static_cast<uint64_t>(10) );
+    BOOST_REQUIRE_EQUAL( stat(segment.c_str(), &sbuf), 0 );
+    BOOST_REQUIRE_EQUAL( sbuf.st_size, durableSize );
+
+    wal.append(recordFor(21));
+    wal.sync();
+    BOOST_REQUIRE_EQUAL( wal.getDurableLSN(), static_cast<uint64_t>(21) );
+  }
+  mace::WriteAheadLog wal(LOG_DIR);
+  wal.open(lsn, snapshot, records);
+  BOOST_REQUIRE_EQUAL( records.size(), static_cast<size_t>(21) );
+  for (uint64_t i = 1; i <= 21; i++) {
+    BOOST_REQUIRE_EQUAL( records[i-1], recordFor(i) );
+  }
+  clearLogDir();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
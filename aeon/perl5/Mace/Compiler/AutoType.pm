@@ -66,6 +66,7 @@ use Class::MakeMethods::Template::Hash
      
 #Auto Type Options
      'boolean' => 'serialize',
+     'boolean' => 'compactSerialize',
      'boolean' => 'node',
      'string' => 'scoreType',
      'string' => 'scoreField',
@@ -119,6 +120,9 @@ sub validateAutoTypeOptions {
         if($name eq 'no') {
           $this->serialize(0);
         }
+        elsif($name eq 'compact') {
+          $this->compactSerialize(1);
+        }
         elsif(! $name eq 'yes') {
           Mace::Compiler::Globals::error('bad_type_option', $option->file(), $option->line(), "Invalid option with name $name and value $value");
         }
@@ -267,8 +271,18 @@ sub validateMessageOptions {
         }
       }
     }
+    elsif ($option->name() eq "serialize") {
+      while(my ($name, $value) = each(%{$option->options()})) {
+        if($name eq 'compact') {
+          $this->compactSerialize(1);
+        }
+        else {
+          Mace::Compiler::Globals::error('bad_type_option', $option->file(), $option->line(), "Invalid option with name $name and value $value (only serialize(compact) is supported for messages)");
+        }
+      }
+    }
     else {
-      Mace::Compiler::Globals::error('bad_type_option', $option->file(), $option->line(), "Invalid option ".$option->name()." (no options yet supported for messages)");
+      Mace::Compiler::Globals::error('bad_type_option', $option->file(), $option->line(), "Invalid option ".$option->name()." (only number and serialize are supported for messages)");
     }
   }
   foreach my $field ($this->fields()) {
@@ -454,7 +468,7 @@ END
       mace::serialize(str, &_id);
 END
       }
-      map { $s .= $_->toSerialize("str")."\n" } $this->fields();
+      map { $s .= $_->toSerialize("str", compact => $this->compactSerialize())."\n" } $this->fields();
 
       $s .= <<END;
       serializedByteSize = str.size() - serializedByteSize;
@@ -470,7 +484,7 @@ END
       serializedByteSize += mace::deserialize(__mace_in, &_id);
 END
       }
-      map { $s .= $_->toDeserialize("__mace_in", prefix => "serializedByteSize += ")."\n" } $this->fields();
+      map { $s .= $_->toDeserialize("__mace_in", prefix => "serializedByteSize += ", compact => $this->compactSerialize())."\n" } $this->fields();
 
 
       $s .= <<END;
@@ -654,10 +668,37 @@ sub toMessageStructString {
     }
   }
   my $s = qq{
-    struct ${\$this->name}_struct { $fieldStr };
+    struct ${\$this->name}_struct { $fieldStr
+      static void* operator new(size_t __size) { return mace::MessagePool<${\$this->name}_struct>::allocate(__size); }
+      static void operator delete(void* __p, size_t __size) { mace::MessagePool<${\$this->name}_struct>::release(__p, __size); }
+    };
   };
 }
 
+# serialized width of the types a fixed-layout message may hold; the bytes
+# match the mace::serialize() overloads for each
+my %fixedWidths = ( 'bool' => 1, 'int8_t' => 1, 'uint8_t' => 1, 'int16_t' => 2, 'uint16_t' => 2,
+                    'int' => 4, 'int32_t' => 4, 'uint32_t' => 4, 'int64_t' => 8, 'uint64_t' => 8,
+                    'float' => 4, 'double' => 8 );
+
+# Returns the packed size of the message, including its type byte, when
+# every serialized field is fixed-width, and 0 otherwise (always 0 for
+# serialize(compact) messages, whose integers are varints).
+sub fixedLayoutSize {
+  my $this = shift;
+  return 0 if $this->compactSerialize();
+  my $size = 1;
+  my $nfields = 0;
+  for my $f ($this->fields()) {
+    next unless $f->flags('serialize');
+    my $width = $fixedWidths{$f->type()->type()};
+    return 0 unless defined $width;
+    $size += $width;
+    $nfields++;
+  }
+  return $nfields ? $size : 0;
+}
+
 sub toMessageClassString {
   my $this = shift;
   my $servicename = shift;
@@ -709,9 +750,60 @@ sub toMessageClassString {
   }
   my $fields = "\n".join('', map { $_->type()->toString(paramconst=>1, paramref=>1).' '.$_->name().";\n" } $this->fields());
   my $fieldPrint = join(qq{\n__out << ", ";\n}, grep(/./, map{ $_->toPrint("__out") } $this->fields()) );
-  my $serializeFields = join("\n", map{ $_->toSerialize("str") } $this->fields());
+  my $serializeFields = join("\n", map{ $_->toSerialize("str", compact => $this->compactSerialize()) } $this->fields());
 
-  my $deserializeFields = join("\n", map{ $_->toDeserialize("__mace_in", prefix => "serializedByteSize += ", 'idprefix' => '_data_store_->') } $this->fields());
+  my $deserializeFields = join("\n", map{ $_->toDeserialize("__mace_in", prefix => "serializedByteSize += ", 'idprefix' => '_data_store_->', compact => $this->compactSerialize()) } $this->fields());
+  my $fixedSize = $this->fixedLayoutSize();
+  my $fixedLayout = "";
+  my $serializeBody = qq/
+        uint8_t messaget = messageType;
+	size_t initsize = str.size();
+        mace::serialize(str, &messaget);
+        ${serializeFields}
+	if (initsize == 0) {
+	  serializedCache = str;
+	}
+	serializedByteSize = str.size() - initsize;
+/;
+  my $deserializeBody = qq/
+	serializedByteSize = 0;
+        uint8_t messaget = 255;
+        serializedByteSize += mace::deserialize(__mace_in, &messaget);
+        ASSERT(messaget == messageType);
+        ${deserializeFields}
+        return serializedByteSize;
+/;
+  if ($fixedSize) {
+    # every field is fixed-width: pack into one buffer at constant offsets
+    my $offset = 1;
+    my $pack = "";
+    my $unpack = "";
+    for my $f (grep { $_->flags('serialize') } $this->fields()) {
+      my $n = $f->name();
+      $pack .= "mace::packFixed(__buf + $offset, &$n);\n";
+      $unpack .= "mace::unpackFixed(__buf + $offset, &_data_store_->$n);\n";
+      $offset += $fixedWidths{$f->type()->type()};
+    }
+    $fixedLayout = "static const size_t fixedSerializedSize = $fixedSize;";
+    $serializeBody = qq/
+        char __buf[fixedSerializedSize];
+        __buf[0] = messageType;
+        $pack
+        str.append(__buf, fixedSerializedSize);
+	if (str.size() == fixedSerializedSize) {
+	  serializedCache = str;
+	}
+	serializedByteSize = fixedSerializedSize;
+/;
+    $deserializeBody = qq/
+        char __buf[fixedSerializedSize];
+        mace::readFixed(__mace_in, __buf, fixedSerializedSize);
+        ASSERT(static_cast<uint8_t>(__buf[0]) == messageType);
+        $unpack
+        serializedByteSize = fixedSerializedSize;
+        return serializedByteSize;
+/;
+  }
   my $sqlizeBody = Mace::Compiler::SQLize::generateBody(\@{$this->fields()}, 0, 1);
   
   my $accessorMethod = "";
@@ -762,6 +854,8 @@ sub toMessageClassString {
         $structFields
         return *this;
       }
+      static void* operator new(size_t __size) { return mace::MessagePool<$msgName>::allocate(__size); }
+      static void operator delete(void* __p, size_t __size) { mace::MessagePool<$msgName>::release(__p, __size); }
       virtual ~$msgName() { 
         ADD_SELECTORS("AsyncEvent_Message::destory$msgName");
         macedbg(1) << "Destory!" << Log::endl; 
@@ -770,6 +864,7 @@ sub toMessageClassString {
       }
       $fields
       static const uint8_t messageType = $messagenum;
+      $fixedLayout
       static uint8_t getMsgType() { return messageType; }
       uint8_t getType() const { return ${msgName}::getMsgType(); }
 
@@ -788,22 +883,10 @@ sub toMessageClassString {
 	  str.append(serializedCache);
 	  return;
 	}
-        uint8_t messaget = messageType;
-	size_t initsize = str.size();
-        mace::serialize(str, &messaget);
-        ${serializeFields}
-	if (initsize == 0) {
-	  serializedCache = str;
-	}
-	serializedByteSize = str.size() - initsize;
+        $serializeBody
       }
       int deserialize(std::istream& __mace_in) throw (mace::SerializationException) {
-	serializedByteSize = 0;
-        uint8_t messaget = 255;
-        serializedByteSize += mace::deserialize(__mace_in, &messaget);
-        ASSERT(messaget == messageType);
-        ${deserializeFields}
-        return serializedByteSize;
+        $deserializeBody
       }
       
       void sqlize(mace::LogNode* __node) const {
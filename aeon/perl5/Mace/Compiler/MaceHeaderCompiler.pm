@@ -163,6 +163,9 @@ sub compileHeader {
     if ($sc->count_auto_types()) {
 	$r .= '#include' . qq{ "mace-macros.h"\n};
 	$r .= '#include' . qq{ "Serializable.h"\n};
+	if (grep { $_->name() eq 'serialize' and exists $_->options()->{compact} } map { $_->typeOptions() } $sc->auto_types()) {
+	    $r .= '#include' . qq{ "CompactSerialization.h"\n};
+	}
     }
 
     $r .= "\n";
@@ -361,7 +361,8 @@ sub toSerialize {
 	    my $file = $this->filename();
 	    $s .= qq{\n#line $line "$file"\n};
 	}
-	$s .= qq{mace::serialize($str, &$name);};
+	my $fn = $opt{compact} ? "serializeCompact" : "serialize";
+	$s .= qq{mace::$fn($str, &$name);};
 	if ((not $opt{noline}) and defined $this->filename() and $this->filename() ne "") {
 	    $s .= qq{\n// __INSERT_LINE_HERE__ \n};
 	}
@@ -388,7 +389,8 @@ sub toDeserialize {
 	    my $file = $this->filename();
 	    $s .= qq{\n#line $line "$file"\n};
 	}
-	$s .= qq{$prefix mace::deserialize($str, &$idprefix$name);};
+	my $fn = $opt{compact} ? "deserializeCompact" : "deserialize";
+	$s .= qq{$prefix mace::$fn($str, &$idprefix$name);};
 	if ((not $opt{noline}) and defined $this->filename() and $this->filename() ne "") {
 	    $s .= qq{\n// __INSERT_LINE_HERE__ \n};
 	}
@@ -1081,7 +1081,7 @@ END
         print $outfile $_->toString(methodprefix=>"${name}Service::", body => 1,selectorVar => 1, prepare => 1, nodefaults=>1);
     } $this->asyncHelperMethods(), $this->broadcastHelperMethods(), $this->routineHelperMethods(), $this->timerHelperMethods(), $this->downcallHelperMethods(), $this->upcallHelperMethods(); #, $this->appUpcallDispatchMethods();
     map {
-        print $outfile $_->toString(methodprefix=>"${name}Service::", body => 1,selectorVar => 1, prepare => 0, nodefaults=>1);
+        print $outfile $_->toString(methodprefix=>"${name}Service::", body => 1,selectorVar => 1, prepare => 0, nodefaults=>1, nostatic=>1);
     } $this->asyncLocalWrapperMethods(), $this->broadcastLocalWrapperMethods(), $this->contextHelperMethods();
     map {
         print $outfile $_->toString(methodprefix=>"${name}Service::", body => 1,selectorVar => 1, prepare => 0, nodefaults=>1, traceLevel=>1);
@@ -1305,6 +1305,9 @@ END
 #include "lib/ContextMapping.h"
 #include "Event.h"
 #include "lib/InternalMessage.h"
+#include "lib/MessageDispatch.h"
+#include "lib/FixedLayout.h"
+#include "lib/CompactSerialization.h"
 END
 
     if( $this->hasContexts() ){
@@ -2536,15 +2539,8 @@ sub createRoutineDispatcher_Incontext {
 sub createRoutineDispatcher_Fullcontext {
     my $this = shift;
 
-    my $adWrapperBody = "
-      mace::string returnValueStr;
-      __beginRemoteMethod( __param->getEvent() );
-      mace::vector<uint32_t> snapshotContextIDs; // empty vector
-
-      Message *msg = static_cast< Message * >( __param );
-      switch( msg->getType()  ){
-    ";
-
+    my $name = $this->name();
+    my @entries;
     for my $m ( $this->routines(), $this->usesHandlerMethods(), $this->providedMethods() ) {
       my $msg = $m->options("serializer");
       next if( not defined $msg );
@@ -2557,17 +2553,33 @@ sub createRoutineDispatcher_Fullcontext {
         when (Mace::Compiler::AutoType::FLAG_UPCALL)      { $call = $m->toRoutineMessageHandler(  ) ; }
       }
 
-      $adWrapperBody .= qq/
-        case ${mname}::messageType: {
-          $call
-        }
-        break;
+      my $body = qq/
+      mace::vector<uint32_t> snapshotContextIDs; \/\/ empty vector
+      {
+        $call
+      }
       /;
+      my $returnValueType = Mace::Compiler::Type->new( type => "mace::string", isConst => 0,isRef => 1 );
+      my $returnValueParam = Mace::Compiler::Param->new( name => "returnValueStr", type => $returnValueType );
+      my $handler = $this->createMessageHandler( "__routine_${mname}", $body, $returnValueParam );
+      $this->push_asyncLocalWrapperMethods( $handler );
+      push @entries, [ $mname, "&${name}Service::__routine_${mname}" ];
     }
-    $adWrapperBody .= qq/
-        default:
-          { ABORT("No matched message type is found" ); }
+    $this->push_asyncLocalWrapperMethods( $this->createMessageDispatchTable( "__routineDispatchTable", "void (${name}Service::*)(Message*, mace::string&)", @entries ) );
+
+    my $adWrapperBody = qq/
+      mace::string returnValueStr;
+      __beginRemoteMethod( __param->getEvent() );
+
+      typedef void (${name}Service::*__DispatchFn)(Message*, mace::string&);
+      static const mace::MessageDispatchTable<__DispatchFn> __dispatch = __routineDispatchTable();
+      Message *msg = static_cast< Message * >( __param );
+      __DispatchFn const __handler = __dispatch.get( msg->getType() );
+      if( __handler == NULL ){
+        ABORT("No matched message type is found" );
       }
+      (this->*__handler)( msg, returnValueStr );
+
       __finishRemoteMethodReturn(source, returnValueStr );
       delete __param;
     /;
@@ -2597,17 +2609,54 @@ sub createRoutineDispatcher {
 
     $this->push_asyncLocalWrapperMethods( $adWrapperMethod  );
 }
-sub createAsyncEventDispatcher {
+# Returns the private handler for one message type in a table-driven
+# dispatcher.  The body finds the message as "msg"; any extra parameters are
+# appended after it.
+sub createMessageHandler {
     my $this = shift;
-    my $adWrapperBody = "
-    {
-      __beginRemoteMethod( __param->getEvent() );
-      __ScopedTransition__ st( this, __param->getExtra() );
+    my $handlerName = shift;
+    my $body = shift;
+    my @extraParams = @_;
 
-      Message *msg = static_cast< Message * >( __param );
-      switch( msg->getType()  ){
+    my $returnType = Mace::Compiler::Type->new(type=>"void",isConst=>0,isConst1=>0,isConst2=>0,isRef=>0);
+    my $msgParamType = Mace::Compiler::Type->new( type => "Message*", isConst => 0,isRef => 0 );
+    my $msgParam = Mace::Compiler::Param->new( name => "msg", type => $msgParamType );
+
+    my $handler = Mace::Compiler::Method->new( name => $handlerName, body => $body, returnType=> $returnType );
+    $handler->push_params( $msgParam, @extraParams );
+    return $handler;
+}
+# Returns a static method building the mace::MessageDispatchTable of
+# $fnType for a dispatcher.  Each entry is [ message name, handler ].  The
+# dispatcher keeps the result in a function-local static, so the table is
+# built once, on first use.
+sub createMessageDispatchTable {
+    my $this = shift;
+    my $tableName = shift;
+    my $fnType = shift;
+    my @entries = @_;
+
+    my $tableType = "mace::MessageDispatchTable< $fnType >";
+    my $body = "
+      $tableType __table;
+    ";
+    for my $e ( @entries ){
+      my ($mname, $handler) = @$e;
+      $body .= "  __table.set( ${mname}::messageType, $handler );\n";
+    }
+    $body .= "
+      return __table;
     ";
 
+    my $returnType = Mace::Compiler::Type->new(type=>$tableType,isConst=>0,isConst1=>0,isConst2=>0,isRef=>0);
+    my $method = Mace::Compiler::Method->new( name => $tableName, body => $body, returnType=> $returnType, isStatic => 1 );
+    return $method;
+}
+sub createAsyncEventDispatcher {
+    my $this = shift;
+    my $name = $this->name();
+    my @entries;
+
     PROCMSG: for my $m ( 
       ($this->asyncMethods(), $this->timerMethods(),  $this->usesHandlerMethods()  , $this->providedHandlerMethods(), $this->providedMethods() ) )
  {
@@ -2626,17 +2675,24 @@ sub createAsyncEventDispatcher {
         when (Mace::Compiler::AutoType::FLAG_APPUPCALL)   { next PROCMSG; }
       }
 
-      $adWrapperBody .= qq/
-        case ${mname}::messageType: {
-          $call
-        }
-        break;
-      /;
+      $this->push_asyncLocalWrapperMethods( $this->createMessageHandler( "__asyncEvent_${mname}", $call ) );
+      push @entries, [ $mname, "&${name}Service::__asyncEvent_${mname}" ];
     }
-    $adWrapperBody .= qq/
-        default:
-          { ABORT("No matched message type is found" ); }
+    $this->push_asyncLocalWrapperMethods( $this->createMessageDispatchTable( "__asyncEventDispatchTable", "void (${name}Service::*)(Message*)", @entries ) );
+
+    my $adWrapperBody = qq/
+    {
+      __beginRemoteMethod( __param->getEvent() );
+      __ScopedTransition__ st( this, __param->getExtra() );
+
+      typedef void (${name}Service::*__DispatchFn)(Message*);
+      static const mace::MessageDispatchTable<__DispatchFn> __dispatch = __asyncEventDispatchTable();
+      Message *msg = static_cast< Message * >( __param );
+      __DispatchFn const __handler = __dispatch.get( msg->getType() );
+      if( __handler == NULL ){
+        ABORT("No matched message type is found" );
       }
+      (this->*__handler)( msg );
     }
     delete __param;
     /;
@@ -2652,14 +2708,8 @@ sub createAsyncEventDispatcher {
 }
 sub createBroadcastEventDispatcher {
     my $this = shift;
-    my $adWrapperBody = "
-    {
-      __beginRemoteMethod( __param->getEvent() );
-      __ScopedTransition__ st( this, __param->getExtra(), __ScopedTransition__::TYPE_BROADCAST_EVENT );
-
-      Message *msg = static_cast< Message * >( __param );
-      switch( msg->getType()  ){
-    ";
+    my $name = $this->name();
+    my @entries;
 
     PROCMSG: for my $m ( 
       ($this->broadcastMethods, $this->timerMethods(),  $this->usesHandlerMethods()  , $this->providedHandlerMethods(), $this->providedMethods() ) )
@@ -2680,17 +2730,24 @@ sub createBroadcastEventDispatcher {
         when (Mace::Compiler::AutoType::FLAG_APPUPCALL)   { next PROCMSG; }
       }
 
-      $adWrapperBody .= qq/
-        case ${mname}::messageType: {
-          $call
-        }
-        break;
-      /;
+      $this->push_broadcastLocalWrapperMethods( $this->createMessageHandler( "__broadcastEvent_${mname}", $call ) );
+      push @entries, [ $mname, "&${name}Service::__broadcastEvent_${mname}" ];
     }
-    $adWrapperBody .= qq/
-        default:
-          { ABORT("No matched message type is found" ); }
+    $this->push_broadcastLocalWrapperMethods( $this->createMessageDispatchTable( "__broadcastEventDispatchTable", "void (${name}Service::*)(Message*)", @entries ) );
+
+    my $adWrapperBody = qq/
+    {
+      __beginRemoteMethod( __param->getEvent() );
+      __ScopedTransition__ st( this, __param->getExtra(), __ScopedTransition__::TYPE_BROADCAST_EVENT );
+
+      typedef void (${name}Service::*__DispatchFn)(Message*);
+      static const mace::MessageDispatchTable<__DispatchFn> __dispatch = __broadcastEventDispatchTable();
+      Message *msg = static_cast< Message * >( __param );
+      __DispatchFn const __handler = __dispatch.get( msg->getType() );
+      if( __handler == NULL ){
+        ABORT("No matched message type is found" );
       }
+      (this->*__handler)( msg );
     }
 
     delete __param;
@@ -3123,10 +3180,7 @@ sub generateInternalTransitions{
 }
 sub createMethodDeserializer {
     my $this = shift;
-    my $adWrapperBody = "
-      uint8_t msgNum_s = static_cast<uint8_t>(is.peek() ) ;
-      switch( msgNum_s  ){
-    ";
+    my @entries;
     for my $m ( 
       $this->asyncMethods(), $this->broadcastMethods(), $this->timerMethods(),  
       $this->usesHandlerMethods() , # upcall transitions
@@ -3137,21 +3191,21 @@ sub createMethodDeserializer {
    {
       my $msg = $m->options("serializer");
       next if( not defined $msg );
-      # create wrapper func
       my $mname = $msg->{name};
-
-      $adWrapperBody .= qq!
-        case ${mname}::messageType: {
-          obj = new $mname;
-          return mace::deserialize( is, obj );
-        }
-        break;
-      !;
+      push @entries, [ $mname, "&mace::newMessage< $mname >" ];
     }
-    $adWrapperBody .= qq/
-        default:
-          { ABORT("No matched message type is found" ); }
+    $this->push_asyncLocalWrapperMethods( $this->createMessageDispatchTable( "__methodDeserializerTable", "mace::Message* (*)()", @entries ) );
+
+    my $adWrapperBody = qq/
+      typedef mace::Message* (*__FactoryFn)();
+      static const mace::MessageDispatchTable<__FactoryFn> __factories = __methodDeserializerTable();
+      uint8_t msgNum_s = static_cast<uint8_t>(is.peek() ) ;
+      __FactoryFn const __factory = __factories.get( msgNum_s );
+      if( __factory == NULL ){
+        ABORT("No matched message type is found" );
       }
+      obj = __factory();
+      return mace::deserialize( is, obj );
     /;
 
     my $adWrapperName = "deserializeMethod";
@@ -429,11 +429,12 @@ sub toString {
             |;
         $rescheduleMethod = "";
         
-        my $loopCondition = "(i->first < (curtime + Scheduler::CLOCK_RESOLUTION))";
+        # multi timers are keyed by mace::getmtime(), not the time of day
+        my $loopCondition = "(i->first < (__now + Scheduler::CLOCK_RESOLUTION))";
             my $weightsTrue = "";
             my $weightsFalse = "";
         if ($macetime) {
-            $loopCondition = "MaceTime(i->first - Scheduler::CLOCK_RESOLUTION).lessThan(curtime, trueWeight, falseWeight)";
+            $loopCondition = "MaceTime(i->first - Scheduler::CLOCK_RESOLUTION).lessThan(MaceTime(__now), trueWeight, falseWeight)";
                 $weightsTrue = qq/ int trueWeight = 1;
                                    int falseWeight = 0; /;
                 $weightsFalse = qq/ trueWeight = 0;
@@ -474,6 +475,7 @@ sub toString {
           }
         }
         else {
+          const uint64_t __now = mace::getmtime();
           ${maptype}::iterator i = timerData.begin();
               $weightsTrue
           while((i != timerData.end()) && $loopCondition) {
@@ -101,14 +101,17 @@ sub writeServerHFile {
 	$seen{$n} = 1;
 	$constructor .= qq[    methods.insert("$n");
     handlerFuncs["$n"] = &${xname}::${n}Handler;
+    binaryHandlerFuncs["$n"] = &${xname}::${n}BinaryHandler;
 ];
 	my $params = "";
 	my $dparam = "";
+	my $bparam = "";
 	my $paramstr = "";
 	my $i = 0;
 	for my $p ($m->params()) {
 	    $params .= "    " . $p->type()->type() . " param${i};\n";
 	    $dparam .= "      mace::deserializeXML_RPCParam(xmlData, &param${i}, param${i});\n";
+	    $bparam .= "      mace::deserialize(binaryData, &param${i});\n";
 	    $paramstr .= "param${i}, ";
 	    $i++;
 	}
@@ -134,6 +137,18 @@ $dparam
       return XmlRpcResponse::constructFault(XmlRpcResponse::SERVER_ERROR, "Internal server error serializing response");
     }
   } // ${n}Handler
+
+  std::string ${n}BinaryHandler(istream& binaryData) {
+$params
+
+    try {
+$bparam
+      service->${n}($paramstr);
+    } catch (const mace::SerializationException& se) {
+      return XmlRpcResponse::constructBinaryFault(XmlRpcResponse::BAD_REQUEST, "Syntax error in request:" + se.toString());
+    }
+    return XmlRpcResponse::constructBinarySuccess("");
+  } // ${n}BinaryHandler
 ];
 	}
 	else {
@@ -158,6 +173,21 @@ $dparam
       return XmlRpcResponse::constructFault(XmlRpcResponse::SERVER_ERROR, "Internal server error serializing response");
     }
   } // ${n}Handler
+
+  std::string ${n}BinaryHandler(istream& binaryData) {
+$params
+    std::string retString = "";
+    $ret ret;
+
+    try {
+$bparam
+      ret = service->${n}($paramstr);
+    } catch (const mace::SerializationException& se) {
+      return XmlRpcResponse::constructBinaryFault(XmlRpcResponse::BAD_REQUEST, "Syntax error in request:" + se.toString());
+    }
+    mace::serialize(retString, &ret);
+    return XmlRpcResponse::constructBinarySuccess(retString);
+  } // ${n}BinaryHandler
 ];
 	}
     }
@@ -192,11 +222,21 @@ $constructor
     }
   }
 
+  virtual std::string executeBinary(const std::string& methodName, std::istream& binaryData) {
+    if(binaryHandlerFuncs.containsKey(methodName)) {
+      return (this->*binaryHandlerFuncs[methodName])(binaryData);
+    }
+    else {
+      return XmlRpcResponse::constructBinaryFault(XmlRpcResponse::INVALID_METHOD, "INVALID METHOD");
+    }
+  }
+
 protected:
 $protected
 
 protected:
   mace::map<std::string, ExecFunc, mace::SoftState> handlerFuncs;
+  mace::map<std::string, ExecFunc, mace::SoftState> binaryHandlerFuncs;
 
 private:
   C* service;
@@ -270,6 +310,7 @@ sub writeClientHFile {
 	$pubmeths .= "  $rt $n($mp) throw(mace::SerializationException, XmlRpcClientException, HttpClientException);\n";
 
 	$privmeths .= "  std::string makeXmlRpcStr_$n($mp);\n";
+	$privmeths .= "  std::string makeBinaryRpcStr_$n($mp);\n";
 
 	$i++;
     }
@@ -456,12 +497,12 @@ sub writeClientCFile {
 void ${xname}::$n($paramsComma ${hname}* obj, void* cbParam) throw(mace::SerializationException, XmlRpcClientException, HttpClientException) {
   $add_selectors
   $cbt cb;
-  std::string xmlRequest = makeXmlRpcStr_$n($paramNames);
+  std::string xmlRequest = isBinary() ? makeBinaryRpcStr_$n($paramNames) : makeXmlRpcStr_$n($paramNames);
   $xmlrequest
 
   cb.$cb = $cbname;
   requests.push($iname(obj, cb, ${hname}::$capn, cbParam));
-  postUrlAsync(url, "text/xml", xmlRequest, "1.1", true, StringHMap(), this, &XmlRpcClient::postRequestResult);
+  postUrlAsync(url, getContentType(), xmlRequest, "1.1", true, StringHMap(), this, &XmlRpcClient::postRequestResult);
 } // $n
 
 $rt ${xname}::$n($params) throw(mace::SerializationException, XmlRpcClientException, HttpClientException) {
@@ -472,10 +513,10 @@ $rt ${xname}::$n($params) throw(mace::SerializationException, XmlRpcClientExcept
   int errCode = -1;
   mace::string errString = "";
   std::istringstream in;
-  std::string xmlRequest = makeXmlRpcStr_$n($paramNames);
+  std::string xmlRequest = isBinary() ? makeBinaryRpcStr_$n($paramNames) : makeXmlRpcStr_$n($paramNames);
   $xmlrequest
 
-  r = postUrl(url, "text/xml", xmlRequest);
+  r = postUrl(url, getContentType(), xmlRequest);
   $rcontent
   in.str(r.content);
   $gtmline
@@ -487,8 +528,10 @@ $rt ${xname}::$n($params) throw(mace::SerializationException, XmlRpcClientExcept
 ];
 
 	my $serparams = "";
+	my $binparams = "";
 	for my $p ($m->params()) {
 	    my $pn = $p->name();
+	    $binparams .= "  mace::serialize(request, &${pn});\n";
 	    $serparams .= qq[  xmlRequest += "    <param>\\n      <value>";
   mace::serializeXML_RPC(xmlRequest, &${pn}, $pn);
   xmlRequest += "</value>\\n      </param>\\n";
@@ -505,6 +548,13 @@ $serparams
   return xmlRequest;
 } // makeXmlRpcStr_$n
 
+std::string ${xname}::makeBinaryRpcStr_$n($params) {
+  std::string request;
+  std::string methodName = "$cname.$n";
+  mace::serialize(request, &methodName);
+$binparams  return request;
+} // makeBinaryRpcStr_$n
+
 ];
 
     }
@@ -514,6 +564,10 @@ $serparams
 	my $fn = $this->getTypeMethod($t);
 	if ($t eq "void") {
 	    $gettypes .= qq[void ${xname}::$fn(std::istream& in, bool& fault, int& errCode, mace::string& errString) throw(mace::SerializationException) {
+  if (isBinary()) {
+    XmlRpcResponse::parseBinaryStatus(in, fault, errCode, errString);
+    return;
+  }
   // ignore the <?xml version=*?> tag (fix later?)
   mace::SerializationUtil::getTag(in, false);
   mace::SerializationUtil::expectTag(in, "<methodResponse>");
@@ -532,6 +586,13 @@ $serparams
 	}
 	else {
 	    $gettypes .= qq[void ${xname}::$fn(std::istream& in, $t& val, bool& fault, int& errCode, mace::string& errString) throw(mace::SerializationException) {
+  if (isBinary()) {
+    XmlRpcResponse::parseBinaryStatus(in, fault, errCode, errString);
+    if (!fault) {
+      mace::deserialize(in, &val);
+    }
+    return;
+  }
   // ignore the <?xml version=*?> tag (fix later?)
   mace::SerializationUtil::getTag(in, false);
   mace::SerializationUtil::expectTag(in, "<methodResponse>");
@@ -28,6 +28,12 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * 
  * ----END-OF-LEGAL-STUFF---- */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
 #include "FileUtil.h"
 
 #include "FileWebObject.h"
@@ -36,32 +42,27 @@
 using namespace std;
 
 StringHMap FileWebObject::contentTypes;
-PathFileStreamMap FileWebObject::files;
-StringCountHMap FileWebObject::fileCount;
+pthread_once_t FileWebObject::contentTypesOnce = PTHREAD_ONCE_INIT;
 
 FileWebObject::FileWebObject(string p, bool head) throw (FileException) :
-  WebObject(head), path(p) {
-  fp = 0;
-  if (files.find(p) != files.end()) {
-    fp = files[p];
-    fileCount[p]++;
-  }
-  else {
-    loadContentTypes();
-    fp = new fstream();
-    fp->open(path.c_str(), fstream::in);
-    files[p] = fp;
-    fileCount[p] = 1;
-  }
+  WebObject(head), path(p), fd(-1) {
+  // every request gets its own descriptor so that connections served by
+  // different worker threads never share a file offset
+  pthread_once(&contentTypesOnce, &FileWebObject::loadContentTypes);
 
   offset = 0;
-  if (!fp || !fp->is_open()) {
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
     throw FileException("open: " + path);
   }
 
   struct stat sbuf;
-  FileUtil::statWithErr(path, sbuf);
+  if (fstat(fd, &sbuf) < 0) {
+    close();
+    throw FileException("fstat: " + path);
+  }
   if (S_ISDIR(sbuf.st_mode)) {
+    close();
     throw FileException("open: " + path + " is dir");
   }
   setLength(sbuf.st_size);
@@ -71,49 +72,52 @@ FileWebObject::FileWebObject(string p, bool head) throw (FileException) :
   size_t i = path.find_last_of(".");
   if (i != string::npos) {
     string t = path.substr(i + 1);
-    if (contentTypes.containsKey(t)) {
-      setContentType(contentTypes[t]);
+    StringHMap::const_iterator ti = contentTypes.find(t);
+    if (ti != contentTypes.end()) {
+      setContentType(ti->second);
     }
   }
 } // FileWebObject
 
 void FileWebObject::loadContentTypes() {
-  if (contentTypes.empty()) {
-    // load types
-    fstream types("/etc/mime.types", fstream::in);
-    while (!types.eof()) {
-      char buf[512];
-      types.getline(buf, 512);
-      string l(buf);
-      if (l == "" || l[0] == '#') {
-	continue;
-      }
-      istringstream ss(l);
-      string type;
-      ss >> type;
-      while (!ss.eof()) {
-	string ext;
-	ss >> ext;
-	contentTypes[ext] = type;
-      }
+  // load types
+  fstream types("/etc/mime.types", fstream::in);
+  while (!types.eof()) {
+    char buf[512];
+    types.getline(buf, 512);
+    string l(buf);
+    if (l == "" || l[0] == '#') {
+      continue;
+    }
+    istringstream ss(l);
+    string type;
+    ss >> type;
+    while (!ss.eof()) {
+      string ext;
+      ss >> ext;
+      contentTypes[ext] = type;
     }
   }
 } // loadContentTypes
 
 void FileWebObject::close() {
-  fileCount[path]--;
-  if ((fileCount[path] == 0) && fp->is_open()) {
-    fp->close();
-    delete fp;
-    fp = 0;
-    files.erase(path);
-    fileCount.erase(path);
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
   }
 } // close
 
 void FileWebObject::read(char* buf, uint len) throw (HttpServerException) {
-  fp->seekg(offset);
-  fp->read(buf, len);
+  uint done = 0;
+  while (done < len) {
+    ssize_t r = pread(fd, buf + done, len - done, offset + done);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      throw HttpServerException("read: " + path);
+    }
+    done += r;
+  }
   offset += len;
 } // read
-
@@ -31,6 +31,7 @@
 #ifndef FILE_WEB_OBJECT_H
 #define FILE_WEB_OBJECT_H
 
+#include <pthread.h>
 #include <fstream>
 #include <sstream>
 
@@ -41,25 +42,22 @@
 
 #include "WebObject.h"
 
-typedef mace::map<std::string, std::fstream*, mace::SoftState> PathFileStreamMap;
-typedef mace::map<std::string, int, mace::SoftState> StringCountHMap;
-
 class FileWebObject : public WebObject {
 public:  
   FileWebObject(std::string path, bool headRequest = false) throw (FileException);
-  virtual ~FileWebObject() { } 
+  virtual ~FileWebObject() { close(); }
   virtual void close();
   void read(char* buf, uint len) throw (HttpServerException);
+  int getFd() const { return fd; }
 
 private:
-  void loadContentTypes();
+  static void loadContentTypes();
 
 private:
   std::string path;
-  std::fstream *fp;
+  int fd;
   static StringHMap contentTypes;
-  static PathFileStreamMap files;
-  static StringCountHMap fileCount;
+  static pthread_once_t contentTypesOnce;
 }; // FileWebObject
 
 #endif // FILE_WEB_OBJECT_H
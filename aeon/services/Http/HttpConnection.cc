@@ -34,9 +34,15 @@
 #include "Accumulator.h"
 
 #include "HttpConnection.h"
+#include "HttpParser.h"
 #include "HttpServer.h"
 
 #include "m_net.h"
+#include "SockUtil.h"
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include "mace-macros.h"
 
@@ -53,7 +59,8 @@ using std::string;
 
 HttpConnection::HttpConnection(int s) :
   client(s), readable(true), writeable(false), open(true), keepAlive(false),
-  readFromSocket(true), wobj(0), wqueued(0) {
+  readFromSocket(true), busy(false), wobj(0), wqueued(0), rpos(0), rscan(0),
+  woff(0) {
 
   struct sockaddr_in sa;
   socklen_t slen = sizeof(sa);
@@ -96,6 +103,7 @@ void HttpConnection::sendHeader() {
   ASSERT(open);
   writeable = true;
 //   readable = false;
+  woff = 0;
   wbuf = HttpResponse::getResponseHeader(HttpResponse::OK, httpVersion);
   wbuf += HttpResponse::getBodyHeader(wobj->getContentType(), wobj->getLength(),
 				      keepAlive,
@@ -107,6 +115,7 @@ void HttpConnection::sendRedirect(int c, const string& location) {
   writeable = true;
   readable = false;
   wobj = new WebObject();
+  woff = 0;
   wbuf = HttpResponse::getResponseHeader(c, httpVersion);
   wbuf += HttpResponse::getBodyHeader("text/html", 0, false, false, location);
   keepAlive = false;
@@ -117,6 +126,7 @@ void HttpConnection::sendError(int c) {
   writeable = true;
   readable = false;
   wobj = new WebObject();
+  woff = 0;
   wbuf = HttpResponse::getResponseHeader(c, "1.0");
   wbuf += "\r\n";
   keepAlive = false;
@@ -147,42 +157,47 @@ void HttpConnection::close(bool reset) {
     uint64_t end = TimeUtil::timeu();
     suseconds_t t = end - start;
     maceout << client << " open for " << (t / 1000) << " ms "
-	    << "wbuf.size=" << wbuf.size()
+	    << "wbuf.size=" << writePending()
 	    << " raddr=" << Util::getAddrString(raddr) << ":" << ntohs(rport)
 	    << Log::endl;
 
     open = false;
 
     rbuf.clear();
+    rpos = 0;
+    rscan = 0;
     wbuf.clear();
+    woff = 0;
   }
 
   readable = false;
   writeable = false;
 } // close
 
-int HttpConnection::read(string& buf) {
+int HttpConnection::read() {
   ASSERT(open);
-  if (usingSocket()) {
-    return readSocket(buf);
+  if (!usingSocket()) {
+    return rbuf.size() - rpos;
   }
-  else {
-    return readBuffer(buf);
-  }
-} // read
 
-int HttpConnection::readSocket(string& buf) {
-  ASSERT(open);
   char tmp[BLOCK_SIZE];
   int r = ::read(client, tmp, sizeof(tmp));
   if (r <= 0) {
-//     Log::log("HttpConnection::readSocket") << "read " << r << " from " << client
+    if (r < 0 && SockUtil::errorWouldBlock()) {
+      return 0;
+    }
+//     Log::log("HttpConnection::read") << "read " << r << " from " << client
 // 					   << ", closing" << Log::endl;
     close();
     return r;
   }
   Accumulator::Instance(Accumulator::HTTP_SERVER_READ)->accumulate(r);
 
+  if (rpos > 0) {
+    // only the unparsed tail of the buffer is kept
+    rbuf.erase(0, rpos);
+    rpos = 0;
+  }
   rbuf.append(tmp, r);
   if (0) {
     // XXX - really need a way of enabling this if desired
@@ -192,21 +207,19 @@ int HttpConnection::readSocket(string& buf) {
     }
   }
 
-  buf = rbuf;
   return r;
-} // readSocket
+} // read
 
-int HttpConnection::readBuffer(string& buf) {
-  ASSERT(open);
-  buf = rbuf;
-  return rbuf.size();
-} // readBuffer
+void HttpConnection::parseRequest(HttpRequestContext& req, size_t& lengthUsed,
+				  bool& valid, bool& done) {
+  HttpParser::parseRequest(rbuf, rpos, rscan, req, lengthUsed, valid, done);
+} // parseRequest
 
 int HttpConnection::write() {
   ASSERT(open);
-  if (wbuf.empty() && wobj && wobj->isChunked()) {
+  if (writePending() == 0 && wobj && wobj->isChunked()) {
     queueData();
-    if (wbuf.empty()) {
+    if (writePending() == 0) {
       ASSERT(wobj->hasMoreChunks());
       return 0;
     }
@@ -217,8 +230,25 @@ int HttpConnection::write() {
 
   }
 
-  int r = ::write(client, wbuf.data(), wbuf.size());
+  bool fromBuffer = (writePending() > 0);
+  int r;
+  if (fromBuffer) {
+    int flags = 0;
+#ifdef MSG_MORE
+    if (usesSendfile() && wqueued < wobj->getLength()) {
+      // the file body follows the header straight away
+      flags |= MSG_MORE;
+    }
+#endif
+    r = ::send(client, wbuf.data() + woff, writePending(), flags);
+  }
+  else {
+    r = sendFile();
+  }
   if (r <= 0) {
+    if (r < 0 && SockUtil::errorWouldBlock()) {
+      return 0;
+    }
 //     Log::log("HttpConnection::write") << "write to " << client
 // 				      << " returned " << r << ", closing" << Log::endl;
     close();
@@ -226,7 +256,13 @@ int HttpConnection::write() {
   }
   Accumulator::Instance(Accumulator::HTTP_SERVER_WRITE)->accumulate(r);
 
-  wbuf = wbuf.substr(r);
+  if (fromBuffer) {
+    woff += r;
+    if (woff == wbuf.size()) {
+      wbuf.clear();
+      woff = 0;
+    }
+  }
 //   Log::log("HttpConnection::write") << "wbuf.size=" << wbuf.size()
 // 				    << " wqueued=" << wqueued
 // 				    << " wobj.length=" << wobj->getLength() << Log::endl;
@@ -235,7 +271,7 @@ int HttpConnection::write() {
     return r;
   }
 
-  if (!wbuf.empty()) {
+  if (writePending() > 0) {
     return r;
   }
 
@@ -249,6 +285,9 @@ int HttpConnection::write() {
     wqueued = 0;
     readable = true;
     writeable = false;
+    busy = false;
+    // a pipelined request may already be waiting in the read buffer
+    readFromSocket = readBufferEmpty();
     opentime = TimeUtil::time();
     return r;
   }
@@ -262,8 +301,13 @@ int HttpConnection::write() {
 } // write
 
 void HttpConnection::advanceReadBuffer(uint pos) {
-  ASSERT(pos <= rbuf.size());
-  rbuf = rbuf.substr(pos);
+  ASSERT(rpos + pos <= rbuf.size());
+  rpos += pos;
+  rscan = 0;
+  if (rpos == rbuf.size()) {
+    rbuf.clear();
+    rpos = 0;
+  }
 } // advanceReadBuffer
 
 bool HttpConnection::isWriteable() {
@@ -271,7 +315,10 @@ bool HttpConnection::isWriteable() {
 //     fprintf(stderr, "isWriteable connection %d hasMoreChunks=%d isChunkReady=%d "
 // 	    "wqueued=%d wbuf=%d\n",
 // 	    client, wobj->hasMoreChunks(), wobj->isChunkReady(), wqueued, wbuf.size());
-    if (!wbuf.empty()) {
+    if (writePending() > 0) {
+      return true;
+    }
+    if (usesSendfile() && wqueued < wobj->getLength()) {
       return true;
     }
     if (wobj->isChunked()) {
@@ -325,6 +372,10 @@ void HttpConnection::queueData() {
       }
       return;
     }
+    if (usesSendfile()) {
+      // write() hands the body to sendfile once the header is out
+      return;
+    }
     ASSERT(wqueued < wobj->getLength());
     uint req = BLOCK_SIZE;
     if (wobj->getLength() - wqueued < req) {
@@ -342,3 +393,31 @@ void HttpConnection::queueData() {
   }
 
 } // queueData
+
+bool HttpConnection::usesSendfile() const {
+#ifdef HAVE_SYS_SENDFILE_H
+  return wobj && !wobj->isHeadRequest() && wobj->getFd() >= 0;
+#else
+  return false;
+#endif
+} // usesSendfile
+
+int HttpConnection::sendFile() {
+  ASSERT(usesSendfile() && wqueued < wobj->getLength());
+#ifdef HAVE_SYS_SENDFILE_H
+  size_t len = wobj->getLength() - wqueued;
+  if (len > SENDFILE_BLOCK_SIZE) {
+    // bound each call so one large file does not starve other connections
+    len = SENDFILE_BLOCK_SIZE;
+  }
+  off_t off = wqueued;
+  ssize_t r = ::sendfile(client, wobj->getFd(), &off, len);
+  if (r > 0) {
+    wqueued += r;
+  }
+  return r;
+#else
+  ABORT("sendfile unsupported");
+  return -1;
+#endif
+} // sendFile
@@ -47,6 +47,7 @@
 #include "m_map.h"
 
 #include "HttpResponse.h"
+#include "HttpRequestContext.h"
 #include "WebObject.h"
 
 class HttpConnection;
@@ -60,10 +61,14 @@ public:
 public:
   HttpConnection(int s);
   virtual ~HttpConnection();
-  bool isReadable() const { return readable; }
+  // a connection with a response outstanding does not read further
+  // requests until that response has been written
+  bool isReadable() const { return readable && !busy; }
   bool isWriteable();
   bool isOpen() { return open; }
-  int read(std::string& buf);
+  int read();
+  void parseRequest(HttpRequestContext& req, size_t& lengthUsed, bool& valid,
+		    bool& done);
   int timeOpen() { return opentime; }
   void setHttpVersion(std::string v) { httpVersion = v; }
   void setKeepAlive() { keepAlive = true; }
@@ -78,17 +83,20 @@ public:
   void useSocket() { readFromSocket = true; }
   void useBuffer() { readFromSocket = false; }
   bool usingSocket() const { return readFromSocket; }
-  bool readBufferEmpty() const { return rbuf.empty(); }
+  bool readBufferEmpty() const { return rpos == rbuf.size(); }
+  void setBusy() { busy = true; }
+  bool isBusy() const { return busy; }
   int sockfd() const { return client; }
 
   int getRemoteAddr();
   int getRemotePort();
 
 protected:
-  int readSocket(std::string& buf);
-  int readBuffer(std::string& buf);
   void sendHeader();
   void queueData();
+  bool usesSendfile() const;
+  int sendFile();
+  size_t writePending() const { return wbuf.size() - woff; }
 
 private:
   int client;
@@ -97,17 +105,22 @@ private:
   bool open;
   bool keepAlive;
   bool readFromSocket;
+  bool busy;
   WebObject *wobj;
   uint wqueued;
   int raddr;
   int rport;
   std::string httpVersion;
   std::string rbuf;
+  size_t rpos;
+  size_t rscan;
   std::string wbuf;
+  size_t woff;
   time_t opentime;
   uint64_t start;
   static const size_t MAX_REQUEST_SIZE = 65536;
   static const size_t BLOCK_SIZE = 8192;
+  static const size_t SENDFILE_BLOCK_SIZE = 1 << 20;
 
 }; // HttpConnection
 
@@ -31,6 +31,8 @@
 #include <iostream>
 #include <sstream>
 #include <ctype.h>
+#include <string.h>
+#include <strings.h>
 #include <boost/lexical_cast.hpp>
 
 #include "StrUtil.h"
@@ -77,45 +79,50 @@ bool HttpParser::parseHeaders(StringList& req, HttpRequestContext& context,
       return false;
     }
 
-    string name = m[0];
-    string value = m[1];
-    context.headers[name] = value;
-
-    string ln = StrUtil::toLower(name);
-    if (ln == "connection") {
-      string lv = StrUtil::toLower(value);
-      if (lv == "close") {
-	context.keepAlive = false;
-      }
-      else if (lv == "keep-alive") {
-	context.keepAlive = true;
-      }
-    }
-    else if (ln == "content-length") {
-      long l;
-      try {
-        l = lexical_cast<long>(value);
-      } catch(exception e) {
-        return false;
-      }
-      if ((context.method != "POST") || (l < 0)) {
-	// bad request
-	return false;
-      }
-      contentLength = (size_t)l;
-    }
-    else if (ln == "transfer-encoding") {
-      if (StrUtil::toLower(value) == "chunked") {
-	context.chunked = true;
-      }
+    if (!applyHeader(m[0], m[1], context, contentLength)) {
+      return false;
     }
-    // add other headers here
   }
 
   // headers are good
   return true;
 } // parseHeaders
 
+bool HttpParser::applyHeader(const string& name, const string& value,
+			     HttpRequestContext& context, size_t& contentLength) {
+  context.headers[name] = value;
+
+  const char* n = name.c_str();
+  if (strcasecmp(n, "connection") == 0) {
+    if (strcasecmp(value.c_str(), "close") == 0) {
+      context.keepAlive = false;
+    }
+    else if (strcasecmp(value.c_str(), "keep-alive") == 0) {
+      context.keepAlive = true;
+    }
+  }
+  else if (strcasecmp(n, "content-length") == 0) {
+    long l;
+    try {
+      l = lexical_cast<long>(value);
+    } catch(exception e) {
+      return false;
+    }
+    if ((context.method != "POST") || (l < 0)) {
+      // bad request
+      return false;
+    }
+    contentLength = (size_t)l;
+  }
+  else if (strcasecmp(n, "transfer-encoding") == 0) {
+    if (strcasecmp(value.c_str(), "chunked") == 0) {
+      context.chunked = true;
+    }
+  }
+  // add other headers here
+  return true;
+} // applyHeader
+
 void HttpParser::readChunked(string& request, string& content,
 			     size_t& lengthUsed, bool& valid, bool& done) {
   do {
@@ -135,9 +142,9 @@ void HttpParser::readChunked(string& request, string& content,
       return;
     }
     lengthUsed += sizeRead;
-    int size = 0;
-    int success = sscanf(sizeBuf.c_str(), "%x", &size);
-    if (!success) {
+    size_t size = 0;
+    const char* next;
+    if (!parseChunkSize(sizeBuf.data(), sizeBuf.data() + sizeBuf.size(), size, next)) {
       // bad request
       done = true;
       return;
@@ -159,7 +166,7 @@ void HttpParser::readChunked(string& request, string& content,
 	return;
       }
     }
-    if (StrUtil::read(request, buf, (size_t)size) == (size_t)size) {
+    if (StrUtil::read(request, buf, size) == size) {
       lengthUsed += size;
       content += buf;
     }
@@ -248,49 +255,243 @@ bool HttpParser::parseRequestHeaderLine(StringList& req, HttpRequestContext& con
   return true;
 } // parseRequestHeaderLine
 
-void HttpParser::parseRequest(string request, HttpRequestContext& context,
+void HttpParser::parseRequest(const string& request, HttpRequestContext& context,
 			      size_t& lengthUsed, bool& valid, bool& done) {
+  size_t scanned = 0;
+  parseRequest(request, 0, scanned, context, lengthUsed, valid, done);
+} // parseRequest
 
-  StringList req;
+void HttpParser::parseRequest(const string& buf, size_t offset, size_t& scanned,
+			      HttpRequestContext& context, size_t& lengthUsed,
+			      bool& valid, bool& done) {
   lengthUsed = 0;
   done = false;
   valid = false;
 
-  if (!readHeader(request, req, lengthUsed)) {
-    // not done
-    return;
+  assert(offset <= buf.size());
+  const char* base = buf.data() + offset;
+  const char* end = buf.data() + buf.size();
+
+  // skip any blank lines left over from the previous request
+  const char* p = base;
+  while (p < end && (*p == '\r' || *p == '\n')) {
+    p++;
   }
 
-  if (!parseRequestHeaderLine(req, context)) {
-    // bad request
-    done = true;
+  // find the blank line ending the header, resuming a little before where
+  // the last call gave up in case the terminator straddled two reads
+  const char* q = base + (scanned > 3 ? scanned - 3 : 0);
+  if (q < p) {
+    q = p;
+  }
+  const char* hend = 0;
+  while (q < end && (q = (const char*)memchr(q, '\n', end - q)) != 0) {
+    const char* n = q + 1;
+    if (n < end && *n == '\r') {
+      n++;
+    }
+    if (n < end && *n == '\n') {
+      hend = n + 1;
+      break;
+    }
+    q++;
+  }
+
+  if (hend == 0) {
+    scanned = end - base;
+    if (scanned > MAX_HEADER_SIZE) {
+      // bad request
+      done = true;
+    }
+    // not done
     return;
   }
 
   size_t contentLength = 0;
-  bool headerOK = parseHeaders(req, context, contentLength);
-  if (context.keepAlive && context.httpVersion == "1.0") {
-    context.keepAlive = false;
+  bool requestLine = true;
+  for (const char* line = p; line < hend; ) {
+    const char* eol = (const char*)memchr(line, '\n', hend - line);
+    const char* e = eol;
+    if (e > line && e[-1] == '\r') {
+      e--;
+    }
+    if (e == line) {
+      break;
+    }
+    if (requestLine) {
+      if (!parseRequestLine(line, e, context)) {
+	// bad request
+	done = true;
+	return;
+      }
+      requestLine = false;
+    }
+    else if (!parseHeaderLine(line, e, context, contentLength)) {
+      done = true;
+      return;
+    }
+    line = eol + 1;
   }
 
   if (context.keepAlive && context.httpVersion == "1.0") {
     context.keepAlive = false;
   }
 
-  if (!headerOK ||
-      ((context.httpVersion == "1.1") && !context.headers.containsKey("Host"))) {
+  if ((context.httpVersion == "1.1") && !context.headers.containsKey("Host")) {
     done = true;
     return;
   }
 
-  if (readContent(request, context, contentLength, lengthUsed, valid, done)) {
-    return;
+  size_t headerLength = hend - base;
+  if (context.chunked) {
+    readChunked(hend, end, context.content, lengthUsed, valid, done);
+    if (done) {
+      lengthUsed += headerLength;
+    }
+  }
+  else if ((size_t)(end - hend) >= contentLength) {
+    context.content.assign(hend, contentLength);
+    lengthUsed = headerLength + contentLength;
+    valid = true;
+    done = true;
   }
 
-  // request is not complete, done is false
-  assert(!done);
+  if (!done) {
+    // the header is complete, only the body is outstanding
+    scanned = headerLength;
+    lengthUsed = 0;
+  }
 } // parseRequest
 
+bool HttpParser::parseRequestLine(const char* b, const char* e,
+				  HttpRequestContext& context) {
+  const char* m = b;
+  while (b < e && *b != ' ' && *b != '\t') {
+    b++;
+  }
+  string method(m, b - m);
+  if (method != "GET" && method != "POST" && method != "HEAD") {
+    return false;
+  }
+
+  while (b < e && (*b == ' ' || *b == '\t')) {
+    b++;
+  }
+  const char* u = b;
+  while (b < e && *b != ' ' && *b != '\t') {
+    b++;
+  }
+  if (b == u) {
+    return false;
+  }
+  string url(u, b - u);
+
+  while (b < e && (*b == ' ' || *b == '\t')) {
+    b++;
+  }
+  if (e - b < 8 || strncmp(b, "HTTP/", 5) != 0) {
+    return false;
+  }
+  string version(b + 5, 3);
+  if (((version != "1.0") && (version != "1.1")) || !validPath(url)) {
+    return false;
+  }
+
+  context.method = method;
+  context.url = url;
+  context.httpVersion = version;
+  context.keepAlive = (context.httpVersion == "1.0" ? false : true);
+  return true;
+} // parseRequestLine
+
+bool HttpParser::parseHeaderLine(const char* b, const char* e,
+				 HttpRequestContext& context, size_t& contentLength) {
+  const char* c = b;
+  while (c < e && *c != ':' && !isspace(*c)) {
+    c++;
+  }
+  if (c == b || c == e || *c != ':') {
+    // bad request
+    return false;
+  }
+  string name(b, c - b);
+
+  c++;
+  while (c < e && isspace(*c)) {
+    c++;
+  }
+  while (e > c && isspace(e[-1])) {
+    e--;
+  }
+  return applyHeader(name, string(c, e - c), context, contentLength);
+} // parseHeaderLine
+
+void HttpParser::readChunked(const char* b, const char* e, string& content,
+			     size_t& lengthUsed, bool& valid, bool& done) {
+  const char* start = b;
+  while (b < e) {
+    // there might be a leading newline, which we should discard
+    while (b < e && (*b == '\r' || *b == '\n')) {
+      b++;
+    }
+    const char* eol = (const char*)memchr(b, '\n', e - b);
+    if (eol == 0) {
+      // not done
+      return;
+    }
+
+    size_t size = 0;
+    const char* h;
+    if (!parseChunkSize(b, eol, size, h)) {
+      // bad request
+      done = true;
+      return;
+    }
+    b = eol + 1;
+
+    if (size == 0) {
+      // skip any trailers up to the final blank line
+      while (b < e) {
+	eol = (const char*)memchr(b, '\n', e - b);
+	if (eol == 0) {
+	  return;
+	}
+	bool blank = (eol == b) || (eol == b + 1 && *b == '\r');
+	b = eol + 1;
+	if (blank) {
+	  lengthUsed = b - start;
+	  valid = true;
+	  done = true;
+	  return;
+	}
+      }
+      return;
+    }
+
+    if ((size_t)(e - b) < size) {
+      // not done
+      return;
+    }
+    content.append(b, size);
+    b += size;
+  }
+} // readChunked
+
+bool HttpParser::parseChunkSize(const char* b, const char* e, size_t& size,
+				const char*& next) {
+  size = 0;
+  next = b;
+  while (next < e && isxdigit(*next)) {
+    size = size * 16 + (isdigit(*next) ? *next - '0' : (tolower(*next) - 'a' + 10));
+    if (size > MAX_CHUNK_SIZE) {
+      // stop before the size can overflow
+      return false;
+    }
+    next++;
+  }
+  return next != b;
+} // parseChunkSize
+
 bool HttpParser::validPath(string p) {
   if (p[0] == '/') {
     return true;
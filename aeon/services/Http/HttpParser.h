@@ -41,8 +41,15 @@
 
 class HttpParser {
 public:
-  static void parseRequest(std::string buf, HttpRequestContext& context,
+  static void parseRequest(const std::string& buf, HttpRequestContext& context,
 			   size_t& lengthUsed, bool& valid, bool& done);
+  // Parses the request beginning at offset in buf in place.  scanned
+  // records how many bytes past offset have already been searched for the
+  // end of the header, so a request arriving over several reads is only
+  // scanned once; reset it to 0 whenever the request is consumed.
+  static void parseRequest(const std::string& buf, size_t offset, size_t& scanned,
+			   HttpRequestContext& context, size_t& lengthUsed,
+			   bool& valid, bool& done);
   static bool readHeader(std::string& request, StringList& req, size_t& lengthUsed);
   static bool parseHeaders(StringList& req, HttpRequestContext& context,
 			   size_t& contentLength);
@@ -54,6 +61,23 @@ public:
   static bool parseRequestHeaderLine(StringList& req, HttpRequestContext& context);
   static bool parseResponseHeaderLine(StringList& req, HttpResponse& response);
   static bool validPath(std::string p);
+
+  static const size_t MAX_HEADER_SIZE = 65536;
+  static const size_t MAX_CHUNK_SIZE = 1 << 30;
+
+private:
+  static bool applyHeader(const std::string& name, const std::string& value,
+			  HttpRequestContext& context, size_t& contentLength);
+  static bool parseRequestLine(const char* b, const char* e,
+			       HttpRequestContext& context);
+  static bool parseHeaderLine(const char* b, const char* e,
+			      HttpRequestContext& context, size_t& contentLength);
+  static void readChunked(const char* b, const char* e, std::string& content,
+			  size_t& lengthUsed, bool& valid, bool& done);
+  // returns false if there are no hex digits at b or the size exceeds
+  // MAX_CHUNK_SIZE; next is left at the first character after the digits
+  static bool parseChunkSize(const char* b, const char* e, size_t& size,
+			     const char*& next);
 }; // HttpParser
 
 #endif // HTTPPARSER_H
@@ -35,7 +35,12 @@
 #include "SysUtil.h"
 #include "SockUtil.h"
 #include "TimeUtil.h"
+#include "params.h"
 #include <signal.h>
+#include <errno.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 using namespace std;
 
@@ -47,12 +52,20 @@ long long HttpServer::diskTime = 0;
 // const int HttpServer::IDLE_TIMEOUT = 90; // time (seconds) to keep connections open
 const int HttpServer::IDLE_TIMEOUT = 0; // time (seconds) to keep connections open
 const int HttpServer::SELECT_TIMEOUT_MILLI = 1;
+// how often an idle epoll worker wakes to check for shutdown
+const int HttpServer::EPOLL_IDLE_TIMEOUT_MILLI = 100;
 
 HttpServer::HttpServer(uint16_t p, int bl) : port(p), backlog(bl), running(false) {
 
   serverAddr = Util::getAddr();
   serverName = Util::getHostByAddr(serverAddr);
 
+  // number of epoll worker threads; 0 selects the single select() loop
+  workerCount = params::get<int>("HTTP_SERVER_THREADS", 1);
+#ifndef HAVE_SYS_EPOLL_H
+  workerCount = 0;
+#endif
+
   // initialize profiling variables
   parseCount = 0;
   parseTime = 0;
@@ -62,10 +75,13 @@ HttpServer::HttpServer(uint16_t p, int bl) : port(p), backlog(bl), running(false
   processTime = 0;
   selectTime = 0;
   readCount = 0;
+
+  pthread_mutex_init(&workersLock, 0);
 } // HttpServer
 
 HttpServer::~HttpServer() {
   shutdown();
+  pthread_mutex_destroy(&workersLock);
 } // ~HttpServer
 
 void HttpServer::shutdown() {
@@ -83,7 +99,12 @@ void HttpServer::run() {
 } // run
 
 void HttpServer::registerUrlHandler(const string& path, UrlHandler* h) {
+  // held across both so a worker being created copies every handler
+  ScopedLock sl(workersLock);
   dispatcher.addHandler(path, h);
+  for (EpollWorkerList::iterator i = workers.begin(); i != workers.end(); i++) {
+    (*i)->dispatcher.addHandler(path, h);
+  }
 } // registerUrlHandler
 
 void HttpServer::setDocumentRoot(const string& path) {
@@ -114,6 +135,12 @@ void HttpServer::runServerThread() {
     assert(false);
   }
 
+  if (workerCount > 0) {
+    runEpollWorkers();
+    maceout << "httpd server halting" << Log::endl;
+    return;
+  }
+
   fd_set rset;
   fd_set wset;
   FD_ZERO(&rset);
@@ -146,7 +173,7 @@ void HttpServer::runServerThread() {
 	  assert(0);
 	}
 	else if (n > 0 && FD_ISSET(serverSocket, &rset)) {
-	  handleAccept();
+	  handleAccept(connections);
 	  acceptedCount++;
 	}
       } while (!stopServer && (n > 0));
@@ -200,7 +227,7 @@ void HttpServer::runServerThread() {
 	FD_SET(s, &wset);
       }
       else {
-	if (c->usingSocket() && !c->hasWebObject()) {
+	if (c->isBusy()) {
 	  unwriteableConnections[s] = c;
 	}
       }
@@ -254,7 +281,7 @@ void HttpServer::runServerThread() {
     int closedCount = 0;
 
     if (FD_ISSET(serverSocket, &rset)) {
-      handleAccept();
+      handleAccept(connections);
       acceptedCount++;
     }
 
@@ -269,7 +296,7 @@ void HttpServer::runServerThread() {
       if (c->isOpen() && c->isReadable() &&
 	  (FD_ISSET(s, &rset) || !c->usingSocket())) {
 
-	handleRead(*c, s);
+	handleRead(dispatcher, *c, s);
       }
 
       if (c->isOpen() && FD_ISSET(s, &wset)) {
@@ -308,6 +335,192 @@ void HttpServer::runServerThread() {
 // private methods
 ////////////////////////////////////////////////////////////////////////
 
+void* HttpServer::startEpollWorker(void* arg) {
+  EpollWorker* w = (EpollWorker*)arg;
+  w->server->runEpollWorker(*w);
+  return 0;
+} // startEpollWorker
+
+void HttpServer::runEpollWorkers() {
+  ScopedLock sl(workersLock);
+  for (int i = 0; i < workerCount; i++) {
+    workers.push_back(new EpollWorker(this, dispatcher));
+  }
+  sl.unlock();
+
+  // the server thread doubles as the first worker
+  for (size_t i = 1; i < workers.size(); i++) {
+    runNewThread(&workers[i]->thread, HttpServer::startEpollWorker, workers[i], 0);
+  }
+  runEpollWorker(*workers[0]);
+  for (size_t i = 1; i < workers.size(); i++) {
+    pthread_join(workers[i]->thread, 0);
+  }
+
+  sl.lock();
+  for (size_t i = 0; i < workers.size(); i++) {
+    delete workers[i];
+  }
+  workers.clear();
+} // runEpollWorkers
+
+void HttpServer::runEpollWorker(EpollWorker& w) {
+#ifdef HAVE_SYS_EPOLL_H
+  ADD_SELECTORS("HttpServer::runEpollWorker");
+  w.epfd = epoll_create(EPOLL_MAX_EVENTS);
+  if (w.epfd < 0) {
+    Log::perror("epoll_create");
+    ABORT("epoll_create");
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+  // wake only one worker per incoming connection
+  ev.events |= EPOLLEXCLUSIVE;
+#endif
+  ev.data.fd = serverSocket;
+  if (epoll_ctl(w.epfd, EPOLL_CTL_ADD, serverSocket, &ev) < 0) {
+    Log::perror("epoll_ctl");
+    ABORT("epoll_ctl");
+  }
+
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  while (!stopServer) {
+    // connections waiting on an asynchronous web object have no socket
+    // event to wake us, so poll for them at the select loop's rate
+    int timeout = w.waiting.empty() ? EPOLL_IDLE_TIMEOUT_MILLI : SELECT_TIMEOUT_MILLI;
+    int n = epoll_wait(w.epfd, events, EPOLL_MAX_EVENTS, timeout);
+    if (n < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      Log::perror("epoll_wait");
+      ABORT("epoll_wait");
+    }
+
+    for (int i = 0; i < n; i++) {
+      socket_t s = events[i].data.fd;
+      if (s == serverSocket) {
+	acceptEpoll(w);
+	continue;
+      }
+
+      HttpConnection::ConnectionMap::iterator ci = w.connections.find(s);
+      if (ci == w.connections.end()) {
+	continue;
+      }
+      HttpConnectionPtr c = ci->second;
+      uint32_t e = events[i].events;
+      if (c->isOpen() && c->isReadable() && (e & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+	handleRead(w.dispatcher, *c, s);
+      }
+      if (c->isOpen() && (e & EPOLLOUT) && c->isWriteable()) {
+	handleWrite(*c);
+      }
+      serviceEpollConnection(w, s, c);
+    }
+
+    if (!w.waiting.empty()) {
+      w.dispatcher.pollWebObjects(w.waiting);
+
+      HttpConnection::ConnectionMap ready = w.waiting;
+      for (HttpConnection::ConnectionMap::const_iterator i = ready.begin();
+	   i != ready.end(); i++) {
+	HttpConnectionPtr c = i->second;
+	if (c->isOpen() && c->isWriteable()) {
+	  // the socket is almost always writeable, so skip a round trip
+	  // through epoll
+	  handleWrite(*c);
+	}
+	serviceEpollConnection(w, i->first, c);
+      }
+    }
+  }
+
+  for (HttpConnection::ConnectionMap::const_iterator i = w.connections.begin();
+       i != w.connections.end(); i++) {
+    i->second->close();
+  }
+  w.connections.clear();
+  w.waiting.clear();
+  w.interest.clear();
+  ::close(w.epfd);
+  w.epfd = -1;
+#else
+  ABORT("epoll unsupported");
+#endif
+} // runEpollWorker
+
+void HttpServer::acceptEpoll(EpollWorker& w) {
+#ifdef HAVE_SYS_EPOLL_H
+  socket_t s;
+  while (!stopServer && (s = handleAccept(w.connections)) >= 0) {
+    __sync_fetch_and_add(&acceptCount, 1);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = s;
+    if (epoll_ctl(w.epfd, EPOLL_CTL_ADD, s, &ev) < 0) {
+      Log::perror("epoll_ctl");
+      w.connections[s]->close(true);
+      w.connections.erase(s);
+      continue;
+    }
+    w.interest[s] = EPOLLIN;
+  }
+#endif
+} // acceptEpoll
+
+void HttpServer::serviceEpollConnection(EpollWorker& w, socket_t s,
+					HttpConnectionPtr c) {
+#ifdef HAVE_SYS_EPOLL_H
+  // serve pipelined requests that are already buffered
+  while (c->isOpen() && c->isReadable() && !c->usingSocket()) {
+    handleRead(w.dispatcher, *c, s);
+    if (c->isOpen() && c->isWriteable()) {
+      handleWrite(*c);
+    }
+  }
+
+  if (!c->isOpen()) {
+    // closing the descriptor already removed it from the epoll set
+    w.dispatcher.clearWebObjects(s);
+    w.connections.erase(s);
+    w.waiting.erase(s);
+    w.interest.erase(s);
+    return;
+  }
+
+  if (c->isBusy() && !c->isWriteable()) {
+    w.waiting[s] = c;
+  }
+  else {
+    w.waiting.erase(s);
+  }
+
+  uint32_t events = 0;
+  if (c->isReadable() && c->usingSocket()) {
+    events |= EPOLLIN;
+  }
+  if (c->isWriteable()) {
+    events |= EPOLLOUT;
+  }
+  uint32_t& current = w.interest[s];
+  if (events != current) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = s;
+    if (epoll_ctl(w.epfd, EPOLL_CTL_MOD, s, &ev) < 0) {
+      Log::perror("epoll_ctl");
+    }
+    current = events;
+  }
+#endif
+} // serviceEpollConnection
+
 void HttpServer::printProfilingResults() {
   if (1) {
     timeval now;
@@ -412,7 +625,7 @@ void HttpServer::setNonblock(socket_t s) {
   SockUtil::setNonblock(s);
 } // setNonblock
 
-void HttpServer::handleAccept() {
+socket_t HttpServer::handleAccept(HttpConnection::ConnectionMap& m) {
   sockaddr_in sin;
   socklen_t sinlen = sizeof(sin);
   memset(&sin, 0, sinlen); 
@@ -420,7 +633,7 @@ void HttpServer::handleAccept() {
   socket_t s;
   if ((s = accept(serverSocket, (sockaddr*) &sin, &sinlen)) < 0) {
     if (SockUtil::errorWouldBlock() || SockUtil::errorConnFail()) {
-      return;
+      return -1;
     }
     Log::perror("accept");
     assert(false);
@@ -428,11 +641,11 @@ void HttpServer::handleAccept() {
 
   setNonblock(s);
   HttpConnectionPtr c = HttpConnectionPtr(new HttpConnection(s));
-  connections[s] = c;
+  m[s] = c;
+  return s;
 } // handleAccept
 
-void HttpServer::handleRead(HttpConnection& c, socket_t s) {
-  string buf;
+void HttpServer::handleRead(RequestDispatcher& d, HttpConnection& c, socket_t s) {
   timeval stv;
   timeval etv;
 
@@ -440,15 +653,15 @@ void HttpServer::handleRead(HttpConnection& c, socket_t s) {
   if (profile) {
     gettimeofday(&stv, 0);
   }
-  rv = c.read(buf);
+  rv = c.read();
   if (profile) {
     gettimeofday(&etv, 0);
-    readTime += TimeUtil::timediff(stv, etv);
+    __sync_fetch_and_add(&readTime, TimeUtil::timediff(stv, etv));
   }
   if (rv <= 0) {
     return;
   }
-  readCount++;
+  __sync_fetch_and_add(&readCount, 1);
 
   assert(rv > 0);
 
@@ -461,10 +674,10 @@ void HttpServer::handleRead(HttpConnection& c, socket_t s) {
   bool isParseValid;
   bool isParseDone;
 
-  HttpParser::parseRequest(buf, req, lengthUsed, isParseValid, isParseDone);
+  c.parseRequest(req, lengthUsed, isParseValid, isParseDone);
   if (profile) {
     gettimeofday(&etv, 0);
-    parseTime += TimeUtil::timediff(stv, etv);
+    __sync_fetch_and_add(&parseTime, TimeUtil::timediff(stv, etv));
   }
   
 //   cout << "isDone=" << isParseDone << " isValid=" << isParseValid
@@ -482,7 +695,7 @@ void HttpServer::handleRead(HttpConnection& c, socket_t s) {
 	c.clearKeepAlive();
       }
 
-      parseCount++;
+      __sync_fetch_and_add(&parseCount, 1);
       c.setHttpVersion(req.httpVersion);
       c.advanceReadBuffer(lengthUsed);
 
@@ -505,7 +718,8 @@ void HttpServer::handleRead(HttpConnection& c, socket_t s) {
 //       cout << "path=" << path << endl;
 
       // request web object
-      if (!dispatcher.dispatch(req.path, req, s, c)) {
+      c.setBusy();
+      if (!d.dispatch(req.path, req, s, c)) {
 	c.sendError(HttpResponse::NOT_FOUND);
 	return;
       }
@@ -525,7 +739,8 @@ void HttpServer::handleWrite(HttpConnection& c) {
     gettimeofday(&sentTimer, 0);
   }
 
-  bytesSent += c.write();
+  // handleRead and handleWrite run concurrently on every epoll worker
+  __sync_fetch_and_add(&bytesSent, c.write());
 } // handleWrite
 
 string HttpServer::canonicalizePath(const string& url) {
@@ -43,8 +43,10 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "m_net.h"
+#include "ScopedLock.h"
 #include "HttpServerServiceClass.h"
 
 #include "RequestDispatcher.h"
@@ -71,11 +73,34 @@ protected:
   std::string canonicalizePath(const std::string& p);
 
 private:
+  typedef mace::map<socket_t, uint32_t, mace::SoftState> InterestMap;
+
+  // one epoll loop; each worker owns its connections and a copy of the
+  // dispatcher, and accepts from the shared listening socket itself
+  struct EpollWorker {
+    EpollWorker(HttpServer* s, const RequestDispatcher& d) :
+      server(s), epfd(-1), dispatcher(d) { }
+    HttpServer* server;
+    int epfd;
+    pthread_t thread;
+    RequestDispatcher dispatcher;
+    HttpConnection::ConnectionMap connections;
+    HttpConnection::ConnectionMap waiting;
+    InterestMap interest;
+  };
+  typedef std::vector<EpollWorker*> EpollWorkerList;
+
+  static void* startEpollWorker(void* arg);
+  void runEpollWorkers();
+  void runEpollWorker(EpollWorker& w);
+  void acceptEpoll(EpollWorker& w);
+  void serviceEpollConnection(EpollWorker& w, socket_t s, HttpConnectionPtr c);
+
   void printProfilingResults();
   void setupSocket();
   void setNonblock(socket_t s);
-  void handleAccept();
-  void handleRead(HttpConnection& c, socket_t s);
+  socket_t handleAccept(HttpConnection::ConnectionMap& m);
+  void handleRead(RequestDispatcher& d, HttpConnection& c, socket_t s);
   void handleWrite(HttpConnection& c);
 
 public:
@@ -95,14 +120,21 @@ private:
 
   static const int IDLE_TIMEOUT;
   static const int SELECT_TIMEOUT_MILLI;
+  static const int EPOLL_IDLE_TIMEOUT_MILLI;
+  static const int EPOLL_MAX_EVENTS = 256;
   bool stopServer;
   socket_t serverSocket;
   std::string root;
   HttpConnection::ConnectionMap connections;
   RequestDispatcher dispatcher;
   pthread_t serverThread;
+  int workerCount;
+  pthread_mutex_t workersLock; // guards workers
+  EpollWorkerList workers;
 
-  // profiling variables
+  // profiling variables; the counters updated from handleRead, handleWrite
+  // and acceptEpoll are shared by every epoll worker and only changed with
+  // __sync_fetch_and_add
   unsigned int selectCount;
   unsigned int acceptCount;
   unsigned int parseCount;
@@ -108,12 +108,26 @@ bool RequestDispatcher::dispatch(const string& url, const HttpRequestContext& re
     UrlHandlerMap::iterator i = handlers.find(p);
     assert(i != handlers.end());
     UrlHandler* h = i->second;
-    uint64_t now = TimeUtil::timeu();
-    if (h->requestWebObject(url, req, now, c)) {
-      requests[s][now] = h;
+    uint64_t id = nextRequestId();
+    if (h->requestWebObject(url, req, id, c)) {
+      requests[s][id] = h;
     }
   }
   
   return match;
 } // dispatch
 
+uint64_t RequestDispatcher::nextRequestId() {
+  // handlers key their ready objects by this id, and several server
+  // workers may dispatch to the same handler in the same microsecond
+  static uint64_t last = 0;
+  uint64_t id = TimeUtil::timeu();
+  uint64_t prev;
+  do {
+    prev = last;
+    if (id <= prev) {
+      id = prev + 1;
+    }
+  } while (!__sync_bool_compare_and_swap(&last, prev, id));
+  return id;
+} // nextRequestId
@@ -52,6 +52,9 @@ public:
 		HttpConnection& c);
   void clearWebObjects(int s);
 
+private:
+  static uint64_t nextRequestId();
+
 private:
   UrlHandlerMap handlers;
   UrlLengthMap urls;
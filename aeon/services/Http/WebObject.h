@@ -47,6 +47,8 @@ public:
   virtual bool hasMoreChunks() { return false; }
   virtual bool isChunkReady() { return false; }
   virtual bool isRaw() { return false; }
+  // descriptor the body can be sent from directly, or -1
+  virtual int getFd() const { return -1; }
   virtual std::string readChunk() throw (HttpServerException) {
     throw HttpServerException("readChunk unsupported");
   }
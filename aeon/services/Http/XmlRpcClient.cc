@@ -32,12 +32,12 @@
 
 using namespace std;
 
-XmlRpcClient::XmlRpcClient(const string& url, bool async) : HttpClient(async), url(url) {
+XmlRpcClient::XmlRpcClient(const string& url, bool async) : HttpClient(async), url(url), binary(false) {
 }
 
 XmlRpcClient::XmlRpcClient(const string& host, uint16_t port, const string& url,
 			   bool async) :
-  HttpClient(host, port, async), url(url) {
+  HttpClient(host, port, async), url(url), binary(false) {
 }
 
 XmlRpcClient::~XmlRpcClient() {
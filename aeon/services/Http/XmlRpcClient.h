@@ -33,6 +33,7 @@
 
 #include "HttpClient.h"
 #include "HttpClientException.h"
+#include "XmlRpcResponse.h"
 
 class XmlRpcClient : protected HttpClient, public HttpClientResponseHandler {
 public:
@@ -46,9 +47,19 @@ public:
   virtual void closeConnection() {
     HttpClient::closeConnection();
   }
+  // send calls in the native binary encoding rather than XML; the server
+  // must also support it
+  virtual void setBinary(bool b) { binary = b; }
+  bool isBinary() const { return binary; }
+
+protected:
+  std::string getContentType() const {
+    return binary ? XmlRpcResponse::BINARY_CONTENT_TYPE : "text/xml";
+  }
 
 protected:
   std::string url;
+  bool binary;
 }; // XmlRpcClient
 
 template<class T>
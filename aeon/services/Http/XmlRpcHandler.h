@@ -34,6 +34,7 @@
 #include <istream>
 #include <string>
 #include "Collections.h"
+#include "XmlRpcResponse.h"
 
 class XmlRpcHandler {
 protected:
@@ -47,6 +48,13 @@ public:
   }
   // xmlData begins with <params> and ends with </params></methodCall>
   virtual std::string execute(const std::string& methodName, std::istream& xmlData) = 0;
+  // binaryData holds the natively serialized parameters; the result is
+  // built with XmlRpcResponse::constructBinarySuccess or constructBinaryFault
+  virtual std::string executeBinary(const std::string& methodName,
+				    std::istream& binaryData) {
+    return XmlRpcResponse::constructBinaryFault(XmlRpcResponse::INVALID_METHOD,
+						"BINARY ENCODING UNSUPPORTED");
+  }
 };
 
 #endif // _XML_RPC_HANDLER_H
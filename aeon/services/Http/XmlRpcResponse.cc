@@ -33,6 +33,9 @@
 const int XmlRpcResponse::BAD_REQUEST;
 const int XmlRpcResponse::INVALID_METHOD;
 const int XmlRpcResponse::SERVER_ERROR;
+const char* const XmlRpcResponse::BINARY_CONTENT_TYPE = "application/x-mace-rpc";
+const uint8_t XmlRpcResponse::BINARY_SUCCESS;
+const uint8_t XmlRpcResponse::BINARY_FAULT;
 
 std::string XmlRpcResponse::constructFault(int errCode, const std::string& errMsg) {
   char buf[30];
@@ -107,3 +110,40 @@ void XmlRpcResponse::parseFault(std::istream& in, int& errorCode,
   mace::SerializationUtil::expectTag(in, "</struct>");
   mace::SerializationUtil::expectTag(in, "</value>");
 } // parseFault
+
+std::string XmlRpcResponse::constructBinaryFault(int errCode, const std::string& errMsg) {
+  std::string r;
+  uint8_t status = BINARY_FAULT;
+  int32_t code = errCode;
+  mace::serialize(r, &status);
+  mace::serialize(r, &code);
+  mace::serialize(r, &errMsg);
+  return r;
+} // constructBinaryFault
+
+std::string XmlRpcResponse::constructBinarySuccess(const std::string& retVal) {
+  std::string r;
+  uint8_t status = BINARY_SUCCESS;
+  r.reserve(sizeof(status) + retVal.size());
+  mace::serialize(r, &status);
+  r.append(retVal);
+  return r;
+} // constructBinarySuccess
+
+void XmlRpcResponse::parseBinaryStatus(std::istream& in, bool& fault, int& errorCode,
+				       mace::string& errorString)
+  throw(mace::SerializationException) {
+  uint8_t status;
+  mace::deserialize(in, &status);
+  if (status != BINARY_SUCCESS && status != BINARY_FAULT) {
+    throw mace::SerializationException("bad binary response status " +
+				       boost::lexical_cast<std::string>((int)status));
+  }
+  fault = (status == BINARY_FAULT);
+  if (fault) {
+    int32_t code;
+    mace::deserialize(in, &code);
+    mace::deserialize(in, &errorString);
+    errorCode = code;
+  }
+} // parseBinaryStatus
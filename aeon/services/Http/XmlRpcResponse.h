@@ -43,10 +43,25 @@ public:
 			 mace::string& errorString) 
     throw(mace::SerializationException);
 
+  // Binary responses are a status byte followed by either the natively
+  // serialized return value or an int32 fault code and fault string.
+  static std::string constructBinaryFault(int errorCode, const std::string& message);
+  static std::string constructBinarySuccess(const std::string& value);
+  // reads the status, and the fault if there is one; on success the
+  // return value is left at the head of in
+  static void parseBinaryStatus(std::istream& in, bool& fault, int& errorCode,
+				mace::string& errorString)
+    throw(mace::SerializationException);
+
 public:
   static const int BAD_REQUEST = 400;
   static const int INVALID_METHOD = 404;
   static const int SERVER_ERROR = 500;
+
+  // requests carrying this content type use the binary encoding
+  static const char* const BINARY_CONTENT_TYPE;
+  static const uint8_t BINARY_SUCCESS = 0;
+  static const uint8_t BINARY_FAULT = 1;
 }; // XmlRpcResponse
 
 #endif // XMLRPC_RESPONSE_H
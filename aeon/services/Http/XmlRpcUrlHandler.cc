@@ -30,6 +30,7 @@
  * ----END-OF-LEGAL-STUFF---- */
 #include "XmlRpcUrlHandler.h"
 #include <iostream>
+#include <strings.h>
 
 using namespace std;
 using mace::SerializationUtil;
@@ -67,8 +68,14 @@ void XmlRpcUrlHandler::registerHandler(const string& className,
 } // registerHandler
 
 void XmlRpcUrlHandler::execute(XmlRpcRequestState* req) {
-  string r = req->hs.handler->execute(req->method, req->is);
-  XmlRpcWebObject* w = new XmlRpcWebObject();
+  string r;
+  if (req->binary) {
+    r = req->hs.handler->executeBinary(req->method, req->is);
+  }
+  else {
+    r = req->hs.handler->execute(req->method, req->is);
+  }
+  XmlRpcWebObject* w = new XmlRpcWebObject(req->binary);
   w->setResult(r);
   uint64_t id = req->id;
   setWebObject(id, w);
@@ -84,9 +91,10 @@ bool XmlRpcUrlHandler::requestWebObject(const string& url, const HttpRequestCont
   }
   
   struct XmlRpcRequestState* rs = new XmlRpcRequestState();
+  rs->binary = isBinaryRequest(req);
   rs->is.str(req.content);
 
-  StringPair p = parseMethodName(rs->is);
+  StringPair p = rs->binary ? parseBinaryMethodName(rs->is) : parseMethodName(rs->is);
 
   if (p.first.empty() || p.second.empty()) {
     sendFault(c, HttpResponse::BAD_REQUEST, "BAD REQUEST", rs);
@@ -110,7 +118,7 @@ bool XmlRpcUrlHandler::requestWebObject(const string& url, const HttpRequestCont
 
 void XmlRpcUrlHandler::sendFault(HttpConnection& c, int code, const string& m,
 				 XmlRpcRequestState* s) {
-  XmlRpcWebObject* w = new XmlRpcWebObject();
+  XmlRpcWebObject* w = new XmlRpcWebObject(s->binary);
   w->setFault(code, m);
   c.setWebObject(w);
   delete s;
@@ -159,3 +167,30 @@ StringPair XmlRpcUrlHandler::parseMethodName(istringstream& is) {
   return StringPair(m[0], m[1]);
 } // parseMethodName
 
+StringPair XmlRpcUrlHandler::parseBinaryMethodName(istream& is) {
+  // the body opens with the serialized "Class.method" string, and the
+  // parameters follow it on the same stream
+  string call;
+  try {
+    mace::deserialize(is, &call);
+  } catch (const mace::SerializationException& e) {
+    return StringPair("", "");
+  }
+
+  string::size_type i = call.rfind('.');
+  if (i == string::npos) {
+    return StringPair("", "");
+  }
+
+  return StringPair(call.substr(0, i), call.substr(i + 1));
+} // parseBinaryMethodName
+
+bool XmlRpcUrlHandler::isBinaryRequest(const HttpRequestContext& req) {
+  static const size_t len = strlen(XmlRpcResponse::BINARY_CONTENT_TYPE);
+  for (StringHMap::const_iterator i = req.headers.begin(); i != req.headers.end(); i++) {
+    if (strcasecmp(i->first.c_str(), "content-type") == 0) {
+      return (strncasecmp(i->second.c_str(), XmlRpcResponse::BINARY_CONTENT_TYPE, len) == 0);
+    }
+  }
+  return false;
+} // isBinaryRequest
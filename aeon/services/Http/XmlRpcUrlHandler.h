@@ -50,6 +50,7 @@ class XmlRpcUrlHandler : public UrlHandler {
 
   struct XmlRpcRequestState {
     uint64_t id;
+    bool binary;
     XmlRpcUrlHandlerState hs;
     std::string method;
     std::istringstream is;
@@ -72,6 +73,9 @@ public:
 				uint64_t id, HttpConnection& c);
   virtual void execute(XmlRpcRequestState* req);
   virtual void shutdown();
+  // splits the serialized "Class.method" header off a binary request,
+  // leaving the parameters at the head of s; empty strings if not parsed
+  static StringPair parseBinaryMethodName(std::istream& s);
 
 protected:
   void sendFault(HttpConnection& c, int code, const std::string& error,
@@ -82,6 +86,7 @@ private:
 			  const std::string& methodName) const;
   // returns empty strings if not parsed
   StringPair parseMethodName(std::istringstream& s);
+  static bool isBinaryRequest(const HttpRequestContext& req);
 
 private:
   XmlRpcRequestQueue* requests;
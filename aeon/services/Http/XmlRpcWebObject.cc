@@ -33,12 +33,20 @@
 using namespace std;
 
 
-XmlRpcWebObject::XmlRpcWebObject() {
+XmlRpcWebObject::XmlRpcWebObject(bool b) : binary(b) {
+  if (binary) {
+    setContentType(XmlRpcResponse::BINARY_CONTENT_TYPE);
+    return;
+  }
   setContentType("text/xml");
   append("<?xml version=\"1.0\"?>\n");
 } // XmlRpcWebObject
 
 void XmlRpcWebObject::setFault(int errorCode, const string& m) {
+  if (binary) {
+    appendFinal(XmlRpcResponse::constructBinaryFault(errorCode, m));
+    return;
+  }
   appendFinal(XmlRpcResponse::constructFault(errorCode, m));
 } // setFault
 
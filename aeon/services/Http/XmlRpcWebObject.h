@@ -36,10 +36,13 @@
 
 class XmlRpcWebObject : public WebObject {
 public:
-  XmlRpcWebObject();
+  XmlRpcWebObject(bool binary = false);
   virtual ~XmlRpcWebObject() { }
   virtual void setFault(int errorCode, const std::string& m);
   virtual void setResult(const std::string& r);
+
+private:
+  bool binary;
 }; // XmlRpcWebObject
 
 #endif // XML_RPC_WEB_OBJECT_H
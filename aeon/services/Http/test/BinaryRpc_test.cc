@@ -0,0 +1,129 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Http
+#include <boost/test/unit_test.hpp>
+#include "XmlRpcResponse.h"
+#include "XmlRpcUrlHandler.h"
+
+namespace {
+  // builds a request body the way the generated binary clients do
+  std::string makeRequest(const std::string& call, uint32_t a, const mace::string& b) {
+    std::string str;
+    mace::serialize(str, &call);
+    mace::serialize(str, &a);
+    mace::serialize(str, &b);
+    return str;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( Http_BinaryRpc )
+
+BOOST_AUTO_TEST_CASE( RequestRoundTrip )
+{
+  std::istringstream is(makeRequest("Counter.add", 42, "label"));
+  StringPair p = XmlRpcUrlHandler::parseBinaryMethodName(is);
+  BOOST_REQUIRE_EQUAL( p.first, "Counter" );
+  BOOST_REQUIRE_EQUAL( p.second, "add" );
+
+  // the parameters are left on the stream for the handler
+  uint32_t a;
+  mace::string b;
+  mace::deserialize(is, &a);
+  mace::deserialize(is, &b);
+  BOOST_REQUIRE_EQUAL( a, 42u );
+  BOOST_REQUIRE_EQUAL( b, "label" );
+  BOOST_REQUIRE_EQUAL( is.peek(), EOF );
+
+  // a dotted class name splits on the last dot
+  std::istringstream dotted(makeRequest("ns.Counter.add", 0, ""));
+  p = XmlRpcUrlHandler::parseBinaryMethodName(dotted);
+  BOOST_REQUIRE_EQUAL( p.first, "ns.Counter" );
+  BOOST_REQUIRE_EQUAL( p.second, "add" );
+}
+
+BOOST_AUTO_TEST_CASE( MalformedRequest )
+{
+  std::istringstream empty("");
+  BOOST_REQUIRE( XmlRpcUrlHandler::parseBinaryMethodName(empty).first.empty() );
+
+  std::istringstream noDot(makeRequest("Counter", 0, ""));
+  BOOST_REQUIRE( XmlRpcUrlHandler::parseBinaryMethodName(noDot).first.empty() );
+
+  std::istringstream noMethod(makeRequest("Counter.", 0, ""));
+  BOOST_REQUIRE( XmlRpcUrlHandler::parseBinaryMethodName(noMethod).second.empty() );
+
+  // the header claims more bytes than the body holds
+  std::string call = makeRequest("Counter.add", 0, "");
+  std::istringstream truncated(call.substr(0, 6));
+  StringPair p = XmlRpcUrlHandler::parseBinaryMethodName(truncated);
+  BOOST_REQUIRE( p.first.empty() && p.second.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( SuccessRoundTrip )
+{
+  std::string ret;
+  mace::string v("result");
+  mace::serialize(ret, &v);
+
+  std::istringstream is(XmlRpcResponse::constructBinarySuccess(ret));
+  bool fault = true;
+  int code = 0;
+  mace::string err;
+  XmlRpcResponse::parseBinaryStatus(is, fault, code, err);
+  BOOST_REQUIRE( !fault );
+
+  mace::string out;
+  mace::deserialize(is, &out);
+  BOOST_REQUIRE_EQUAL( out, "result" );
+
+  // a void call returns only the status byte
+  std::istringstream empty(XmlRpcResponse::constructBinarySuccess(""));
+  XmlRpcResponse::parseBinaryStatus(empty, fault, code, err);
+  BOOST_REQUIRE( !fault );
+  BOOST_REQUIRE_EQUAL( empty.peek(), EOF );
+}
+
+BOOST_AUTO_TEST_CASE( FaultRoundTrip )
+{
+  std::istringstream is(XmlRpcResponse::constructBinaryFault(XmlRpcResponse::INVALID_METHOD,
+                                                             "no such method"));
+  bool fault = false;
+  int code = 0;
+  mace::string err;
+  XmlRpcResponse::parseBinaryStatus(is, fault, code, err);
+  BOOST_REQUIRE( fault );
+  BOOST_REQUIRE_EQUAL( code, XmlRpcResponse::INVALID_METHOD );
+  BOOST_REQUIRE_EQUAL( err, "no such method" );
+
+  std::istringstream negative(XmlRpcResponse::constructBinaryFault(-1, ""));
+  XmlRpcResponse::parseBinaryStatus(negative, fault, code, err);
+  BOOST_REQUIRE( fault );
+  BOOST_REQUIRE_EQUAL( code, -1 );
+  BOOST_REQUIRE( err.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( MalformedResponse )
+{
+  bool fault;
+  int code;
+  mace::string err;
+
+  std::istringstream empty("");
+  BOOST_REQUIRE_THROW( XmlRpcResponse::parseBinaryStatus(empty, fault, code, err),
+                       mace::SerializationException );
+
+  std::istringstream badStatus(std::string("\x07", 1));
+  BOOST_REQUIRE_THROW( XmlRpcResponse::parseBinaryStatus(badStatus, fault, code, err),
+                       mace::SerializationException );
+
+  // a fault cut off inside its code, and inside its message
+  std::string f = XmlRpcResponse::constructBinaryFault(XmlRpcResponse::SERVER_ERROR,
+                                                        "internal error");
+  std::istringstream shortCode(f.substr(0, 3));
+  BOOST_REQUIRE_THROW( XmlRpcResponse::parseBinaryStatus(shortCode, fault, code, err),
+                       mace::SerializationException );
+  std::istringstream shortMessage(f.substr(0, f.size() - 4));
+  BOOST_REQUIRE_THROW( XmlRpcResponse::parseBinaryStatus(shortMessage, fault, code, err),
+                       mace::SerializationException );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Http
+#include <boost/test/unit_test.hpp>
+#include "HttpParser.h"
+
+namespace {
+  // parses the request at offset the way HttpConnection does, with a fresh
+  // context for every attempt
+  struct Parse {
+    HttpRequestContext context;
+    size_t lengthUsed;
+    bool valid;
+    bool done;
+
+    Parse(const std::string& buf, size_t offset, size_t& scanned) {
+      HttpParser::parseRequest(buf, offset, scanned, context, lengthUsed, valid, done);
+    }
+  };
+
+  const std::string GET = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+}
+
+BOOST_AUTO_TEST_SUITE( Http_HttpParser )
+
+BOOST_AUTO_TEST_CASE( HeaderSplitAcrossReads )
+{
+  // the terminator arrives in two pieces, between and inside its CRLFs
+  for (size_t split = GET.size() - 4; split < GET.size(); split++) {
+    std::string buf = GET.substr(0, split);
+    size_t scanned = 0;
+    Parse first(buf, 0, scanned);
+    BOOST_REQUIRE( !first.done );
+    BOOST_REQUIRE_EQUAL( scanned, split );
+
+    buf.append(GET.substr(split));
+    Parse second(buf, 0, scanned);
+    BOOST_REQUIRE( second.done && second.valid );
+    BOOST_REQUIRE_EQUAL( second.lengthUsed, GET.size() );
+    BOOST_REQUIRE_EQUAL( second.context.url, "/index.html" );
+    BOOST_REQUIRE_EQUAL( second.context.headers["Host"], "localhost" );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( PipelinedRequests )
+{
+  const std::string post = "POST /rpc HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello";
+  const std::string buf = post + GET;
+
+  size_t scanned = 0;
+  Parse first(buf, 0, scanned);
+  BOOST_REQUIRE( first.done && first.valid );
+  BOOST_REQUIRE_EQUAL( first.lengthUsed, post.size() );
+  BOOST_REQUIRE_EQUAL( first.context.method, "POST" );
+  BOOST_REQUIRE_EQUAL( first.context.content, "hello" );
+
+  scanned = 0;
+  Parse second(buf, first.lengthUsed, scanned);
+  BOOST_REQUIRE( second.done && second.valid );
+  BOOST_REQUIRE_EQUAL( second.lengthUsed, GET.size() );
+  BOOST_REQUIRE_EQUAL( second.context.method, "GET" );
+  BOOST_REQUIRE( second.context.content.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( ChunkedBody )
+{
+  const std::string header = "POST /rpc HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+  const std::string body = "4\r\nWiki\r\n5\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\n\r\n";
+  const std::string request = header + body;
+
+  // a body that has not all arrived waits, with the header already scanned
+  std::string buf = request.substr(0, header.size() + 10);
+  size_t scanned = 0;
+  Parse partial(buf, 0, scanned);
+  BOOST_REQUIRE( !partial.done );
+  BOOST_REQUIRE_EQUAL( scanned, header.size() );
+
+  buf = request + GET;
+  Parse whole(buf, 0, scanned);
+  BOOST_REQUIRE( whole.done && whole.valid );
+  BOOST_REQUIRE_EQUAL( whole.lengthUsed, request.size() );
+  BOOST_REQUIRE_EQUAL( whole.context.content, "Wikipedia in\r\n\r\nchunks." );
+
+  scanned = 0;
+  Parse next(buf, whole.lengthUsed, scanned);
+  BOOST_REQUIRE( next.done && next.valid );
+  BOOST_REQUIRE_EQUAL( next.context.url, "/index.html" );
+}
+
+BOOST_AUTO_TEST_CASE( BadChunkSize )
+{
+  const std::string header = "POST /rpc HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+  // more hex digits than a size_t holds
+  size_t scanned = 0;
+  Parse overflow(header + "10000000000000004\r\nWiki\r\n0\r\n\r\n", 0, scanned);
+  BOOST_REQUIRE( overflow.done && !overflow.valid );
+
+  scanned = 0;
+  Parse tooLarge(header + "7fffffff\r\n", 0, scanned);
+  BOOST_REQUIRE( tooLarge.done && !tooLarge.valid );
+
+  scanned = 0;
+  Parse notHex(header + "zz\r\n", 0, scanned);
+  BOOST_REQUIRE( notHex.done && !notHex.valid );
+
+  // the client side reads chunked responses through the same size check
+  std::string response = "10000000000000004\r\nWiki\r\n0\r\n\r\n";
+  std::string content;
+  size_t lengthUsed = 0;
+  bool valid = false;
+  bool done = false;
+  HttpParser::readChunked(response, content, lengthUsed, valid, done);
+  BOOST_REQUIRE( done && !valid );
+}
+
+BOOST_AUTO_TEST_CASE( OversizedHeader )
+{
+  std::string buf = "GET / HTTP/1.1\r\nHost: localhost\r\nX-Filler: ";
+  size_t scanned = 0;
+  Parse small(buf, 0, scanned);
+  BOOST_REQUIRE( !small.done );
+
+  buf.append(HttpParser::MAX_HEADER_SIZE + 0, 'x');
+  Parse large(buf, 0, scanned);
+  BOOST_REQUIRE( large.done && !large.valid );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -218,6 +218,10 @@ public:
     pipeline = p;
   }
 
+  int getPortOffset() const {
+    return portOffset;
+  }
+
 public:
   static const uint64_t DEFAULT_WINDOW_SIZE = 5*1000*1000;
 
@@ -297,9 +301,10 @@ protected:
     return r;
   } // route
 
-private:
+protected:
+  virtual void setupSocket();
 
-  void setupSocket();
+private:
   void closeSockets();
 
 private:
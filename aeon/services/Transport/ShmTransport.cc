@@ -0,0 +1,583 @@
+/* 
+ * ShmTransport.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <stddef.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+#include "massert.h"
+#include "Accumulator.h"
+#include "ScopedLock.h"
+#include "params.h"
+
+#include "TransportScheduler.h"
+#include "ShmTransport.h"
+
+const uint8_t ShmTransport::LAST_FRAGMENT;
+const uint8_t ShmTransport::MORE_FRAGMENTS;
+
+namespace {
+  int createSegment(size_t size) {
+#ifdef SYS_memfd_create
+    int fd = syscall(SYS_memfd_create, "mace-shm", 0);
+    if (fd >= 0 && ftruncate(fd, size) < 0) {
+      ::close(fd);
+      fd = -1;
+    }
+    return fd;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+}
+
+ShmTransport::Channel::Channel(socket_t sock, int efd, int spaceFd, void* base, size_t size, bool initialize) :
+  sock(sock), efd(efd), spaceFd(spaceFd), base(base), size(size), ring(base, size, initialize), closed(0) {
+  pthread_mutex_init(&wlock, 0);
+} // Channel
+
+ShmTransport::Channel::~Channel() {
+  munmap(base, size);
+  ::close(efd);
+  ::close(spaceFd);
+  ::close(sock);
+  pthread_mutex_destroy(&wlock);
+} // ~Channel
+
+ShmTransport::ShmTransport(int portOffset) : BaseTransport(portOffset),
+  ringSize(std::max(params::get<size_t>(params::MACE_TRANSPORT_SHM_RING_SIZE, 4*1024*1024), (size_t)4096)),
+  rc(0), wc(0) {
+  pthread_mutex_init(&chanlock, 0);
+} // ShmTransport
+
+ShmTransport::~ShmTransport() {
+  pthread_mutex_destroy(&chanlock);
+} // ~ShmTransport
+
+ShmTransportPtr ShmTransport::create(int portOffset) {
+  ShmTransportPtr p(new ShmTransport(portOffset));
+  TransportScheduler::add(p);
+  return p;
+} // create
+
+void ShmTransport::fillUnixAddr(uint32_t addr, uint16_t port, struct sockaddr_un& sa, socklen_t& len) {
+  std::ostringstream name;
+  name << "mace-shm-" << addr << "-" << port;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  // the leading nul puts the name in the abstract namespace, so nothing is left behind on exit
+  strncpy(sa.sun_path + 1, name.str().c_str(), sizeof(sa.sun_path) - 2);
+  len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(sa.sun_path + 1);
+} // fillUnixAddr
+
+void ShmTransport::setupSocket() {
+  ADD_SELECTORS("ShmTransport::setupSocket");
+
+  transportSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (transportSocket < 0) {
+    Log::perror("socket");
+    ABORT("socket");
+  }
+
+  struct sockaddr_un sa;
+  socklen_t len;
+  fillUnixAddr(saddr, port, sa, len);
+  maceout << "binding to " << (sa.sun_path + 1) << Log::endl;
+
+  if (bind(transportSocket, (struct sockaddr*)&sa, len) < 0) {
+    Log::perror("bind");
+    ::close(transportSocket);
+    std::ostringstream m;
+    m << "ShmTransport::setupSocket: error binding to " << (sa.sun_path + 1)
+      << ": " << Util::getErrorString(SockUtil::getErrno());
+    throw BindException(m.str());
+  }
+
+  SockUtil::setNonblock(transportSocket);
+} // setupSocket
+
+bool ShmTransport::isLocal(const MaceKey& dest) {
+  if (!running || !forwardingHost.isNull()) {
+    return false;
+  }
+  const MaceAddr& ma = dest.getMaceAddr();
+  if (!ma.proxy.isNull() || ma.local.addr != saddr) {
+    return false;
+  }
+  return getChannel(ma.local);
+} // isLocal
+
+ShmTransport::ChannelPtr ShmTransport::getChannel(const SockAddr& ma) {
+  ScopedLock sl(chanlock);
+  ChannelMap::iterator i = out.find(ma);
+  if (i != out.end()) {
+    if (!i->second->isClosed()) {
+      return i->second;
+    }
+    out.erase(i);
+  }
+  // a peer that refused once keeps using the other transport, so its messages stay in order
+  if (unreachable.contains(ma)) {
+    return ChannelPtr();
+  }
+  ChannelPtr c = connectChannel(ma);
+  if (c) {
+    out[ma] = c;
+  }
+  else {
+    unreachable.insert(ma);
+  }
+  return c;
+} // getChannel
+
+ShmTransport::ChannelPtr ShmTransport::connectChannel(const SockAddr& ma) {
+  ADD_SELECTORS("ShmTransport::connectChannel");
+
+  struct sockaddr_un sa;
+  socklen_t len;
+  fillUnixAddr(ma.addr, ma.port + portOffset, sa, len);
+
+  socket_t s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s < 0) {
+    Log::perror("socket");
+    return ChannelPtr();
+  }
+  if (connect(s, (struct sockaddr*)&sa, len) < 0) {
+    macedbg(1) << "no shared memory peer at " << ma << ": "
+	       << Util::getErrorString(SockUtil::getErrno()) << Log::endl;
+    ::close(s);
+    return ChannelPtr();
+  }
+
+  const size_t size = mace::ShmRing::segmentSize(ringSize);
+  int fd = createSegment(size);
+  int efd = (fd < 0) ? -1 : eventfd(0, EFD_NONBLOCK);
+  int spaceFd = (efd < 0) ? -1 : eventfd(0, EFD_NONBLOCK);
+  void* base = (spaceFd < 0) ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    Log::perror("shared memory segment");
+    if (spaceFd >= 0) {
+      ::close(spaceFd);
+    }
+    if (efd >= 0) {
+      ::close(efd);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    ::close(s);
+    return ChannelPtr();
+  }
+  ChannelPtr c(new Channel(s, efd, spaceFd, base, size, true));
+
+  // hand the segment and the eventfds to the peer, which maps its own copy
+  int fds[3] = { fd, efd, spaceFd };
+  char cbuf[CMSG_SPACE(sizeof(fds))];
+  memset(cbuf, 0, sizeof(cbuf));
+  char hello = 0;
+  struct iovec iov;
+  iov.iov_base = &hello;
+  iov.iov_len = sizeof(hello);
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+  int r = sendmsg(s, &msg, MSG_NOSIGNAL);
+  ::close(fd);
+  if (r != sizeof(hello)) {
+    Log::perror("sendmsg");
+    return ChannelPtr();
+  }
+
+  maceout << "using shared memory for " << ma << Log::endl;
+  return c;
+} // connectChannel
+
+bool ShmTransport::acceptChannel(socket_t s) {
+  ADD_SELECTORS("ShmTransport::acceptChannel");
+
+  int fds[3] = { -1, -1, -1 };
+  char cbuf[CMSG_SPACE(sizeof(fds))];
+  char hello;
+  struct iovec iov;
+  iov.iov_base = &hello;
+  iov.iov_len = sizeof(hello);
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+
+  int r = recvmsg(s, &msg, 0);
+  if (r < 0 && SockUtil::errorWouldBlock()) {
+    return false;
+  }
+  struct cmsghdr* cm = (r == sizeof(hello)) ? CMSG_FIRSTHDR(&msg) : NULL;
+  if (cm == NULL || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS ||
+      cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    maceerr << "dropping shared memory connection that sent no segment" << Log::endl;
+    ::close(s);
+    return true;
+  }
+  memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (fstat(fds[0], &st) == 0) {
+    base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  }
+  ::close(fds[0]);
+  if (base == MAP_FAILED) {
+    Log::perror("mmap");
+    ::close(fds[1]);
+    ::close(fds[2]);
+    ::close(s);
+    return true;
+  }
+
+  ChannelPtr c(new Channel(s, fds[1], fds[2], base, st.st_size, false));
+  if (!c->ring.isValid()) {
+    maceerr << "dropping shared memory connection with a bad segment" << Log::endl;
+    return true;
+  }
+  // the peer may have written before we got here
+  if (drain(*c)) {
+    in.push_back(c);
+  }
+  return true;
+} // acceptChannel
+
+void ShmTransport::addSockets(fd_set& rset, fd_set& wset, socket_t& selectMax) {
+  if (!running) {
+    return;
+  }
+  BaseTransport::addSockets(rset, wset, selectMax);
+
+  for (SocketList::const_iterator i = pending.begin(); i != pending.end(); i++) {
+    FD_SET(*i, &rset);
+    selectMax = std::max(*i, selectMax);
+  }
+  for (ChannelList::const_iterator i = in.begin(); i != in.end(); i++) {
+    FD_SET((*i)->sock, &rset);
+    FD_SET((*i)->efd, &rset);
+    selectMax = std::max(std::max((*i)->sock, (socket_t)(*i)->efd), selectMax);
+  }
+  // outgoing sockets only become readable when the peer closes them
+  ScopedLock sl(chanlock);
+  for (ChannelMap::const_iterator i = out.begin(); i != out.end(); i++) {
+    FD_SET(i->second->sock, &rset);
+    selectMax = std::max(i->second->sock, selectMax);
+  }
+} // addSockets
+
+void ShmTransport::doIO(CONST_ISSET fd_set& rset, CONST_ISSET fd_set& wset, uint64_t st) {
+  ADD_SELECTORS("ShmTransport::doIO");
+
+  if (!running) {
+    return;
+  }
+
+  SocketList::iterator p = pending.begin();
+  while (p != pending.end()) {
+    if (FD_ISSET(*p, &rset) && acceptChannel(*p)) {
+      p = pending.erase(p);
+    }
+    else {
+      p++;
+    }
+  }
+
+  ChannelList::iterator i = in.begin();
+  while (i != in.end()) {
+    Channel& c = **i;
+    bool closed = false;
+    if (FD_ISSET(c.sock, &rset)) {
+      char b;
+      int r = recv(c.sock, &b, sizeof(b), 0);
+      closed = (r == 0 || (r < 0 && !SockUtil::errorWouldBlock()));
+    }
+    if (closed || FD_ISSET(c.efd, &rset)) {
+      closed = !drain(c) || closed;
+    }
+    if (closed) {
+      macedbg(1) << "shared memory peer closed" << Log::endl;
+      i = in.erase(i);
+    }
+    else {
+      i++;
+    }
+  }
+
+  if (FD_ISSET(transportSocket, &rset)) {
+    while (true) {
+      socket_t s = accept(transportSocket, NULL, NULL);
+      if (s < 0) {
+	if (!SockUtil::errorWouldBlock()) {
+	  Log::perror("accept");
+	}
+	break;
+      }
+      SockUtil::setNonblock(s);
+      pending.push_back(s);
+    }
+  }
+
+  ScopedLock sl(chanlock);
+  ChannelMap::iterator o = out.begin();
+  while (o != out.end()) {
+    if (FD_ISSET(o->second->sock, &rset)) {
+      maceout << "shared memory peer " << o->first << " closed" << Log::endl;
+      o->second->markClosed();
+      out.erase(o++);
+    }
+    else {
+      o++;
+    }
+  }
+} // doIO
+
+// returns false if the peer corrupted the ring, which must then be dropped
+bool ShmTransport::drain(Channel& c) {
+  ADD_SELECTORS("ShmTransport::drain");
+
+  // reset the eventfd before looking, so a push after the last pop wakes us again
+  uint64_t n;
+  if (read(c.efd, &n, sizeof(n)) < 0 && !SockUtil::errorWouldBlock()) {
+    Log::perror("read");
+  }
+
+  bool delivered = false;
+  bool valid = true;
+  StringPtr buf(new std::string());
+  while (true) {
+    try {
+      if (!c.ring.pop(*buf)) {
+	break;
+      }
+    }
+    catch (const ReadException& e) {
+      maceerr << "dropping shared memory peer: " << e << Log::endl;
+      valid = false;
+      break;
+    }
+    ASSERT(!buf->empty());
+    rc += buf->size();
+    if (!c.partial.empty() || (*buf)[0] == MORE_FRAGMENTS) {
+      c.partial.append(*buf, 1, std::string::npos);
+      if ((*buf)[0] == MORE_FRAGMENTS) {
+	continue;
+      }
+      buf->swap(c.partial);
+      c.partial.clear();
+    }
+    else {
+      buf->erase(0, 1);
+    }
+
+    ASSERT(buf->size() >= TransportHeader::ssize());
+    StringPtr hdr(new std::string(*buf, 0, TransportHeader::ssize()));
+    ASSERT(TransportHeader::deserializeSize(*hdr) == buf->size() - TransportHeader::ssize());
+    buf->erase(0, TransportHeader::ssize());
+
+    if (!shuttingDown) {
+      rq.push(buf);
+      rhq.push(hdr);
+      delivered = true;
+    }
+    buf = StringPtr(new std::string());
+  }
+  if (valid && c.ring.producerWaiting()) {
+    uint64_t one = 1;
+    if (write(c.spaceFd, &one, sizeof(one)) < 0) {
+      Log::perror("write");
+    }
+  }
+  if (delivered) {
+    signalDeliver();
+  }
+  return valid;
+} // drain
+
+bool ShmTransport::push(Channel& c, const std::string* const* parts, size_t n) {
+  ADD_SELECTORS("ShmTransport::push");
+
+  bool wasEmpty = false;
+  while (!c.ring.push(parts, n, wasEmpty)) {
+    // the ring is full: sleep until the peer drains it, unless it has gone;
+    // the timeout only bounds how long a local close goes unnoticed
+    struct pollfd p[2];
+    p[0].fd = c.sock;
+    p[0].events = POLLIN;
+    p[0].revents = 0;
+    p[1].fd = c.spaceFd;
+    p[1].events = POLLIN;
+    p[1].revents = 0;
+    if (c.isClosed() || (poll(p, 2, 1000) > 0 && p[0].revents != 0)) {
+      c.markClosed();
+      maceerr << "shared memory peer closed with a full ring" << Log::endl;
+      return false;
+    }
+    uint64_t signals;
+    if (read(c.spaceFd, &signals, sizeof(signals)) < 0 && !SockUtil::errorWouldBlock()) {
+      Log::perror("read");
+    }
+  }
+  if (wasEmpty) {
+    uint64_t one = 1;
+    if (write(c.efd, &one, sizeof(one)) < 0) {
+      Log::perror("write");
+    }
+  }
+  return true;
+} // push
+
+bool ShmTransport::sendData(const MaceAddr& src, const MaceKey& dest,
+			    const MaceAddr& nextHop, registration_uid_t rid,
+			    const std::string& ph, const std::string& s, bool checkQueueSize, bool rts) {
+  ADD_SELECTORS("ShmTransport::sendData");
+  static Accumulator* sendaccum = Accumulator::Instance(Accumulator::TRANSPORT_SEND);
+  static const std::string last(1, (char)LAST_FRAGMENT);
+  static const std::string more(1, (char)MORE_FRAGMENTS);
+
+  const SockAddr& ma = getNextHop(nextHop);
+  ChannelPtr c = getChannel(ma);
+  if (!c) {
+    maceerr << "no shared memory channel to " << ma << Log::endl;
+    return false;
+  }
+
+  lock();
+  SourceTranslationMap::const_iterator i = translations.find(ma);
+  const MaceAddr from = (i == translations.end()) ? src : i->second;
+  unlock();
+
+  std::string h;
+  TransportHeader::serialize(h, from, dest.getMaceAddr(), rid, 0, ph.size() + s.size());
+
+  const size_t size = last.size() + h.size() + ph.size() + s.size();
+  bool success = true;
+  ScopedLock sl(c->wlock);
+  if (c->ring.fits(size)) {
+    const std::string* parts[] = { &last, &h, &ph, &s };
+    success = push(*c, parts, 4);
+  }
+  else {
+    // too big for the ring: send it in pieces the peer puts back together
+    std::string m;
+    m.reserve(size);
+    m.append(h);
+    m.append(ph);
+    m.append(s);
+    const size_t fragment = ringSize / 4;
+    for (size_t off = 0; success && off < m.size(); off += fragment) {
+      std::string piece(m, off, fragment);
+      const std::string* parts[] = { (off + fragment < m.size()) ? &more : &last, &piece };
+      success = push(*c, parts, 2);
+    }
+  }
+
+  if (success) {
+    sendaccum->accumulate(s.size());
+    wc += size;
+  }
+  return success;
+} // sendData
+
+void ShmTransport::closeConnections() {
+  for (SocketList::const_iterator i = pending.begin(); i != pending.end(); i++) {
+    ::close(*i);
+  }
+  pending.clear();
+  in.clear();
+
+  ScopedLock sl(chanlock);
+  for (ChannelMap::iterator i = out.begin(); i != out.end(); i++) {
+    i->second->markClosed();
+  }
+  out.clear();
+} // closeConnections
+
+bool ShmTransport::runDeliverCondition(ThreadPoolType* tp, uint threadId) {
+  unregisterHandlers();
+  return !rhq.empty() || shuttingDown;
+} // runDeliverCondition
+
+void ShmTransport::runDeliverSetup(ThreadPoolType* tp, uint threadId) {
+  ADD_SELECTORS("ShmTransport::runDeliverSetup");
+  ASSERT(shuttingDown || !rhq.empty());
+
+  DeliveryData& d = tp->data(threadId);
+
+  if (shuttingDown && !rhq.empty() && dataHandlers.empty()) {
+    rhq.clear();
+    rq.clear();
+  }
+
+  if (rhq.empty()) {
+    d.deliverState = FINITO;
+  }
+  else {
+    d.deliverState = DELIVER;
+
+    d.shdr = *rhq.front();
+    rhq.pop();
+
+    d.s = *rq.front();
+    rq.pop();
+
+    deliverDataSetup(tp, d);
+  }
+} // runDeliverSetup
+
+void ShmTransport::runDeliverProcessUnlocked(ThreadPoolType* tp, uint threadId) {
+  DeliveryData& d = tp->data(threadId);
+
+  if (d.deliverState == DELIVER) {
+    deliverData(d);
+  }
+  else {
+    tp->halt();
+  }
+} // runDeliverProcessUnlocked
+
+void ShmTransport::runDeliverFinish(ThreadPoolType* tp, uint threadId) {}
@@ -0,0 +1,162 @@
+/* 
+ * ShmTransport.h : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <sys/un.h>
+#include <list>
+
+#include "CircularQueueList.h"
+
+#include "BaseTransport.h"
+#include "ShmRing.h"
+
+class ShmTransport;
+
+typedef boost::shared_ptr<ShmTransport> ShmTransportPtr;
+
+/**
+ * Carries messages between Mace processes on the same host through rings in
+ * shared memory instead of the loopback.
+ *
+ * Each process listens on an abstract unix socket named after its address
+ * and port.  The first message to a local peer connects to it and hands
+ * over a memfd segment holding a ShmRing and an eventfd; from then on the
+ * sender copies serialized messages straight into the ring and only writes
+ * the eventfd when the ring was empty.  The peer's scheduler thread drains
+ * the ring and delivers through the usual thread pool.  The socket carries
+ * nothing else, so its closing tells each side the other has gone.
+ *
+ * Peers that do not accept the connection are remembered and left to the
+ * transport this one is paired with; see TcpTransportService.
+ */
+class ShmTransport : public virtual BaseTransport {
+public:
+  typedef boost::shared_ptr<std::string> StringPtr;
+  typedef CircularQueueList<StringPtr> StringPtrQueue;
+
+public:
+  static ShmTransportPtr create(int portOffset);
+  virtual ~ShmTransport();
+
+  using BaseTransport::route;
+  virtual bool route(const MaceKey& dest, const std::string& s, registration_uid_t rid) {
+    return BaseTransport::route(dest, s, false, rid);
+  } // route
+
+  /// true if messages to \c dest go through shared memory, connecting to it if needed
+  bool isLocal(const MaceKey& dest);
+
+  virtual void addSockets(fd_set& rset, fd_set& wset, socket_t& selectMax);
+  virtual void doIO(CONST_ISSET fd_set& rset, CONST_ISSET fd_set& wset, uint64_t st);
+  virtual void suspendDeliver(MaceKey const & dest, registration_uid_t rid) {
+    ASSERT(dataHandlers.size() <= 1);
+    suspended.insert(dest);
+  }
+  virtual void resumeDeliver(MaceKey const & dest, registration_uid_t rid) {
+    ASSERT(dataHandlers.size() <= 1);
+    suspended.erase(dest);
+  }
+
+  virtual void closeConnections();
+  virtual void freeSockets() { }
+
+  bool runDeliverCondition(ThreadPoolType* tp, uint threadId);
+  void runDeliverSetup(ThreadPoolType* tp, uint threadId);
+  void runDeliverProcessUnlocked(ThreadPoolType* tp, uint threadId);
+  void runDeliverFinish(ThreadPoolType* tp, uint threadId);
+
+protected:
+  int getSockType() { return SOCK_STREAM; }
+  virtual void setupSocket();
+  virtual bool sendData(const MaceAddr& src, const MaceKey& dest,
+			const MaceAddr& nextHop, registration_uid_t rid,
+			const std::string& ph, const std::string& s, bool checkQueueSize, bool rts);
+
+private:
+  /// one direction of a process pair: the mapped ring, its eventfds, and the socket it was handed over on
+  class Channel {
+  public:
+    Channel(socket_t sock, int efd, int spaceFd, void* base, size_t size, bool initialize);
+    ~Channel();
+
+    bool isClosed() { return __sync_add_and_fetch(&closed, 0) != 0; }
+    void markClosed() { __sync_lock_test_and_set(&closed, 1); }
+
+    socket_t sock;
+    int efd; ///< signalled by the producer when it pushes to an empty ring
+    int spaceFd; ///< signalled by the consumer when it drained a ring a producer found full
+    void* base;
+    size_t size;
+    mace::ShmRing ring;
+    std::string partial; ///< fragments received of a message larger than the ring
+    pthread_mutex_t wlock; ///< serializes producers, the ring takes only one
+
+  private:
+    uint32_t closed; ///< set once the peer has gone, from any thread
+  };
+  typedef boost::shared_ptr<Channel> ChannelPtr;
+  typedef mace::map<SockAddr, ChannelPtr, mace::SoftState> ChannelMap;
+  typedef std::list<ChannelPtr> ChannelList;
+  typedef std::list<socket_t> SocketList;
+  typedef mace::set<SockAddr> SockAddrSet;
+
+  ShmTransport(int portOffset);
+
+  static void fillUnixAddr(uint32_t addr, uint16_t port, struct sockaddr_un& sa, socklen_t& len);
+  ChannelPtr getChannel(const SockAddr& ma);
+  ChannelPtr connectChannel(const SockAddr& ma);
+  bool acceptChannel(socket_t s);
+  bool drain(Channel& c);
+  bool push(Channel& c, const std::string* const* parts, size_t n);
+
+public:
+  static const uint8_t LAST_FRAGMENT = 0;
+  static const uint8_t MORE_FRAGMENTS = 1;
+
+private:
+  const size_t ringSize;
+
+  uint64_t rc;
+  uint64_t wc;
+
+  pthread_mutex_t chanlock; ///< guards out and unreachable
+  ChannelMap out;
+  SockAddrSet unreachable;
+  ChannelList in; ///< only touched by the scheduler thread
+  SocketList pending; ///< accepted sockets yet to hand over their segment
+
+  NodeSet suspended;
+  StringPtrQueue rhq;
+  StringPtrQueue rq;
+}; // ShmTransport
+
+#endif // SHM_TRANSPORT_H
@@ -35,6 +35,7 @@
 #include "mace-macros.h"
 #include "params.h"
 #include "Accumulator.h"
+#include "Metrics.h"
 #include "Log.h"
 #include "Util.h"
 #include "StrUtil.h"
@@ -516,7 +517,7 @@ void TcpConnection::read() {
     connaccum = Accumulator::Instance("TCP_READ::" + host);
   }
   static Accumulator* readaccum = Accumulator::Instance(Accumulator::TCP_READ);
-  static Accumulator* netaccum = Accumulator::Instance(Accumulator::NETWORK_READ);
+  static mace::Counter* netaccum = mace::Metrics::counter(mace::Metrics::NETWORK_READ);
   static size_t thssz = TransportHeader::ssize();
 
   ScopedTimer st(readTime, USE_DEBUGGING_TIMERS);
@@ -555,7 +556,7 @@ void TcpConnection::read() {
     connaccum->accumulate(r);
   }
   readaccum->accumulate(r);
-  netaccum->accumulate(r);
+  netaccum->add(r);
   bufStats->append(r);
   byteCount += r;
 
@@ -734,7 +735,7 @@ int TcpConnection::write(const std::string& buf) {
       StrUtil::toString(ntohs(rport));
     connaccum = Accumulator::Instance("TCP_WRITE::" + host);
   }
-  static Accumulator* writeaccum = Accumulator::Instance(Accumulator::TCP_WRITE);
+  static mace::Counter* writeaccum = mace::Metrics::counter(mace::Metrics::TCP_WRITE);
   static Accumulator* netaccum = Accumulator::Instance(Accumulator::NETWORK_WRITE);
   //macedbg(1) << "Try to write the message!" << Log::endl;
   int r = write(c, buf.data(), buf.size());
@@ -757,7 +758,7 @@ int TcpConnection::write(const std::string& buf) {
   if (connaccum) {
     connaccum->accumulate(r);
   }
-  writeaccum->accumulate(r);
+  writeaccum->add(r);
   netaccum->accumulate(r);
   bufStats->append(r);
 
@@ -42,6 +42,7 @@
 #include "TcpTransport-init.h"
 #include "TcpConnection.h"
 #include "BaseTransport.h"
+#include "ShmTransport.h"
 
 #include "SimulatorBasics.h"
 
@@ -587,10 +588,16 @@ public:
   TcpTransportService(const TcpTransport_namespace::OptionsMap& m = TcpTransport_namespace::OptionsMap()) {
     ASSERTMSG( ( (!macesim::SimulatorFlags::simulated()) || params::containsKey("ALLOW_LIVE_TRANSPORT_IN_SIMULATOR") ), "Not safe to create TCP Transport when using Simulator.  Set ALLOW_LIVE_TRANSPORT_IN_SIMULATOR to override.");
     t = TcpTransport::create(m);
+    if (params::get<bool>(params::MACE_TRANSPORT_SHM, false)) {
+      shm = ShmTransport::create(t->getPortOffset());
+    }
   }
   virtual ~TcpTransportService();
   bool route(const MaceKey& dest, const std::string& s,
 	     registration_uid_t rid = -1) {
+    if (shm && shm->isLocal(dest)) {
+      return shm->route(dest, s, false, rid);
+    }
     return t->route(dest, s, false, rid);
   }
   const MaceKey&  localAddress() const {
@@ -598,6 +605,9 @@ public:
   }
   bool route(const MaceKey& src, const MaceKey& dest, const std::string& s,
 	     registration_uid_t rid = -1) {
+    if (shm && shm->isLocal(dest)) {
+      return shm->route(src, dest, s, false, rid);
+    }
     return t->route(src, dest, s, false, rid);
   }
   void requestToSend(const MaceKey& peer, registration_uid_t rid = -1) {
@@ -675,11 +685,19 @@ public:
   }
   registration_uid_t registerHandler(ReceiveDataHandler& h,
 				     registration_uid_t rid = -1, bool isAppHandler = true) {
-    return t->registerHandler(h, rid, isAppHandler);
+    rid = t->registerHandler(h, rid, isAppHandler);
+    if (shm) {
+      shm->registerHandler(h, rid, isAppHandler);
+    }
+    return rid;
   }
   registration_uid_t registerHandler(NetworkErrorHandler& h,
 				     registration_uid_t rid = -1, bool isAppHandler = true) {
-    return t->registerHandler(h, rid, isAppHandler);
+    rid = t->registerHandler(h, rid, isAppHandler);
+    if (shm) {
+      shm->registerHandler(h, rid, isAppHandler);
+    }
+    return rid;
   }
   registration_uid_t registerHandler(ConnectionStatusHandler& h,
 				     registration_uid_t rid = -1, bool isAppHandler = true) {
@@ -691,9 +709,15 @@ public:
   }
   void unregisterHandler(ReceiveDataHandler& h, registration_uid_t rid = -1) {
     t->unregisterHandler(h, rid);
+    if (shm) {
+      shm->unregisterHandler(h, rid);
+    }
   }
   void unregisterHandler(NetworkErrorHandler& h, registration_uid_t rid = -1) {
     t->unregisterHandler(h, rid);
+    if (shm) {
+      shm->unregisterHandler(h, rid);
+    }
   }
   void unregisterHandler(ConnectionStatusHandler& h,
 			 registration_uid_t rid = -1) {
@@ -705,9 +729,15 @@ public:
   }
   void registerUniqueHandler(ReceiveDataHandler& h) {
     t->registerUniqueHandler(h);
+    if (shm) {
+      shm->registerUniqueHandler(h);
+    }
   }
   void registerUniqueHandler(NetworkErrorHandler& h) {
     t->registerUniqueHandler(h);
+    if (shm) {
+      shm->registerUniqueHandler(h);
+    }
   }
   void registerUniqueHandler(ConnectionStatusHandler& h) {
     t->registerUniqueHandler(h);
@@ -715,11 +745,23 @@ public:
   void registerUniqueHandler(ConnectionAcceptanceHandler& h) {
     t->registerUniqueHandler(h);
   }
-  void maceInit() { t->maceInit(); }
-  void maceExit() { t->maceExit(); }
+  void maceInit() {
+    t->maceInit();
+    if (shm) {
+      shm->maceInit();
+    }
+  }
+  void maceExit() {
+    t->maceExit();
+    if (shm) {
+      shm->maceExit();
+    }
+  }
 
 private:
   TcpTransportPtr t;
+  /// carries route() to processes on this host when MACE_TRANSPORT_SHM is set
+  ShmTransportPtr shm;
 
 }; // TcpTransportService
 
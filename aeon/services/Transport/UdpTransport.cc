@@ -30,6 +30,7 @@
  * ----END-OF-LEGAL-STUFF---- */
 #include "massert.h"
 #include "Accumulator.h"
+#include "Metrics.h"
 
 #include "TransportScheduler.h"
 #include "UdpTransport.h"
@@ -99,7 +100,7 @@ UdpTransportPtr UdpTransport::create(int portOffset) {
 void UdpTransport::doIO(CONST_ISSET fd_set& rset, CONST_ISSET fd_set& wset, uint64_t st) {
   ADD_SELECTORS("UdpTransport::doIO");
   static Accumulator* readaccum = Accumulator::Instance(Accumulator::UDP_READ);
-  static Accumulator* netaccum = Accumulator::Instance(Accumulator::NETWORK_READ);
+  static mace::Counter* netaccum = mace::Metrics::counter(mace::Metrics::NETWORK_READ);
 
   if (!running) {
     return;
@@ -128,7 +129,7 @@ void UdpTransport::doIO(CONST_ISSET fd_set& rset, CONST_ISSET fd_set& wset, uint
       ASSERT(r > (int)TransportHeader::ssize());
 
       readaccum->accumulate(r);
-      netaccum->accumulate(r);
+      netaccum->add(r);
       rc += r;
 
       StringPtr hdr = StringPtr(new std::string(rbuf, TransportHeader::ssize()));
@@ -0,0 +1,267 @@
+/* 
+ * autoscalesim.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include "../lib/LoadForecast.h"
+
+// Replays a load trace against the autoscaling policies of eMonitor (see
+// ELASTICITY_AUTOSCALE) to compare them offline.  Each line of the trace is
+// one elasticity period:
+//   <load> [<events>]
+// where load is the CPU demand in percent of one server (250 needs two and a
+// half servers) and events, if given, the events that arrived in the period.
+// Lines starting with # are ignored.
+//
+// The simulated cluster spreads the load evenly over its active servers.  A
+// server that is activated only takes load after -d periods, the time to
+// start it and migrate contexts to it; load beyond the capacity of the
+// active servers is queued and run when there is spare capacity.  A period
+// violates the SLA when the servers are busier than -s percent or events
+// are queued.
+//
+// Policies:
+//   static      never scales
+//   reactive    scales on the CPU usage of the period
+//   predictive  scales on the load forecast -f periods ahead
+//
+// e.g. autoscalesim -n 2 -m 16 -d 2 trace.txt
+
+using namespace std;
+
+namespace {
+  void usage(const char* prog) {
+    cerr << "usage: " << prog << " [options] [file ...]" << endl
+         << "  -p policies  comma separated list of static, reactive and predictive (default all)" << endl
+         << "  -n servers   servers active at the start (default 1)" << endl
+         << "  -m servers   servers that may be active (default 16)" << endl
+         << "  -d periods   periods before an activated server takes load (default 2)" << endl
+         << "  -s percent   server usage above which a period violates the SLA (default 90)" << endl
+         << "  -u percent   scale up threshold (default 70)" << endl
+         << "  -l percent   scale down threshold (default 30)" << endl
+         << "  -c periods   cooldown after a scale action (default 3)" << endl
+         << "  -f periods   forecast horizon (default 2)" << endl
+         << "  -q events    queued events per server that count as saturated (default 1000)" << endl
+         << "  -a alpha -b beta -g gamma -S season   forecast smoothing (default 0.5, 0.3, 0.1, 0)" << endl
+         << "  -v           print every period" << endl;
+  }
+
+  struct Sample {
+    double load;
+    double events; ///< negative when the trace has no event counts
+  };
+
+  struct Result {
+    uint64_t violations;
+    uint64_t serverPeriods;
+    uint64_t ups;
+    uint64_t downs;
+    double maxBacklog;
+    Result() : violations(0), serverPeriods(0), ups(0), downs(0), maxBacklog(0) { }
+  };
+
+  bool readTrace(istream& in, vector<Sample>& trace, string& error) {
+    string line;
+    uint64_t lineno = 0;
+    while (getline(in, line)) {
+      lineno++;
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      istringstream fields(line);
+      Sample sample;
+      if (!(fields >> sample.load) || sample.load < 0) {
+        ostringstream msg;
+        msg << "line " << lineno << ": bad load";
+        error = msg.str();
+        return false;
+      }
+      if (!(fields >> sample.events)) {
+        sample.events = -1;
+      }
+      trace.push_back(sample);
+    }
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  string policyList = "static,reactive,predictive";
+  uint32_t initialServers = 1;
+  uint32_t maxServers = 16;
+  uint32_t startDelay = 2;
+  double sla = 90;
+  double upThreshold = 70;
+  double downThreshold = 30;
+  uint32_t cooldown = 3;
+  uint32_t horizon = 2;
+  double queueLimit = 1000;
+  double alpha = 0.5, beta = 0.3, gamma = 0.1;
+  uint32_t season = 0;
+  bool verbose = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "p:n:m:d:s:u:l:c:f:q:a:b:g:S:vh")) != -1) {
+    switch (c) {
+      case 'p': policyList = optarg; break;
+      case 'n': initialServers = strtoul(optarg, NULL, 10); break;
+      case 'm': maxServers = strtoul(optarg, NULL, 10); break;
+      case 'd': startDelay = strtoul(optarg, NULL, 10); break;
+      case 's': sla = atof(optarg); break;
+      case 'u': upThreshold = atof(optarg); break;
+      case 'l': downThreshold = atof(optarg); break;
+      case 'c': cooldown = strtoul(optarg, NULL, 10); break;
+      case 'f': horizon = strtoul(optarg, NULL, 10); break;
+      case 'q': queueLimit = atof(optarg); break;
+      case 'a': alpha = atof(optarg); break;
+      case 'b': beta = atof(optarg); break;
+      case 'g': gamma = atof(optarg); break;
+      case 'S': season = strtoul(optarg, NULL, 10); break;
+      case 'v': verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (initialServers == 0 || initialServers > maxServers) {
+    cerr << "need 0 < initial servers <= max servers" << endl;
+    return 1;
+  }
+
+  vector<string> policies;
+  istringstream list(policyList);
+  string policy;
+  while (getline(list, policy, ',')) {
+    if (policy != "static" && policy != "reactive" && policy != "predictive") {
+      cerr << "unknown policy " << policy << endl;
+      usage(argv[0]);
+      return 1;
+    }
+    policies.push_back(policy);
+  }
+
+  vector<string> files;
+  for (int i = optind; i < argc; i++) {
+    files.push_back(argv[i]);
+  }
+  if (files.empty()) {
+    files.push_back("-");
+  }
+  vector<Sample> trace;
+  for (size_t f = 0; f < files.size(); f++) {
+    ifstream file;
+    if (files[f] != "-") {
+      file.open(files[f].c_str());
+      if (!file) {
+        cerr << "cannot open " << files[f] << endl;
+        return 1;
+      }
+    }
+    string error;
+    if (!readTrace(file.is_open() ? file : cin, trace, error)) {
+      cerr << files[f] << ": " << error << endl;
+      return 1;
+    }
+  }
+
+  vector<Result> results(policies.size());
+  for (size_t p = 0; p < policies.size(); p++) {
+    mace::AutoscalePolicy decider(upThreshold, downThreshold, 2, 3, cooldown);
+    mace::ServerLoadForecast forecast(alpha, beta, gamma, season);
+    // servers taking load, and activated servers by the period they take load from
+    uint32_t serving = initialServers;
+    vector<uint32_t> starting(trace.size() + startDelay + 1, 0);
+    uint32_t active = initialServers;
+    double backlog = 0;
+    Result& r = results[p];
+
+    for (size_t t = 0; t < trace.size(); t++) {
+      serving += starting[t];
+      const double capacity = 100.0 * serving;
+      const double demand = trace[t].load + backlog;
+      const double run = demand < capacity ? demand : capacity;
+      backlog = demand - run;
+      const double usage = run / serving;
+      // the servers see the events they ran, and the rest waiting
+      const double events = trace[t].events >= 0 ? trace[t].events : trace[t].load;
+      const double eventRate = trace[t].load > 0 ? events * run / demand : 0;
+      const double queued = trace[t].load > 0 ? events * backlog / trace[t].load : 0;
+
+      const bool violated = usage > sla || backlog > 0;
+      if (violated) {
+        r.violations++;
+      }
+      r.serverPeriods += active;
+      if (backlog > r.maxBacklog) {
+        r.maxBacklog = backlog;
+      }
+
+      int32_t action = 0;
+      if (policies[p] == "reactive") {
+        action = decider.decide(run, active, maxServers);
+      }
+      else if (policies[p] == "predictive") {
+        // the forecaster works per server, so feed it the average server
+        forecast.update(usage, eventRate / serving, queued / serving);
+        action = decider.decide(forecast.forecast(horizon, queueLimit) * serving, active, maxServers);
+      }
+      if (action > 0) {
+        active += action;
+        starting[t + 1 + startDelay] += action;
+        r.ups++;
+      }
+      else if (action < 0 && serving > 1) {
+        active--;
+        serving--;
+        r.downs++;
+      }
+
+      if (verbose) {
+        cout << t + 1 << " " << policies[p] << " load " << fixed << setprecision(1) << trace[t].load << " servers " << serving
+             << "/" << active << " usage " << usage << " backlog " << backlog << (violated ? " violation" : "")
+             << (action > 0 ? " up" : action < 0 ? " down" : "") << endl;
+      }
+    }
+  }
+
+  cout << trace.size() << " periods" << endl;
+  cout << left << setw(12) << "policy" << right << setw(12) << "violations" << setw(16) << "server-periods" << setw(6) << "ups"
+       << setw(7) << "downs" << setw(13) << "max backlog" << endl;
+  for (size_t p = 0; p < policies.size(); p++) {
+    const Result& r = results[p];
+    cout << left << setw(12) << policies[p] << right << setw(12) << r.violations << setw(16) << r.serverPeriods << setw(6) << r.ups
+         << setw(7) << r.downs << setw(13) << fixed << setprecision(1) << r.maxBacklog << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+/* 
+ * eventtrace2json.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../lib/EventTrace.h"
+
+// Converts EventTrace files (one per process, see lib/EventTrace.h) into a
+// single Chrome trace JSON document, loadable in chrome://tracing or
+// Perfetto.  Each process is a trace process and each span is a complete
+// event; ticket and commit are instant events.  Every span carries the
+// OrderID of its event as "event", so one event can be followed across
+// processes by searching for it.
+//
+// usage: eventtrace2json trace-file... > trace.json
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " trace-file..." << endl;
+    return 1;
+  }
+
+  cout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (int i = 1; i < argc; i++) {
+    uint32_t pid = 0;
+    vector<mace::EventTrace::Record> records;
+    try {
+      mace::EventTrace::readFile(argv[i], pid, records);
+    }
+    catch (const IOException& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+
+    for (size_t j = 0; j < records.size(); j++) {
+      const mace::EventTrace::Record& r = records[j];
+      bool instant = r.type == mace::EventTrace::TICKET || r.type == mace::EventTrace::COMMIT;
+      cout << (first ? "" : ",") << "\n{\"name\":\"" << mace::EventTrace::spanName(r.type) << "\""
+           << ",\"cat\":\"event\",\"pid\":" << pid << ",\"tid\":" << r.thread
+           << ",\"ts\":" << r.begin;
+      if (instant) {
+        cout << ",\"ph\":\"i\",\"s\":\"t\"";
+      }
+      else {
+        cout << ",\"ph\":\"X\",\"dur\":" << (r.end - r.begin);
+      }
+      cout << ",\"args\":{\"event\":\"" << r.ctxId << "." << r.ticket << "\""
+           << ",\"context\":" << r.contextId << "}}";
+      first = false;
+    }
+  }
+  cout << "\n]}" << endl;
+  return 0;
+}
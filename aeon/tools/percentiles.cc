@@ -29,40 +29,242 @@
  * 
  * ----END-OF-LEGAL-STUFF---- */
 #include <iostream>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/time.h>
 #include "../lib/StatisticalFilter.h"
+#include "../lib/TDigest.h"
+
+// Prints percentiles of the numbers read from a file or stdin.
+//
+// With no options every number in the input is read, and a table of
+// "percentile value" lines is printed at the end in steps of
+// PERCENTILE_INCREMENT (default 0.01).  The values are kept, so the table is
+// exact.  With -d they are summarized by a t-digest instead, so memory use
+// stays constant however large the input is, at the cost of approximate
+// percentiles (most accurate at the tails).
+//
+// With -w, rolling percentiles over the last <window> seconds are printed
+// every <interval> seconds as "time count min p50 p90 p99 p99.9 max"; with -f
+// the file is followed like tail -f, so this works on a live log, e.g.
+//   percentiles -f -m ASYNC_EVENT_LIFE_TIME -c 3 -w 10 node.log
 
 using namespace std;
 
-int main() {
+namespace {
+  uint64_t nowMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  }
+
+  void usage(const char* prog) {
+    cerr << "usage: " << prog << " [-d] [-c column] [-m match] [-w window [-i interval]] [-f] [file]" << endl
+         << "  -d           approximate with a t-digest in constant memory" << endl
+         << "  -c column    only read the column'th whitespace separated field (from 1)" << endl
+         << "  -m match     only read lines containing match" << endl
+         << "  -w window    print percentiles over the last window seconds (always a t-digest)" << endl
+         << "  -i interval  seconds between rolling reports (default 1)" << endl
+         << "  -f           follow the file as it grows, like tail -f" << endl;
+  }
+
+  /// keeps one digest per interval, and merges the most recent ones on report
+  class RollingWindow {
+  public:
+    RollingWindow(uint64_t windowMicros, uint64_t intervalMicros) :
+      interval(intervalMicros),
+      slots((windowMicros + intervalMicros - 1) / intervalMicros),
+      current(0),
+      nextReport(nowMicros() + intervalMicros) { }
+
+    void update(double value) {
+      slots[current].update(value);
+    }
+
+    /// prints a report line for every interval that has elapsed
+    void tick(ostream& out) {
+      uint64_t now = nowMicros();
+      while (now >= nextReport) {
+        report(out, nextReport);
+        current = (current + 1) % slots.size();
+        slots[current].reset();
+        nextReport += interval;
+      }
+    }
 
-  double increment = 0.01;
+    void report(ostream& out, uint64_t time) const {
+      mace::TDigest all;
+      for (size_t i = 0; i < slots.size(); i++) {
+        all.merge(slots[i]);
+      }
+      out << time / 1000000 << "." << setw(6) << setfill('0') << time % 1000000 << setfill(' ')
+          << " " << all.getCount() << " " << all.getMin()
+          << " " << all.percentileToValue(0.5)
+          << " " << all.percentileToValue(0.9)
+          << " " << all.percentileToValue(0.99)
+          << " " << all.percentileToValue(0.999)
+          << " " << all.getMax() << endl;
+    }
 
-  char* incStr = getenv("PERCENTILE_INCREMENT");
-  if(incStr != NULL) {
-    //     cerr << "GETENV: " << incStr << endl;
-    sscanf(incStr, "%lf", &increment);
+  private:
+    uint64_t interval;
+    vector<mace::TDigest> slots;
+    size_t current;
+    uint64_t nextReport;
+  };
+
+  /// reads the selected numbers of \c line into \c values
+  void parseLine(const string& line, int column, const char* match, vector<double>& values) {
+    if (match != NULL && line.find(match) == string::npos) {
+      return;
+    }
+    istringstream in(line);
+    string field;
+    for (int n = 1; in >> field; n++) {
+      if (column > 0 && n != column) {
+        continue;
+      }
+      char* end;
+      double v = strtod(field.c_str(), &end);
+      if (end != field.c_str() && *end == '\0') {
+        values.push_back(v);
+      }
+      if (n == column) {
+        break;
+      }
+    }
   }
 
-  double val;
-  StatisticalFilter fil;
-  while(!cin.eof()) {
-    cin >> val;
-    fil.update(val);
+  /// prints the percentile table of \c stats (a StatisticalFilter or a TDigest)
+  template<class Stats>
+  void printTable(const Stats& stats) {
+    double increment = 0.01;
+    char* incStr = getenv("PERCENTILE_INCREMENT");
+    if(incStr != NULL) {
+      sscanf(incStr, "%lf", &increment);
+    }
+
+    int values = stats.getCount();
+    if (values > 0 && increment * values < 1.0) {
+      increment = 1.0 / (values-1);
+    }
+
+    cout << 0.0 << " " << stats.percentileToValue(0.0) << endl;
+    for(double iter = increment; iter < 1.0; iter += increment) {
+      cout << iter << " " << stats.percentileToValue(iter) << endl;
+    }
+    cout << 1.0 << " " << stats.percentileToValue(1.0) << endl;
   }
+}
+
+int main(int argc, char* argv[]) {
+  int column = 0;
+  const char* match = NULL;
+  double window = 0;
+  double interval = 1;
+  bool follow = false;
+  bool digest = false;
 
-  int values = fil.getCount();
-  if (increment * values < 1.0) {
-    increment = 1.0 / (values-1);
+  int c;
+  while ((c = getopt(argc, argv, "dc:m:w:i:fh")) != -1) {
+    switch (c) {
+      case 'd': digest = true; break;
+      case 'c': column = atoi(optarg); break;
+      case 'm': match = optarg; break;
+      case 'w': window = atof(optarg); break;
+      case 'i': interval = atof(optarg); break;
+      case 'f': follow = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind < argc - 1 || column < 0 || window < 0 || interval <= 0 || (follow && optind == argc)) {
+    usage(argv[0]);
+    return 1;
   }
-  
+
+  ifstream file;
+  if (optind < argc) {
+    file.open(argv[optind]);
+    if (!file) {
+      cerr << "cannot open " << argv[optind] << endl;
+      return 1;
+    }
+  }
+  istream& in = file.is_open() ? file : cin;
+
   cout << setprecision(16);
-  cout << 0.0 << " " << fil.percentileToValue(0.0) << endl;
-  for(double iter = increment; iter < 1.0; iter += increment) {
-    cout << iter << " " << fil.percentileToValue(iter) << endl;
+  StatisticalFilter exact;
+  if (!digest && window == 0 && column == 0 && match == NULL && !follow) {
+    // the original reader, kept as is so plain runs print what they always have
+    double val;
+    while(!in.eof()) {
+      in >> val;
+      exact.update(val);
+    }
+    printTable(exact);
+    return 0;
+  }
+
+  mace::TDigest total;
+  RollingWindow* rolling = NULL;
+  if (window > 0) {
+    rolling = new RollingWindow((uint64_t)(window * 1000000), (uint64_t)(interval * 1000000));
+  }
+
+  string line;
+  string partial;
+  vector<double> values;
+  while (true) {
+    // a last line without a newline sets eof; when following, the writer may
+    // still be in the middle of it, so keep it until the rest arrives
+    bool complete = getline(in, line) && !in.eof();
+    if (!complete && follow) {
+      partial += line;
+      in.clear();
+      if (rolling != NULL) {
+        rolling->tick(cout);
+      }
+      usleep(100 * 1000);
+      continue;
+    }
+    parseLine(partial + line, column, match, values);
+    partial.clear();
+
+    for (size_t i = 0; i < values.size(); i++) {
+      if (rolling != NULL) {
+        rolling->update(values[i]);
+      } else if (digest) {
+        total.update(values[i]);
+      } else {
+        exact.update(values[i]);
+      }
+    }
+    values.clear();
+    if (rolling != NULL) {
+      rolling->tick(cout);
+    }
+    if (!complete) {
+      break;
+    }
+  }
+
+  if (rolling != NULL) {
+    rolling->report(cout, nowMicros());
+    delete rolling;
+    return 0;
+  }
+
+  if (digest) {
+    printTable(total);
+  } else {
+    printTable(exact);
   }
-  cout << 1.0 << " " << fil.percentileToValue(1.0) << endl;
   return 0;
 }
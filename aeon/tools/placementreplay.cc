@@ -0,0 +1,241 @@
+/* 
+ * placementreplay.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include "../lib/ContextPlacement.h"
+
+// Replays context interaction graphs recorded by eMonitor (see
+// PLACEMENT_GRAPH_LOG) and compares how context placement policies would
+// have done on them.  Each graph in the input is one elasticity period; a
+// policy starts from the placement recorded in the first graph and carries
+// its own placement from period to period.
+//
+// Policies:
+//   none       never migrates
+//   greedy     every context moves to the server it interacts with most, if
+//              that server has room, deciding from the placement at the start
+//              of the period (like the pairwise per-context decisions)
+//   partition  ContextPartitioner
+//
+// For each policy the cut (interactions between contexts on different
+// servers), the highest server load relative to its capacity, and the number
+// of migrations are printed, per period with -v and in total, e.g.
+//   placementreplay -c 10 placement.graphs
+
+using namespace std;
+
+namespace {
+  void usage(const char* prog) {
+    cerr << "usage: " << prog << " [-p policy,...] [-c migration cost] [-b imbalance] [-v] [file ...]" << endl
+         << "  -p policies  comma separated list of none, greedy and partition (default all)" << endl
+         << "  -c cost      interactions a migration must save, for partition (default 10)" << endl
+         << "  -b imbalance fraction by which servers may exceed their capacity (default 0.05)" << endl
+         << "  -v           print every period" << endl;
+  }
+
+  struct Result {
+    uint64_t cut;
+    uint64_t total;
+    uint64_t migrations;
+    double maxLoad;
+    Result() : cut(0), total(0), migrations(0), maxLoad(0) { }
+  };
+
+  vector<uint32_t> greedy(const mace::ContextInteractionGraph& graph, const vector<uint32_t>& current, double imbalance) {
+    vector<uint32_t> next(current);
+    vector<double> loads = graph.serverLoads(current);
+    for (uint32_t i = 0; i < graph.contextCount(); i++) {
+      if (graph.getContext(i).pinned) {
+        continue;
+      }
+      vector<uint64_t> conn(graph.serverCount(), 0);
+      const mace::ContextInteractionGraph::EdgeMap& edges = graph.getEdges(i);
+      for (mace::ContextInteractionGraph::EdgeMap::const_iterator e = edges.begin(); e != edges.end(); e++) {
+        conn[current[e->first]] += e->second;
+      }
+      uint32_t best = current[i];
+      for (uint32_t s = 0; s < graph.serverCount(); s++) {
+        const double w = graph.getContext(i).weight;
+        if (conn[s] > conn[best] && loads[s] + w <= graph.getServer(s).capacity * (1 + imbalance)) {
+          best = s;
+        }
+      }
+      if (best != current[i]) {
+        loads[current[i]] -= graph.getContext(i).weight;
+        loads[best] += graph.getContext(i).weight;
+        next[i] = best;
+      }
+    }
+    return next;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  string policyList = "none,greedy,partition";
+  uint64_t migrationCost = 10;
+  double imbalance = 0.05;
+  bool verbose = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "p:c:b:vh")) != -1) {
+    switch (c) {
+      case 'p': policyList = optarg; break;
+      case 'c': migrationCost = strtoull(optarg, NULL, 10); break;
+      case 'b': imbalance = atof(optarg); break;
+      case 'v': verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  vector<string> policies;
+  istringstream list(policyList);
+  string policy;
+  while (getline(list, policy, ',')) {
+    if (policy != "none" && policy != "greedy" && policy != "partition") {
+      cerr << "unknown policy " << policy << endl;
+      usage(argv[0]);
+      return 1;
+    }
+    policies.push_back(policy);
+  }
+
+  vector<string> files;
+  for (int i = optind; i < argc; i++) {
+    files.push_back(argv[i]);
+  }
+  if (files.empty()) {
+    files.push_back("-");
+  }
+
+  mace::ContextPartitioner partitioner(imbalance, migrationCost);
+  // placement of each policy, by context and server name, carried across periods
+  vector< map<string, string> > placements(policies.size());
+  vector<Result> results(policies.size());
+  uint32_t period = 0;
+
+  for (size_t f = 0; f < files.size(); f++) {
+    ifstream file;
+    if (files[f] != "-") {
+      file.open(files[f].c_str());
+      if (!file) {
+        cerr << "cannot open " << files[f] << endl;
+        return 1;
+      }
+    }
+    istream& in = file.is_open() ? file : cin;
+
+    mace::ContextInteractionGraph graph;
+    string error;
+    while (graph.read(in, error)) {
+      period++;
+      for (size_t p = 0; p < policies.size(); p++) {
+        vector<uint32_t> current = graph.currentAssignment();
+        for (uint32_t i = 0; i < graph.contextCount(); i++) {
+          const mace::ContextInteractionGraph::Context& ctx = graph.getContext(i);
+          map<string, string>::const_iterator placed = placements[p].find(ctx.name);
+          if (!ctx.pinned && placed != placements[p].end() && graph.hasServer(placed->second)) {
+            current[i] = graph.getServerId(placed->second);
+          }
+        }
+
+        vector<uint32_t> next = current;
+        if (policies[p] == "greedy") {
+          next = greedy(graph, current, imbalance);
+        }
+        else if (policies[p] == "partition") {
+          // the partitioner plans relative to the placement it is given
+          mace::ContextInteractionGraph replay;
+          for (uint32_t s = 0; s < graph.serverCount(); s++) {
+            replay.addServer(graph.getServer(s).name, graph.getServer(s).capacity, graph.getServer(s).baseLoad);
+          }
+          for (uint32_t i = 0; i < graph.contextCount(); i++) {
+            replay.addContext(graph.getContext(i).name, graph.getContext(i).weight, current[i], graph.getContext(i).pinned);
+          }
+          for (uint32_t i = 0; i < graph.contextCount(); i++) {
+            const mace::ContextInteractionGraph::EdgeMap& edges = graph.getEdges(i);
+            for (mace::ContextInteractionGraph::EdgeMap::const_iterator e = edges.upper_bound(i); e != edges.end(); e++) {
+              replay.addInteraction(graph.getContext(i).name, graph.getContext(e->first).name, e->second);
+            }
+          }
+          next = partitioner.partition(replay);
+        }
+
+        uint64_t migrations = 0;
+        for (uint32_t i = 0; i < graph.contextCount(); i++) {
+          if (next[i] != current[i]) {
+            migrations++;
+          }
+          placements[p][graph.getContext(i).name] = graph.getServer(next[i]).name;
+        }
+        double maxLoad = 0;
+        vector<double> loads = graph.serverLoads(next);
+        for (uint32_t s = 0; s < graph.serverCount(); s++) {
+          if (graph.getServer(s).capacity > 0) {
+            maxLoad = max(maxLoad, loads[s] / graph.getServer(s).capacity);
+          }
+        }
+
+        Result& r = results[p];
+        uint64_t cut = graph.cutWeight(next);
+        r.cut += cut;
+        r.total += graph.totalWeight();
+        r.migrations += migrations;
+        r.maxLoad = max(r.maxLoad, maxLoad);
+        if (verbose) {
+          cout << period << " " << policies[p] << " cut " << cut << "/" << graph.totalWeight() << " load "
+               << setprecision(3) << maxLoad << " migrations " << migrations << endl;
+        }
+      }
+    }
+    if (!error.empty()) {
+      cerr << files[f] << ": " << error << endl;
+      return 1;
+    }
+  }
+
+  cout << period << " periods" << endl;
+  cout << left << setw(10) << "policy" << right << setw(14) << "cut" << setw(8) << "cut%" << setw(10) << "max load"
+       << setw(12) << "migrations" << endl;
+  for (size_t p = 0; p < policies.size(); p++) {
+    const Result& r = results[p];
+    cout << left << setw(10) << policies[p] << right << setw(14) << r.cut << setw(8) << fixed << setprecision(1)
+         << (r.total ? 100.0 * r.cut / r.total : 0.0) << setw(10) << setprecision(2) << r.maxLoad
+         << setw(12) << r.migrations << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+/* 
+ * walbench.cc : part of the Mace toolkit for building distributed systems
+ * 
+ * Copyright (c) 2011, Charles Killian, Dejan Kostic, Ryan Braud, James W. Anderson, John Fisher-Ogden, Calvin Hubble, Duy Nguyen, Justin Burke, David Oppenheimer, Amin Vahdat, Adolfo Rodriguez, Sooraj Bhat
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of the contributors, nor their associated universities 
+ *      or organizations may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * ----END-OF-LEGAL-STUFF---- */
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <pthread.h>
+#include "../lib/TimeUtil.h"
+#include "../lib/WriteAheadLog.h"
+
+// Measures acceptor-log throughput on local disk: how many accept records per
+// second the WriteAheadLog sustains when one fdatasync covers a group of
+// accepts, for a range of group sizes.  With threads > 1, each thread syncs
+// its own records and the log merges concurrent syncs (group commit).
+//
+// usage: walbench [dir] [records per run] [record bytes] [threads]
+
+using namespace std;
+
+namespace {
+  struct WorkerArgs {
+    mace::WriteAheadLog* wal;
+    const string* record;
+    uint64_t records;
+    uint64_t group;
+  };
+
+  void* worker(void* p) {
+    WorkerArgs* args = (WorkerArgs*)p;
+    for (uint64_t i = 0; i < args->records; i += args->group) {
+      uint64_t lsn = 0;
+      for (uint64_t j = i; j < i + args->group && j < args->records; j++) {
+        lsn = args->wal->append(*args->record);
+      }
+      args->wal->sync(lsn);
+    }
+    return NULL;
+  }
+
+  class NullRecovery : public mace::WriteAheadLog::RecoveryHandler {
+  public:
+    void recoverCheckpoint(uint64_t lsn, const std::string& snapshot) { }
+    void recoverRecord(uint64_t lsn, const std::string& record) { }
+  };
+}
+
+int main(int argc, char* argv[]) {
+  string dir = argc > 1 ? argv[1] : "walbench.d";
+  uint64_t records = argc > 2 ? strtoull(argv[2], NULL, 10) : 20000;
+  size_t recordSize = argc > 3 ? strtoul(argv[3], NULL, 10) : 128;
+  int threads = argc > 4 ? atoi(argv[4]) : 1;
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  string record(recordSize, 'x');
+  const uint64_t groups[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+
+  cout << "dir " << dir << " records " << records << " record_bytes " << recordSize << " threads " << threads << endl;
+  cout << setw(8) << "group" << setw(14) << "accepts/sec" << setw(12) << "fsyncs" << setw(14) << "usec/accept" << endl;
+  for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+    if (system(("rm -rf '" + dir + "'").c_str()) != 0) {
+      cerr << "cannot clear " << dir << endl;
+      return 1;
+    }
+    NullRecovery recovery;
+    mace::WriteAheadLog wal(dir);
+    wal.open(recovery);
+
+    WorkerArgs args;
+    args.wal = &wal;
+    args.record = &record;
+    args.records = records / threads;
+    args.group = groups[g];
+
+    uint64_t start = TimeUtil::timeu();
+    pthread_t tids[threads];
+    for (int t = 0; t < threads; t++) {
+      pthread_create(&tids[t], NULL, worker, &args);
+    }
+    for (int t = 0; t < threads; t++) {
+      pthread_join(tids[t], NULL);
+    }
+    uint64_t elapsed = TimeUtil::timeu() - start;
+
+    uint64_t done = args.records * threads;
+    cout << setw(8) << groups[g]
+         << setw(14) << (uint64_t)(done * 1000000.0 / elapsed)
+         << setw(12) << wal.getSyncCount()
+         << setw(14) << setprecision(3) << fixed << (double)elapsed / done << endl;
+    wal.close();
+  }
+  if (system(("rm -rf '" + dir + "'").c_str()) != 0) {
+    return 1;
+  }
+  return 0;
+}